@@ -0,0 +1,119 @@
+#include "d3d11_backend_bench.h"
+
+#include <foundation/allocator.h>
+#include <foundation/log.h>
+#include <foundation/os.h>
+
+#include <plugins/d3d11_render_backend/d3d11_render_backend.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+// Each size is sorted this many times, the fastest run is reported.
+#define NUM_RUNS 5
+
+static const uint32_t sizes[] = { 10 * 1000, 100 * 1000, 1000 * 1000 };
+
+// Workload names of `sizes` in the reported results.
+static const char *size_names[] = { "10k", "100k", "1m" };
+TM_STATIC_ASSERT(TM_ARRAY_COUNT(size_names) == TM_ARRAY_COUNT(sizes));
+
+// Sort keys laid out like the renderer's: a few bits of layer, a quantized depth and a shader
+// index, with the low bits unused.
+static uint64_t
+draw_sort_key(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+
+    const uint64_t layer = x & 0xf;
+    const uint64_t depth = (x >> 8) & 0xffffff;
+    const uint64_t shader = (x >> 32) & 0x3ff;
+    return layer << 56 | depth << 32 | shader << 16;
+}
+
+// Ties are broken on the command pointer, so the comparison sort gives the same stable order as
+// the radix sort.
+static int
+compare_pairs(const void *a, const void *b)
+{
+    const struct tm_d3d11_sort_pair_t *x = a, *y = b;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    return x->command < y->command ? -1 : x->command > y->command;
+}
+
+static double
+time_qsort(const struct tm_d3d11_sort_pair_t *input, struct tm_d3d11_sort_pair_t *pairs, uint32_t n)
+{
+    double best = 1e9;
+    for (uint32_t run = 0; run != NUM_RUNS; ++run)
+    {
+        memcpy(pairs, input, n * sizeof(*pairs));
+        const tm_clock_o start = tm_os_api->time->now();
+        qsort(pairs, n, sizeof(*pairs), compare_pairs);
+        best = tm_min(best, tm_os_api->time->delta(tm_os_api->time->now(), start));
+    }
+    return best;
+}
+
+static double
+time_radix_sort(const struct tm_d3d11_sort_pair_t *input, struct tm_d3d11_sort_pair_t *pairs, uint32_t n,
+    void *scratch, uint32_t max_jobs)
+{
+    double best = 1e9;
+    for (uint32_t run = 0; run != NUM_RUNS; ++run)
+    {
+        memcpy(pairs, input, n * sizeof(*pairs));
+        const tm_clock_o start = tm_os_api->time->now();
+        tm_d3d11_api->sort_commands(pairs, n, scratch, max_jobs);
+        best = tm_min(best, tm_os_api->time->delta(tm_os_api->time->now(), start));
+    }
+    return best;
+}
+
+void
+bench__command_sort(struct tm_allocator_i *allocator)
+{
+    const uint32_t num_processors = tm_os_api->info->num_logical_processors();
+
+    TM_LOG("%10s %12s %12s %12s %10s", "draws", "qsort ms", "radix ms", "radix/N ms", "speedup");
+    for (const uint32_t *size = sizes; size != sizes + TM_ARRAY_COUNT(sizes); ++size)
+    {
+        const uint32_t n = *size;
+        const uint64_t pairs_size = n * sizeof(struct tm_d3d11_sort_pair_t);
+        const uint64_t scratch_size = tm_d3d11_api->sort_commands_memory_needed(n, num_processors);
+
+        struct tm_d3d11_sort_pair_t *input = tm_alloc(allocator, pairs_size);
+        struct tm_d3d11_sort_pair_t *pairs = tm_alloc(allocator, pairs_size);
+        void *scratch = tm_alloc(allocator, scratch_size);
+
+        // The commands are never dereferenced, they only need to be distinct.
+        uint64_t state = 0x9e3779b97f4a7c15ULL;
+        for (uint32_t i = 0; i != n; ++i)
+        {
+            input[i] = (struct tm_d3d11_sort_pair_t) {
+                .key     = draw_sort_key(&state),
+                .command = (const struct tm_renderer_command_t *)(uintptr_t)((i + 1) * 16),
+            };
+        }
+
+        const double comparison = time_qsort(input, pairs, n);
+        const double radix = time_radix_sort(input, pairs, n, scratch, 1);
+        const double radix_jobs = time_radix_sort(input, pairs, n, scratch, num_processors);
+        TM_LOG("%10u %12.3f %12.3f %12.3f %9.2fx", n, comparison * 1000, radix * 1000, radix_jobs * 1000,
+            comparison / tm_min(radix, radix_jobs));
+
+        const char *workload = size_names[size - sizes];
+        bench__report("command_sort", workload, "qsort_ms", comparison * 1000);
+        bench__report("command_sort", workload, "radix_ms", radix * 1000);
+        bench__report("command_sort", workload, "radix_jobs_ms", radix_jobs * 1000);
+
+        tm_free(allocator, scratch, scratch_size);
+        tm_free(allocator, pairs, pairs_size);
+        tm_free(allocator, input, pairs_size);
+    }
+}
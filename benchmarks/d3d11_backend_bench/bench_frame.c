@@ -0,0 +1,335 @@
+#include "d3d11_backend_bench.h"
+
+#include <foundation/allocator.h>
+#include <foundation/error.h>
+#include <foundation/log.h>
+#include <foundation/os.h>
+#include <foundation/temp_allocator.h>
+
+#include <plugins/d3d11_render_backend/d3d11_render_backend.h>
+#include <plugins/renderer/render_backend.h>
+#include <plugins/renderer/render_command_buffer.h>
+#include <plugins/renderer/renderer.h>
+#include <plugins/renderer/renderer_api_types.h>
+#include <plugins/renderer/resource_command_buffer.h>
+
+#include <string.h>
+
+// Frames run before measuring, so pools and rings have grown to their steady state, and frames
+// measured.
+#define NUM_WARMUP_FRAMES 8
+#define NUM_FRAMES 64
+
+#define NUM_DRAWS 10000
+#define NUM_SHADERS 16
+#define NUM_BINDERS 256
+
+// Buffers created and destroyed per frame by `handle_churn` and updated per frame by `uploads`.
+#define NUM_CHURN_BUFFERS 1024
+#define NUM_UPLOADS 1024
+#define UPLOAD_SIZE 256
+
+// Allocator that counts the allocations made through it and tracks the live and peak bytes. The
+// backend allocates from job threads, so the counters are guarded.
+struct counting_allocator_t
+{
+    struct tm_allocator_i *parent;
+    tm_critical_section_o lock;
+
+    uint64_t num_allocations;
+    uint64_t live_bytes;
+    uint64_t peak_bytes;
+};
+
+static void *
+counting_realloc(struct tm_allocator_i *a, void *ptr, uint64_t old_size, uint64_t new_size, const char *file,
+    uint32_t line)
+{
+    struct counting_allocator_t *c = (struct counting_allocator_t *)a->inst;
+    void *res = c->parent->realloc(c->parent, ptr, old_size, new_size, file, line);
+
+    tm_os_api->thread->enter_critical_section(&c->lock);
+    if (new_size)
+        ++c->num_allocations;
+    c->live_bytes = c->live_bytes + new_size - old_size;
+    c->peak_bytes = tm_max(c->peak_bytes, c->live_bytes);
+    tm_os_api->thread->leave_critical_section(&c->lock);
+
+    return res;
+}
+
+// Resources shared by the workloads.
+struct frame_scene_t
+{
+    struct tm_d3d11_backend_i *backend;
+    struct tm_renderer_backend_i *rb;
+
+    tm_renderer_handle_t shaders[NUM_SHADERS];
+    tm_renderer_handle_t binders[NUM_BINDERS];
+    tm_renderer_handle_t constants[NUM_BINDERS];
+    tm_renderer_handle_t uploads[NUM_UPLOADS];
+
+    // Buffers created by the previous frame of `handle_churn`.
+    tm_renderer_handle_t churn[NUM_CHURN_BUFFERS];
+    bool has_churn;
+    TM_PAD(7);
+};
+
+// Any non-empty blob is a valid shader on the recording device.
+static const uint8_t dummy_bytecode[16] = { 0x44, 0x58, 0x42, 0x43 };
+
+static void
+create_scene(struct frame_scene_t *s)
+{
+    struct tm_renderer_resource_command_buffer_api *rcb_api = tm_renderer_api->tm_renderer_resource_command_buffer_api;
+
+    struct tm_renderer_resource_command_buffer_o *buf;
+    s->rb->create_resource_command_buffers(s->rb->inst, &buf, 1);
+
+    for (uint32_t i = 0; i != NUM_SHADERS; ++i)
+    {
+        tm_renderer_shader_t shader = { 0 };
+        shader.stages[TM_RENDERER_SHADER_STAGE_VERTEX] = (tm_renderer_shader_blob_t) { .size = sizeof(dummy_bytecode), .data = dummy_bytecode };
+        shader.stages[TM_RENDERER_SHADER_STAGE_PIXEL] = (tm_renderer_shader_blob_t) { .size = sizeof(dummy_bytecode), .data = dummy_bytecode };
+        s->shaders[i] = rcb_api->create_shader(buf, &shader, TM_RENDERER_DEVICE_AFFINITY_MASK_ALL);
+    }
+
+    const tm_renderer_resource_bind_point_t bind_point = {
+        .binding     = 0,
+        .type        = TM_RENDERER_BIND_POINT_TYPE_CONSTANT_BUFFER,
+        .stage_flags = TM_RENDERER_SHADER_STAGE_FLAG_VERTEX | TM_RENDERER_SHADER_STAGE_FLAG_PIXEL,
+    };
+    const tm_renderer_buffer_desc_t constants_desc = {
+        .size        = UPLOAD_SIZE,
+        .usage_flags = TM_RENDERER_BUFFER_USAGE_UNIFORM,
+        .debug_tag   = "bench_constants",
+    };
+    for (uint32_t i = 0; i != NUM_BINDERS; ++i)
+    {
+        s->constants[i] = rcb_api->create_buffer(buf, &constants_desc, TM_RENDERER_DEVICE_AFFINITY_MASK_ALL);
+        s->binders[i] = rcb_api->create_resource_binder(buf, &bind_point, 1, TM_RENDERER_DEVICE_AFFINITY_MASK_ALL);
+        rcb_api->set_resource(buf, s->binders[i], 0, s->constants[i], 0);
+    }
+    for (uint32_t i = 0; i != NUM_UPLOADS; ++i)
+        s->uploads[i] = rcb_api->create_buffer(buf, &constants_desc, TM_RENDERER_DEVICE_AFFINITY_MASK_ALL);
+
+    s->rb->submit_resource_command_buffers(s->rb->inst, &buf, 1);
+    s->rb->destroy_resource_command_buffers(s->rb->inst, &buf, 1);
+}
+
+static void
+destroy_scene(struct frame_scene_t *s)
+{
+    struct tm_renderer_resource_command_buffer_api *rcb_api = tm_renderer_api->tm_renderer_resource_command_buffer_api;
+
+    struct tm_renderer_resource_command_buffer_o *buf;
+    s->rb->create_resource_command_buffers(s->rb->inst, &buf, 1);
+    for (uint32_t i = 0; i != NUM_SHADERS; ++i)
+        rcb_api->destroy_resource(buf, s->shaders[i]);
+    for (uint32_t i = 0; i != NUM_BINDERS; ++i)
+    {
+        rcb_api->destroy_resource(buf, s->binders[i]);
+        rcb_api->destroy_resource(buf, s->constants[i]);
+    }
+    for (uint32_t i = 0; i != NUM_UPLOADS; ++i)
+        rcb_api->destroy_resource(buf, s->uploads[i]);
+    for (uint32_t i = 0; s->has_churn && i != NUM_CHURN_BUFFERS; ++i)
+        rcb_api->destroy_resource(buf, s->churn[i]);
+    s->rb->submit_resource_command_buffers(s->rb->inst, &buf, 1);
+    s->rb->destroy_resource_command_buffers(s->rb->inst, &buf, 1);
+}
+
+// Workloads
+
+// Records and submits one frame of `workload` and returns the number of operations it timed:
+// draws for the draw workloads, resource commands for the others.
+typedef uint32_t (*workload_f)(struct frame_scene_t *s, double *seconds);
+
+// Submits `NUM_DRAWS` draws with the shader and binder of each picked by `pick()`.
+static uint32_t
+submit_draws(struct frame_scene_t *s, double *seconds, uint32_t (*pick)(uint32_t i, uint32_t n))
+{
+    struct tm_renderer_command_buffer_api *cb_api = tm_renderer_api->tm_renderer_command_buffer_api;
+
+    TM_INIT_TEMP_ALLOCATOR(ta);
+    uint64_t *keys = tm_temp_alloc(ta, NUM_DRAWS * sizeof(*keys));
+    tm_renderer_draw_call_info_t *draws = tm_temp_alloc(ta, NUM_DRAWS * sizeof(*draws));
+    tm_renderer_shader_info_t *shaders = tm_temp_alloc(ta, NUM_DRAWS * sizeof(*shaders));
+    memset(shaders, 0, NUM_DRAWS * sizeof(*shaders));
+
+    for (uint32_t i = 0; i != NUM_DRAWS; ++i)
+    {
+        keys[i] = (uint64_t)i << 16;
+        draws[i] = (tm_renderer_draw_call_info_t) {
+            .primitive_type = TM_RENDERER_PRIMITIVE_TYPE_TRIANGLE_LIST,
+            .draw_type      = TM_RENDERER_DRAW_TYPE_NON_INDEXED,
+            .non_indexed    = { .num_vertices = 3, .num_instances = 1 },
+        };
+        shaders[i].shader = s->shaders[pick(i, NUM_SHADERS)];
+        shaders[i].resource_binders[0] = s->binders[pick(i, NUM_BINDERS)];
+        shaders[i].num_resource_binders = 1;
+    }
+
+    struct tm_renderer_command_buffer_o *buf;
+    s->rb->create_command_buffers(s->rb->inst, &buf, 1);
+    cb_api->draw_calls(buf, keys, draws, shaders, NUM_DRAWS);
+
+    const tm_clock_o start = tm_os_api->time->now();
+    s->rb->submit_command_buffers(s->rb->inst, &buf, 1);
+    *seconds = tm_os_api->time->delta(tm_os_api->time->now(), start);
+
+    s->rb->destroy_command_buffers(s->rb->inst, &buf, 1);
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+    return NUM_DRAWS;
+}
+
+// Spreads the draws over all shaders and binders, so every draw changes state.
+static uint32_t
+pick_spread(uint32_t i, uint32_t n)
+{
+    return (i * 7919) % n;
+}
+
+// Runs of 64 draws share their shader and binder, so most state calls are redundant.
+static uint32_t
+pick_runs(uint32_t i, uint32_t n)
+{
+    return (i / 64) % 2;
+}
+
+static uint32_t
+workload_draws(struct frame_scene_t *s, double *seconds)
+{
+    return submit_draws(s, seconds, pick_spread);
+}
+
+static uint32_t
+workload_state_dedup(struct frame_scene_t *s, double *seconds)
+{
+    return submit_draws(s, seconds, pick_runs);
+}
+
+// Destroys the buffers created by the previous frame and creates as many new ones.
+static uint32_t
+workload_handle_churn(struct frame_scene_t *s, double *seconds)
+{
+    struct tm_renderer_resource_command_buffer_api *rcb_api = tm_renderer_api->tm_renderer_resource_command_buffer_api;
+
+    struct tm_renderer_resource_command_buffer_o *buf;
+    s->rb->create_resource_command_buffers(s->rb->inst, &buf, 1);
+    for (uint32_t i = 0; s->has_churn && i != NUM_CHURN_BUFFERS; ++i)
+        rcb_api->destroy_resource(buf, s->churn[i]);
+    for (uint32_t i = 0; i != NUM_CHURN_BUFFERS; ++i)
+    {
+        const tm_renderer_buffer_desc_t desc = {
+            .size        = 1024 + (i % 16) * 256,
+            .usage_flags = TM_RENDERER_BUFFER_USAGE_VERTEX,
+            .debug_tag   = "bench_churn",
+        };
+        s->churn[i] = rcb_api->create_buffer(buf, &desc, TM_RENDERER_DEVICE_AFFINITY_MASK_ALL);
+    }
+
+    const tm_clock_o start = tm_os_api->time->now();
+    s->rb->submit_resource_command_buffers(s->rb->inst, &buf, 1);
+    *seconds = tm_os_api->time->delta(tm_os_api->time->now(), start);
+
+    s->rb->destroy_resource_command_buffers(s->rb->inst, &buf, 1);
+    const uint32_t ops = s->has_churn ? 2 * NUM_CHURN_BUFFERS : NUM_CHURN_BUFFERS;
+    s->has_churn = true;
+    return ops;
+}
+
+// Updates every upload buffer, like per-frame constants.
+static uint32_t
+workload_uploads(struct frame_scene_t *s, double *seconds)
+{
+    struct tm_renderer_resource_command_buffer_api *rcb_api = tm_renderer_api->tm_renderer_resource_command_buffer_api;
+
+    struct tm_renderer_resource_command_buffer_o *buf;
+    s->rb->create_resource_command_buffers(s->rb->inst, &buf, 1);
+    for (uint32_t i = 0; i != NUM_UPLOADS; ++i)
+    {
+        void *data;
+        rcb_api->update_buffer(buf, s->uploads[i], 0, UPLOAD_SIZE, TM_RENDERER_DEVICE_AFFINITY_MASK_ALL, 0, &data);
+        memset(data, (int)i, UPLOAD_SIZE);
+    }
+
+    const tm_clock_o start = tm_os_api->time->now();
+    s->rb->submit_resource_command_buffers(s->rb->inst, &buf, 1);
+    *seconds = tm_os_api->time->delta(tm_os_api->time->now(), start);
+
+    s->rb->destroy_resource_command_buffers(s->rb->inst, &buf, 1);
+    return NUM_UPLOADS;
+}
+
+static const struct
+{
+    const char *name;
+    const char *unit;
+    workload_f run;
+} workloads[] = {
+    { "draws", "ns/draw", workload_draws },
+    { "state_dedup", "ns/draw", workload_state_dedup },
+    { "handle_churn", "ns/command", workload_handle_churn },
+    { "uploads", "ns/command", workload_uploads },
+};
+
+void
+bench__frame(struct tm_allocator_i *allocator)
+{
+    struct counting_allocator_t counter = { .parent = allocator };
+    tm_os_api->thread->create_critical_section(&counter.lock);
+    struct tm_allocator_i counting = { .inst = (struct tm_allocator_o *)&counter, .realloc = counting_realloc };
+
+    struct tm_d3d11_backend_i *backend = tm_d3d11_api->create_backend(&counting, tm_error_api->def);
+    backend->init(backend->inst);
+    backend->create_recording_device(backend->inst);
+
+    struct frame_scene_t scene = { .backend = backend, .rb = backend->agnostic_render_backend(backend->inst) };
+    create_scene(&scene);
+
+    TM_LOG("%14s %12s %14s %12s %14s", "workload", "ns/op", "unit", "allocs/frame", "peak bytes");
+    for (uint32_t w = 0; w != TM_ARRAY_COUNT(workloads); ++w)
+    {
+        double seconds;
+        for (uint32_t i = 0; i != NUM_WARMUP_FRAMES; ++i)
+            workloads[w].run(&scene, &seconds);
+
+        struct tm_d3d11_statistics_t before, after;
+        backend->statistics(backend->inst, &before);
+        const uint64_t allocations = counter.num_allocations;
+        counter.peak_bytes = counter.live_bytes;
+
+        double total = 0;
+        uint64_t ops = 0;
+        for (uint32_t i = 0; i != NUM_FRAMES; ++i)
+        {
+            ops += workloads[w].run(&scene, &seconds);
+            total += seconds;
+        }
+        backend->statistics(backend->inst, &after);
+
+        const double ns_per_op = 1e9 * total / (double)ops;
+        const double allocs_per_frame = (double)(counter.num_allocations - allocations) / NUM_FRAMES;
+        TM_LOG("%14s %12.1f %14s %12.1f %14llu", workloads[w].name, ns_per_op, workloads[w].unit, allocs_per_frame,
+            (unsigned long long)counter.peak_bytes);
+
+        bench__report("frame", workloads[w].name, workloads[w].unit, ns_per_op);
+        bench__report("frame", workloads[w].name, "allocations/frame", allocs_per_frame);
+        bench__report("frame", workloads[w].name, "peak_bytes", (double)counter.peak_bytes);
+        bench__report("frame", workloads[w].name, "frame_arena_high_water", (double)after.frame_arena_high_water);
+
+        const uint64_t issued = after.num_state_calls_issued - before.num_state_calls_issued;
+        const uint64_t filtered = after.num_state_calls_filtered - before.num_state_calls_filtered;
+        if (issued + filtered)
+            bench__report("frame", workloads[w].name, "state_calls_filtered", (double)filtered / (double)(issued + filtered));
+    }
+
+    destroy_scene(&scene);
+
+    backend->destroy_device(backend->inst);
+    backend->shutdown(backend->inst);
+    tm_d3d11_api->destroy_backend(backend);
+
+    tm_os_api->thread->destroy_critical_section(&counter.lock);
+}
@@ -0,0 +1,136 @@
+#include "d3d11_backend_bench.h"
+
+#include <foundation/allocator.h>
+#include <foundation/error.h>
+#include <foundation/log.h>
+#include <foundation/os.h>
+#include <foundation/temp_allocator.h>
+
+#include <plugins/d3d11_render_backend/d3d11_render_backend.h>
+#include <plugins/renderer/render_backend.h>
+#include <plugins/renderer/renderer.h>
+#include <plugins/renderer/renderer_api_types.h>
+#include <plugins/renderer/resource_command_buffer.h>
+
+// Resources created per load, in the proportions of a level load: mostly vertex and index
+// buffers, some textures.
+#define NUM_BUFFERS 24576
+#define NUM_IMAGES 8192
+
+// Each job count loads this many times, the fastest run is reported.
+#define NUM_RUNS 3
+
+// Records the creation of all resources in `buffers`, spread over them like the renderer's
+// loading jobs do, and stores the handles in `handles`.
+static void
+record_load(struct tm_renderer_resource_command_buffer_o **buffers, uint32_t num_buffers, tm_renderer_handle_t *handles)
+{
+    struct tm_renderer_resource_command_buffer_api *rcb_api = tm_renderer_api->tm_renderer_resource_command_buffer_api;
+
+    for (uint32_t i = 0; i != NUM_BUFFERS + NUM_IMAGES; ++i)
+    {
+        struct tm_renderer_resource_command_buffer_o *buf = buffers[i % num_buffers];
+        if (i < NUM_BUFFERS)
+        {
+            const tm_renderer_buffer_desc_t desc = {
+                .size        = 4096 + (i % 61) * 256,
+                .usage_flags = i % 3 ? TM_RENDERER_BUFFER_USAGE_VERTEX : TM_RENDERER_BUFFER_USAGE_INDEX,
+                .debug_tag   = "bench_buffer",
+            };
+            handles[i] = rcb_api->create_buffer(buf, &desc, TM_RENDERER_DEVICE_AFFINITY_MASK_ALL);
+        }
+        else
+        {
+            const tm_renderer_image_desc_t desc = {
+                .type         = TM_RENDERER_IMAGE_TYPE_2D,
+                .format       = TM_RENDERER_FORMAT_BC1_RGBA_UNORM,
+                .width        = 256u << (i % 3),
+                .height       = 256u << (i % 3),
+                .depth        = 1,
+                .mip_levels   = 9 + i % 3,
+                .layer_count  = 1,
+                .sample_count = 1,
+                .debug_tag    = "bench_image",
+            };
+            handles[i] = rcb_api->create_image(buf, &desc, TM_RENDERER_DEVICE_AFFINITY_MASK_ALL);
+        }
+    }
+}
+
+// Loads and unloads all resources with at most `max_jobs` resource jobs and returns the time the
+// load submit took.
+static double
+load(struct tm_d3d11_backend_i *backend, tm_renderer_handle_t *handles, uint32_t max_jobs)
+{
+    struct tm_renderer_backend_i *rb = backend->agnostic_render_backend(backend->inst);
+    struct tm_renderer_resource_command_buffer_api *rcb_api = tm_renderer_api->tm_renderer_resource_command_buffer_api;
+    backend->set_max_resource_jobs(backend->inst, max_jobs);
+
+    struct tm_renderer_resource_command_buffer_o *buffers[8];
+    rb->create_resource_command_buffers(rb->inst, buffers, TM_ARRAY_COUNT(buffers));
+    record_load(buffers, TM_ARRAY_COUNT(buffers), handles);
+
+    const tm_clock_o start = tm_os_api->time->now();
+    rb->submit_resource_command_buffers(rb->inst, buffers, TM_ARRAY_COUNT(buffers));
+    const double seconds = tm_os_api->time->delta(tm_os_api->time->now(), start);
+    rb->destroy_resource_command_buffers(rb->inst, buffers, TM_ARRAY_COUNT(buffers));
+
+    struct tm_renderer_resource_command_buffer_o *unload;
+    rb->create_resource_command_buffers(rb->inst, &unload, 1);
+    for (uint32_t i = 0; i != NUM_BUFFERS + NUM_IMAGES; ++i)
+        rcb_api->destroy_resource(unload, handles[i]);
+    rb->submit_resource_command_buffers(rb->inst, &unload, 1);
+    rb->destroy_resource_command_buffers(rb->inst, &unload, 1);
+
+    return seconds;
+}
+
+void
+bench__resource_load(struct tm_allocator_i *allocator)
+{
+    struct tm_d3d11_backend_i *backend = tm_d3d11_api->create_backend(allocator, tm_error_api->def);
+    backend->init(backend->inst);
+    backend->create_recording_device(backend->inst);
+
+    TM_INIT_TEMP_ALLOCATOR(ta);
+    tm_renderer_handle_t *handles = tm_temp_alloc(ta, (NUM_BUFFERS + NUM_IMAGES) * sizeof(*handles));
+
+    const uint32_t num_processors = tm_os_api->info->num_logical_processors();
+
+    TM_LOG("%8s %14s %10s %8s", "jobs", "resources/s", "speedup", "on jobs");
+    double single_job = 0;
+    for (uint32_t jobs = 1;; jobs = tm_min(jobs * 2, num_processors))
+    {
+        struct tm_d3d11_statistics_t before, after;
+        backend->statistics(backend->inst, &before);
+
+        double best = 1e9;
+        for (uint32_t run = 0; run != NUM_RUNS; ++run)
+            best = tm_min(best, load(backend, handles, jobs));
+        if (jobs == 1)
+            single_job = best;
+
+        backend->statistics(backend->inst, &after);
+        const uint64_t commands = after.num_resource_commands - before.num_resource_commands;
+        const uint64_t job_commands = after.num_resource_job_commands - before.num_resource_job_commands;
+        TM_LOG("%8u %14.0f %9.2fx %7.1f%%", jobs, (NUM_BUFFERS + NUM_IMAGES) / best, single_job / best,
+            commands ? 100.0 * (double)job_commands / (double)commands : 0.0);
+
+        // Only one job and all of them are reported, the counts in between depend on the machine.
+        if (jobs == 1)
+            bench__report("resource_load", "1_job", "resources/s", (NUM_BUFFERS + NUM_IMAGES) / best);
+
+        if (jobs == num_processors)
+        {
+            bench__report("resource_load", "all_jobs", "resources/s", (NUM_BUFFERS + NUM_IMAGES) / best);
+            bench__report("resource_load", "all_jobs", "speedup", single_job / best);
+            break;
+        }
+    }
+
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+
+    backend->destroy_device(backend->inst);
+    backend->shutdown(backend->inst);
+    tm_d3d11_api->destroy_backend(backend);
+}
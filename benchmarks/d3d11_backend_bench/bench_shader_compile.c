@@ -0,0 +1,94 @@
+#include "d3d11_backend_bench.h"
+
+#include <foundation/allocator.h>
+#include <foundation/log.h>
+#include <foundation/os.h>
+#include <foundation/temp_allocator.h>
+
+#include <plugins/d3d11_render_backend/d3d11_render_backend.h>
+#include <plugins/renderer/shader_compiler.h>
+
+// Number of distinct shaders compiled per run.
+#define NUM_SHADERS 256
+
+// Pixel shader with a loop count that differs per shader, so no two sources are the same and the
+// compile times vary like they do in a real shader repository.
+static const char *shader_format =
+    "cbuffer constants : register(b0) { float4 params[%u]; };\n"
+    "float4 ps_main(float4 pos : SV_Position, float2 uv : TEXCOORD0) : SV_Target\n"
+    "{\n"
+    "    float4 c = 0;\n"
+    "    [unroll] for (uint i = 0; i != %u; ++i)\n"
+    "        c += sin(params[i] * uv.x + pos.y) * cos(params[i] * uv.y + pos.x);\n"
+    "    return c;\n"
+    "}\n";
+
+static double
+compile_all(struct tm_renderer_shader_compiler_api *api, struct tm_allocator_i *allocator,
+    const struct tm_d3d11_shader_compile_request_t *requests, tm_renderer_shader_blob_t *results, uint32_t max_jobs)
+{
+    struct tm_renderer_shader_compiler_o *compiler = api->init(allocator);
+
+    const tm_clock_o start = tm_os_api->time->now();
+    tm_d3d11_api->compile_shaders(compiler, requests, NUM_SHADERS, results, max_jobs);
+    const double seconds = tm_os_api->time->delta(tm_os_api->time->now(), start);
+
+    for (uint32_t i = 0; i != NUM_SHADERS; ++i)
+        api->release_blob(compiler, results[i]);
+
+    struct tm_d3d11_shader_compiler_statistics_t stats;
+    tm_d3d11_api->shader_compiler_statistics(compiler, &stats);
+    if (stats.num_failures)
+        TM_LOG("%u shaders failed to compile", (uint32_t)stats.num_failures);
+
+    api->shutdown(compiler);
+    return seconds;
+}
+
+void
+bench__shader_compile(struct tm_allocator_i *allocator)
+{
+    TM_INIT_TEMP_ALLOCATOR(ta);
+
+    struct tm_d3d11_shader_compile_request_t *requests = tm_temp_alloc(ta, NUM_SHADERS * sizeof(*requests));
+    tm_renderer_shader_blob_t *results = tm_temp_alloc(ta, NUM_SHADERS * sizeof(*results));
+    for (uint32_t i = 0; i != NUM_SHADERS; ++i)
+    {
+        const uint32_t n = 8 + i % 57;
+        requests[i] = (struct tm_d3d11_shader_compile_request_t) {
+            .source          = tm_temp_allocator_api->printf(ta, shader_format, n + i / 57, n),
+            .entry_point     = "ps_main",
+            .source_language = TM_RENDERER_SHADER_SOURCE_LANGUAGE_HLSL,
+            .stage           = TM_RENDERER_SHADER_STAGE_PIXEL,
+        };
+    }
+
+    // Every compile must reach the compiler.
+    const struct tm_d3d11_shader_compiler_config_t config = { 0 };
+    tm_d3d11_api->configure_shader_compiler(&config);
+
+    struct tm_renderer_shader_compiler_api *api = tm_d3d11_api->shader_compiler();
+    const uint32_t num_processors = tm_os_api->info->num_logical_processors();
+
+    TM_LOG("%8s %12s %10s", "jobs", "shaders/s", "speedup");
+    double single_job = 0;
+    for (uint32_t jobs = 1;; jobs = tm_min(jobs * 2, num_processors))
+    {
+        const double seconds = compile_all(api, allocator, requests, results, jobs);
+        if (jobs == 1)
+            single_job = seconds;
+        TM_LOG("%8u %12.1f %9.2fx", jobs, NUM_SHADERS / seconds, single_job / seconds);
+
+        if (jobs == 1)
+            bench__report("shader_compile", "1_job", "shaders/s", NUM_SHADERS / seconds);
+
+        if (jobs == num_processors)
+        {
+            bench__report("shader_compile", "all_jobs", "shaders/s", NUM_SHADERS / seconds);
+            bench__report("shader_compile", "all_jobs", "speedup", single_job / seconds);
+            break;
+        }
+    }
+
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+}
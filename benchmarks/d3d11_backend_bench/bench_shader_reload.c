@@ -0,0 +1,203 @@
+#include "d3d11_backend_bench.h"
+
+#include <foundation/allocator.h>
+#include <foundation/error.h>
+#include <foundation/log.h>
+#include <foundation/os.h>
+#include <foundation/temp_allocator.h>
+
+#include <plugins/d3d11_render_backend/d3d11_render_backend.h>
+#include <plugins/renderer/render_backend.h>
+#include <plugins/renderer/render_command_buffer.h>
+#include <plugins/renderer/renderer.h>
+#include <plugins/renderer/renderer_api_types.h>
+#include <plugins/renderer/resource_command_buffer.h>
+#include <plugins/renderer/shader_compiler.h>
+
+#include <string.h>
+
+// Shaders watched by the reloader. They all include `common.hlsl`, which includes
+// `lighting.hlsl`.
+#define NUM_SHADERS 64
+
+// The sources are written here, relative to the working directory, and removed afterwards.
+#define SOURCE_DIR "shader_reload_bench"
+
+// Longest wait for a change to be picked up before a workload is given up.
+#define TIMEOUT_SECONDS 5.0
+
+// Each write adds a revision comment so the source differs from what the shader cache has seen
+// and every reload is a real compile.
+static const char *lighting_format =
+    "// revision %u\n"
+    "float3 lighting(float3 n, float3 l) { return saturate(dot(n, l)) * float3(1.0, 0.9, 0.8); }\n";
+
+static const char *common_format =
+    "// revision %u\n"
+    "#include \"lighting.hlsl\"\n"
+    "cbuffer constants : register(b0) { float4x4 view_projection; float4 light_dir; };\n";
+
+static const char *shader_format =
+    "// revision %u\n"
+    "#include \"common.hlsl\"\n"
+    "float4 vs_main(float3 pos : POSITION, float3 n : NORMAL, out float3 out_n : NORMAL) : SV_Position\n"
+    "{\n"
+    "    out_n = n;\n"
+    "    return mul(view_projection, float4(pos * %u.0, 1.0));\n"
+    "}\n"
+    "float4 ps_main(float4 pos : SV_Position, float3 n : NORMAL) : SV_Target\n"
+    "{\n"
+    "    return float4(lighting(normalize(n), light_dir.xyz), 1.0);\n"
+    "}\n";
+
+static void
+write_source(const char *path, const char *text)
+{
+    tm_file_o f = tm_os_api->file_io->open_output(path, false);
+    if (!f.valid)
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Failed to write `%s`", path);
+        return;
+    }
+    tm_os_api->file_io->write(f, text, strlen(text));
+    tm_os_api->file_io->close(f);
+}
+
+static const char *
+shader_path(uint32_t i, struct tm_temp_allocator_i *ta)
+{
+    return tm_temp_allocator_api->printf(ta, SOURCE_DIR "/shader_%u.hlsl", i);
+}
+
+// Renders frames until the reloader has queued the change and the backend has swapped it in.
+// Returns false on timeout.
+static bool
+wait_for_reload(struct tm_d3d11_shader_reloader_o *reloader, struct tm_renderer_backend_i *rb)
+{
+    const tm_clock_o start = tm_os_api->time->now();
+    bool queued = false;
+    while (!queued && tm_os_api->time->delta(tm_os_api->time->now(), start) < TIMEOUT_SECONDS)
+    {
+        queued = tm_d3d11_api->begin_shader_reload(reloader) > 0;
+
+        struct tm_renderer_command_buffer_o *buf;
+        rb->create_command_buffers(rb->inst, &buf, 1);
+        rb->submit_command_buffers(rb->inst, &buf, 1);
+        rb->destroy_command_buffers(rb->inst, &buf, 1);
+
+        tm_d3d11_api->end_shader_reload(reloader);
+    }
+    return queued;
+}
+
+void
+bench__shader_reload(struct tm_allocator_i *allocator)
+{
+    struct tm_d3d11_backend_i *backend = tm_d3d11_api->create_backend(allocator, tm_error_api->def);
+    backend->init(backend->inst);
+    backend->create_recording_device(backend->inst);
+    struct tm_renderer_backend_i *rb = backend->agnostic_render_backend(backend->inst);
+    struct tm_renderer_resource_command_buffer_api *rcb_api = tm_renderer_api->tm_renderer_resource_command_buffer_api;
+
+    // Every compile must reach the compiler.
+    const struct tm_d3d11_shader_compiler_config_t config = { 0 };
+    tm_d3d11_api->configure_shader_compiler(&config);
+    struct tm_renderer_shader_compiler_api *compiler_api = tm_d3d11_api->shader_compiler();
+    struct tm_renderer_shader_compiler_o *compiler = compiler_api->init(allocator);
+
+    TM_INIT_TEMP_ALLOCATOR(ta);
+
+    uint32_t revision = 0;
+    tm_os_api->file_system->make_directory(SOURCE_DIR);
+    write_source(SOURCE_DIR "/lighting.hlsl", tm_temp_allocator_api->printf(ta, lighting_format, revision));
+    write_source(SOURCE_DIR "/common.hlsl", tm_temp_allocator_api->printf(ta, common_format, revision));
+    for (uint32_t i = 0; i != NUM_SHADERS; ++i)
+        write_source(shader_path(i, ta), tm_temp_allocator_api->printf(ta, shader_format, revision, i + 1));
+
+    // Any non-empty blob is a valid shader on the recording device, the reloads replace them.
+    static const uint8_t dummy_bytecode[16];
+    const tm_renderer_shader_blob_t dummy = { .size = sizeof(dummy_bytecode), .data = (void *)dummy_bytecode };
+    tm_renderer_handle_t shaders[NUM_SHADERS];
+    struct tm_renderer_resource_command_buffer_o *res_buf;
+    rb->create_resource_command_buffers(rb->inst, &res_buf, 1);
+    for (uint32_t i = 0; i != NUM_SHADERS; ++i)
+    {
+        tm_renderer_shader_t shader = { 0 };
+        shader.stages[TM_RENDERER_SHADER_STAGE_VERTEX] = dummy;
+        shader.stages[TM_RENDERER_SHADER_STAGE_PIXEL] = dummy;
+        shaders[i] = rcb_api->create_shader(res_buf, &shader, TM_RENDERER_DEVICE_AFFINITY_MASK_ALL);
+    }
+    rb->submit_resource_command_buffers(rb->inst, &res_buf, 1);
+    rb->destroy_resource_command_buffers(rb->inst, &res_buf, 1);
+
+    struct tm_d3d11_shader_reloader_o *reloader = tm_d3d11_api->create_shader_reloader(allocator, backend, compiler,
+        SOURCE_DIR);
+    for (uint32_t i = 0; i != NUM_SHADERS; ++i)
+    {
+        struct tm_d3d11_watched_shader_t watched = { .shader = shaders[i], .path = shader_path(i, ta) };
+        watched.entry_points[TM_RENDERER_SHADER_STAGE_VERTEX] = "vs_main";
+        watched.entry_points[TM_RENDERER_SHADER_STAGE_PIXEL] = "ps_main";
+        tm_d3d11_api->watch_shader(reloader, &watched);
+    }
+
+    // Editing a shader recompiles only that shader, editing the include they share recompiles all.
+    const struct
+    {
+        const char *name;
+        const char *path;
+        const char *format;
+    } workloads[] = {
+        { "shader", SOURCE_DIR "/shader_0.hlsl", shader_format },
+        { "include", SOURCE_DIR "/lighting.hlsl", lighting_format },
+    };
+
+    TM_LOG("%10s %10s %12s %12s %12s", "edit", "shaders", "detect ms", "compile ms", "latency ms");
+    for (uint32_t w = 0; w != TM_ARRAY_COUNT(workloads); ++w)
+    {
+        // Keeps the new modification time apart from the previous one on coarse file systems.
+        tm_os_api->thread->sleep(0.05f);
+
+        struct tm_d3d11_shader_reload_statistics_t before, after;
+        tm_d3d11_api->shader_reload_statistics(reloader, &before);
+
+        ++revision;
+        // The scale argument only matters to `shader_format`, the other formats ignore it.
+        write_source(workloads[w].path, tm_temp_allocator_api->printf(ta, workloads[w].format, revision, 1));
+
+        if (!wait_for_reload(reloader, rb))
+        {
+            TM_LOG("%10s timed out", workloads[w].name);
+            continue;
+        }
+
+        tm_d3d11_api->shader_reload_statistics(reloader, &after);
+        const uint64_t num_shaders = after.num_reloaded_shaders - before.num_reloaded_shaders;
+        TM_LOG("%10s %10llu %12.2f %12.2f %12.2f", workloads[w].name, (unsigned long long)num_shaders,
+            after.detect_seconds * 1000.0, after.compile_seconds * 1000.0, after.latency_seconds * 1000.0);
+
+        bench__report("shader_reload", workloads[w].name, "shaders", (double)num_shaders);
+        bench__report("shader_reload", workloads[w].name, "compile_ms", after.compile_seconds * 1000.0);
+        bench__report("shader_reload", workloads[w].name, "latency_ms", after.latency_seconds * 1000.0);
+    }
+
+    tm_d3d11_api->destroy_shader_reloader(reloader);
+
+    rb->create_resource_command_buffers(rb->inst, &res_buf, 1);
+    for (uint32_t i = 0; i != NUM_SHADERS; ++i)
+        rcb_api->destroy_resource(res_buf, shaders[i]);
+    rb->submit_resource_command_buffers(rb->inst, &res_buf, 1);
+    rb->destroy_resource_command_buffers(rb->inst, &res_buf, 1);
+
+    for (uint32_t i = 0; i != NUM_SHADERS; ++i)
+        tm_os_api->file_system->remove_file(shader_path(i, ta));
+    tm_os_api->file_system->remove_file(SOURCE_DIR "/common.hlsl");
+    tm_os_api->file_system->remove_file(SOURCE_DIR "/lighting.hlsl");
+    tm_os_api->file_system->remove_directory(SOURCE_DIR);
+
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+
+    compiler_api->shutdown(compiler);
+    backend->destroy_device(backend->inst);
+    backend->shutdown(backend->inst);
+    tm_d3d11_api->destroy_backend(backend);
+}
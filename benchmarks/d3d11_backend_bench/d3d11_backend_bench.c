@@ -0,0 +1,220 @@
+struct tm_api_registry_api *tm_global_api_registry;
+
+struct tm_allocator_api *tm_allocator_api;
+struct tm_error_api *tm_error_api;
+struct tm_logger_api *tm_logger_api;
+struct tm_os_api *tm_os_api;
+struct tm_path_api *tm_path_api;
+struct tm_plugins_api *tm_plugins_api;
+struct tm_temp_allocator_api *tm_temp_allocator_api;
+
+struct tm_renderer_api *tm_renderer_api;
+struct tm_renderer_init_api *tm_renderer_init_api;
+struct tm_d3d11_api *tm_d3d11_api;
+
+
+#include "d3d11_backend_bench.h"
+
+#include <foundation/allocator.h>
+#include <foundation/api_registry.h>
+#include <foundation/application.h>
+#include <foundation/carray.inl>
+#include <foundation/error.h>
+#include <foundation/log.h>
+#include <foundation/os.h>
+#include <foundation/path.h>
+#include <foundation/plugin.h>
+#include <foundation/string.inl>
+#include <foundation/temp_allocator.h>
+
+#include <plugins/d3d11_render_backend/d3d11_render_backend.h>
+#include <plugins/renderer/renderer.h>
+
+#include <string.h>
+
+// Runs the benchmarks named on the command line, or all of them, and exits. With `--json` the
+// reported results are also logged as JSON, with `--json=<path>` they are written to `path`.
+//
+//     d3d11-backend-bench [--json[=<path>]] [benchmark]...
+
+static const struct bench_t benches[] = {
+    { "shader_compile", bench__shader_compile },
+    { "command_sort", bench__command_sort },
+    { "resource_load", bench__resource_load },
+    { "frame", bench__frame },
+    { "shader_reload", bench__shader_reload },
+};
+
+// Results
+
+#define MAX_RESULTS 256
+
+struct result_t
+{
+    const char *bench;
+    const char *workload;
+    const char *metric;
+    double value;
+};
+
+static struct result_t results[MAX_RESULTS];
+static uint32_t num_results;
+
+void
+bench__report(const char *bench, const char *workload, const char *metric, double value)
+{
+    if (num_results == MAX_RESULTS)
+        return;
+    results[num_results++] = (struct result_t) { bench, workload, metric, value };
+}
+
+// Returns the results as a JSON array of `{"bench", "workload", "metric", "value"}` objects.
+static const char *
+results_json(struct tm_temp_allocator_i *ta)
+{
+    const char *json = "[";
+    for (uint32_t i = 0; i != num_results; ++i)
+    {
+        const struct result_t *r = results + i;
+        json = tm_temp_allocator_api->printf(ta, "%s%s\n  { \"bench\": \"%s\", \"workload\": \"%s\", \"metric\": \"%s\", \"value\": %.6g }",
+            json, i ? "," : "", r->bench, r->workload, r->metric, r->value);
+    }
+    return tm_temp_allocator_api->printf(ta, "%s\n]\n", json);
+}
+
+// Logs the results or writes them to the path given with `--json`, if any.
+static void
+write_results(int argc, char **argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strncmp(argv[i], "--json", 6) || (argv[i][6] && argv[i][6] != '='))
+            continue;
+
+        TM_INIT_TEMP_ALLOCATOR(ta);
+        const char *json = results_json(ta);
+        if (!argv[i][6])
+        {
+            TM_LOG("%s", json);
+        }
+        else
+        {
+            const char *path = argv[i] + 7;
+            tm_file_o f = tm_os_api->file_io->open_output(path);
+            const bool ok = f.valid && tm_os_api->file_io->write(f, json, strlen(json));
+            if (f.valid)
+                tm_os_api->file_io->close(f);
+            if (!ok)
+                tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Failed to write benchmark results to `%s`", path);
+        }
+        TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+    }
+}
+
+struct tm_application_o
+{
+    struct tm_allocator_i allocator;
+};
+
+static bool
+selected(const char *name, int argc, char **argv)
+{
+    bool any = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-')
+            continue;
+        if (!strcmp(argv[i], name))
+            return true;
+        any = true;
+    }
+    return !any;
+}
+
+static tm_application_o *
+create_application(int argc, char **argv)
+{
+    // Load the plugins next to the executable, like simple-triangle does.
+    const char *exe_path = tm_os_api->system->exe_path(argv[0]);
+    {
+        TM_INIT_TEMP_ALLOCATOR(ta);
+
+        const tm_str_t exe_dir = tm_path_api->directory(tm_str(exe_path));
+        const tm_str_t plugin_dir = tm_path_api->join(exe_dir, tm_str("plugins"), ta);
+        const char **plugins = tm_plugins_api->enumerate(tm_cstring(plugin_dir, ta), ta);
+        for (const char **p = plugins; p != tm_carray_end(plugins); ++p)
+            tm_plugins_api->load(*p, false);
+
+        TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+    }
+    tm_global_api_registry->log_missing_apis();
+
+    struct tm_allocator_i a = tm_allocator_api->create_child(tm_allocator_api->system, "d3d11_backend_bench");
+    struct tm_application_o *app = tm_alloc(&a, sizeof(*app));
+    *app = (struct tm_application_o) {
+        .allocator = a,
+    };
+
+    if (!tm_d3d11_api->create_backend)
+    {
+        TM_LOG("The D3D11 render backend plugin isn't loaded");
+        return app;
+    }
+
+    // The renderer owns the command buffers the backends are driven with.
+    const uint64_t renderer_user_data_size = 8 * 1024;
+    tm_renderer_init_api->init(&app->allocator, renderer_user_data_size);
+
+    for (const struct bench_t *b = benches; b != benches + TM_ARRAY_COUNT(benches); ++b)
+    {
+        if (!selected(b->name, argc, argv))
+            continue;
+        TM_LOG("# %s", b->name);
+        b->run(&app->allocator);
+    }
+    write_results(argc, argv);
+
+    tm_renderer_init_api->shutdown();
+    return app;
+}
+
+static bool
+tick_application(struct tm_application_o *app)
+{
+    return false;
+}
+
+static void
+destroy_application(struct tm_application_o *app)
+{
+    struct tm_allocator_i a = app->allocator;
+    tm_free(&a, app, sizeof(*app));
+    tm_allocator_api->destroy_child(&a);
+}
+
+struct tm_application_api *tm_application_api = &(struct tm_application_api) {
+    .create  = create_application,
+    .tick    = tick_application,
+    .destroy = destroy_application,
+};
+
+TM_DLL_EXPORT void tm_load_plugin(struct tm_api_registry_api *reg, bool load)
+{
+    tm_global_api_registry = reg;
+
+    // foundation apis
+    tm_allocator_api           = reg->get(TM_ALLOCATOR_API_NAME);
+    tm_error_api               = reg->get(TM_ERROR_API_NAME);
+    tm_logger_api              = reg->get(TM_LOGGER_API_NAME);
+    tm_os_api                  = reg->get(TM_OS_API_NAME);
+    tm_path_api                = reg->get(TM_PATH_API_NAME);
+    tm_plugins_api             = reg->get(TM_PLUGINS_API_NAME);
+    tm_temp_allocator_api      = reg->get(TM_TEMP_ALLOCATOR_API_NAME);
+
+    // other plugin apis
+    tm_renderer_api            = reg->get(TM_RENDERER_API_NAME);
+    tm_renderer_init_api       = reg->get(TM_RENDERER_INIT_API_NAME);
+    tm_d3d11_api               = reg->get(TM_D3D11_API_NAME);
+
+    tm_set_or_remove_api(reg, load, TM_APPLICATION_API_NAME, tm_application_api);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+extern struct tm_api_registry_api *tm_global_api_registry;
+
+extern struct tm_allocator_api *tm_allocator_api;
+extern struct tm_error_api *tm_error_api;
+extern struct tm_logger_api *tm_logger_api;
+extern struct tm_os_api *tm_os_api;
+extern struct tm_path_api *tm_path_api;
+extern struct tm_plugins_api *tm_plugins_api;
+extern struct tm_temp_allocator_api *tm_temp_allocator_api;
+
+extern struct tm_renderer_api *tm_renderer_api;
+extern struct tm_renderer_init_api *tm_renderer_init_api;
+extern struct tm_d3d11_api *tm_d3d11_api;
+
+struct tm_allocator_i;
+
+// Benchmarks
+
+struct bench_t
+{
+    const char *name;
+    void (*run)(struct tm_allocator_i *allocator);
+};
+
+// Records `value` of `metric` measured by the benchmark `bench` for `workload`. The results are
+// written as JSON when the benchmarks are run with `--json`. The strings must be static.
+void bench__report(const char *bench, const char *workload, const char *metric, double value);
+
+// Compile throughput of `tm_d3d11_api->compile_shaders()` against the number of jobs.
+void bench__shader_compile(struct tm_allocator_i *allocator);
+
+// Radix sort of draw sort keys against `qsort()` at 10k, 100k and 1M draws.
+void bench__command_sort(struct tm_allocator_i *allocator);
+
+// Resource creation throughput of `submit_resource_command_buffers()` on the recording device
+// against the number of resource jobs.
+void bench__resource_load(struct tm_allocator_i *allocator);
+
+// Frames of synthetic draws, state changes, resource churn and buffer uploads submitted to the
+// recording device. Reports the time per draw or resource command, the allocations per frame and
+// the peak bytes allocated by the backend.
+void bench__frame(struct tm_allocator_i *allocator);
+
+// Time from saving a shader source to the first frame using the recompiled shader, with
+// `create_shader_reloader()`, for an edit of one shader and of an include all shaders share.
+void bench__shader_reload(struct tm_allocator_i *allocator);
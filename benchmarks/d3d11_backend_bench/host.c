@@ -0,0 +1,3 @@
+const char *main_dll = "d3d11-backend-bench-dll";
+
+#include "../../samples/simple_triangle/host.inl"
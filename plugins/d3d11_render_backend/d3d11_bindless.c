@@ -0,0 +1,408 @@
+#include "d3d11_bindless.h"
+
+#include "d3d11_device.h"
+#include "d3d11_internal.h"
+
+#include <foundation/allocator.h>
+#include <foundation/carray.inl>
+#include <foundation/log.h>
+
+#include <string.h>
+
+// Heap ranges are aligned to this, which keeps the handles of buffers 16 byte aligned offsets.
+#define HEAP_ALIGNMENT (256)
+
+// Slices of a new pool, and the most a pool can grow to (`D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION`).
+#define POOL_INITIAL_SLICES (8)
+#define POOL_MAX_SLICES (2048)
+
+static inline uint32_t
+range_size(uint32_t size)
+{
+    return (size + HEAP_ALIGNMENT - 1) & ~(HEAP_ALIGNMENT - 1u);
+}
+
+// -------------------------------------------------------------------
+// Heap
+
+static void
+remove_range(struct d3d11_bindless_t *b, uint32_t i)
+{
+    const uint32_t n = (uint32_t)tm_carray_size(b->free_ranges);
+    memmove(b->free_ranges + i, b->free_ranges + i + 1, (n - i - 1) * sizeof(*b->free_ranges));
+    tm_carray_shrink(b->free_ranges, n - 1);
+}
+
+// First fit, the heap holds long lived buffers and is seldom fragmented enough for it to matter.
+static bool
+heap_allocate(struct d3d11_bindless_t *b, uint32_t size, uint32_t *offset)
+{
+    for (struct d3d11_bindless_range_t *r = b->free_ranges; r != tm_carray_end(b->free_ranges); ++r)
+    {
+        if (r->size < size)
+            continue;
+
+        *offset = r->offset;
+        r->offset += size;
+        r->size -= size;
+        if (!r->size)
+            remove_range(b, (uint32_t)(r - b->free_ranges));
+        return true;
+    }
+    return false;
+}
+
+// Returns the range to the free list, merged with its neighbours.
+static void
+heap_free(struct d3d11_bindless_t *b, uint32_t offset, uint32_t size)
+{
+    uint32_t i = 0;
+    const uint32_t n = (uint32_t)tm_carray_size(b->free_ranges);
+    while (i != n && b->free_ranges[i].offset < offset)
+        ++i;
+
+    struct d3d11_bindless_range_t *prev = i ? b->free_ranges + i - 1 : 0;
+    struct d3d11_bindless_range_t *next = i != n ? b->free_ranges + i : 0;
+    if (prev && prev->offset + prev->size == offset)
+    {
+        prev->size += size;
+        if (next && prev->offset + prev->size == next->offset)
+        {
+            prev->size += next->size;
+            remove_range(b, i);
+        }
+    }
+    else if (next && offset + size == next->offset)
+    {
+        next->offset = offset;
+        next->size += size;
+    }
+    else
+    {
+        const struct d3d11_bindless_range_t r = { .offset = offset, .size = size };
+        tm_carray_push(b->free_ranges, r, b->allocator);
+        memmove(b->free_ranges + i + 1, b->free_ranges + i, (n - i) * sizeof(r));
+        b->free_ranges[i] = r;
+    }
+}
+
+// -------------------------------------------------------------------
+// Image pools
+
+static bool
+create_pool_texture(struct d3d11_bindless_t *b, struct d3d11_bindless_pool_t *pool, uint32_t num_slices,
+    void **texture, void **srv)
+{
+    struct d3d11_device_i *device = b->device;
+    const struct d3d11_texture_desc_t desc = {
+        .dimension           = TEXTURE_DIMENSION__2D,
+        .width               = pool->width,
+        .height              = pool->height,
+        .depth_or_array_size = num_slices,
+        .mip_levels          = pool->mip_levels,
+        .format              = pool->format,
+        .sample_count        = 1,
+        .usage               = USAGE__DEFAULT,
+        .bind_flags          = BIND_FLAG__SHADER_RESOURCE,
+    };
+    *texture = device->create_texture(device->inst, &desc, 0);
+    *srv = *texture ? device->create_view(device->inst, *texture, VIEW__SRV) : 0;
+    if (*srv)
+        return true;
+
+    if (*texture)
+        device->release(device->inst, *texture);
+    tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Failed to create a bindless image pool of %u slices", num_slices);
+    return false;
+}
+
+// Replaces the texture of `pool` with one of twice as many slices and copies the used slices over.
+static bool
+grow_pool(struct d3d11_bindless_t *b, struct d3d11_bindless_pool_t *pool)
+{
+    const uint32_t num_slices = tm_min(pool->num_slices * 2, POOL_MAX_SLICES);
+    void *texture, *srv;
+    if (num_slices == pool->num_slices || !create_pool_texture(b, pool, num_slices, &texture, &srv))
+        return false;
+
+    struct d3d11_context_i *ctx = b->device->immediate_context(b->device->inst);
+    for (uint32_t s = 0; s != pool->num_used_slices * pool->mip_levels; ++s)
+        ctx->copy_subresource(ctx->inst, texture, s, pool->texture, s);
+
+    b->device->release(b->device->inst, pool->srv);
+    b->device->release(b->device->inst, pool->texture);
+    pool->texture = texture;
+    pool->srv = srv;
+    pool->num_slices = num_slices;
+    ++b->stats.num_pool_grows;
+    return true;
+}
+
+static struct d3d11_bindless_pool_t *
+find_pool(struct d3d11_bindless_t *b, const struct d3d11_texture_desc_t *desc)
+{
+    for (struct d3d11_bindless_pool_t *pool = b->pools; pool != b->pools + b->num_pools; ++pool)
+    {
+        if (pool->format == desc->format && pool->width == desc->width && pool->height == desc->height
+            && pool->mip_levels == desc->mip_levels)
+        {
+            return pool;
+        }
+    }
+
+    if (b->num_pools == BINDLESS_MAX_IMAGE_POOLS)
+        return 0;
+
+    struct d3d11_bindless_pool_t *pool = b->pools + b->num_pools;
+    *pool = (struct d3d11_bindless_pool_t) {
+        .format     = desc->format,
+        .width      = desc->width,
+        .height     = desc->height,
+        .mip_levels = desc->mip_levels,
+        .num_slices = POOL_INITIAL_SLICES,
+    };
+    if (!create_pool_texture(b, pool, pool->num_slices, &pool->texture, &pool->srv))
+        return 0;
+
+    ++b->num_pools;
+    return pool;
+}
+
+// -------------------------------------------------------------------
+// Copies
+
+// Removes the copies from `resource`, keeping the order of the others.
+static void
+drop_copies(/* carray */ struct d3d11_bindless_copy_t *copies, void *resource)
+{
+    uint32_t n = 0;
+    for (const struct d3d11_bindless_copy_t *c = copies; c != tm_carray_end(copies); ++c)
+    {
+        if (c->src != resource)
+            copies[n++] = *c;
+    }
+    tm_carray_shrink(copies, n);
+}
+
+static void
+issue_copy(struct d3d11_bindless_t *b, struct d3d11_context_i *ctx, const struct d3d11_bindless_copy_t *c)
+{
+    if (c->size)
+    {
+        ctx->copy_buffer_region(ctx->inst, b->heap, c->handle * 16, c->src, 0, c->size);
+        b->stats.bytes_copied += c->size;
+        return;
+    }
+
+    const struct d3d11_bindless_pool_t *pool = b->pools + (c->handle >> 16);
+    const uint32_t slice = c->handle & 0xffff;
+    for (uint32_t mip = 0; mip != pool->mip_levels; ++mip)
+        ctx->copy_subresource(ctx->inst, pool->texture, mip + slice * pool->mip_levels, c->src, mip);
+    ++b->stats.num_image_copies;
+}
+
+// -------------------------------------------------------------------
+// Public
+
+bool
+d3d11_bindless__init(struct d3d11_bindless_t *b, struct tm_allocator_i *allocator, struct d3d11_device_i *device,
+    uint32_t heap_size)
+{
+    memset(b, 0, sizeof(*b));
+    b->allocator = allocator;
+    b->device = device;
+    b->heap_size = heap_size & ~(HEAP_ALIGNMENT - 1u);
+
+    const struct d3d11_buffer_desc_t desc = {
+        .size       = b->heap_size,
+        .usage      = USAGE__DEFAULT,
+        .bind_flags = BIND_FLAG__SHADER_RESOURCE,
+        .misc_flags = MISC_FLAG__BUFFER_ALLOW_RAW_VIEWS,
+    };
+    b->heap = b->heap_size ? device->create_buffer(device->inst, &desc, 0) : 0;
+    b->heap_srv = b->heap ? device->create_view(device->inst, b->heap, VIEW__SRV) : 0;
+    if (!b->heap_srv)
+    {
+        if (b->heap)
+            device->release(device->inst, b->heap);
+        memset(b, 0, sizeof(*b));
+        return false;
+    }
+
+    const struct d3d11_bindless_range_t all = { .offset = 0, .size = b->heap_size };
+    tm_carray_push(b->free_ranges, all, allocator);
+    return true;
+}
+
+void
+d3d11_bindless__shutdown(struct d3d11_bindless_t *b)
+{
+    struct d3d11_device_i *device = b->device;
+    for (struct d3d11_bindless_pool_t *pool = b->pools; pool != b->pools + b->num_pools; ++pool)
+    {
+        device->release(device->inst, pool->srv);
+        device->release(device->inst, pool->texture);
+        tm_carray_free(pool->free_slices, b->allocator);
+    }
+    if (b->heap)
+    {
+        device->release(device->inst, b->heap_srv);
+        device->release(device->inst, b->heap);
+    }
+    tm_carray_free(b->free_ranges, b->allocator);
+    tm_carray_free(b->copies, b->allocator);
+    tm_carray_free(b->gpu_written, b->allocator);
+    memset(b, 0, sizeof(*b));
+}
+
+bool
+d3d11_bindless__buffer_eligible(uint32_t bind_flags)
+{
+    return (bind_flags & BIND_FLAG__SHADER_RESOURCE) != 0;
+}
+
+bool
+d3d11_bindless__image_eligible(const struct d3d11_texture_desc_t *desc)
+{
+    return desc->dimension == TEXTURE_DIMENSION__2D && desc->depth_or_array_size == 1 && desc->sample_count == 1
+        && desc->bind_flags == BIND_FLAG__SHADER_RESOURCE && !desc->misc_flags;
+}
+
+uint32_t
+d3d11_bindless__add_buffer(struct d3d11_bindless_t *b, void *buffer, uint32_t size, bool gpu_written)
+{
+    uint32_t offset;
+    if (!heap_allocate(b, range_size(size), &offset))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Bindless heap is full, %u byte buffer has no handle", size);
+        return BINDLESS_INVALID_HANDLE;
+    }
+
+    const struct d3d11_bindless_copy_t c = { .src = buffer, .handle = offset / 16, .size = size };
+    tm_carray_push(gpu_written ? b->gpu_written : b->copies, c, b->allocator);
+    b->stats.heap_bytes += range_size(size);
+    ++b->stats.num_buffers;
+    return c.handle;
+}
+
+uint32_t
+d3d11_bindless__add_image(struct d3d11_bindless_t *b, void *texture, const struct d3d11_texture_desc_t *desc)
+{
+    struct d3d11_bindless_pool_t *pool = find_pool(b, desc);
+    if (!pool)
+        return BINDLESS_INVALID_HANDLE;
+
+    uint32_t slice;
+    if (tm_carray_size(pool->free_slices))
+        slice = tm_carray_pop(pool->free_slices);
+    else if (pool->num_used_slices != pool->num_slices || grow_pool(b, pool))
+        slice = pool->num_used_slices++;
+    else
+        return BINDLESS_INVALID_HANDLE;
+
+    const struct d3d11_bindless_copy_t c = { .src = texture, .handle = (uint32_t)(pool - b->pools) << 16 | slice };
+    tm_carray_push(b->copies, c, b->allocator);
+    ++b->stats.num_images;
+    return c.handle;
+}
+
+void
+d3d11_bindless__changed(struct d3d11_bindless_t *b, uint32_t handle, void *resource, uint32_t size)
+{
+    for (const struct d3d11_bindless_copy_t *c = b->gpu_written; c != tm_carray_end(b->gpu_written); ++c)
+    {
+        if (c->src == resource)
+            return;
+    }
+    for (const struct d3d11_bindless_copy_t *c = b->copies; c != tm_carray_end(b->copies); ++c)
+    {
+        if (c->src == resource)
+            return;
+    }
+
+    const struct d3d11_bindless_copy_t c = { .src = resource, .handle = handle, .size = size };
+    tm_carray_push(b->copies, c, b->allocator);
+}
+
+void
+d3d11_bindless__remove(struct d3d11_bindless_t *b, uint32_t handle, void *resource, uint32_t size)
+{
+    drop_copies(b->copies, resource);
+    drop_copies(b->gpu_written, resource);
+
+    if (size)
+    {
+        heap_free(b, handle * 16, range_size(size));
+        b->stats.heap_bytes -= range_size(size);
+        --b->stats.num_buffers;
+    }
+    else
+    {
+        struct d3d11_bindless_pool_t *pool = b->pools + (handle >> 16);
+        tm_carray_push(pool->free_slices, handle & 0xffff, b->allocator);
+        --b->stats.num_images;
+    }
+}
+
+void
+d3d11_bindless__flush(struct d3d11_bindless_t *b, bool gpu_written)
+{
+    if (!tm_carray_size(b->copies) && (!gpu_written || !tm_carray_size(b->gpu_written)))
+        return;
+
+    struct d3d11_context_i *ctx = b->device->immediate_context(b->device->inst);
+    for (const struct d3d11_bindless_copy_t *c = b->copies; c != tm_carray_end(b->copies); ++c)
+        issue_copy(b, ctx, c);
+    tm_carray_shrink(b->copies, 0);
+
+    if (!gpu_written)
+        return;
+    for (const struct d3d11_bindless_copy_t *c = b->gpu_written; c != tm_carray_end(b->gpu_written); ++c)
+        issue_copy(b, ctx, c);
+}
+
+void
+d3d11_bindless__views(const struct d3d11_bindless_t *b, void *views[BINDLESS_NUM_VIEWS])
+{
+    memset(views, 0, BINDLESS_NUM_VIEWS * sizeof(*views));
+    views[0] = b->heap_srv;
+    for (uint32_t i = 0; i != b->num_pools; ++i)
+        views[1 + i] = b->pools[i].srv;
+}
+
+// Shader model 5.0 can't index arrays of textures with non-literal indices, so the pool is picked
+// with a switch. Sampling inside it is fine as long as the handle is uniform over the quad.
+#define POOL(i, r) "Texture2DArray tm_bindless_pool_" #i " : register(t" #r ");\n"
+#define SAMPLE(i, r) "    case " #i ": return tm_bindless_pool_" #i ".Sample(s, c);\n"
+#define SAMPLE_LEVEL(i, r) "    case " #i ": return tm_bindless_pool_" #i ".SampleLevel(s, c, lod);\n"
+#define POOLS(X) X(0, 49) X(1, 50) X(2, 51) X(3, 52) X(4, 53) X(5, 54) X(6, 55) X(7, 56) X(8, 57) X(9, 58) \
+    X(10, 59) X(11, 60) X(12, 61) X(13, 62) X(14, 63)
+
+TM_STATIC_ASSERT(BINDLESS_HEAP_REGISTER == 48 && BINDLESS_MAX_IMAGE_POOLS == 15);
+
+static const char bindless_hlsl[] =
+    "#define TM_BINDLESS 1\n"
+    "ByteAddressBuffer tm_bindless_heap : register(t48);\n"
+    POOLS(POOL)
+    "uint tm_bindless_load(uint handle, uint offset) { return tm_bindless_heap.Load(handle * 16 + offset); }\n"
+    "uint2 tm_bindless_load2(uint handle, uint offset) { return tm_bindless_heap.Load2(handle * 16 + offset); }\n"
+    "uint3 tm_bindless_load3(uint handle, uint offset) { return tm_bindless_heap.Load3(handle * 16 + offset); }\n"
+    "uint4 tm_bindless_load4(uint handle, uint offset) { return tm_bindless_heap.Load4(handle * 16 + offset); }\n"
+    "float4 tm_bindless_sample(uint handle, SamplerState s, float2 uv)\n"
+    "{\n"
+    "    const float3 c = float3(uv, handle & 0xffff);\n"
+    "    switch (handle >> 16) {\n" POOLS(SAMPLE) "    }\n"
+    "    return 0;\n"
+    "}\n"
+    "float4 tm_bindless_sample_level(uint handle, SamplerState s, float2 uv, float lod)\n"
+    "{\n"
+    "    const float3 c = float3(uv, handle & 0xffff);\n"
+    "    switch (handle >> 16) {\n" POOLS(SAMPLE_LEVEL) "    }\n"
+    "    return 0;\n"
+    "}\n";
+
+const char *
+d3d11_bindless__hlsl(void)
+{
+    return bindless_hlsl;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+// Emulates bindless resource access on D3D11, which can't index descriptors from shaders. See
+// `tm_d3d11_bindless_t`.
+//
+// Buffers are copied into ranges of the heap, one large raw buffer that shaders read as a
+// `ByteAddressBuffer`. The bindless handle of a buffer is the offset of its range in 16 byte units.
+//
+// 2D images are copied into slices of image pools, `Texture2DArray`s of images with the same
+// format, size and number of mips. The bindless handle of an image is its pool in the high 16 bits
+// and its slice in the low 16 bits. A full pool is replaced with one of twice as many slices.
+//
+// The heap and the pools are bound at registers reserved for them, once at the start of every
+// translated range of commands. Copies are queued as resources are created and changed and
+// issued on the immediate context by `d3d11_bindless__flush()`, before the frame's commands are
+// translated. Shaders only read the copies, so buffers written by the GPU are copied again on
+// every flush and images written by the GPU don't get handles.
+
+// Shader resource register (`t#`) of the heap, the pools follow it.
+#define BINDLESS_HEAP_REGISTER (48)
+#define BINDLESS_MAX_IMAGE_POOLS (15)
+#define BINDLESS_NUM_VIEWS (1 + BINDLESS_MAX_IMAGE_POOLS)
+
+// Handle of resources without a copy.
+#define BINDLESS_INVALID_HANDLE (0xffffffffu)
+
+// Default size of the heap.
+#define BINDLESS_DEFAULT_HEAP_SIZE (64 * 1024 * 1024)
+
+struct d3d11_device_i;
+struct d3d11_texture_desc_t;
+struct tm_allocator_i;
+
+// A free range of the heap.
+struct d3d11_bindless_range_t
+{
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct d3d11_bindless_pool_t
+{
+    // Format, size and mips of the images in the pool.
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_levels;
+
+    void *texture;
+    void *srv;
+
+    // Slices of `texture`, and how many of them have been handed out so far. Freed slices are
+    // handed out again first.
+    uint32_t num_slices;
+    uint32_t num_used_slices;
+    /* carray */ uint32_t *free_slices;
+};
+
+// A copy from a resource to its range of the heap or its pool slice.
+struct d3d11_bindless_copy_t
+{
+    void *src;
+    uint32_t handle;
+
+    // Bytes to copy for buffers, 0 for images.
+    uint32_t size;
+};
+
+struct d3d11_bindless_statistics_t
+{
+    // Bytes of the heap taken by buffers, and the number of buffers and images with handles.
+    uint64_t heap_bytes;
+    uint32_t num_buffers;
+    uint32_t num_images;
+
+    // Bytes copied to the heap, images copied to the pools and the number of times a pool grew.
+    uint64_t bytes_copied;
+    uint64_t num_image_copies;
+    uint64_t num_pool_grows;
+};
+
+struct d3d11_bindless_t
+{
+    struct tm_allocator_i *allocator;
+    struct d3d11_device_i *device;
+
+    void *heap;
+    void *heap_srv;
+    uint32_t heap_size;
+    uint32_t num_pools;
+
+    // Free ranges of the heap, sorted on their offset.
+    /* carray */ struct d3d11_bindless_range_t *free_ranges;
+
+    struct d3d11_bindless_pool_t pools[BINDLESS_MAX_IMAGE_POOLS];
+
+    // Copies issued by the next flush, and the buffers written by the GPU, which every flush
+    // copies again.
+    /* carray */ struct d3d11_bindless_copy_t *copies;
+    /* carray */ struct d3d11_bindless_copy_t *gpu_written;
+
+    struct d3d11_bindless_statistics_t stats;
+};
+
+// Creates the heap of `heap_size` bytes on `device`. Returns false on failure.
+bool d3d11_bindless__init(struct d3d11_bindless_t *b, struct tm_allocator_i *allocator, struct d3d11_device_i *device,
+    uint32_t heap_size);
+
+// Releases the heap and the pools. The GPU must be done with them.
+void d3d11_bindless__shutdown(struct d3d11_bindless_t *b);
+
+// Returns true if a buffer with the `enum d3d11_bind_flag`s `bind_flags` gets a handle.
+bool d3d11_bindless__buffer_eligible(uint32_t bind_flags);
+
+// Returns true if a texture of `desc` gets a handle.
+bool d3d11_bindless__image_eligible(const struct d3d11_texture_desc_t *desc);
+
+// Allocates a range of the heap for `buffer` of `size` bytes and queues a copy of it. Buffers that
+// are `gpu_written` are copied by every flush. Returns the handle of the buffer, or
+// `BINDLESS_INVALID_HANDLE` if the heap is full.
+uint32_t d3d11_bindless__add_buffer(struct d3d11_bindless_t *b, void *buffer, uint32_t size, bool gpu_written);
+
+// Allocates a slice of the pool of `desc` for `texture` and queues a copy of it. Returns the handle
+// of the image, or `BINDLESS_INVALID_HANDLE` if all pools are taken or the pool can't grow.
+uint32_t d3d11_bindless__add_image(struct d3d11_bindless_t *b, void *texture, const struct d3d11_texture_desc_t *desc);
+
+// Queues a copy of the changed `resource` with the handle `handle`. `size` is the size of buffers,
+// 0 for images.
+void d3d11_bindless__changed(struct d3d11_bindless_t *b, uint32_t handle, void *resource, uint32_t size);
+
+// Frees the range or slice of `resource` and drops its pending copies. `size` is the size of
+// buffers, 0 for images.
+void d3d11_bindless__remove(struct d3d11_bindless_t *b, uint32_t handle, void *resource, uint32_t size);
+
+// Issues the queued copies, and with `gpu_written` set the copies of the buffers written by the GPU,
+// on the immediate context.
+void d3d11_bindless__flush(struct d3d11_bindless_t *b, bool gpu_written);
+
+// Stores the views of the heap and the pools, in register order, in `views`. Unused pools are NULL.
+void d3d11_bindless__views(const struct d3d11_bindless_t *b, void *views[BINDLESS_NUM_VIEWS]);
+
+// Returns the HLSL declarations of the heap and the pools and the functions shaders access them
+// with. The shader compiler prepends it to every shader when bindless is enabled.
+const char *d3d11_bindless__hlsl(void);
@@ -0,0 +1,130 @@
+#include "d3d11_bytecode_compiler.h"
+#include "d3d11_internal.h"
+#include "d3d11_render_backend.h"
+
+#include <foundation/allocator.h>
+#include <foundation/log.h>
+#include <plugins/renderer/shader_compiler.h>
+
+#if defined(TM_OS_WINDOWS)
+#define COBJMACROS
+#include <d3dcompiler.h>
+#endif
+#include <string.h>
+
+// -------------------------------------------------------------------
+// Stand-in
+
+#define STAND_IN_MAGIC 0x4e495453 // "STIN"
+
+// Layout of the stand-in bytecode, followed by the entry point and the source, both zero
+// terminated.
+struct stand_in_header_t
+{
+    uint32_t magic;
+    uint32_t stage;
+};
+
+static void *
+stand_in__compile(void *inst, const char *source, const char *entry_point, uint32_t stage,
+    struct tm_allocator_i *allocator, uint64_t *size)
+{
+    const uint64_t entry_point_size = strlen(entry_point) + 1;
+    const uint64_t source_size = strlen(source) + 1;
+
+    *size = sizeof(struct stand_in_header_t) + entry_point_size + source_size;
+    uint8_t *bytecode = tm_alloc(allocator, *size);
+
+    const struct stand_in_header_t header = { STAND_IN_MAGIC, stage };
+    memcpy(bytecode, &header, sizeof(header));
+    memcpy(bytecode + sizeof(header), entry_point, entry_point_size);
+    memcpy(bytecode + sizeof(header) + entry_point_size, source, source_size);
+    return bytecode;
+}
+
+static const struct tm_d3d11_bytecode_compiler_i stand_in_compiler = {
+    .version = STAND_IN_MAGIC,
+    .compile = stand_in__compile,
+};
+
+const struct tm_d3d11_bytecode_compiler_i *
+d3d11_bytecode_compiler__stand_in(void)
+{
+    return &stand_in_compiler;
+}
+
+// -------------------------------------------------------------------
+// D3DCompile
+
+#if defined(TM_OS_WINDOWS)
+
+#if defined(TM_CONFIGURATION_DEBUG)
+#define COMPILE_FLAGS (D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION)
+#else
+#define COMPILE_FLAGS (D3DCOMPILE_OPTIMIZATION_LEVEL3)
+#endif
+
+static pD3DCompile d3d_compile;
+
+static const char *const targets[TM_RENDERER_SHADER_STAGE_MAX] = {
+    [TM_RENDERER_SHADER_STAGE_VERTEX]   = "vs_5_0",
+    [TM_RENDERER_SHADER_STAGE_HULL]     = "hs_5_0",
+    [TM_RENDERER_SHADER_STAGE_DOMAIN]   = "ds_5_0",
+    [TM_RENDERER_SHADER_STAGE_GEOMETRY] = "gs_5_0",
+    [TM_RENDERER_SHADER_STAGE_PIXEL]    = "ps_5_0",
+    [TM_RENDERER_SHADER_STAGE_COMPUTE]  = "cs_5_0",
+};
+
+static void *
+d3d_compiler__compile(void *inst, const char *source, const char *entry_point, uint32_t stage,
+    struct tm_allocator_i *allocator, uint64_t *size)
+{
+    if (stage >= TM_RENDERER_SHADER_STAGE_MAX)
+        return 0;
+
+    ID3DBlob *code = 0;
+    ID3DBlob *errors = 0;
+    const HRESULT hr = d3d_compile(source, strlen(source), 0, 0, D3D_COMPILE_STANDARD_FILE_INCLUDE, entry_point,
+        targets[stage], COMPILE_FLAGS, 0, &code, &errors);
+
+    if (errors)
+    {
+        tm_logger_api->printf(FAILED(hr) ? TM_LOG_TYPE_ERROR : TM_LOG_TYPE_INFO, "%s: %s", entry_point,
+            (const char *)ID3D10Blob_GetBufferPointer(errors));
+        ID3D10Blob_Release(errors);
+    }
+
+    if (FAILED(hr))
+        return 0;
+
+    *size = ID3D10Blob_GetBufferSize(code);
+    void *bytecode = tm_alloc(allocator, *size);
+    memcpy(bytecode, ID3D10Blob_GetBufferPointer(code), *size);
+    ID3D10Blob_Release(code);
+    return bytecode;
+}
+
+static const struct tm_d3d11_bytecode_compiler_i d3d_compiler = {
+    .version = ((uint64_t)D3D_COMPILER_VERSION << 32) | COMPILE_FLAGS,
+    .compile = d3d_compiler__compile,
+};
+
+#endif
+
+const struct tm_d3d11_bytecode_compiler_i *
+d3d11_bytecode_compiler__default(void)
+{
+#if defined(TM_OS_WINDOWS)
+    if (!d3d_compile)
+    {
+        HMODULE module = LoadLibraryA(D3DCOMPILER_DLL_A);
+        if (module)
+            d3d_compile = (pD3DCompile)GetProcAddress(module, "D3DCompile");
+        if (!d3d_compile)
+            tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Failed to load D3DCompile from %s", D3DCOMPILER_DLL_A);
+    }
+    if (d3d_compile)
+        return &d3d_compiler;
+#endif
+    return &stand_in_compiler;
+}
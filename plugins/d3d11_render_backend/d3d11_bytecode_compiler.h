@@ -0,0 +1,14 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+struct tm_d3d11_bytecode_compiler_i;
+
+// Returns the compiler used when none is configured: `D3DCompile()` on Windows (if
+// `d3dcompiler_47.dll` can be loaded), the stand-in compiler otherwise.
+const struct tm_d3d11_bytecode_compiler_i *d3d11_bytecode_compiler__default(void);
+
+// Returns a compiler that doesn't compile anything: it wraps the stage, entry point and source in a
+// blob that only the recording device accepts. It makes the shader compiler and its cache usable
+// on platforms without D3D11.
+const struct tm_d3d11_bytecode_compiler_i *d3d11_bytecode_compiler__stand_in(void);
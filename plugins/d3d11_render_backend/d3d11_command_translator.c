@@ -0,0 +1,583 @@
+#include "d3d11_command_translator.h"
+
+#include "d3d11_bindless.h"
+#include "d3d11_device.h"
+#include "d3d11_gpu_profiler.h"
+#include "d3d11_indirect_draws.h"
+#include "d3d11_internal.h"
+#include "d3d11_resources.h"
+
+#include <plugins/renderer/render_command_buffer.h>
+
+#include <string.h>
+
+#define MAX_RENDER_TARGETS (8)
+
+enum pipeline
+{
+    PIPELINE__GRAPHICS = 0,
+    PIPELINE__COMPUTE,
+};
+
+static const uint32_t graphics_stage_mask = (1 << SHADER_STAGE__VERTEX) | (1 << SHADER_STAGE__HULL)
+    | (1 << SHADER_STAGE__DOMAIN) | (1 << SHADER_STAGE__GEOMETRY) | (1 << SHADER_STAGE__PIXEL);
+
+static const uint32_t compute_stage_mask = 1 << SHADER_STAGE__COMPUTE;
+
+// State of a single translation pass. Only used to avoid re-issuing state that a sequence of
+// draws share, there is no attempt to track what the device has bound.
+struct translator_t
+{
+    struct d3d11_context_i *ctx;
+    const struct d3d11_resource_resolver_i *resolver;
+    const struct d3d11_gpu_profiler_t *profiler;
+    struct d3d11_translate_statistics_t *stats;
+
+    // Next instanced run that may start at or after the current command.
+    const struct d3d11_instanced_run_t *run;
+    const struct d3d11_instanced_run_t *runs_end;
+    uint32_t instance_buffer_slot;
+
+    // Stages that have the instance buffer of a run bound at `instance_buffer_slot`.
+    uint32_t instance_buffer_stages;
+
+    // Next compacted draw that may belong to the current command or one after it.
+    const struct d3d11_indirect_draws_t *indirect_draws;
+    const struct d3d11_compacted_draw_t *compacted;
+    const struct d3d11_compacted_draw_t *compacted_end;
+
+    const struct d3d11_shader_t *graphics_shader;
+    const struct d3d11_shader_t *compute_shader;
+
+    void *index_buffer;
+    uint32_t index_format;
+    uint32_t topology;
+};
+
+static const uint32_t topologies[TM_RENDERER_PRIMITIVE_TYPE_MAX_TYPES] = {
+    [TM_RENDERER_PRIMITIVE_TYPE_TRIANGLE_LIST] = TOPOLOGY__TRIANGLE_LIST,
+    [TM_RENDERER_PRIMITIVE_TYPE_LINE_LIST]     = TOPOLOGY__LINE_LIST,
+    [TM_RENDERER_PRIMITIVE_TYPE_POINT_LIST]    = TOPOLOGY__POINT_LIST,
+};
+
+// -------------------------------------------------------------------
+// Binding
+
+static inline void *
+resolve(struct translator_t *t, tm_renderer_handle_t handle, enum d3d11_view view)
+{
+    return handle.resource ? t->resolver->view(t->resolver->inst, handle.resource, view) : 0;
+}
+
+static void
+bind_shader(struct translator_t *t, const struct d3d11_shader_t *shader, enum pipeline pipeline)
+{
+    struct d3d11_context_i *ctx = t->ctx;
+
+    if (pipeline == PIPELINE__COMPUTE)
+    {
+        if (shader != t->compute_shader)
+        {
+            ctx->set_shader(ctx->inst, SHADER_STAGE__COMPUTE, shader->stages[SHADER_STAGE__COMPUTE]);
+            t->compute_shader = shader;
+        }
+        return;
+    }
+
+    if (shader == t->graphics_shader)
+        return;
+
+    for (uint32_t stage = 0; stage != SHADER_STAGE__COMPUTE; ++stage)
+        ctx->set_shader(ctx->inst, stage, shader->stages[stage]);
+
+    ctx->ia_set_input_layout(ctx->inst, shader->input_layout);
+    ctx->rs_set_state(ctx->inst, shader->rasterizer_state);
+    ctx->om_set_depth_stencil_state(ctx->inst, shader->depth_stencil_state, shader->stencil_ref);
+    ctx->om_set_blend_state(ctx->inst, shader->blend_state, shader->blend_factor, shader->sample_mask);
+
+    t->graphics_shader = shader;
+}
+
+static void
+apply_bind(struct translator_t *t, const struct d3d11_bind_t *bind, uint32_t stage_mask)
+{
+    struct d3d11_context_i *ctx = t->ctx;
+    const struct d3d11_resource_resolver_i *r = t->resolver;
+
+    if (bind->type == BIND_TYPE__VERTEX_BUFFER)
+    {
+        if (stage_mask == compute_stage_mask)
+            return;
+
+        void *buffer = r->view(r->inst, bind->resource, VIEW__RESOURCE);
+        ctx->ia_set_vertex_buffers(ctx->inst, bind->slot, 1, &buffer, &bind->stride, &bind->offset);
+        return;
+    }
+
+    if (bind->type == BIND_TYPE__UNORDERED_ACCESS)
+    {
+        // Graphics UAVs are bound through OMSetRenderTargetsAndUnorderedAccessViews(), which the
+        // renderer doesn't use on D3D11.
+        if (stage_mask != compute_stage_mask)
+            return;
+
+        void *uav = r->view(r->inst, bind->resource, VIEW__UAV);
+        ctx->cs_set_unordered_access_views(ctx->inst, bind->slot, 1, &uav);
+        return;
+    }
+
+    // Suballocated constant buffers are bound as a range of the constant arena.
+    uint32_t first_constant = 0, num_constants = 0;
+    void *object = bind->type == BIND_TYPE__CONSTANT_BUFFER
+        ? r->constant_buffer(r->inst, bind->resource, &first_constant, &num_constants)
+        : r->view(r->inst, bind->resource, bind->type == BIND_TYPE__SHADER_RESOURCE ? VIEW__SRV : VIEW__RESOURCE);
+
+    uint32_t stages = bind->stage_mask & stage_mask;
+    for (uint32_t stage = 0; stages; ++stage, stages >>= 1)
+    {
+        if (!(stages & 1))
+            continue;
+
+        switch (bind->type)
+        {
+        case BIND_TYPE__CONSTANT_BUFFER:
+            if (num_constants)
+                ctx->set_constant_buffers1(ctx->inst, stage, bind->slot, 1, &object, &first_constant, &num_constants);
+            else
+                ctx->set_constant_buffers(ctx->inst, stage, bind->slot, 1, &object);
+            break;
+        case BIND_TYPE__SHADER_RESOURCE:
+            ctx->set_shader_resources(ctx->inst, stage, bind->slot, 1, &object);
+            break;
+        case BIND_TYPE__SAMPLER:
+            ctx->set_samplers(ctx->inst, stage, bind->slot, 1, &object);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void
+bind_resources(struct translator_t *t, const tm_renderer_shader_info_t *shader_info, uint32_t stage_mask)
+{
+    const struct d3d11_resource_resolver_i *r = t->resolver;
+
+    for (uint32_t i = 0; i != shader_info->num_resource_binders; ++i)
+    {
+        const struct d3d11_resource_binder_t *binder = r->resource_binder(r->inst, shader_info->resource_binders[i].resource);
+        if (!binder)
+            continue;
+
+        for (const struct d3d11_bind_t *bind = binder->binds, *end = bind + binder->num_binds; bind != end; ++bind)
+            apply_bind(t, bind, stage_mask);
+    }
+}
+
+// -------------------------------------------------------------------
+// Commands
+
+static void
+bind_render_pass(struct translator_t *t, const tm_renderer_render_pass_bind_t *pass, bool clear)
+{
+    struct d3d11_context_i *ctx = t->ctx;
+    void *rtvs[MAX_RENDER_TARGETS];
+    uint32_t num_rtvs = 0;
+
+    for (; num_rtvs != MAX_RENDER_TARGETS; ++num_rtvs)
+    {
+        const tm_renderer_render_target_t *rt = pass->render_targets + num_rtvs;
+        if (!rt->resource.resource)
+            break;
+
+        rtvs[num_rtvs] = resolve(t, rt->resource, VIEW__RTV);
+    }
+
+    const tm_renderer_render_target_t *ds = &pass->depth_stencil_target;
+    void *dsv = resolve(t, ds->resource, VIEW__DSV);
+
+    ctx->om_set_render_targets(ctx->inst, num_rtvs, rtvs, dsv);
+    if (!clear)
+        return;
+
+    for (uint32_t i = 0; i != num_rtvs; ++i)
+    {
+        if (pass->render_targets[i].load_op == TM_RENDERER_LOAD_OP_CLEAR && rtvs[i])
+            ctx->clear_render_target_view(ctx->inst, rtvs[i], pass->render_targets[i].clear_value);
+    }
+
+    if (dsv && ds->load_op == TM_RENDERER_LOAD_OP_CLEAR)
+    {
+        ctx->clear_depth_stencil_view(ctx->inst, dsv, CLEAR_FLAG__DEPTH | CLEAR_FLAG__STENCIL, ds->clear_value[0],
+            (uint8_t)ds->clear_value[1]);
+    }
+}
+
+static void
+translate_bind_render_pass(struct translator_t *t, const tm_renderer_render_pass_bind_t *pass)
+{
+    bind_render_pass(t, pass, true);
+    ++t->stats->num_render_passes;
+}
+
+static void
+translate_set_viewports(struct translator_t *t, const tm_renderer_set_viewports_t *cmd)
+{
+    struct d3d11_viewport_t viewports[TM_ARRAY_COUNT(cmd->viewports)];
+    const uint32_t n = tm_min(cmd->num_viewports, (uint32_t)TM_ARRAY_COUNT(cmd->viewports));
+
+    for (uint32_t i = 0; i != n; ++i)
+    {
+        const tm_renderer_viewport_t *v = cmd->viewports + i;
+        viewports[i] = (struct d3d11_viewport_t) {
+            .x         = v->x,
+            .y         = v->y,
+            .width     = v->width,
+            .height    = v->height,
+            .min_depth = v->min_depth,
+            .max_depth = v->max_depth,
+        };
+    }
+
+    t->ctx->rs_set_viewports(t->ctx->inst, n, viewports);
+}
+
+static void
+translate_set_scissor_rects(struct translator_t *t, const tm_renderer_set_scissor_rects_t *cmd)
+{
+    struct d3d11_rect_t rects[TM_ARRAY_COUNT(cmd->rects)];
+    const uint32_t n = tm_min(cmd->num_rects, (uint32_t)TM_ARRAY_COUNT(cmd->rects));
+
+    for (uint32_t i = 0; i != n; ++i)
+    {
+        const tm_renderer_scissor_rect_t *r = cmd->rects + i;
+        rects[i] = (struct d3d11_rect_t) {
+            .left   = r->x,
+            .top    = r->y,
+            .right  = r->x + (int32_t)r->width,
+            .bottom = r->y + (int32_t)r->height,
+        };
+    }
+
+    t->ctx->rs_set_scissor_rects(t->ctx->inst, n, rects);
+}
+
+static void
+bind_index_buffer(struct translator_t *t, const tm_renderer_draw_call_info_t *dc)
+{
+    void *index_buffer = resolve(t, dc->index_buffer, VIEW__RESOURCE);
+    const uint32_t index_format = dc->index_type == TM_RENDERER_INDEX_TYPE_UINT16 ? INDEX_FORMAT__UINT16 : INDEX_FORMAT__UINT32;
+    if (index_buffer != t->index_buffer || index_format != t->index_format)
+    {
+        t->ctx->ia_set_index_buffer(t->ctx->inst, index_buffer, index_format, 0);
+        t->index_buffer = index_buffer;
+        t->index_format = index_format;
+    }
+}
+
+// Draws the indirect draw `dc`, one indirect draw per argument. The arguments of `compacted` are
+// compacted first and drawn from the compacted argument buffer. Returns false if the draw can't be
+// issued.
+static bool
+draw_indirect(struct translator_t *t, const tm_renderer_draw_call_info_t *dc,
+    const struct d3d11_compacted_draw_t *compacted)
+{
+    struct d3d11_context_i *ctx = t->ctx;
+    const bool indexed = dc->draw_type == TM_RENDERER_DRAW_TYPE_INDEXED_INDIRECT;
+    const uint32_t args_size = indexed ? INDIRECT_DRAW_INDEXED_ARGS_SIZE : INDIRECT_DRAW_ARGS_SIZE;
+
+    void *args = resolve(t, dc->indirect.indirect_buffer, VIEW__RESOURCE);
+    uint32_t offset = (uint32_t)dc->indirect.argument_buffer_offset;
+    uint32_t stride = dc->indirect.stride ? dc->indirect.stride : args_size;
+    uint32_t num_args = dc->indirect.num_draws;
+
+    void *args_uav = compacted ? resolve(t, dc->indirect.indirect_buffer, VIEW__UAV) : 0;
+    void *count_uav = compacted ? resolve(t, dc->indirect.count_buffer, VIEW__UAV) : 0;
+    if (compacted && args_uav && (count_uav || !dc->indirect.count_buffer.resource))
+    {
+        d3d11_indirect_draws__compact(t->indirect_draws, ctx, compacted, args_uav, count_uav);
+        t->compute_shader = 0;
+
+        args = t->indirect_draws->args;
+        offset = compacted->offset;
+        stride = args_size;
+        num_args = compacted->num_args;
+    }
+    else if (dc->indirect.count_buffer.resource)
+        return false;
+
+    if (!args)
+        return false;
+
+    if (indexed)
+        bind_index_buffer(t, dc);
+
+    // D3D11 has no multi-draw, the GPU skips the zeroed arguments past the compacted ones.
+    for (uint32_t i = 0; i != num_args; ++i)
+    {
+        if (indexed)
+            ctx->draw_indexed_instanced_indirect(ctx->inst, args, offset + i * stride);
+        else
+            ctx->draw_instanced_indirect(ctx->inst, args, offset + i * stride);
+    }
+    t->stats->num_indirect_draws += num_args;
+    return true;
+}
+
+// Draws `cmd`, or all draws of `run` as instances of `cmd` if `run` is non-NULL. Indirect draws
+// are compacted first if `compacted` is non-NULL.
+static void
+translate_draw_call(struct translator_t *t, const tm_renderer_draw_command_t *cmd, const struct d3d11_instanced_run_t *run,
+    const struct d3d11_compacted_draw_t *compacted)
+{
+    struct d3d11_context_i *ctx = t->ctx;
+    const tm_renderer_draw_call_info_t *dc = &cmd->draw_call;
+    const tm_renderer_shader_info_t *si = &cmd->shader_info;
+
+    const struct d3d11_shader_t *shader = t->resolver->shader(t->resolver->inst, si->shader.resource);
+    if (!shader || dc->primitive_type >= TM_RENDERER_PRIMITIVE_TYPE_MAX_TYPES)
+    {
+        ++t->stats->num_skipped_commands;
+        return;
+    }
+
+    // Draws outside runs read their constants from the constant buffer. Unbinding the instance
+    // buffer of the previous run before the draw's own resources are bound makes a shader that
+    // reads it anyway get zeros rather than another draw's records.
+    if (!run && t->instance_buffer_stages)
+    {
+        void *null_view = 0;
+        uint32_t stages = t->instance_buffer_stages;
+        for (uint32_t stage = 0; stages; ++stage, stages >>= 1)
+        {
+            if (stages & 1)
+                ctx->set_shader_resources(ctx->inst, stage, t->instance_buffer_slot, 1, &null_view);
+        }
+        t->instance_buffer_stages = 0;
+    }
+
+    bind_shader(t, shader, PIPELINE__GRAPHICS);
+    bind_resources(t, si, graphics_stage_mask);
+
+    const uint32_t topology = topologies[dc->primitive_type];
+    if (topology != t->topology)
+    {
+        ctx->ia_set_primitive_topology(ctx->inst, topology);
+        t->topology = topology;
+    }
+
+    // Runs only contain single instance draws, the instances stand for the draws of the run.
+    uint32_t num_instances = dc->draw_type == TM_RENDERER_DRAW_TYPE_INDEXED ? dc->indexed.num_instances : dc->non_indexed.num_instances;
+    if (run)
+    {
+        uint32_t stages = run->stage_mask & graphics_stage_mask;
+        for (uint32_t stage = 0; stages; ++stage, stages >>= 1)
+        {
+            if (stages & 1)
+                ctx->set_shader_resources(ctx->inst, stage, t->instance_buffer_slot, 1, &run->instance_buffer);
+        }
+        t->instance_buffer_stages = run->stage_mask & graphics_stage_mask;
+        num_instances = run->num_draws;
+        ++t->stats->num_instanced_draws;
+        t->stats->num_merged_draws += run->num_draws;
+    }
+
+    switch (dc->draw_type)
+    {
+    case TM_RENDERER_DRAW_TYPE_NON_INDEXED:
+        ctx->draw_instanced(ctx->inst, dc->non_indexed.num_vertices, num_instances, dc->non_indexed.first_vertex,
+            dc->non_indexed.first_instance);
+        break;
+
+    case TM_RENDERER_DRAW_TYPE_INDEXED:
+        bind_index_buffer(t, dc);
+        ctx->draw_indexed_instanced(ctx->inst, dc->indexed.num_indices, num_instances, dc->indexed.first_index,
+            (int32_t)dc->indexed.first_vertex, dc->indexed.first_instance);
+        break;
+
+    case TM_RENDERER_DRAW_TYPE_NON_INDEXED_INDIRECT:
+    case TM_RENDERER_DRAW_TYPE_INDEXED_INDIRECT:
+        if (!draw_indirect(t, dc, compacted))
+        {
+            ++t->stats->num_skipped_commands;
+            return;
+        }
+        break;
+
+    default:
+        ++t->stats->num_skipped_commands;
+        return;
+    }
+
+    ++t->stats->num_draw_calls;
+}
+
+static void
+translate_compute_dispatch(struct translator_t *t, const tm_renderer_compute_command_t *cmd)
+{
+    struct d3d11_context_i *ctx = t->ctx;
+    const tm_renderer_compute_info_t *ci = &cmd->compute;
+
+    const struct d3d11_shader_t *shader = t->resolver->shader(t->resolver->inst, cmd->shader_info.shader.resource);
+    if (!shader)
+    {
+        ++t->stats->num_skipped_commands;
+        return;
+    }
+
+    bind_shader(t, shader, PIPELINE__COMPUTE);
+    bind_resources(t, &cmd->shader_info, compute_stage_mask);
+
+    if (ci->dispatch_type == TM_RENDERER_DISPATCH_TYPE_INDIRECT)
+    {
+        void *args = resolve(t, ci->indirect_buffer, VIEW__RESOURCE);
+        if (!args)
+        {
+            ++t->stats->num_skipped_commands;
+            return;
+        }
+        ctx->dispatch_indirect(ctx->inst, args, ci->argument_buffer_offset);
+    }
+    else
+        ctx->dispatch(ctx->inst, ci->group_count[0], ci->group_count[1], ci->group_count[2]);
+
+    ++t->stats->num_dispatches;
+}
+
+static void
+translate_copy_buffer(struct translator_t *t, const tm_renderer_copy_buffer_command_t *cmd)
+{
+    void *src = resolve(t, cmd->source, VIEW__RESOURCE);
+    void *dst = resolve(t, cmd->destination, VIEW__RESOURCE);
+    if (!src || !dst)
+    {
+        ++t->stats->num_skipped_commands;
+        return;
+    }
+
+    t->ctx->copy_buffer_region(t->ctx->inst, dst, (uint32_t)cmd->destination_offset, src,
+        (uint32_t)cmd->source_offset, (uint32_t)cmd->size);
+    ++t->stats->num_copies;
+}
+
+// Binds the render pass, viewports and scissor rects that the last of the `n` preceding commands
+// of each type left bound.
+static void
+inherit_state(struct translator_t *t, const tm_renderer_command_t *preceding, uint32_t n)
+{
+    const tm_renderer_command_t *pass = 0, *viewports = 0, *scissor_rects = 0;
+    for (const tm_renderer_command_t *cmd = preceding + n; cmd != preceding && !(pass && viewports && scissor_rects);)
+    {
+        --cmd;
+        if (cmd->type == TM_RENDERER_COMMAND_BIND_RENDER_PASS && !pass)
+            pass = cmd;
+        else if (cmd->type == TM_RENDERER_COMMAND_SET_VIEWPORTS && !viewports)
+            viewports = cmd;
+        else if (cmd->type == TM_RENDERER_COMMAND_SET_SCISSOR_RECTS && !scissor_rects)
+            scissor_rects = cmd;
+    }
+
+    if (pass)
+        bind_render_pass(t, pass->data, false);
+    if (viewports)
+        translate_set_viewports(t, viewports->data);
+    if (scissor_rects)
+        translate_set_scissor_rects(t, scissor_rects->data);
+}
+
+// -------------------------------------------------------------------
+// Public
+
+void
+d3d11_translator__translate(const struct d3d11_translate_params_t *params, const tm_renderer_command_t *commands,
+    uint32_t num_commands, struct d3d11_translate_statistics_t *stats)
+{
+    struct translator_t t = {
+        .ctx      = params->context,
+        .resolver = params->resolver,
+        .profiler = params->profiler,
+        .stats    = stats,
+        .topology = TOPOLOGY__UNDEFINED,
+
+        .run                  = params->runs,
+        .runs_end             = params->runs + params->num_runs,
+        .instance_buffer_slot = params->instance_buffer_slot,
+
+        .indirect_draws = params->indirect_draws,
+        .compacted      = params->compacted_draws,
+        .compacted_end  = params->compacted_draws + params->num_compacted_draws,
+    };
+
+    while (t.run != t.runs_end && t.run->first < commands)
+        ++t.run;
+
+    while (t.compacted != t.compacted_end && t.compacted->command < commands)
+        ++t.compacted;
+
+    // Bindless resources are bound once for the whole range, draws only pass handles.
+    if (params->bindless_views)
+    {
+        for (uint32_t stage = 0; stage != SHADER_STAGE__COUNT; ++stage)
+            t.ctx->set_shader_resources(t.ctx->inst, stage, BINDLESS_HEAP_REGISTER, BINDLESS_NUM_VIEWS, params->bindless_views);
+    }
+
+    if (params->num_preceding)
+        inherit_state(&t, params->preceding, params->num_preceding);
+
+    const tm_renderer_command_t *end = commands + num_commands;
+    for (const tm_renderer_command_t *cmd = commands; cmd != end; ++cmd)
+    {
+        switch (cmd->type)
+        {
+        case TM_RENDERER_COMMAND_BIND_RENDER_PASS:
+            translate_bind_render_pass(&t, cmd->data);
+            break;
+        case TM_RENDERER_COMMAND_SET_VIEWPORTS:
+            translate_set_viewports(&t, cmd->data);
+            break;
+        case TM_RENDERER_COMMAND_SET_SCISSOR_RECTS:
+            translate_set_scissor_rects(&t, cmd->data);
+            break;
+        case TM_RENDERER_COMMAND_DRAW_CALL:
+            if (t.run != t.runs_end && t.run->first == cmd)
+            {
+                const struct d3d11_instanced_run_t *run = t.run++;
+                if (run->num_draws <= (uint32_t)(end - cmd))
+                {
+                    translate_draw_call(&t, cmd->data, run, 0);
+                    cmd += run->num_draws - 1;
+                    break;
+                }
+            }
+            // Runs never contain indirect draws.
+            if (t.compacted != t.compacted_end && t.compacted->command == cmd)
+                translate_draw_call(&t, cmd->data, 0, t.compacted++);
+            else
+                translate_draw_call(&t, cmd->data, 0, 0);
+            break;
+        case TM_RENDERER_COMMAND_COMPUTE_DISPATCH:
+            translate_compute_dispatch(&t, cmd->data);
+            break;
+        case TM_RENDERER_COMMAND_COPY_BUFFER:
+            translate_copy_buffer(&t, cmd->data);
+            break;
+
+        case TM_RENDERER_COMMAND_BEGIN_STATISTICS:
+        case TM_RENDERER_COMMAND_END_STATISTICS:
+            if (t.profiler)
+                d3d11_gpu_profiler__timestamp(t.profiler, t.ctx, cmd);
+            break;
+
+        // D3D11 tracks hazards and queues itself.
+        case TM_RENDERER_COMMAND_BIND_QUEUE:
+        case TM_RENDERER_COMMAND_TRANSITION_RESOURCES:
+            break;
+
+        default:
+            ++stats->num_skipped_commands;
+            break;
+        }
+    }
+
+    stats->num_commands += num_commands;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+// Translates sorted renderer commands (`tm_renderer_command_t`) into calls on a D3D11 context in
+// a single linear pass. Translation state lives on the stack of the translate call, so several
+// translations can run at the same time on different contexts, for example on consecutive ranges
+// of the same sorted commands.
+
+struct d3d11_context_i;
+struct d3d11_gpu_profiler_t;
+struct d3d11_indirect_draws_t;
+struct d3d11_resource_resolver_i;
+struct tm_renderer_command_t;
+
+// Consecutive draws issued as a single instanced draw, see `d3d11_draw_instancer.h`.
+struct d3d11_instanced_run_t
+{
+    // First draw of the run among the sorted commands, the other draws follow it directly.
+    const struct tm_renderer_command_t *first;
+    uint32_t num_draws;
+
+    // Bit mask of `enum d3d11_shader_stage`s that see the per-draw constants.
+    uint32_t stage_mask;
+
+    // Raw view of the gathered per-draw constants.
+    void *instance_buffer;
+};
+
+// Indirect multi-draw whose arguments are compacted before it is drawn, see
+// `d3d11_indirect_draws.h`.
+struct d3d11_compacted_draw_t
+{
+    const struct tm_renderer_command_t *command;
+
+    // Constant buffer with the parameters of the compaction.
+    void *params;
+
+    // Byte offset of the draw's range of the compacted argument buffer and the number of arguments
+    // in it.
+    uint32_t offset;
+    uint32_t num_args;
+};
+
+struct d3d11_translate_params_t
+{
+    // Context receiving the translated calls.
+    struct d3d11_context_i *context;
+
+    // Maps renderer handles referenced by the commands to device objects.
+    const struct d3d11_resource_resolver_i *resolver;
+
+    // Writes the timestamps of statistics commands. Optional.
+    const struct d3d11_gpu_profiler_t *profiler;
+
+    // Commands sorted before the translated ones, when translating a range in the middle of the
+    // sorted commands. The render pass, viewports and scissor rects they leave bound are bound
+    // again first, without clearing, since the context starts out with default state.
+    const struct tm_renderer_command_t *preceding;
+    uint32_t num_preceding;
+
+    // Register the instance buffers of instanced runs are bound to.
+    uint32_t instance_buffer_slot;
+
+    // Runs of draws to issue as instanced draws, sorted on `first`. Runs that start before the
+    // translated commands are ignored, runs that extend past them are drawn one draw at a time.
+    const struct d3d11_instanced_run_t *runs;
+    uint32_t num_runs;
+    TM_PAD(4);
+
+    // Views of the bindless heap and image pools, bound to every stage before the first command,
+    // see `d3d11_bindless__views()`. NULL if bindless is disabled.
+    void *const *bindless_views;
+
+    // Compacts the arguments of indirect multi-draws, see `d3d11_indirect_draws.h`. Optional.
+    const struct d3d11_indirect_draws_t *indirect_draws;
+
+    // Indirect multi-draws to compact before they are drawn, sorted on `command`. Multi-draws that
+    // aren't among them are drawn from their arguments as they are, and skipped if they have a
+    // count buffer.
+    const struct d3d11_compacted_draw_t *compacted_draws;
+    uint32_t num_compacted_draws;
+    TM_PAD(4);
+};
+
+struct d3d11_translate_statistics_t
+{
+    uint64_t num_commands;
+    uint64_t num_render_passes;
+    uint64_t num_draw_calls;
+
+    // Instanced draws issued for runs, and the number of draws they replaced.
+    uint64_t num_instanced_draws;
+    uint64_t num_merged_draws;
+
+    // Indirect draw calls issued on the context. A multi-draw issues one per argument.
+    uint64_t num_indirect_draws;
+
+    uint64_t num_dispatches;
+    uint64_t num_copies;
+
+    // Commands dropped because they reference unknown resources or use features the translator
+    // doesn't support yet.
+    uint64_t num_skipped_commands;
+};
+
+// Translates `num_commands` commands, which must already be sorted on their sort key, and
+// accumulates counters in `stats`.
+void d3d11_translator__translate(const struct d3d11_translate_params_t *params,
+    const struct tm_renderer_command_t *commands, uint32_t num_commands,
+    struct d3d11_translate_statistics_t *stats);
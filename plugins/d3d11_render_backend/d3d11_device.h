@@ -0,0 +1,465 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+// Thin function tables over `ID3D11Device` and `ID3D11DeviceContext`.
+//
+// The command translator only talks to these interfaces, never to COM objects directly. That
+// lets the same translation code drive either a native D3D11 device (`d3d11_native_device.c`)
+// or a recording stand-in device (`d3d11_recording_device.c`) that runs on machines without a
+// GPU. Device objects (buffers, views, shaders, states) are passed around as opaque pointers.
+
+// Enum values mirror their D3D11 / DXGI counterparts so the native device can pass them through.
+
+enum d3d11_shader_stage
+{
+    SHADER_STAGE__VERTEX = 0,
+    SHADER_STAGE__HULL,
+    SHADER_STAGE__DOMAIN,
+    SHADER_STAGE__GEOMETRY,
+    SHADER_STAGE__PIXEL,
+    SHADER_STAGE__COMPUTE,
+
+    SHADER_STAGE__COUNT,
+};
+
+enum d3d11_topology
+{
+    TOPOLOGY__UNDEFINED      = 0,
+    TOPOLOGY__POINT_LIST     = 1,
+    TOPOLOGY__LINE_LIST      = 2,
+    TOPOLOGY__TRIANGLE_LIST  = 4,
+};
+
+enum d3d11_index_format
+{
+    INDEX_FORMAT__UINT32 = 42, // DXGI_FORMAT_R32_UINT
+    INDEX_FORMAT__UINT16 = 57, // DXGI_FORMAT_R16_UINT
+};
+
+enum d3d11_clear_flag
+{
+    CLEAR_FLAG__DEPTH   = 0x1,
+    CLEAR_FLAG__STENCIL = 0x2,
+};
+
+enum d3d11_view
+{
+    // The resource itself (`ID3D11Buffer`, `ID3D11Texture2D`, `ID3D11SamplerState`, ...).
+    VIEW__RESOURCE = 0,
+    VIEW__SRV,
+    VIEW__UAV,
+    VIEW__RTV,
+    VIEW__DSV,
+
+    VIEW__COUNT,
+};
+
+enum d3d11_usage
+{
+    USAGE__DEFAULT   = 0,
+    USAGE__IMMUTABLE = 1,
+    USAGE__DYNAMIC   = 2,
+    USAGE__STAGING   = 3,
+};
+
+enum d3d11_bind_flag
+{
+    BIND_FLAG__VERTEX_BUFFER    = 0x1,
+    BIND_FLAG__INDEX_BUFFER     = 0x2,
+    BIND_FLAG__CONSTANT_BUFFER  = 0x4,
+    BIND_FLAG__SHADER_RESOURCE  = 0x8,
+    BIND_FLAG__RENDER_TARGET    = 0x20,
+    BIND_FLAG__DEPTH_STENCIL    = 0x40,
+    BIND_FLAG__UNORDERED_ACCESS = 0x80,
+};
+
+enum d3d11_cpu_access_flag
+{
+    CPU_ACCESS__WRITE = 0x10000,
+    CPU_ACCESS__READ  = 0x20000,
+};
+
+enum d3d11_misc_flag
+{
+    MISC_FLAG__TEXTURECUBE            = 0x4,
+    MISC_FLAG__DRAWINDIRECT_ARGS      = 0x10,
+    MISC_FLAG__BUFFER_ALLOW_RAW_VIEWS = 0x20,
+    MISC_FLAG__BUFFER_STRUCTURED      = 0x40,
+    MISC_FLAG__RESOURCE_CLAMP         = 0x80,
+};
+
+enum d3d11_texture_dimension
+{
+    TEXTURE_DIMENSION__1D = 0,
+    TEXTURE_DIMENSION__2D,
+    TEXTURE_DIMENSION__3D,
+};
+
+enum d3d11_map
+{
+    MAP__READ               = 1,
+    MAP__WRITE              = 2,
+    MAP__READ_WRITE         = 3,
+    MAP__WRITE_DISCARD      = 4,
+    MAP__WRITE_NO_OVERWRITE = 5,
+};
+
+enum d3d11_query
+{
+    QUERY__EVENT              = 0,
+    QUERY__OCCLUSION          = 1,
+    QUERY__TIMESTAMP          = 2,
+    QUERY__TIMESTAMP_DISJOINT = 3,
+};
+
+struct d3d11_buffer_desc_t
+{
+    uint32_t size;
+    uint32_t usage;
+    uint32_t bind_flags;
+    uint32_t cpu_access_flags;
+    uint32_t misc_flags;
+    uint32_t structure_stride;
+};
+
+struct d3d11_texture_desc_t
+{
+    // `enum d3d11_texture_dimension`.
+    uint32_t dimension;
+    uint32_t width;
+    uint32_t height;
+
+    // Depth for 3D textures, array size for 1D and 2D textures.
+    uint32_t depth_or_array_size;
+    uint32_t mip_levels;
+
+    // `DXGI_FORMAT`.
+    uint32_t format;
+    uint32_t sample_count;
+    uint32_t usage;
+    uint32_t bind_flags;
+    uint32_t cpu_access_flags;
+    uint32_t misc_flags;
+};
+
+// Same layout as `D3D11_SAMPLER_DESC`.
+struct d3d11_sampler_desc_t
+{
+    uint32_t filter;
+    uint32_t address_u;
+    uint32_t address_v;
+    uint32_t address_w;
+    float mip_lod_bias;
+    uint32_t max_anisotropy;
+    uint32_t comparison_func;
+    float border_color[4];
+    float min_lod;
+    float max_lod;
+};
+
+// Same layout as `D3D11_RASTERIZER_DESC`.
+struct d3d11_rasterizer_desc_t
+{
+    uint32_t fill_mode;
+    uint32_t cull_mode;
+    uint32_t front_counter_clockwise;
+    int32_t depth_bias;
+    float depth_bias_clamp;
+    float slope_scaled_depth_bias;
+    uint32_t depth_clip_enable;
+    uint32_t scissor_enable;
+    uint32_t multisample_enable;
+    uint32_t antialiased_line_enable;
+};
+
+// Same layout as `D3D11_DEPTH_STENCILOP_DESC`.
+struct d3d11_stencil_op_desc_t
+{
+    uint32_t fail_op;
+    uint32_t depth_fail_op;
+    uint32_t pass_op;
+    uint32_t func;
+};
+
+// Same layout as `D3D11_DEPTH_STENCIL_DESC`.
+struct d3d11_depth_stencil_desc_t
+{
+    uint32_t depth_enable;
+    uint32_t depth_write_mask;
+    uint32_t depth_func;
+    uint32_t stencil_enable;
+    uint8_t stencil_read_mask;
+    uint8_t stencil_write_mask;
+    TM_PAD(2);
+    struct d3d11_stencil_op_desc_t front_face;
+    struct d3d11_stencil_op_desc_t back_face;
+};
+
+// Same layout as `D3D11_RENDER_TARGET_BLEND_DESC`.
+struct d3d11_render_target_blend_desc_t
+{
+    uint32_t blend_enable;
+    uint32_t src_blend;
+    uint32_t dest_blend;
+    uint32_t blend_op;
+    uint32_t src_blend_alpha;
+    uint32_t dest_blend_alpha;
+    uint32_t blend_op_alpha;
+    uint8_t render_target_write_mask;
+    TM_PAD(3);
+};
+
+// Same layout as `D3D11_BLEND_DESC`.
+struct d3d11_blend_desc_t
+{
+    uint32_t alpha_to_coverage_enable;
+    uint32_t independent_blend_enable;
+    struct d3d11_render_target_blend_desc_t render_target[8];
+};
+
+// Same layout as `D3D11_SUBRESOURCE_DATA`.
+struct d3d11_subresource_data_t
+{
+    const void *data;
+    uint32_t row_pitch;
+    uint32_t slice_pitch;
+};
+
+// Same layout as `D3D11_BOX`.
+struct d3d11_box_t
+{
+    uint32_t left, top, front;
+    uint32_t right, bottom, back;
+};
+
+// Same layout as `D3D11_VIEWPORT`.
+struct d3d11_viewport_t
+{
+    float x, y;
+    float width, height;
+    float min_depth, max_depth;
+};
+
+// Same layout as `D3D11_RECT`.
+struct d3d11_rect_t
+{
+    int32_t left, top;
+    int32_t right, bottom;
+};
+
+struct d3d11_context_o;
+
+struct d3d11_context_i
+{
+    struct d3d11_context_o *inst;
+
+    // Output merger
+
+    void (*om_set_render_targets)(struct d3d11_context_o *inst, uint32_t num_views, void *const *rtvs, void *dsv);
+    void (*om_set_blend_state)(struct d3d11_context_o *inst, void *state, const float blend_factor[4], uint32_t sample_mask);
+    void (*om_set_depth_stencil_state)(struct d3d11_context_o *inst, void *state, uint32_t stencil_ref);
+    void (*clear_render_target_view)(struct d3d11_context_o *inst, void *rtv, const float color[4]);
+    void (*clear_depth_stencil_view)(struct d3d11_context_o *inst, void *dsv, uint32_t clear_flags, float depth, uint8_t stencil);
+
+    // Rasterizer
+
+    void (*rs_set_state)(struct d3d11_context_o *inst, void *state);
+    void (*rs_set_viewports)(struct d3d11_context_o *inst, uint32_t num_viewports, const struct d3d11_viewport_t *viewports);
+    void (*rs_set_scissor_rects)(struct d3d11_context_o *inst, uint32_t num_rects, const struct d3d11_rect_t *rects);
+
+    // Input assembler
+
+    void (*ia_set_input_layout)(struct d3d11_context_o *inst, void *layout);
+    void (*ia_set_primitive_topology)(struct d3d11_context_o *inst, uint32_t topology);
+    void (*ia_set_vertex_buffers)(struct d3d11_context_o *inst, uint32_t start_slot, uint32_t num_buffers,
+        void *const *buffers, const uint32_t *strides, const uint32_t *offsets);
+    void (*ia_set_index_buffer)(struct d3d11_context_o *inst, void *buffer, uint32_t format, uint32_t offset);
+
+    // Shader stages. `stage` is an `enum d3d11_shader_stage`.
+
+    void (*set_shader)(struct d3d11_context_o *inst, uint32_t stage, void *shader);
+    void (*set_constant_buffers)(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+        uint32_t num_buffers, void *const *buffers);
+
+    // Binds `num_constants[i]` 16 byte constants from `first_constants[i]` of each buffer. Both
+    // must be multiples of 16. Only available if the device `supports_constant_buffer_offsets()`.
+    void (*set_constant_buffers1)(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+        uint32_t num_buffers, void *const *buffers, const uint32_t *first_constants, const uint32_t *num_constants);
+    void (*set_shader_resources)(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+        uint32_t num_views, void *const *views);
+    void (*set_samplers)(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+        uint32_t num_samplers, void *const *samplers);
+    void (*cs_set_unordered_access_views)(struct d3d11_context_o *inst, uint32_t start_slot, uint32_t num_views,
+        void *const *uavs);
+
+    // Draw & dispatch
+
+    void (*draw_instanced)(struct d3d11_context_o *inst, uint32_t vertex_count_per_instance, uint32_t instance_count,
+        uint32_t start_vertex, uint32_t start_instance);
+    void (*draw_indexed_instanced)(struct d3d11_context_o *inst, uint32_t index_count_per_instance,
+        uint32_t instance_count, uint32_t start_index, int32_t base_vertex, uint32_t start_instance);
+    void (*dispatch)(struct d3d11_context_o *inst, uint32_t x, uint32_t y, uint32_t z);
+
+    // Indirect calls read their arguments from `args_buffer` at `offset`, which must be a multiple
+    // of 4. The buffer must have been created with `MISC_FLAG__DRAWINDIRECT_ARGS`.
+    void (*draw_instanced_indirect)(struct d3d11_context_o *inst, void *args_buffer, uint32_t offset);
+    void (*draw_indexed_instanced_indirect)(struct d3d11_context_o *inst, void *args_buffer, uint32_t offset);
+    void (*dispatch_indirect)(struct d3d11_context_o *inst, void *args_buffer, uint32_t offset);
+
+    // Copies
+
+    void (*copy_buffer_region)(struct d3d11_context_o *inst, void *dst, uint32_t dst_offset, void *src,
+        uint32_t src_offset, uint32_t size);
+
+    // Copies all of `src_subresource` to `dst_subresource`. Both must have the same size and
+    // compatible formats.
+    void (*copy_subresource)(struct d3d11_context_o *inst, void *dst, uint32_t dst_subresource, void *src,
+        uint32_t src_subresource);
+
+    // Uploads `data` to `box` of `subresource`. A NULL `box` updates the whole subresource.
+    void (*update_subresource)(struct d3d11_context_o *inst, void *resource, uint32_t subresource,
+        const struct d3d11_box_t *box, const void *data, uint32_t row_pitch, uint32_t depth_pitch);
+
+    // Clamps sampling of the texture `resource` to its mips from `min_lod` on.
+    void (*set_resource_min_lod)(struct d3d11_context_o *inst, void *resource, float min_lod);
+
+    // Maps `subresource` of a CPU accessible resource with `map_type` (`enum d3d11_map`) and
+    // returns a pointer to its memory, or NULL on failure.
+    void *(*map)(struct d3d11_context_o *inst, void *resource, uint32_t subresource, uint32_t map_type);
+    void (*unmap)(struct d3d11_context_o *inst, void *resource, uint32_t subresource);
+
+    // Queries
+
+    // Only `QUERY__TIMESTAMP_DISJOINT` and `QUERY__OCCLUSION` queries are begun, `end_query()`
+    // alone issues events and timestamps.
+    void (*begin_query)(struct d3d11_context_o *inst, void *query);
+    void (*end_query)(struct d3d11_context_o *inst, void *query);
+
+    // Copies the result of `query` to `data` and returns true once it is available. With `flush`
+    // set, pending commands are flushed to the GPU so the query eventually completes.
+    bool (*get_query_data)(struct d3d11_context_o *inst, void *query, void *data, uint32_t size, bool flush);
+
+    // Command lists
+
+    // Ends recording on a deferred context and returns the recorded command list. The context
+    // starts over with default state. Command lists are released with `release()`.
+    void *(*finish_command_list)(struct d3d11_context_o *inst);
+
+    // Executes a command list recorded by a deferred context on the immediate context. The
+    // immediate context is left with default state.
+    void (*execute_command_list)(struct d3d11_context_o *inst, void *command_list);
+};
+
+struct d3d11_swap_chain_desc_t
+{
+    // Native window handle (`HWND`).
+    void *window;
+
+    uint32_t width;
+    uint32_t height;
+
+    // `DXGI_FORMAT` of the back buffers.
+    uint32_t format;
+
+    // Number of frames that can be queued for presentation before `wait_until_ready()` blocks.
+    uint32_t max_frame_latency;
+};
+
+struct d3d11_swap_chain_o;
+
+// Flip model swap chain with a frame latency waitable object.
+struct d3d11_swap_chain_i
+{
+    struct d3d11_swap_chain_o *inst;
+
+    // Returns the render target view of the back buffer. It stays the same across presents and
+    // changes when the swap chain is resized.
+    void *(*render_target_view)(struct d3d11_swap_chain_o *inst);
+
+    // Resizes the back buffers. All references to them, including the render target view, must
+    // have been unbound. Returns false on failure.
+    bool (*resize)(struct d3d11_swap_chain_o *inst, uint32_t width, uint32_t height);
+
+    // Presents the back buffer after `sync_interval` vertical blanks, 0 presents immediately.
+    void (*present)(struct d3d11_swap_chain_o *inst, uint32_t sync_interval);
+
+    // Waits up to `timeout_ms` milliseconds until fewer than the maximum frame latency frames are
+    // queued for presentation. Returns true if the swap chain is ready for another frame.
+    bool (*wait_until_ready)(struct d3d11_swap_chain_o *inst, uint32_t timeout_ms);
+
+    // Sets the number of frames that can be queued for presentation, between 1 and 16.
+    void (*set_max_frame_latency)(struct d3d11_swap_chain_o *inst, uint32_t max_frame_latency);
+};
+
+struct d3d11_device_o;
+
+struct d3d11_device_i
+{
+    struct d3d11_device_o *inst;
+
+    // Returns the immediate context of the device.
+    struct d3d11_context_i *(*immediate_context)(struct d3d11_device_o *inst);
+
+    // Deferred contexts record calls into command lists from any thread, one thread per context.
+    // `supports_command_lists()` returns true if the driver builds command lists natively, without
+    // them the runtime emulates command lists at a considerable cost. `create_deferred_context()`
+    // returns NULL if the device has no deferred contexts.
+
+    bool (*supports_command_lists)(struct d3d11_device_o *inst);
+
+    // Returns true if constant buffers can be bound with offsets (`set_constant_buffers1()`) and
+    // dynamic constant buffers can be mapped with `MAP__WRITE_NO_OVERWRITE`, which needs the 11.1
+    // runtime and driver support.
+    bool (*supports_constant_buffer_offsets)(struct d3d11_device_o *inst);
+
+    struct d3d11_context_i *(*create_deferred_context)(struct d3d11_device_o *inst);
+    void (*destroy_deferred_context)(struct d3d11_device_o *inst, struct d3d11_context_i *context);
+
+    // Resource creation. Functions return NULL on failure. `initial_data` is optional, for
+    // textures it holds one entry per subresource (`mip + array_slice * mip_levels`). The device
+    // is free-threaded: these, the views and `release()` can be called from several threads at once.
+
+    void *(*create_buffer)(struct d3d11_device_o *inst, const struct d3d11_buffer_desc_t *desc, const void *initial_data);
+    void *(*create_texture)(struct d3d11_device_o *inst, const struct d3d11_texture_desc_t *desc,
+        const struct d3d11_subresource_data_t *initial_data);
+
+    // Creates a view of type `view` (`VIEW__SRV`, `VIEW__UAV`, `VIEW__RTV` or `VIEW__DSV`) that
+    // covers the whole `resource`. Buffer views are raw (`ByteAddressBuffer`).
+    void *(*create_view)(struct d3d11_device_o *inst, void *resource, enum d3d11_view view);
+
+    // Pipeline state objects. D3D11 itself returns the same object for identical descriptions,
+    // but caps the number of unique objects at 4096.
+
+    void *(*create_sampler_state)(struct d3d11_device_o *inst, const struct d3d11_sampler_desc_t *desc);
+    void *(*create_rasterizer_state)(struct d3d11_device_o *inst, const struct d3d11_rasterizer_desc_t *desc);
+    void *(*create_depth_stencil_state)(struct d3d11_device_o *inst, const struct d3d11_depth_stencil_desc_t *desc);
+    void *(*create_blend_state)(struct d3d11_device_o *inst, const struct d3d11_blend_desc_t *desc);
+
+    // Creates a query of `type` (`enum d3d11_query`).
+    void *(*create_query)(struct d3d11_device_o *inst, uint32_t type);
+
+    // Creates a shader for `stage` (`enum d3d11_shader_stage`) from DXBC `bytecode`.
+    void *(*create_shader)(struct d3d11_device_o *inst, uint32_t stage, const void *bytecode, uint64_t size);
+
+    // Releases a reference to an object returned by any of the functions above.
+    void (*release)(struct d3d11_device_o *inst, void *object);
+
+    // Creates a swap chain presenting to `desc->window`. Returns NULL on failure. Swap chains
+    // are destroyed with `destroy_swap_chain()`, not `release()`.
+    struct d3d11_swap_chain_i *(*create_swap_chain)(struct d3d11_device_o *inst, const struct d3d11_swap_chain_desc_t *desc);
+    void (*destroy_swap_chain)(struct d3d11_device_o *inst, struct d3d11_swap_chain_i *swap_chain);
+
+    // Returns the video memory budget the OS gives the process, in bytes, or 0 if unknown. Costs a
+    // call into the kernel.
+    uint64_t (*video_memory_budget)(struct d3d11_device_o *inst);
+
+    // Releases the device and everything it owns.
+    void (*destroy)(struct d3d11_device_o *inst);
+};
+
+struct tm_allocator_i;
+
+// Creates a device on top of a native `IDXGIAdapter`. Returns NULL on failure or on platforms
+// without D3D11.
+struct d3d11_device_i *d3d11_native_device__create(struct tm_allocator_i *allocator, void *dxgi_adapter);
@@ -0,0 +1,253 @@
+#include "d3d11_draw_instancer.h"
+
+#include "d3d11_command_translator.h"
+#include "d3d11_device.h"
+#include "d3d11_internal.h"
+#include "d3d11_render_backend.h"
+#include "d3d11_resources.h"
+#include "d3d11_upload_ring.h"
+
+#include <foundation/allocator.h>
+#include <foundation/carray.inl>
+#include <foundation/log.h>
+#include <foundation/temp_allocator.h>
+#include <plugins/renderer/render_command_buffer.h>
+
+#include <string.h>
+
+// Per-draw constants of a draw, found in the bind `bind_index` of its binder `binder_index`.
+struct draw_constants_t
+{
+    uint32_t binder_index;
+    uint32_t bind_index;
+    uint32_t stage_mask;
+    uint32_t size;
+    const void *data;
+};
+
+static bool
+single_instance(const tm_renderer_draw_call_info_t *dc)
+{
+    switch (dc->draw_type)
+    {
+    case TM_RENDERER_DRAW_TYPE_NON_INDEXED:
+        return dc->non_indexed.num_instances == 1;
+    case TM_RENDERER_DRAW_TYPE_INDEXED:
+        return dc->indexed.num_instances == 1;
+    default:
+        return false;
+    }
+}
+
+static bool
+same_geometry(const tm_renderer_draw_call_info_t *a, const tm_renderer_draw_call_info_t *b)
+{
+    if (a->primitive_type != b->primitive_type || a->draw_type != b->draw_type)
+        return false;
+
+    if (a->draw_type == TM_RENDERER_DRAW_TYPE_NON_INDEXED)
+    {
+        return a->non_indexed.num_vertices == b->non_indexed.num_vertices
+            && a->non_indexed.first_vertex == b->non_indexed.first_vertex
+            && a->non_indexed.first_instance == b->non_indexed.first_instance;
+    }
+
+    return a->index_buffer.resource == b->index_buffer.resource && a->index_type == b->index_type
+        && a->indexed.num_indices == b->indexed.num_indices && a->indexed.first_index == b->indexed.first_index
+        && a->indexed.first_vertex == b->indexed.first_vertex && a->indexed.first_instance == b->indexed.first_instance;
+}
+
+static bool
+same_bind(const struct d3d11_bind_t *a, const struct d3d11_bind_t *b)
+{
+    return a->type == b->type && a->slot == b->slot && a->stage_mask == b->stage_mask && a->resource == b->resource
+        && a->stride == b->stride && a->offset == b->offset;
+}
+
+// Finds the constant buffer bound to `slot` by the binders of `si`. Returns false if there is none
+// or it has no system memory copy.
+static bool
+find_constants(const struct d3d11_resource_resolver_i *r, const tm_renderer_shader_info_t *si, uint32_t slot,
+    struct draw_constants_t *constants)
+{
+    for (uint32_t i = 0; i != si->num_resource_binders; ++i)
+    {
+        const struct d3d11_resource_binder_t *binder = r->resource_binder(r->inst, si->resource_binders[i].resource);
+        if (!binder)
+            continue;
+
+        for (uint32_t j = 0; j != binder->num_binds; ++j)
+        {
+            const struct d3d11_bind_t *bind = binder->binds + j;
+            if (bind->type != BIND_TYPE__CONSTANT_BUFFER || bind->slot != slot)
+                continue;
+
+            constants->binder_index = i;
+            constants->bind_index = j;
+            constants->stage_mask = bind->stage_mask;
+            constants->data = r->constants(r->inst, bind->resource, &constants->size);
+            return constants->data != 0;
+        }
+    }
+    return false;
+}
+
+// Returns true if `cmd` can join the run started by `head`, whose per-draw constants are
+// `head_constants`, and stores the constants of `cmd` in `constants`.
+static bool
+can_join(const struct d3d11_resource_resolver_i *r, uint32_t slot, const tm_renderer_draw_command_t *head,
+    const struct draw_constants_t *head_constants, const tm_renderer_draw_command_t *cmd,
+    struct draw_constants_t *constants)
+{
+    const tm_renderer_shader_info_t *a = &head->shader_info;
+    const tm_renderer_shader_info_t *b = &cmd->shader_info;
+    if (a->shader.resource != b->shader.resource || a->num_resource_binders != b->num_resource_binders
+        || !single_instance(&cmd->draw_call) || !same_geometry(&head->draw_call, &cmd->draw_call))
+    {
+        return false;
+    }
+
+    if (!find_constants(r, b, slot, constants) || constants->binder_index != head_constants->binder_index
+        || constants->bind_index != head_constants->bind_index || constants->size != head_constants->size)
+    {
+        return false;
+    }
+
+    // Only the binder with the per-draw constants may differ, and only in the constant buffer.
+    for (uint32_t i = 0; i != a->num_resource_binders; ++i)
+    {
+        if (a->resource_binders[i].resource == b->resource_binders[i].resource)
+            continue;
+        if (i != constants->binder_index)
+            return false;
+
+        const struct d3d11_resource_binder_t *x = r->resource_binder(r->inst, a->resource_binders[i].resource);
+        const struct d3d11_resource_binder_t *y = r->resource_binder(r->inst, b->resource_binders[i].resource);
+        if (!x || !y || x->num_binds != y->num_binds)
+            return false;
+
+        for (uint32_t j = 0; j != x->num_binds; ++j)
+        {
+            const struct d3d11_bind_t *u = x->binds + j, *v = y->binds + j;
+            if (j == constants->bind_index ? u->stage_mask != v->stage_mask || u->offset != v->offset : !same_bind(u, v))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Returns the view of instance buffer `index`, creating the buffer if needed, or NULL on failure.
+static void *
+instance_buffer_view(struct d3d11_draw_instancer_t *di, uint32_t index, void **buffer)
+{
+    struct d3d11_device_i *device = di->device;
+    if (index == tm_carray_size(di->buffers))
+    {
+        const struct d3d11_buffer_desc_t desc = {
+            .size       = INSTANCE_BUFFER_SIZE,
+            .usage      = USAGE__DEFAULT,
+            .bind_flags = BIND_FLAG__SHADER_RESOURCE,
+            .misc_flags = MISC_FLAG__BUFFER_ALLOW_RAW_VIEWS,
+        };
+        void *b = device->create_buffer(device->inst, &desc, 0);
+        void *v = b ? device->create_view(device->inst, b, VIEW__SRV) : 0;
+        if (!v)
+        {
+            if (b)
+                device->release(device->inst, b);
+            tm_logger_api->print(TM_LOG_TYPE_ERROR, "Failed to create an instance buffer");
+            return 0;
+        }
+        tm_carray_push(di->buffers, b, di->allocator);
+        tm_carray_push(di->views, v, di->allocator);
+    }
+
+    *buffer = di->buffers[index];
+    return di->views[index];
+}
+
+void
+d3d11_draw_instancer__init(struct d3d11_draw_instancer_t *di, struct tm_allocator_i *allocator,
+    struct d3d11_device_i *device)
+{
+    memset(di, 0, sizeof(*di));
+    di->allocator = allocator;
+    di->device = device;
+}
+
+void
+d3d11_draw_instancer__shutdown(struct d3d11_draw_instancer_t *di)
+{
+    for (uint32_t i = 0; i != tm_carray_size(di->buffers); ++i)
+    {
+        di->device->release(di->device->inst, di->views[i]);
+        di->device->release(di->device->inst, di->buffers[i]);
+    }
+    tm_carray_free(di->buffers, di->allocator);
+    tm_carray_free(di->views, di->allocator);
+    tm_carray_free(di->runs, di->allocator);
+    memset(di, 0, sizeof(*di));
+}
+
+void
+d3d11_draw_instancer__gather(struct d3d11_draw_instancer_t *di, const struct tm_d3d11_draw_instancing_t *settings,
+    const struct d3d11_resource_resolver_i *resolver, struct d3d11_upload_ring_t *ring,
+    const tm_renderer_command_t *commands, uint32_t num_commands)
+{
+    tm_carray_shrink(di->runs, 0);
+    if (!settings->enabled || !ring)
+        return;
+
+    TM_INIT_TEMP_ALLOCATOR(ta);
+    uint8_t *records = tm_temp_alloc(ta, INSTANCE_BUFFER_SIZE);
+
+    const uint32_t slot = settings->constant_buffer_slot;
+    const tm_renderer_command_t *end = commands + num_commands;
+    for (const tm_renderer_command_t *cmd = commands; cmd != end; ++cmd)
+    {
+        if (cmd->type != TM_RENDERER_COMMAND_DRAW_CALL || tm_carray_size(di->runs) == MAX_INSTANCE_BUFFERS)
+            continue;
+
+        const tm_renderer_draw_command_t *head = cmd->data;
+        const struct d3d11_shader_t *shader = resolver->shader(resolver->inst, head->shader_info.shader.resource);
+        struct draw_constants_t head_constants;
+        if (!shader || !shader->draw_instancing || !single_instance(&head->draw_call)
+            || !find_constants(resolver, &head->shader_info, slot, &head_constants))
+        {
+            continue;
+        }
+
+        const uint32_t max_draws = INSTANCE_BUFFER_SIZE / head_constants.size;
+        memcpy(records, head_constants.data, head_constants.size);
+
+        uint32_t n = 1;
+        struct draw_constants_t constants;
+        for (const tm_renderer_command_t *next = cmd + 1; next != end && n != max_draws; ++next, ++n)
+        {
+            if (next->type != TM_RENDERER_COMMAND_DRAW_CALL
+                || !can_join(resolver, slot, head, &head_constants, next->data, &constants))
+            {
+                break;
+            }
+            memcpy(records + n * head_constants.size, constants.data, constants.size);
+        }
+        if (n == 1)
+            continue;
+
+        void *buffer;
+        void *view = instance_buffer_view(di, (uint32_t)tm_carray_size(di->runs), &buffer);
+        if (!view || !d3d11_upload_ring__copy_to_buffer(ring, buffer, 0, records, n * head_constants.size))
+            break;
+
+        const struct d3d11_instanced_run_t run = {
+            .first           = cmd,
+            .num_draws       = n,
+            .stage_mask      = head_constants.stage_mask,
+            .instance_buffer = view,
+        };
+        tm_carray_push(di->runs, run, di->allocator);
+        cmd += n - 1;
+    }
+
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+// Finds runs of consecutive draws that can be issued as a single instanced draw, see
+// `tm_d3d11_draw_instancing_t`, and gathers their per-draw constants into instance buffers.
+//
+// A run starts at a single instance draw of a shader with draw instancing enabled. Following draws
+// join it if they draw the same geometry with the same shader and bind the same resources, except
+// for the constant buffer at `constant_buffer_slot`, which must be of the same size and have a
+// system memory copy. The copies are gathered in draw order and uploaded through the upload ring.
+//
+// Every run gets an instance buffer of its own, so that shaders can index it with `SV_InstanceID`
+// alone, and is cut short when its buffer is full. The buffers are kept between frames and only
+// created when a frame has more runs than any frame before it.
+
+// Size of an instance buffer.
+#define INSTANCE_BUFFER_SIZE (16 * 1024)
+
+// Runs beyond this many per frame are drawn one draw at a time.
+#define MAX_INSTANCE_BUFFERS (512)
+
+struct d3d11_device_i;
+struct d3d11_instanced_run_t;
+struct d3d11_resource_resolver_i;
+struct d3d11_upload_ring_t;
+struct tm_allocator_i;
+struct tm_d3d11_draw_instancing_t;
+struct tm_renderer_command_t;
+
+struct d3d11_draw_instancer_t
+{
+    struct tm_allocator_i *allocator;
+    struct d3d11_device_i *device;
+
+    // Instance buffers and their raw views.
+    /* carray */ void **buffers;
+    /* carray */ void **views;
+
+    // Runs found by the latest `d3d11_draw_instancer__gather()`, in command order.
+    /* carray */ struct d3d11_instanced_run_t *runs;
+};
+
+void d3d11_draw_instancer__init(struct d3d11_draw_instancer_t *di, struct tm_allocator_i *allocator,
+    struct d3d11_device_i *device);
+
+// Releases the instance buffers. The GPU must be done with them.
+void d3d11_draw_instancer__shutdown(struct d3d11_draw_instancer_t *di);
+
+// Replaces `di->runs` with the runs of the `num_commands` sorted `commands` and queues the uploads
+// of their instance buffers on `ring`. The uploads are issued by the next flush of the ring, which
+// must come before the runs are drawn.
+void d3d11_draw_instancer__gather(struct d3d11_draw_instancer_t *di, const struct tm_d3d11_draw_instancing_t *settings,
+    const struct d3d11_resource_resolver_i *resolver, struct d3d11_upload_ring_t *ring,
+    const struct tm_renderer_command_t *commands, uint32_t num_commands);
@@ -0,0 +1,775 @@
+#include "d3d11_emulated_context.h"
+
+#include "d3d11_device.h"
+#include "d3d11_internal.h"
+
+#include <foundation/allocator.h>
+#include <foundation/carray.inl>
+#include <foundation/log.h>
+
+#include <string.h>
+
+enum emulated_call
+{
+    EMULATED_CALL__OM_SET_RENDER_TARGETS = 0,
+    EMULATED_CALL__OM_SET_BLEND_STATE,
+    EMULATED_CALL__OM_SET_DEPTH_STENCIL_STATE,
+    EMULATED_CALL__CLEAR_RENDER_TARGET_VIEW,
+    EMULATED_CALL__CLEAR_DEPTH_STENCIL_VIEW,
+    EMULATED_CALL__RS_SET_STATE,
+    EMULATED_CALL__RS_SET_VIEWPORTS,
+    EMULATED_CALL__RS_SET_SCISSOR_RECTS,
+    EMULATED_CALL__IA_SET_INPUT_LAYOUT,
+    EMULATED_CALL__IA_SET_PRIMITIVE_TOPOLOGY,
+    EMULATED_CALL__IA_SET_VERTEX_BUFFERS,
+    EMULATED_CALL__IA_SET_INDEX_BUFFER,
+    EMULATED_CALL__SET_SHADER,
+    EMULATED_CALL__SET_CONSTANT_BUFFERS,
+    EMULATED_CALL__SET_CONSTANT_BUFFERS1,
+    EMULATED_CALL__SET_SHADER_RESOURCES,
+    EMULATED_CALL__SET_SAMPLERS,
+    EMULATED_CALL__CS_SET_UNORDERED_ACCESS_VIEWS,
+    EMULATED_CALL__DRAW_INSTANCED,
+    EMULATED_CALL__DRAW_INDEXED_INSTANCED,
+    EMULATED_CALL__DISPATCH,
+    EMULATED_CALL__DRAW_INSTANCED_INDIRECT,
+    EMULATED_CALL__DRAW_INDEXED_INSTANCED_INDIRECT,
+    EMULATED_CALL__DISPATCH_INDIRECT,
+    EMULATED_CALL__COPY_BUFFER_REGION,
+    EMULATED_CALL__COPY_SUBRESOURCE,
+    EMULATED_CALL__SET_RESOURCE_MIN_LOD,
+    EMULATED_CALL__BEGIN_QUERY,
+    EMULATED_CALL__END_QUERY,
+};
+
+// Every call in the stream starts with a header, followed by `size` bytes of arguments. Array
+// arguments follow the fixed arguments. Sizes are rounded up to keep the headers aligned.
+struct call_header_t
+{
+    uint32_t call;
+    uint32_t size;
+};
+
+struct object_args_t
+{
+    void *object;
+};
+
+struct render_targets_args_t
+{
+    void *dsv;
+    uint32_t num_views;
+    TM_PAD(4);
+    // void *rtvs[num_views];
+};
+
+struct blend_state_args_t
+{
+    void *state;
+    float blend_factor[4];
+    uint32_t sample_mask;
+    TM_PAD(4);
+};
+
+struct depth_stencil_state_args_t
+{
+    void *state;
+    uint32_t stencil_ref;
+    TM_PAD(4);
+};
+
+struct clear_render_target_args_t
+{
+    void *rtv;
+    float color[4];
+};
+
+struct clear_depth_stencil_args_t
+{
+    void *dsv;
+    uint32_t clear_flags;
+    float depth;
+    uint8_t stencil;
+    TM_PAD(7);
+};
+
+struct count_args_t
+{
+    uint32_t count;
+    TM_PAD(4);
+    // struct d3d11_viewport_t viewports[count] or struct d3d11_rect_t rects[count];
+};
+
+struct vertex_buffers_args_t
+{
+    uint32_t start_slot;
+    uint32_t num_buffers;
+    // void *buffers[num_buffers];
+    // uint32_t strides[num_buffers];
+    // uint32_t offsets[num_buffers];
+};
+
+struct index_buffer_args_t
+{
+    void *buffer;
+    uint32_t format;
+    uint32_t offset;
+};
+
+struct shader_args_t
+{
+    void *shader;
+    uint32_t stage;
+    TM_PAD(4);
+};
+
+// Constant buffers, shader resources, samplers and unordered access views.
+struct slots_args_t
+{
+    uint32_t stage;
+    uint32_t start_slot;
+    uint32_t num_objects;
+    TM_PAD(4);
+    // void *objects[num_objects];
+};
+
+struct draw_args_t
+{
+    uint32_t count_per_instance;
+    uint32_t instance_count;
+    uint32_t start;
+    int32_t base_vertex;
+    uint32_t start_instance;
+};
+
+struct dispatch_args_t
+{
+    uint32_t x, y, z;
+};
+
+// Also used by indirect draws.
+struct dispatch_indirect_args_t
+{
+    void *args_buffer;
+    uint32_t offset;
+    TM_PAD(4);
+};
+
+struct copy_buffer_region_args_t
+{
+    void *dst;
+    void *src;
+    uint32_t dst_offset;
+    uint32_t src_offset;
+    uint32_t size;
+    TM_PAD(4);
+};
+
+struct copy_subresource_args_t
+{
+    void *dst;
+    void *src;
+    uint32_t dst_subresource;
+    uint32_t src_subresource;
+};
+
+struct set_resource_min_lod_args_t
+{
+    void *resource;
+    float min_lod;
+    TM_PAD(4);
+};
+
+struct d3d11_context_o
+{
+    struct d3d11_context_i i;
+
+    struct tm_allocator_i *allocator;
+
+    /* carray */ uint8_t *stream;
+};
+
+// Appends a call with `size` bytes of arguments to the stream and returns a pointer to the
+// arguments. The pointer is valid until the next call is recorded.
+static void *
+push(struct d3d11_context_o *inst, enum emulated_call call, uint64_t size)
+{
+    size = (size + 7) & ~7ULL;
+    const uint64_t offset = tm_carray_size(inst->stream);
+    tm_carray_resize(inst->stream, offset + sizeof(struct call_header_t) + size, inst->allocator);
+
+    const struct call_header_t header = { call, (uint32_t)size };
+    memcpy(inst->stream + offset, &header, sizeof(header));
+    return inst->stream + offset + sizeof(header);
+}
+
+// -------------------------------------------------------------------
+// Recording
+
+static void
+context__om_set_render_targets(struct d3d11_context_o *inst, uint32_t num_views, void *const *rtvs, void *dsv)
+{
+    struct render_targets_args_t *a = push(inst, EMULATED_CALL__OM_SET_RENDER_TARGETS,
+        sizeof(*a) + num_views * sizeof(void *));
+    *a = (struct render_targets_args_t) { .dsv = dsv, .num_views = num_views };
+    memcpy(a + 1, rtvs, num_views * sizeof(void *));
+}
+
+static void
+context__om_set_blend_state(struct d3d11_context_o *inst, void *state, const float blend_factor[4], uint32_t sample_mask)
+{
+    struct blend_state_args_t *a = push(inst, EMULATED_CALL__OM_SET_BLEND_STATE, sizeof(*a));
+    *a = (struct blend_state_args_t) { .state = state, .blend_factor = { 1, 1, 1, 1 }, .sample_mask = sample_mask };
+    if (blend_factor)
+        memcpy(a->blend_factor, blend_factor, sizeof(a->blend_factor));
+}
+
+static void
+context__om_set_depth_stencil_state(struct d3d11_context_o *inst, void *state, uint32_t stencil_ref)
+{
+    struct depth_stencil_state_args_t *a = push(inst, EMULATED_CALL__OM_SET_DEPTH_STENCIL_STATE, sizeof(*a));
+    *a = (struct depth_stencil_state_args_t) { .state = state, .stencil_ref = stencil_ref };
+}
+
+static void
+context__clear_render_target_view(struct d3d11_context_o *inst, void *rtv, const float color[4])
+{
+    struct clear_render_target_args_t *a = push(inst, EMULATED_CALL__CLEAR_RENDER_TARGET_VIEW, sizeof(*a));
+    a->rtv = rtv;
+    memcpy(a->color, color, sizeof(a->color));
+}
+
+static void
+context__clear_depth_stencil_view(struct d3d11_context_o *inst, void *dsv, uint32_t clear_flags, float depth, uint8_t stencil)
+{
+    struct clear_depth_stencil_args_t *a = push(inst, EMULATED_CALL__CLEAR_DEPTH_STENCIL_VIEW, sizeof(*a));
+    *a = (struct clear_depth_stencil_args_t) { .dsv = dsv, .clear_flags = clear_flags, .depth = depth, .stencil = stencil };
+}
+
+static void
+push_object(struct d3d11_context_o *inst, enum emulated_call call, void *object)
+{
+    struct object_args_t *a = push(inst, call, sizeof(*a));
+    a->object = object;
+}
+
+static void
+context__rs_set_state(struct d3d11_context_o *inst, void *state)
+{
+    push_object(inst, EMULATED_CALL__RS_SET_STATE, state);
+}
+
+static void
+context__rs_set_viewports(struct d3d11_context_o *inst, uint32_t num_viewports, const struct d3d11_viewport_t *viewports)
+{
+    struct count_args_t *a = push(inst, EMULATED_CALL__RS_SET_VIEWPORTS, sizeof(*a) + num_viewports * sizeof(*viewports));
+    *a = (struct count_args_t) { .count = num_viewports };
+    memcpy(a + 1, viewports, num_viewports * sizeof(*viewports));
+}
+
+static void
+context__rs_set_scissor_rects(struct d3d11_context_o *inst, uint32_t num_rects, const struct d3d11_rect_t *rects)
+{
+    struct count_args_t *a = push(inst, EMULATED_CALL__RS_SET_SCISSOR_RECTS, sizeof(*a) + num_rects * sizeof(*rects));
+    *a = (struct count_args_t) { .count = num_rects };
+    memcpy(a + 1, rects, num_rects * sizeof(*rects));
+}
+
+static void
+context__ia_set_input_layout(struct d3d11_context_o *inst, void *layout)
+{
+    push_object(inst, EMULATED_CALL__IA_SET_INPUT_LAYOUT, layout);
+}
+
+static void
+context__ia_set_primitive_topology(struct d3d11_context_o *inst, uint32_t topology)
+{
+    struct count_args_t *a = push(inst, EMULATED_CALL__IA_SET_PRIMITIVE_TOPOLOGY, sizeof(*a));
+    *a = (struct count_args_t) { .count = topology };
+}
+
+static void
+context__ia_set_vertex_buffers(struct d3d11_context_o *inst, uint32_t start_slot, uint32_t num_buffers,
+    void *const *buffers, const uint32_t *strides, const uint32_t *offsets)
+{
+    struct vertex_buffers_args_t *a = push(inst, EMULATED_CALL__IA_SET_VERTEX_BUFFERS,
+        sizeof(*a) + num_buffers * (sizeof(void *) + 2 * sizeof(uint32_t)));
+    *a = (struct vertex_buffers_args_t) { .start_slot = start_slot, .num_buffers = num_buffers };
+
+    uint8_t *p = (uint8_t *)(a + 1);
+    memcpy(p, buffers, num_buffers * sizeof(void *));
+    memcpy(p + num_buffers * sizeof(void *), strides, num_buffers * sizeof(uint32_t));
+    memcpy(p + num_buffers * (sizeof(void *) + sizeof(uint32_t)), offsets, num_buffers * sizeof(uint32_t));
+}
+
+static void
+context__ia_set_index_buffer(struct d3d11_context_o *inst, void *buffer, uint32_t format, uint32_t offset)
+{
+    struct index_buffer_args_t *a = push(inst, EMULATED_CALL__IA_SET_INDEX_BUFFER, sizeof(*a));
+    *a = (struct index_buffer_args_t) { .buffer = buffer, .format = format, .offset = offset };
+}
+
+static void
+context__set_shader(struct d3d11_context_o *inst, uint32_t stage, void *shader)
+{
+    struct shader_args_t *a = push(inst, EMULATED_CALL__SET_SHADER, sizeof(*a));
+    *a = (struct shader_args_t) { .shader = shader, .stage = stage };
+}
+
+static void
+push_slots(struct d3d11_context_o *inst, enum emulated_call call, uint32_t stage, uint32_t start_slot,
+    uint32_t num_objects, void *const *objects)
+{
+    struct slots_args_t *a = push(inst, call, sizeof(*a) + num_objects * sizeof(void *));
+    *a = (struct slots_args_t) { .stage = stage, .start_slot = start_slot, .num_objects = num_objects };
+    memcpy(a + 1, objects, num_objects * sizeof(void *));
+}
+
+static void
+context__set_constant_buffers(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_buffers, void *const *buffers)
+{
+    push_slots(inst, EMULATED_CALL__SET_CONSTANT_BUFFERS, stage, start_slot, num_buffers, buffers);
+}
+
+static void
+context__set_constant_buffers1(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_buffers, void *const *buffers, const uint32_t *first_constants, const uint32_t *num_constants)
+{
+    // The ranges follow the buffers: uint32_t first_constants[num_buffers], num_constants[num_buffers].
+    struct slots_args_t *a = push(inst, EMULATED_CALL__SET_CONSTANT_BUFFERS1,
+        sizeof(*a) + num_buffers * (sizeof(void *) + 2 * sizeof(uint32_t)));
+    *a = (struct slots_args_t) { .stage = stage, .start_slot = start_slot, .num_objects = num_buffers };
+
+    uint8_t *p = (uint8_t *)(a + 1);
+    memcpy(p, buffers, num_buffers * sizeof(void *));
+    memcpy(p + num_buffers * sizeof(void *), first_constants, num_buffers * sizeof(uint32_t));
+    memcpy(p + num_buffers * (sizeof(void *) + sizeof(uint32_t)), num_constants, num_buffers * sizeof(uint32_t));
+}
+
+static void
+context__set_shader_resources(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_views, void *const *views)
+{
+    push_slots(inst, EMULATED_CALL__SET_SHADER_RESOURCES, stage, start_slot, num_views, views);
+}
+
+static void
+context__set_samplers(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_samplers, void *const *samplers)
+{
+    push_slots(inst, EMULATED_CALL__SET_SAMPLERS, stage, start_slot, num_samplers, samplers);
+}
+
+static void
+context__cs_set_unordered_access_views(struct d3d11_context_o *inst, uint32_t start_slot, uint32_t num_views,
+    void *const *uavs)
+{
+    push_slots(inst, EMULATED_CALL__CS_SET_UNORDERED_ACCESS_VIEWS, SHADER_STAGE__COMPUTE, start_slot, num_views, uavs);
+}
+
+static void
+context__draw_instanced(struct d3d11_context_o *inst, uint32_t vertex_count_per_instance, uint32_t instance_count,
+    uint32_t start_vertex, uint32_t start_instance)
+{
+    struct draw_args_t *a = push(inst, EMULATED_CALL__DRAW_INSTANCED, sizeof(*a));
+    *a = (struct draw_args_t) {
+        .count_per_instance = vertex_count_per_instance,
+        .instance_count     = instance_count,
+        .start              = start_vertex,
+        .start_instance     = start_instance,
+    };
+}
+
+static void
+context__draw_indexed_instanced(struct d3d11_context_o *inst, uint32_t index_count_per_instance,
+    uint32_t instance_count, uint32_t start_index, int32_t base_vertex, uint32_t start_instance)
+{
+    struct draw_args_t *a = push(inst, EMULATED_CALL__DRAW_INDEXED_INSTANCED, sizeof(*a));
+    *a = (struct draw_args_t) {
+        .count_per_instance = index_count_per_instance,
+        .instance_count     = instance_count,
+        .start              = start_index,
+        .base_vertex        = base_vertex,
+        .start_instance     = start_instance,
+    };
+}
+
+static void
+context__dispatch(struct d3d11_context_o *inst, uint32_t x, uint32_t y, uint32_t z)
+{
+    struct dispatch_args_t *a = push(inst, EMULATED_CALL__DISPATCH, sizeof(*a));
+    *a = (struct dispatch_args_t) { x, y, z };
+}
+
+static void
+context__draw_instanced_indirect(struct d3d11_context_o *inst, void *args_buffer, uint32_t offset)
+{
+    struct dispatch_indirect_args_t *a = push(inst, EMULATED_CALL__DRAW_INSTANCED_INDIRECT, sizeof(*a));
+    *a = (struct dispatch_indirect_args_t) { .args_buffer = args_buffer, .offset = offset };
+}
+
+static void
+context__draw_indexed_instanced_indirect(struct d3d11_context_o *inst, void *args_buffer, uint32_t offset)
+{
+    struct dispatch_indirect_args_t *a = push(inst, EMULATED_CALL__DRAW_INDEXED_INSTANCED_INDIRECT, sizeof(*a));
+    *a = (struct dispatch_indirect_args_t) { .args_buffer = args_buffer, .offset = offset };
+}
+
+static void
+context__dispatch_indirect(struct d3d11_context_o *inst, void *args_buffer, uint32_t offset)
+{
+    struct dispatch_indirect_args_t *a = push(inst, EMULATED_CALL__DISPATCH_INDIRECT, sizeof(*a));
+    *a = (struct dispatch_indirect_args_t) { .args_buffer = args_buffer, .offset = offset };
+}
+
+static void
+context__copy_buffer_region(struct d3d11_context_o *inst, void *dst, uint32_t dst_offset, void *src,
+    uint32_t src_offset, uint32_t size)
+{
+    struct copy_buffer_region_args_t *a = push(inst, EMULATED_CALL__COPY_BUFFER_REGION, sizeof(*a));
+    *a = (struct copy_buffer_region_args_t) {
+        .dst        = dst,
+        .src        = src,
+        .dst_offset = dst_offset,
+        .src_offset = src_offset,
+        .size       = size,
+    };
+}
+
+static void
+context__copy_subresource(struct d3d11_context_o *inst, void *dst, uint32_t dst_subresource, void *src,
+    uint32_t src_subresource)
+{
+    struct copy_subresource_args_t *a = push(inst, EMULATED_CALL__COPY_SUBRESOURCE, sizeof(*a));
+    *a = (struct copy_subresource_args_t) {
+        .dst             = dst,
+        .src             = src,
+        .dst_subresource = dst_subresource,
+        .src_subresource = src_subresource,
+    };
+}
+
+static void
+context__update_subresource(struct d3d11_context_o *inst, void *resource, uint32_t subresource,
+    const struct d3d11_box_t *box, const void *data, uint32_t row_pitch, uint32_t depth_pitch)
+{
+    tm_logger_api->print(TM_LOG_TYPE_ERROR, "Uploads must go through the immediate context");
+}
+
+static void
+context__set_resource_min_lod(struct d3d11_context_o *inst, void *resource, float min_lod)
+{
+    struct set_resource_min_lod_args_t *a = push(inst, EMULATED_CALL__SET_RESOURCE_MIN_LOD, sizeof(*a));
+    *a = (struct set_resource_min_lod_args_t) {
+        .resource = resource,
+        .min_lod  = min_lod,
+    };
+}
+
+static void *
+context__map(struct d3d11_context_o *inst, void *resource, uint32_t subresource, uint32_t map_type)
+{
+    tm_logger_api->print(TM_LOG_TYPE_ERROR, "Maps must go through the immediate context");
+    return 0;
+}
+
+static void
+context__unmap(struct d3d11_context_o *inst, void *resource, uint32_t subresource)
+{
+}
+
+static void
+context__begin_query(struct d3d11_context_o *inst, void *query)
+{
+    push_object(inst, EMULATED_CALL__BEGIN_QUERY, query);
+}
+
+static void
+context__end_query(struct d3d11_context_o *inst, void *query)
+{
+    push_object(inst, EMULATED_CALL__END_QUERY, query);
+}
+
+static bool
+context__get_query_data(struct d3d11_context_o *inst, void *query, void *data, uint32_t size, bool flush)
+{
+    tm_logger_api->print(TM_LOG_TYPE_ERROR, "Queries must be read on the immediate context");
+    return false;
+}
+
+static void *
+context__finish_command_list(struct d3d11_context_o *inst)
+{
+    return 0;
+}
+
+static void
+context__execute_command_list(struct d3d11_context_o *inst, void *command_list)
+{
+}
+
+// -------------------------------------------------------------------
+// Replay
+
+static void
+replay_call(struct d3d11_context_i *ctx, uint32_t call, const void *args)
+{
+    switch (call)
+    {
+    case EMULATED_CALL__OM_SET_RENDER_TARGETS:
+    {
+        const struct render_targets_args_t *a = args;
+        ctx->om_set_render_targets(ctx->inst, a->num_views, (void *const *)(a + 1), a->dsv);
+        break;
+    }
+    case EMULATED_CALL__OM_SET_BLEND_STATE:
+    {
+        const struct blend_state_args_t *a = args;
+        ctx->om_set_blend_state(ctx->inst, a->state, a->blend_factor, a->sample_mask);
+        break;
+    }
+    case EMULATED_CALL__OM_SET_DEPTH_STENCIL_STATE:
+    {
+        const struct depth_stencil_state_args_t *a = args;
+        ctx->om_set_depth_stencil_state(ctx->inst, a->state, a->stencil_ref);
+        break;
+    }
+    case EMULATED_CALL__CLEAR_RENDER_TARGET_VIEW:
+    {
+        const struct clear_render_target_args_t *a = args;
+        ctx->clear_render_target_view(ctx->inst, a->rtv, a->color);
+        break;
+    }
+    case EMULATED_CALL__CLEAR_DEPTH_STENCIL_VIEW:
+    {
+        const struct clear_depth_stencil_args_t *a = args;
+        ctx->clear_depth_stencil_view(ctx->inst, a->dsv, a->clear_flags, a->depth, a->stencil);
+        break;
+    }
+    case EMULATED_CALL__RS_SET_STATE:
+        ctx->rs_set_state(ctx->inst, ((const struct object_args_t *)args)->object);
+        break;
+    case EMULATED_CALL__RS_SET_VIEWPORTS:
+    {
+        const struct count_args_t *a = args;
+        ctx->rs_set_viewports(ctx->inst, a->count, (const struct d3d11_viewport_t *)(a + 1));
+        break;
+    }
+    case EMULATED_CALL__RS_SET_SCISSOR_RECTS:
+    {
+        const struct count_args_t *a = args;
+        ctx->rs_set_scissor_rects(ctx->inst, a->count, (const struct d3d11_rect_t *)(a + 1));
+        break;
+    }
+    case EMULATED_CALL__IA_SET_INPUT_LAYOUT:
+        ctx->ia_set_input_layout(ctx->inst, ((const struct object_args_t *)args)->object);
+        break;
+    case EMULATED_CALL__IA_SET_PRIMITIVE_TOPOLOGY:
+        ctx->ia_set_primitive_topology(ctx->inst, ((const struct count_args_t *)args)->count);
+        break;
+    case EMULATED_CALL__IA_SET_VERTEX_BUFFERS:
+    {
+        const struct vertex_buffers_args_t *a = args;
+        const uint8_t *p = (const uint8_t *)(a + 1);
+        const uint32_t n = a->num_buffers;
+        ctx->ia_set_vertex_buffers(ctx->inst, a->start_slot, n, (void *const *)p,
+            (const uint32_t *)(p + n * sizeof(void *)), (const uint32_t *)(p + n * (sizeof(void *) + sizeof(uint32_t))));
+        break;
+    }
+    case EMULATED_CALL__IA_SET_INDEX_BUFFER:
+    {
+        const struct index_buffer_args_t *a = args;
+        ctx->ia_set_index_buffer(ctx->inst, a->buffer, a->format, a->offset);
+        break;
+    }
+    case EMULATED_CALL__SET_SHADER:
+    {
+        const struct shader_args_t *a = args;
+        ctx->set_shader(ctx->inst, a->stage, a->shader);
+        break;
+    }
+    case EMULATED_CALL__SET_CONSTANT_BUFFERS:
+    {
+        const struct slots_args_t *a = args;
+        ctx->set_constant_buffers(ctx->inst, a->stage, a->start_slot, a->num_objects, (void *const *)(a + 1));
+        break;
+    }
+    case EMULATED_CALL__SET_CONSTANT_BUFFERS1:
+    {
+        const struct slots_args_t *a = args;
+        const uint8_t *p = (const uint8_t *)(a + 1);
+        const uint32_t n = a->num_objects;
+        ctx->set_constant_buffers1(ctx->inst, a->stage, a->start_slot, n, (void *const *)p,
+            (const uint32_t *)(p + n * sizeof(void *)), (const uint32_t *)(p + n * (sizeof(void *) + sizeof(uint32_t))));
+        break;
+    }
+    case EMULATED_CALL__SET_SHADER_RESOURCES:
+    {
+        const struct slots_args_t *a = args;
+        ctx->set_shader_resources(ctx->inst, a->stage, a->start_slot, a->num_objects, (void *const *)(a + 1));
+        break;
+    }
+    case EMULATED_CALL__SET_SAMPLERS:
+    {
+        const struct slots_args_t *a = args;
+        ctx->set_samplers(ctx->inst, a->stage, a->start_slot, a->num_objects, (void *const *)(a + 1));
+        break;
+    }
+    case EMULATED_CALL__CS_SET_UNORDERED_ACCESS_VIEWS:
+    {
+        const struct slots_args_t *a = args;
+        ctx->cs_set_unordered_access_views(ctx->inst, a->start_slot, a->num_objects, (void *const *)(a + 1));
+        break;
+    }
+    case EMULATED_CALL__DRAW_INSTANCED:
+    {
+        const struct draw_args_t *a = args;
+        ctx->draw_instanced(ctx->inst, a->count_per_instance, a->instance_count, a->start, a->start_instance);
+        break;
+    }
+    case EMULATED_CALL__DRAW_INDEXED_INSTANCED:
+    {
+        const struct draw_args_t *a = args;
+        ctx->draw_indexed_instanced(ctx->inst, a->count_per_instance, a->instance_count, a->start, a->base_vertex,
+            a->start_instance);
+        break;
+    }
+    case EMULATED_CALL__DISPATCH:
+    {
+        const struct dispatch_args_t *a = args;
+        ctx->dispatch(ctx->inst, a->x, a->y, a->z);
+        break;
+    }
+    case EMULATED_CALL__DRAW_INSTANCED_INDIRECT:
+    {
+        const struct dispatch_indirect_args_t *a = args;
+        ctx->draw_instanced_indirect(ctx->inst, a->args_buffer, a->offset);
+        break;
+    }
+    case EMULATED_CALL__DRAW_INDEXED_INSTANCED_INDIRECT:
+    {
+        const struct dispatch_indirect_args_t *a = args;
+        ctx->draw_indexed_instanced_indirect(ctx->inst, a->args_buffer, a->offset);
+        break;
+    }
+    case EMULATED_CALL__DISPATCH_INDIRECT:
+    {
+        const struct dispatch_indirect_args_t *a = args;
+        ctx->dispatch_indirect(ctx->inst, a->args_buffer, a->offset);
+        break;
+    }
+    case EMULATED_CALL__COPY_BUFFER_REGION:
+    {
+        const struct copy_buffer_region_args_t *a = args;
+        ctx->copy_buffer_region(ctx->inst, a->dst, a->dst_offset, a->src, a->src_offset, a->size);
+        break;
+    }
+    case EMULATED_CALL__COPY_SUBRESOURCE:
+    {
+        const struct copy_subresource_args_t *a = args;
+        ctx->copy_subresource(ctx->inst, a->dst, a->dst_subresource, a->src, a->src_subresource);
+        break;
+    }
+    case EMULATED_CALL__SET_RESOURCE_MIN_LOD:
+    {
+        const struct set_resource_min_lod_args_t *a = args;
+        ctx->set_resource_min_lod(ctx->inst, a->resource, a->min_lod);
+        break;
+    }
+    case EMULATED_CALL__BEGIN_QUERY:
+        ctx->begin_query(ctx->inst, ((const struct object_args_t *)args)->object);
+        break;
+    case EMULATED_CALL__END_QUERY:
+        ctx->end_query(ctx->inst, ((const struct object_args_t *)args)->object);
+        break;
+    default:
+        break;
+    }
+}
+
+// -------------------------------------------------------------------
+// Public
+
+struct d3d11_context_i *
+d3d11_emulated_context__create(struct tm_allocator_i *allocator)
+{
+    struct d3d11_context_o *o = tm_alloc(allocator, sizeof(*o));
+    memset(o, 0, sizeof(*o));
+
+    o->i = (struct d3d11_context_i) {
+        .inst                            = o,
+        .om_set_render_targets           = context__om_set_render_targets,
+        .om_set_blend_state              = context__om_set_blend_state,
+        .om_set_depth_stencil_state      = context__om_set_depth_stencil_state,
+        .clear_render_target_view        = context__clear_render_target_view,
+        .clear_depth_stencil_view        = context__clear_depth_stencil_view,
+        .rs_set_state                    = context__rs_set_state,
+        .rs_set_viewports                = context__rs_set_viewports,
+        .rs_set_scissor_rects            = context__rs_set_scissor_rects,
+        .ia_set_input_layout             = context__ia_set_input_layout,
+        .ia_set_primitive_topology       = context__ia_set_primitive_topology,
+        .ia_set_vertex_buffers           = context__ia_set_vertex_buffers,
+        .ia_set_index_buffer             = context__ia_set_index_buffer,
+        .set_shader                      = context__set_shader,
+        .set_constant_buffers            = context__set_constant_buffers,
+        .set_constant_buffers1           = context__set_constant_buffers1,
+        .set_shader_resources            = context__set_shader_resources,
+        .set_samplers                    = context__set_samplers,
+        .cs_set_unordered_access_views   = context__cs_set_unordered_access_views,
+        .draw_instanced                  = context__draw_instanced,
+        .draw_indexed_instanced          = context__draw_indexed_instanced,
+        .dispatch                        = context__dispatch,
+        .draw_instanced_indirect         = context__draw_instanced_indirect,
+        .draw_indexed_instanced_indirect = context__draw_indexed_instanced_indirect,
+        .dispatch_indirect               = context__dispatch_indirect,
+        .copy_buffer_region              = context__copy_buffer_region,
+        .copy_subresource                = context__copy_subresource,
+        .update_subresource              = context__update_subresource,
+        .set_resource_min_lod            = context__set_resource_min_lod,
+        .map                             = context__map,
+        .unmap                           = context__unmap,
+        .begin_query                     = context__begin_query,
+        .end_query                       = context__end_query,
+        .get_query_data                  = context__get_query_data,
+        .finish_command_list             = context__finish_command_list,
+        .execute_command_list            = context__execute_command_list,
+    };
+    o->allocator = allocator;
+
+    return &o->i;
+}
+
+void
+d3d11_emulated_context__destroy(struct d3d11_context_i *context)
+{
+    struct d3d11_context_o *o = context->inst;
+    tm_carray_free(o->stream, o->allocator);
+    tm_free(o->allocator, o, sizeof(*o));
+}
+
+void
+d3d11_emulated_context__replay(struct d3d11_context_i *context, struct d3d11_context_i *target)
+{
+    struct d3d11_context_o *o = context->inst;
+
+    const uint8_t *p = o->stream;
+    const uint8_t *end = tm_carray_end(o->stream);
+    while (p != end)
+    {
+        struct call_header_t header;
+        memcpy(&header, p, sizeof(header));
+        p += sizeof(header);
+
+        replay_call(target, header.call, p);
+        p += header.size;
+    }
+
+    tm_carray_shrink(o->stream, 0);
+}
+
+uint64_t
+d3d11_emulated_context__size(const struct d3d11_context_i *context)
+{
+    return tm_carray_size(context->inst->stream);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+// Context that records the calls made on it into a flat byte stream instead of issuing them, so
+// that command translation can run on several threads without driver support for command lists.
+// The stream is replayed on the immediate context afterwards, in the order it was recorded.
+//
+// Only the calls the command translator makes are recorded. Uploads, maps and queries need the
+// immediate context and are dropped.
+
+struct d3d11_context_i;
+struct tm_allocator_i;
+
+// Creates an empty emulated context.
+struct d3d11_context_i *d3d11_emulated_context__create(struct tm_allocator_i *allocator);
+
+void d3d11_emulated_context__destroy(struct d3d11_context_i *context);
+
+// Issues the recorded calls on `target` and clears the stream. The stream memory is kept for the
+// next recording.
+void d3d11_emulated_context__replay(struct d3d11_context_i *context, struct d3d11_context_i *target);
+
+// Returns the size in bytes of the recorded stream.
+uint64_t d3d11_emulated_context__size(const struct d3d11_context_i *context);
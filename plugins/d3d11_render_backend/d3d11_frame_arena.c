@@ -0,0 +1,117 @@
+#include "d3d11_frame_arena.h"
+
+#include "d3d11_device.h"
+#include "d3d11_internal.h"
+
+#include <foundation/allocator.h>
+#include <foundation/os.h>
+
+#include <string.h>
+
+// Largest supported alignment. The regions start at multiples of it.
+#define MAX_ALIGNMENT (64)
+
+#define MEMORY_SIZE (FRAME_ARENA_NUM_FRAMES * (uint64_t)FRAME_ARENA_FRAME_SIZE + MAX_ALIGNMENT)
+
+static uint8_t *
+region(const struct d3d11_frame_arena_t *arena, uint32_t frame)
+{
+    const uintptr_t base = ((uintptr_t)arena->memory + MAX_ALIGNMENT - 1) & ~(uintptr_t)(MAX_ALIGNMENT - 1);
+    return (uint8_t *)base + (uint64_t)frame * FRAME_ARENA_FRAME_SIZE;
+}
+
+bool
+d3d11_frame_arena__init(struct d3d11_frame_arena_t *arena, struct tm_allocator_i *allocator,
+    struct d3d11_device_i *device)
+{
+    memset(arena, 0, sizeof(*arena));
+    arena->allocator = allocator;
+    arena->device = device;
+    arena->memory = tm_alloc(allocator, MEMORY_SIZE);
+
+    for (uint32_t i = 0; i != FRAME_ARENA_NUM_FRAMES; ++i)
+        arena->queries[i] = device->create_query(device->inst, QUERY__EVENT);
+
+    if (!arena->memory || !arena->queries[FRAME_ARENA_NUM_FRAMES - 1])
+    {
+        d3d11_frame_arena__shutdown(arena);
+        return false;
+    }
+    return true;
+}
+
+void
+d3d11_frame_arena__shutdown(struct d3d11_frame_arena_t *arena)
+{
+    struct d3d11_device_i *device = arena->device;
+    if (!device)
+        return;
+
+    for (uint32_t i = 0; i != FRAME_ARENA_NUM_FRAMES; ++i)
+    {
+        if (arena->queries[i])
+            device->release(device->inst, arena->queries[i]);
+    }
+    if (arena->memory)
+        tm_free(arena->allocator, arena->memory, MEMORY_SIZE);
+    memset(arena, 0, sizeof(*arena));
+}
+
+void
+d3d11_frame_arena__begin_frame(struct d3d11_frame_arena_t *arena)
+{
+    if (!arena->device)
+        return;
+
+    arena->frame = (arena->frame + 1) % FRAME_ARENA_NUM_FRAMES;
+    atomic_store_uint64_t(&arena->used, 0);
+
+    if (!arena->pending[arena->frame])
+        return;
+
+    struct d3d11_context_i *ctx = arena->device->immediate_context(arena->device->inst);
+    void *query = arena->queries[arena->frame];
+    uint32_t signaled = 0;
+    if (!ctx->get_query_data(ctx->inst, query, &signaled, sizeof(signaled), false))
+    {
+        const tm_clock_o start = tm_os_api->time->now();
+        while (!ctx->get_query_data(ctx->inst, query, &signaled, sizeof(signaled), true))
+            ;
+        ++arena->stats.num_stalls;
+        arena->stats.stall_seconds += tm_os_api->time->delta(tm_os_api->time->now(), start);
+    }
+    arena->pending[arena->frame] = false;
+}
+
+void *
+d3d11_frame_arena__allocate(struct d3d11_frame_arena_t *arena, uint64_t size, uint32_t alignment)
+{
+    if (!arena->memory || alignment > MAX_ALIGNMENT)
+        return 0;
+
+    // Asking for the worst case padding up front keeps the bump a single atomic add.
+    const uint64_t mask = (uint64_t)(alignment ? alignment : 1) - 1;
+    const uint64_t offset = atomic_fetch_add_uint64_t(&arena->used, size + mask);
+    if (offset + size + mask > FRAME_ARENA_FRAME_SIZE)
+    {
+        atomic_fetch_add_uint64_t(&arena->num_overflows, 1);
+        return 0;
+    }
+
+    const uintptr_t p = (uintptr_t)(region(arena, arena->frame) + offset);
+    return (void *)((p + mask) & ~(uintptr_t)mask);
+}
+
+void
+d3d11_frame_arena__end_frame(struct d3d11_frame_arena_t *arena)
+{
+    if (!arena->device)
+        return;
+
+    arena->stats.high_water = tm_max(arena->stats.high_water, atomic_load_uint64_t(&arena->used));
+    arena->stats.num_overflows = atomic_load_uint64_t(&arena->num_overflows);
+
+    struct d3d11_context_i *ctx = arena->device->immediate_context(arena->device->inst);
+    ctx->end_query(ctx->inst, arena->queries[arena->frame]);
+    arena->pending[arena->frame] = true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <foundation/api_types.h>
+#include <foundation/atomics.inl>
+
+// Linear arena for the system memory data a submit produces and throws away, like the merged and
+// sorted commands.
+//
+// The arena is split in `FRAME_ARENA_NUM_FRAMES` equal regions used round robin, one per frame.
+// Allocating bumps the offset of the current region and never frees, any thread can allocate.
+// `d3d11_frame_arena__end_frame()` marks the end of the frame's work with an event query and
+// `d3d11_frame_arena__begin_frame()` resets the next region once the GPU has passed the marker
+// of the frame that used it last, so data referenced by work in flight stays valid until the
+// GPU is done with it. An allocation that doesn't fit returns NULL, callers fall back to the
+// heap. The high-water mark counts those allocations too, so it is the region size that would
+// have been needed.
+
+#define FRAME_ARENA_NUM_FRAMES (3)
+
+// Size of each region.
+#define FRAME_ARENA_FRAME_SIZE (8 * 1024 * 1024)
+
+struct d3d11_device_i;
+struct tm_allocator_i;
+
+struct d3d11_frame_arena_statistics_t
+{
+    // Most bytes a frame has asked for, and the number of allocations that didn't fit.
+    uint64_t high_water;
+    uint64_t num_overflows;
+
+    // Number of times a region was still in use by the GPU when its turn came, and the time spent
+    // waiting for it.
+    uint64_t num_stalls;
+    double stall_seconds;
+};
+
+struct d3d11_frame_arena_t
+{
+    struct tm_allocator_i *allocator;
+    struct d3d11_device_i *device;
+
+    uint8_t *memory;
+
+    // Region of the current frame, and the bytes asked for from it. May exceed
+    // `FRAME_ARENA_FRAME_SIZE`, allocations past it fail.
+    uint32_t frame;
+    TM_PAD(4);
+    atomic_uint64_t used;
+
+    // Event queries marking the end of each region's latest frame, and whether they have been
+    // issued and not yet passed.
+    void *queries[FRAME_ARENA_NUM_FRAMES];
+    bool pending[FRAME_ARENA_NUM_FRAMES];
+    TM_PAD(8 - FRAME_ARENA_NUM_FRAMES);
+
+    atomic_uint64_t num_overflows;
+    struct d3d11_frame_arena_statistics_t stats;
+};
+
+// Allocates the regions and creates the queries on `device`. Returns false on failure.
+bool d3d11_frame_arena__init(struct d3d11_frame_arena_t *arena, struct tm_allocator_i *allocator,
+    struct d3d11_device_i *device);
+
+// Frees the regions and releases the queries.
+void d3d11_frame_arena__shutdown(struct d3d11_frame_arena_t *arena);
+
+// Moves to the next region, waiting for the GPU to pass the end of its latest frame if needed.
+void d3d11_frame_arena__begin_frame(struct d3d11_frame_arena_t *arena);
+
+// Returns `size` bytes aligned to `alignment` (a power of two, at most 64) from the current
+// region, valid until the region is reused. Returns NULL if they don't fit. Can be called from
+// several threads at once.
+void *d3d11_frame_arena__allocate(struct d3d11_frame_arena_t *arena, uint64_t size, uint32_t alignment);
+
+// Marks the end of the frame's work on the immediate context and updates the high-water mark.
+void d3d11_frame_arena__end_frame(struct d3d11_frame_arena_t *arena);
@@ -0,0 +1,263 @@
+#include "d3d11_gpu_profiler.h"
+
+#include "d3d11_device.h"
+#include "d3d11_internal.h"
+
+#include <foundation/carray.inl>
+#include <plugins/renderer/render_command_buffer.h>
+
+#include <string.h>
+
+// Scopes nested deeper than this are not timed.
+#define MAX_SCOPE_DEPTH (64)
+
+// Same layout as `D3D11_QUERY_DATA_TIMESTAMP_DISJOINT`.
+struct timestamp_disjoint_t
+{
+    uint64_t frequency;
+    uint32_t disjoint;
+    TM_PAD(4);
+};
+
+static void
+release_frame(struct d3d11_gpu_profiler_t *p, struct d3d11_gpu_frame_t *f)
+{
+    struct d3d11_device_i *device = p->device;
+    if (f->disjoint_query)
+        device->release(device->inst, f->disjoint_query);
+    for (void **q = f->timestamp_queries; q != tm_carray_end(f->timestamp_queries); ++q)
+        device->release(device->inst, *q);
+    tm_carray_free(f->timestamp_queries, p->allocator);
+    tm_carray_free(f->scopes, p->allocator);
+    memset(f, 0, sizeof(*f));
+}
+
+// Makes sure `f` has a disjoint query and at least `n` timestamp queries.
+static bool
+ensure_queries(struct d3d11_gpu_profiler_t *p, struct d3d11_gpu_frame_t *f, uint32_t n)
+{
+    struct d3d11_device_i *device = p->device;
+    if (!f->disjoint_query)
+        f->disjoint_query = device->create_query(device->inst, QUERY__TIMESTAMP_DISJOINT);
+    if (!f->disjoint_query)
+        return false;
+
+    while (tm_carray_size(f->timestamp_queries) < n)
+    {
+        void *q = device->create_query(device->inst, QUERY__TIMESTAMP);
+        if (!q)
+            return false;
+        tm_carray_push(f->timestamp_queries, q, p->allocator);
+    }
+    return true;
+}
+
+// Pairs up the statistics commands of the frame into scopes. An end closes the innermost open
+// scope. Scopes that are never closed are dropped.
+static void
+build_scopes(struct d3d11_gpu_profiler_t *p, struct d3d11_gpu_frame_t *f)
+{
+    tm_carray_shrink(f->scopes, 0);
+
+    uint32_t open[MAX_SCOPE_DEPTH];
+    uint32_t depth = 0, too_deep = 0;
+    for (uint32_t i = 0; i != p->num_statistics_commands; ++i)
+    {
+        const tm_renderer_command_t *cmd = p->commands + p->statistics_commands[i];
+        if (cmd->type == TM_RENDERER_COMMAND_BEGIN_STATISTICS)
+        {
+            if (depth == MAX_SCOPE_DEPTH)
+            {
+                ++too_deep;
+                continue;
+            }
+            const tm_renderer_statistics_scope_command_t *s = cmd->data;
+            const struct d3d11_gpu_scope_t scope = {
+                .category = s->category,
+                .scope    = s->scope,
+                .flags    = s->flags,
+                .depth    = depth,
+                .begin    = i,
+                .end      = UINT32_MAX,
+            };
+            open[depth++] = (uint32_t)tm_carray_size(f->scopes);
+            tm_carray_push(f->scopes, scope, p->allocator);
+        }
+        else if (too_deep)
+            --too_deep;
+        else if (depth)
+            f->scopes[open[--depth]].end = i;
+    }
+}
+
+// Converts the timestamps of `f` to timings. Returns false, and clears the timings, if any of them
+// isn't available yet.
+static bool
+read_frame(struct d3d11_gpu_profiler_t *p, struct d3d11_context_i *ctx, struct d3d11_gpu_frame_t *f,
+    uint64_t frequency)
+{
+    uint64_t first = 0;
+    tm_carray_shrink(p->timings, 0);
+    for (const struct d3d11_gpu_scope_t *s = f->scopes; s != tm_carray_end(f->scopes); ++s)
+    {
+        if (s->end == UINT32_MAX)
+            continue;
+
+        uint64_t begin = 0, end = 0;
+        if (!ctx->get_query_data(ctx->inst, f->timestamp_queries[s->begin], &begin, sizeof(begin), false)
+            || !ctx->get_query_data(ctx->inst, f->timestamp_queries[s->end], &end, sizeof(end), false))
+        {
+            tm_carray_shrink(p->timings, 0);
+            p->timings_submit = 0;
+            return false;
+        }
+
+        if (!tm_carray_size(p->timings))
+            first = begin;
+
+        // The recording device has no clock and reads every query as zero.
+        const double to_seconds = frequency ? 1.0 / (double)frequency : 0.0;
+        const struct tm_d3d11_gpu_scope_timing_t t = {
+            .category = s->category,
+            .scope    = s->scope,
+            .flags    = s->flags,
+            .depth    = s->depth,
+            .start    = (double)(int64_t)(begin - first) * to_seconds,
+            .duration = (double)(int64_t)(end - begin) * to_seconds,
+        };
+        tm_carray_push(p->timings, t, p->allocator);
+    }
+    p->timings_submit = f->submit;
+    return true;
+}
+
+// Reads back the pending frames the GPU has completed, oldest first, without waiting.
+static void
+read_completed(struct d3d11_gpu_profiler_t *p, struct d3d11_context_i *ctx)
+{
+    while (p->num_pending)
+    {
+        struct d3d11_gpu_frame_t *f = p->frames + p->first_pending;
+
+        struct timestamp_disjoint_t disjoint;
+        if (!ctx->get_query_data(ctx->inst, f->disjoint_query, &disjoint, sizeof(disjoint), false))
+            break;
+
+        // All timestamps ended before the disjoint query, so they are available too.
+        if (disjoint.disjoint || !read_frame(p, ctx, f, disjoint.frequency))
+            ++p->num_dropped;
+
+        p->first_pending = (p->first_pending + 1) % p->num_frames;
+        --p->num_pending;
+    }
+}
+
+void
+d3d11_gpu_profiler__init(struct d3d11_gpu_profiler_t *profiler, struct tm_allocator_i *allocator,
+    struct d3d11_device_i *device, uint32_t num_frames)
+{
+    memset(profiler, 0, sizeof(*profiler));
+    profiler->allocator = allocator;
+    profiler->device = device;
+    d3d11_gpu_profiler__set_num_frames(profiler, num_frames);
+}
+
+void
+d3d11_gpu_profiler__shutdown(struct d3d11_gpu_profiler_t *profiler)
+{
+    if (!profiler->device)
+        return;
+
+    for (uint32_t i = 0; i != TM_D3D11_MAX_GPU_TIMING_LATENCY; ++i)
+        release_frame(profiler, profiler->frames + i);
+    tm_carray_free(profiler->timings, profiler->allocator);
+    memset(profiler, 0, sizeof(*profiler));
+}
+
+void
+d3d11_gpu_profiler__set_num_frames(struct d3d11_gpu_profiler_t *profiler, uint32_t num_frames)
+{
+    profiler->num_frames = tm_min(tm_max(num_frames, 1), TM_D3D11_MAX_GPU_TIMING_LATENCY);
+    profiler->num_dropped += profiler->num_pending;
+    profiler->first_pending = 0;
+    profiler->num_pending = 0;
+}
+
+void
+d3d11_gpu_profiler__begin_frame(struct d3d11_gpu_profiler_t *profiler, struct d3d11_context_i *immediate,
+    const struct tm_renderer_command_t *commands, const uint32_t *statistics_commands,
+    uint32_t num_statistics_commands)
+{
+    struct d3d11_gpu_profiler_t *p = profiler;
+    ++p->num_submits;
+
+    read_completed(p, immediate);
+
+    p->active = false;
+    if (!num_statistics_commands)
+        return;
+
+    // Never wait for the GPU, drop the oldest frame instead.
+    if (p->num_pending == p->num_frames)
+    {
+        p->first_pending = (p->first_pending + 1) % p->num_frames;
+        --p->num_pending;
+        ++p->num_dropped;
+    }
+
+    struct d3d11_gpu_frame_t *f = p->frames + (p->first_pending + p->num_pending) % p->num_frames;
+    if (!ensure_queries(p, f, num_statistics_commands))
+        return;
+
+    p->commands = commands;
+    p->statistics_commands = statistics_commands;
+    p->num_statistics_commands = num_statistics_commands;
+    p->active = true;
+
+    f->submit = p->num_submits;
+    build_scopes(p, f);
+    immediate->begin_query(immediate->inst, f->disjoint_query);
+}
+
+void
+d3d11_gpu_profiler__timestamp(const struct d3d11_gpu_profiler_t *profiler, struct d3d11_context_i *context,
+    const struct tm_renderer_command_t *command)
+{
+    const struct d3d11_gpu_profiler_t *p = profiler;
+    if (!p->active)
+        return;
+
+    // Binary search for the timestamp index of the command.
+    const uint32_t index = (uint32_t)(command - p->commands);
+    uint32_t lo = 0, hi = p->num_statistics_commands;
+    while (lo < hi)
+    {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (p->statistics_commands[mid] < index)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == p->num_statistics_commands || p->statistics_commands[lo] != index)
+        return;
+
+    const struct d3d11_gpu_frame_t *f = p->frames + (p->first_pending + p->num_pending) % p->num_frames;
+    context->end_query(context->inst, f->timestamp_queries[lo]);
+}
+
+void
+d3d11_gpu_profiler__end_frame(struct d3d11_gpu_profiler_t *profiler, struct d3d11_context_i *immediate)
+{
+    struct d3d11_gpu_profiler_t *p = profiler;
+    if (!p->active)
+        return;
+
+    struct d3d11_gpu_frame_t *f = p->frames + (p->first_pending + p->num_pending) % p->num_frames;
+    immediate->end_query(immediate->inst, f->disjoint_query);
+    ++p->num_pending;
+
+    p->active = false;
+    p->commands = 0;
+    p->statistics_commands = 0;
+    p->num_statistics_commands = 0;
+}
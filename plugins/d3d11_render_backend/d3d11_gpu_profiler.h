@@ -0,0 +1,100 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+#include "d3d11_render_backend.h"
+
+// Times the statistics scopes of submitted commands on the GPU.
+//
+// Every submit with statistics commands writes one timestamp query per
+// `TM_RENDERER_COMMAND_BEGIN_STATISTICS` and `TM_RENDERER_COMMAND_END_STATISTICS` command, wrapped
+// in a disjoint query. Frames, each with its own pool of queries, are kept in a ring. Completed
+// frames are read back at the start of later submits with `get_query_data()` without flushing, so
+// reading never waits for the GPU. When the ring is full, the oldest frame is dropped instead.
+
+struct d3d11_device_i;
+struct d3d11_context_i;
+struct tm_allocator_i;
+struct tm_renderer_command_t;
+
+// Scope of a frame. `begin` and `end` index the frame's timestamps.
+struct d3d11_gpu_scope_t
+{
+    const char *category;
+    uint64_t scope;
+    uint32_t flags;
+    uint32_t depth;
+    uint32_t begin;
+    uint32_t end;
+};
+
+struct d3d11_gpu_frame_t
+{
+    void *disjoint_query;
+
+    // Timestamp queries, kept when the frame is reused.
+    /* carray */ void **timestamp_queries;
+
+    /* carray */ struct d3d11_gpu_scope_t *scopes;
+
+    // Submit number of the frame.
+    uint64_t submit;
+};
+
+struct d3d11_gpu_profiler_t
+{
+    struct tm_allocator_i *allocator;
+    struct d3d11_device_i *device;
+
+    struct d3d11_gpu_frame_t frames[TM_D3D11_MAX_GPU_TIMING_LATENCY];
+
+    // Number of frames in the ring and the range of frames waiting for the GPU.
+    uint32_t num_frames;
+    uint32_t first_pending;
+    uint32_t num_pending;
+
+    // Set between `begin_frame()` and `end_frame()` if the frame has timestamps.
+    bool active;
+    TM_PAD(3);
+
+    // Sorted commands of the current submit and the (ascending) indices of the statistics commands
+    // among them. Timestamp `i` is written by command `commands[statistics_commands[i]]`.
+    const struct tm_renderer_command_t *commands;
+    const uint32_t *statistics_commands;
+    uint32_t num_statistics_commands;
+    TM_PAD(4);
+
+    uint64_t num_submits;
+
+    // Timings of the latest frame read back and the submit it belongs to.
+    /* carray */ struct tm_d3d11_gpu_scope_timing_t *timings;
+    uint64_t timings_submit;
+
+    uint64_t num_dropped;
+};
+
+void d3d11_gpu_profiler__init(struct d3d11_gpu_profiler_t *profiler, struct tm_allocator_i *allocator,
+    struct d3d11_device_i *device, uint32_t num_frames);
+
+// Releases all queries. Pending frames are dropped.
+void d3d11_gpu_profiler__shutdown(struct d3d11_gpu_profiler_t *profiler);
+
+// Changes the number of frames in the ring, dropping the pending ones.
+void d3d11_gpu_profiler__set_num_frames(struct d3d11_gpu_profiler_t *profiler, uint32_t num_frames);
+
+// Reads back the frames the GPU has completed, then starts timing the submit of the sorted
+// `commands`. `statistics_commands` lists the indices of the statistics commands in `commands` and
+// must stay valid until `d3d11_gpu_profiler__end_frame()`.
+void d3d11_gpu_profiler__begin_frame(struct d3d11_gpu_profiler_t *profiler, struct d3d11_context_i *immediate,
+    const struct tm_renderer_command_t *commands, const uint32_t *statistics_commands,
+    uint32_t num_statistics_commands);
+
+// Writes the timestamp of the statistics command `command`, which must be one of the sorted
+// commands passed to `begin_frame()`. Can be called from several threads at once, on different
+// contexts.
+void d3d11_gpu_profiler__timestamp(const struct d3d11_gpu_profiler_t *profiler, struct d3d11_context_i *context,
+    const struct tm_renderer_command_t *command);
+
+// Ends the frame started by `begin_frame()`. The timestamps must have been executed on
+// `immediate` by now.
+void d3d11_gpu_profiler__end_frame(struct d3d11_gpu_profiler_t *profiler, struct d3d11_context_i *immediate);
@@ -0,0 +1,168 @@
+#include "d3d11_handle_pool.h"
+#include "d3d11_internal.h"
+
+#include <foundation/allocator.h>
+#include <foundation/carray.inl>
+#include <foundation/os.h>
+
+#include <string.h>
+
+#define HOT_ALIGNMENT (64)
+
+static inline uint32_t *
+slot_generation(struct d3d11_handle_pool_t *pool, uint32_t index)
+{
+    return (uint32_t *)(pool->hot_chunks[index >> HANDLE_POOL_CHUNK_BITS] + (index & HANDLE_POOL_CHUNK_MASK) * pool->hot_size);
+}
+
+// Must be called with the pool lock held.
+static bool
+add_chunk(struct d3d11_handle_pool_t *pool)
+{
+    const uint32_t chunk = atomic_load_uint32_t(&pool->num_chunks);
+    if (chunk == HANDLE_POOL_MAX_CHUNKS)
+        return false;
+
+    const uint64_t hot_bytes = (uint64_t)HANDLE_POOL_CHUNK_SIZE * pool->hot_size;
+    uint8_t *hot_allocation = tm_alloc(pool->allocator, hot_bytes + HOT_ALIGNMENT);
+    uint8_t *hot = (uint8_t *)(((uintptr_t)hot_allocation + HOT_ALIGNMENT - 1) & ~(uintptr_t)(HOT_ALIGNMENT - 1));
+    memset(hot, 0, hot_bytes);
+
+    uint8_t *cold = 0;
+    if (pool->cold_size)
+    {
+        const uint64_t cold_bytes = (uint64_t)HANDLE_POOL_CHUNK_SIZE * pool->cold_size;
+        cold = tm_alloc(pool->allocator, cold_bytes);
+        memset(cold, 0, cold_bytes);
+    }
+
+    pool->hot_allocations[chunk] = hot_allocation;
+    pool->hot_chunks[chunk] = hot;
+    pool->cold_chunks[chunk] = cold;
+
+    // Publish the chunk only once its pointers are in place, lock-free lookups check against it.
+    // The atomic store orders the pointer writes before it.
+    atomic_store_uint32_t(&pool->num_chunks, chunk + 1);
+    return true;
+}
+
+void
+d3d11_handle_pool__init(struct d3d11_handle_pool_t *pool, struct tm_allocator_i *allocator, uint32_t type,
+    uint32_t hot_size, uint32_t cold_size)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->allocator = allocator;
+    pool->type = type;
+    pool->hot_size = hot_size;
+    pool->cold_size = cold_size;
+    pool->next_index = 1;
+    tm_os_api->thread->create_critical_section(&pool->lock);
+}
+
+void
+d3d11_handle_pool__shutdown(struct d3d11_handle_pool_t *pool)
+{
+    const uint64_t hot_bytes = (uint64_t)HANDLE_POOL_CHUNK_SIZE * pool->hot_size;
+    const uint64_t cold_bytes = (uint64_t)HANDLE_POOL_CHUNK_SIZE * pool->cold_size;
+
+    const uint32_t num_chunks = atomic_load_uint32_t(&pool->num_chunks);
+    for (uint32_t i = 0; i != num_chunks; ++i)
+    {
+        tm_free(pool->allocator, pool->hot_allocations[i], hot_bytes + HOT_ALIGNMENT);
+        if (pool->cold_chunks[i])
+            tm_free(pool->allocator, pool->cold_chunks[i], cold_bytes);
+    }
+
+    tm_carray_free(pool->free_indices, pool->allocator);
+    tm_os_api->thread->destroy_critical_section(&pool->lock);
+    memset(pool, 0, sizeof(*pool));
+}
+
+// Takes the oldest freed index. Must be called with the pool lock held and a non-empty free list.
+static uint32_t
+pop_free_index(struct d3d11_handle_pool_t *pool)
+{
+    const uint32_t index = pool->free_indices[pool->free_head++];
+
+    // Move the waiting indices to the front once the consumed ones make up half the array, so the
+    // array doesn't grow with the total number of frees.
+    const uint32_t size = (uint32_t)tm_carray_size(pool->free_indices);
+    if (pool->free_head * 2 >= size)
+    {
+        memmove(pool->free_indices, pool->free_indices + pool->free_head, (size - pool->free_head) * sizeof(uint32_t));
+        tm_carray_shrink(pool->free_indices, size - pool->free_head);
+        pool->free_head = 0;
+    }
+    return index;
+}
+
+uint32_t
+d3d11_handle_pool__allocate(struct d3d11_handle_pool_t *pool)
+{
+    uint32_t index = 0;
+
+    tm_os_api->thread->enter_critical_section(&pool->lock);
+
+    const uint32_t num_free = (uint32_t)tm_carray_size(pool->free_indices) - pool->free_head;
+    if (num_free > HANDLE_POOL_MIN_FREE)
+        index = pop_free_index(pool);
+    else if (pool->next_index < (atomic_load_uint32_t(&pool->num_chunks) << HANDLE_POOL_CHUNK_BITS) || add_chunk(pool))
+        index = pool->next_index++;
+    else if (num_free)
+        index = pop_free_index(pool);
+
+    uint32_t generation = 0;
+    if (index)
+    {
+        uint32_t *gen = slot_generation(pool, index);
+        generation = *gen & HANDLE_GENERATION_MASK;
+        *gen = HANDLE_SLOT_LIVE | generation;
+        ++pool->num_live;
+    }
+
+    tm_os_api->thread->leave_critical_section(&pool->lock);
+
+    return index ? make_handle(pool->type, generation, index) : 0;
+}
+
+bool
+d3d11_handle_pool__free(struct d3d11_handle_pool_t *pool, uint32_t handle)
+{
+    if (!d3d11_handle_pool__hot(pool, handle))
+        return false;
+
+    const uint32_t index = handle_index(handle);
+
+    tm_os_api->thread->enter_critical_section(&pool->lock);
+
+    // Check again under the lock, a racing free of the same handle may have won.
+    uint32_t *gen = slot_generation(pool, index);
+    if (*gen != (HANDLE_SLOT_LIVE | handle_generation(handle)))
+    {
+        tm_os_api->thread->leave_critical_section(&pool->lock);
+        return false;
+    }
+
+    // Clear the records so the next owner of the slot starts from zero, then bump the generation.
+    const uint32_t next_generation = (handle_generation(handle) + 1) & HANDLE_GENERATION_MASK;
+    memset(gen, 0, pool->hot_size);
+    *gen = next_generation;
+    if (pool->cold_size)
+        memset(d3d11_handle_pool__cold(pool, handle), 0, pool->cold_size);
+
+    tm_carray_push(pool->free_indices, index, pool->allocator);
+    --pool->num_live;
+
+    tm_os_api->thread->leave_critical_section(&pool->lock);
+    return true;
+}
+
+uint32_t
+d3d11_handle_pool__handle_at(const struct d3d11_handle_pool_t *pool, uint32_t index)
+{
+    if (!index || index >= pool->next_index)
+        return 0;
+
+    const uint32_t gen = *(const uint32_t *)(pool->hot_chunks[index >> HANDLE_POOL_CHUNK_BITS] + (index & HANDLE_POOL_CHUNK_MASK) * pool->hot_size);
+    return (gen & HANDLE_SLOT_LIVE) ? make_handle(pool->type, gen & HANDLE_GENERATION_MASK, index) : 0;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <foundation/api_types.h>
+#include <foundation/atomics.inl>
+#include <foundation/os.h>
+
+// Generation checked handle table with structure-of-arrays storage.
+//
+// A handle is a 32 bit value packing `[type:4][generation:8][index:20]`. Each slot has a small
+// "hot" record, which the draw path reads, and an optional "cold" record for everything else.
+// The first member of every hot record is the `uint32_t` slot generation, so validating a handle
+// and reading what the draw path needs touches a single cache line (hot records are at most 64
+// bytes and allocated 64 byte aligned).
+//
+// Records are stored in fixed size chunks that never move once allocated. Handles can therefore
+// be allocated from any thread (under the pool lock) while the render thread looks up other
+// handles without taking any lock. Freeing a slot bumps its generation, so stale handles fail the
+// lookup. Freed indices are recycled first in, first out, and only once more than
+// `HANDLE_POOL_MIN_FREE` of them are waiting, so a slot goes through the other free slots
+// between two reuses. A stale handle can only validate again after its slot has been reused
+// `1 << HANDLE_GENERATION_BITS` times, which then takes that many times `HANDLE_POOL_MIN_FREE`
+// frees instead of as many frees of the same slot. Index 0 is never handed out, which makes 0 a
+// valid "null" handle.
+
+#define HANDLE_INDEX_BITS (20)
+#define HANDLE_GENERATION_BITS (8)
+#define HANDLE_TYPE_BITS (4)
+
+#define HANDLE_INDEX_MASK ((1u << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_GENERATION_MASK ((1u << HANDLE_GENERATION_BITS) - 1)
+
+// Set in the generation word of hot records that are allocated.
+#define HANDLE_SLOT_LIVE (0x80000000u)
+
+#define HANDLE_POOL_CHUNK_BITS (12)
+#define HANDLE_POOL_CHUNK_SIZE (1u << HANDLE_POOL_CHUNK_BITS)
+#define HANDLE_POOL_CHUNK_MASK (HANDLE_POOL_CHUNK_SIZE - 1)
+#define HANDLE_POOL_MAX_CHUNKS (1u << (HANDLE_INDEX_BITS - HANDLE_POOL_CHUNK_BITS))
+
+// Number of freed indices kept out of circulation before the oldest is reused. A full pool
+// reuses them regardless.
+#define HANDLE_POOL_MIN_FREE (1024)
+
+static inline uint32_t
+handle_index(uint32_t handle)
+{
+    return handle & HANDLE_INDEX_MASK;
+}
+
+static inline uint32_t
+handle_generation(uint32_t handle)
+{
+    return (handle >> HANDLE_INDEX_BITS) & HANDLE_GENERATION_MASK;
+}
+
+static inline uint32_t
+handle_type(uint32_t handle)
+{
+    return handle >> (HANDLE_INDEX_BITS + HANDLE_GENERATION_BITS);
+}
+
+static inline uint32_t
+make_handle(uint32_t type, uint32_t generation, uint32_t index)
+{
+    return (type << (HANDLE_INDEX_BITS + HANDLE_GENERATION_BITS))
+        | ((generation & HANDLE_GENERATION_MASK) << HANDLE_INDEX_BITS) | index;
+}
+
+struct d3d11_handle_pool_t
+{
+    // 64 byte aligned hot chunks, and the pointers returned by the allocator for them.
+    uint8_t *hot_chunks[HANDLE_POOL_MAX_CHUNKS];
+    uint8_t *hot_allocations[HANDLE_POOL_MAX_CHUNKS];
+    uint8_t *cold_chunks[HANDLE_POOL_MAX_CHUNKS];
+
+    struct tm_allocator_i *allocator;
+
+    uint32_t type;
+    uint32_t hot_size;
+    uint32_t cold_size;
+
+    // Written under the lock, read by lock-free lookups.
+    atomic_uint32_t num_chunks;
+
+    // Next index that has never been handed out.
+    uint32_t next_index;
+    uint32_t num_live;
+
+    // Freed indices, oldest first from `free_head`.
+    /* carray */ uint32_t *free_indices;
+    uint32_t free_head;
+    TM_PAD(4);
+
+    tm_critical_section_o lock;
+};
+
+// Initializes `pool` for handles of `type`. `hot_size` must be a power of two between 8 and 64
+// and the hot record must start with its `uint32_t` generation, which is owned by the pool.
+// `cold_size` may be zero.
+void d3d11_handle_pool__init(struct d3d11_handle_pool_t *pool, struct tm_allocator_i *allocator, uint32_t type,
+    uint32_t hot_size, uint32_t cold_size);
+
+// Frees all memory of `pool`. Objects referenced by the records must have been released first.
+void d3d11_handle_pool__shutdown(struct d3d11_handle_pool_t *pool);
+
+// Allocates a new handle with zero-initialized records. Thread-safe. Returns 0 when the pool is
+// full.
+uint32_t d3d11_handle_pool__allocate(struct d3d11_handle_pool_t *pool);
+
+// Frees `handle`, invalidating it and every copy of it. Thread-safe. Returns false if `handle`
+// was already stale.
+bool d3d11_handle_pool__free(struct d3d11_handle_pool_t *pool, uint32_t handle);
+
+// Returns the hot record of `handle` or NULL if the handle is stale or of another type.
+static inline void *
+d3d11_handle_pool__hot(const struct d3d11_handle_pool_t *pool, uint32_t handle)
+{
+    const uint32_t index = handle_index(handle);
+    const uint32_t chunk = index >> HANDLE_POOL_CHUNK_BITS;
+    if (chunk >= atomic_load_uint32_t((atomic_uint32_t *)&pool->num_chunks) || handle_type(handle) != pool->type)
+        return 0;
+
+    uint8_t *hot = pool->hot_chunks[chunk] + (index & HANDLE_POOL_CHUNK_MASK) * pool->hot_size;
+    return *(const uint32_t *)hot == (HANDLE_SLOT_LIVE | handle_generation(handle)) ? hot : 0;
+}
+
+// Returns the cold record of `handle` without validating it. Use together with
+// `d3d11_handle_pool__hot()`. Computing the address doesn't touch the record.
+static inline void *
+d3d11_handle_pool__cold(const struct d3d11_handle_pool_t *pool, uint32_t handle)
+{
+    const uint32_t index = handle_index(handle);
+    return pool->cold_chunks[index >> HANDLE_POOL_CHUNK_BITS] + (index & HANDLE_POOL_CHUNK_MASK) * pool->cold_size;
+}
+
+// Returns the handle currently stored at `index` if that slot is allocated, else 0. Used to walk
+// all live records.
+uint32_t d3d11_handle_pool__handle_at(const struct d3d11_handle_pool_t *pool, uint32_t index);
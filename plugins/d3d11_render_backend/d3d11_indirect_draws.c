@@ -0,0 +1,363 @@
+#include "d3d11_indirect_draws.h"
+
+#include "d3d11_bytecode_compiler.h"
+#include "d3d11_command_translator.h"
+#include "d3d11_device.h"
+#include "d3d11_internal.h"
+#include "d3d11_render_backend.h"
+#include "d3d11_resources.h"
+#include "d3d11_upload_ring.h"
+
+#include <foundation/allocator.h>
+#include <foundation/carray.inl>
+#include <foundation/log.h>
+#include <plugins/renderer/render_command_buffer.h>
+#include <plugins/renderer/renderer_api_types.h>
+
+#include <stddef.h>
+#include <string.h>
+
+// The renderer's indirect arguments are passed to D3D11 as they are, and the compaction shader
+// reads the vertex or index count and the instance count as the first two words of either
+// layout.
+TM_STATIC_ASSERT(sizeof(tm_renderer_draw_indirect_command_t) == INDIRECT_DRAW_ARGS_SIZE);
+TM_STATIC_ASSERT(offsetof(tm_renderer_draw_indirect_command_t, num_vertices) == 0);
+TM_STATIC_ASSERT(offsetof(tm_renderer_draw_indirect_command_t, num_instances) == 4);
+TM_STATIC_ASSERT(offsetof(tm_renderer_draw_indirect_command_t, first_vertex) == 8);
+TM_STATIC_ASSERT(offsetof(tm_renderer_draw_indirect_command_t, first_instance) == 12);
+
+TM_STATIC_ASSERT(sizeof(tm_renderer_draw_indexed_indirect_command_t) == INDIRECT_DRAW_INDEXED_ARGS_SIZE);
+TM_STATIC_ASSERT(offsetof(tm_renderer_draw_indexed_indirect_command_t, num_indices) == 0);
+TM_STATIC_ASSERT(offsetof(tm_renderer_draw_indexed_indirect_command_t, num_instances) == 4);
+TM_STATIC_ASSERT(offsetof(tm_renderer_draw_indexed_indirect_command_t, first_index) == 8);
+TM_STATIC_ASSERT(offsetof(tm_renderer_draw_indexed_indirect_command_t, first_vertex) == 12);
+TM_STATIC_ASSERT(offsetof(tm_renderer_draw_indexed_indirect_command_t, first_instance) == 16);
+
+// Layout of the `tm_indirect_compaction` constant buffer. Offsets and sizes are in bytes.
+struct compaction_params_t
+{
+    uint32_t src_offset;
+    uint32_t src_stride;
+    uint32_t max_draws;
+    uint32_t count_offset;
+    uint32_t dst_offset;
+    uint32_t args_size;
+    uint32_t has_count;
+    TM_PAD(4);
+};
+
+TM_STATIC_ASSERT(sizeof(struct compaction_params_t) == 32);
+TM_STATIC_ASSERT(offsetof(struct compaction_params_t, has_count) == 24);
+
+// A single group scans the arguments 64 at a time, so the kept arguments stay in draw order.
+static const char *compaction_hlsl = "\
+cbuffer tm_indirect_compaction : register(b0)\n\
+{\n\
+    uint src_offset;\n\
+    uint src_stride;\n\
+    uint max_draws;\n\
+    uint count_offset;\n\
+    uint dst_offset;\n\
+    uint args_size;\n\
+    uint has_count;\n\
+    uint padding;\n\
+};\n\
+\n\
+RWByteAddressBuffer src : register(u0);\n\
+RWByteAddressBuffer count_buffer : register(u1);\n\
+RWByteAddressBuffer dst : register(u2);\n\
+RWByteAddressBuffer counter : register(u3);\n\
+\n\
+groupshared uint scan[64];\n\
+\n\
+[numthreads(64, 1, 1)]\n\
+void compact(uint i : SV_GroupIndex)\n\
+{\n\
+    const uint count = has_count ? min(count_buffer.Load(count_offset), max_draws) : max_draws;\n\
+    uint kept = 0;\n\
+    for (uint first = 0; first < max_draws; first += 64) {\n\
+        const uint draw = first + i;\n\
+        const uint addr = src_offset + draw * src_stride;\n\
+        // Both argument layouts start with the vertex or index count and the instance count.\n\
+        const bool keep = draw < count && src.Load(addr) != 0 && src.Load(addr + 4) != 0;\n\
+        scan[i] = keep ? 1 : 0;\n\
+        GroupMemoryBarrierWithGroupSync();\n\
+        for (uint d = 1; d < 64; d <<= 1) {\n\
+            const uint v = i >= d ? scan[i - d] : 0;\n\
+            GroupMemoryBarrierWithGroupSync();\n\
+            scan[i] += v;\n\
+            GroupMemoryBarrierWithGroupSync();\n\
+        }\n\
+        if (keep) {\n\
+            const uint dst_addr = dst_offset + (kept + scan[i] - 1) * args_size;\n\
+            for (uint w = 0; w < args_size; w += 4)\n\
+                dst.Store(dst_addr + w, src.Load(addr + w));\n\
+        }\n\
+        kept += scan[63];\n\
+        GroupMemoryBarrierWithGroupSync();\n\
+    }\n\
+    for (uint draw = kept + i; draw < max_draws; draw += 64) {\n\
+        for (uint w = 0; w < args_size; w += 4)\n\
+            dst.Store(dst_offset + draw * args_size + w, 0);\n\
+    }\n\
+    if (i == 0)\n\
+        counter.InterlockedAdd(0, max_draws - kept);\n\
+}\n";
+
+// Size of the compacted argument buffer, large enough for indexed arguments.
+#define COMPACTED_ARGS_BUFFER_SIZE (INDIRECT_MAX_COMPACTED_ARGS * INDIRECT_DRAW_INDEXED_ARGS_SIZE)
+
+static void *
+create_compaction_shader(struct d3d11_indirect_draws_t *ind)
+{
+    const struct tm_d3d11_bytecode_compiler_i *compiler = d3d11_bytecode_compiler__default();
+    uint64_t size = 0;
+    void *bytecode = compiler->compile(compiler->inst, compaction_hlsl, "compact", TM_RENDERER_SHADER_STAGE_COMPUTE,
+        ind->allocator, &size);
+    if (!bytecode)
+        return 0;
+
+    void *shader = ind->device->create_shader(ind->device->inst, SHADER_STAGE__COMPUTE, bytecode, size);
+    tm_free(ind->allocator, bytecode, size);
+    return shader;
+}
+
+// Returns constant buffer `index` for compaction parameters, creating it if needed, or NULL on
+// failure.
+static void *
+params_buffer(struct d3d11_indirect_draws_t *ind, uint32_t index)
+{
+    if (index == tm_carray_size(ind->params))
+    {
+        const struct d3d11_buffer_desc_t desc = {
+            .size       = sizeof(struct compaction_params_t),
+            .usage      = USAGE__DEFAULT,
+            .bind_flags = BIND_FLAG__CONSTANT_BUFFER,
+        };
+        void *b = ind->device->create_buffer(ind->device->inst, &desc, 0);
+        if (!b)
+        {
+            tm_logger_api->print(TM_LOG_TYPE_ERROR, "Failed to create an indirect draw compaction buffer");
+            return 0;
+        }
+        tm_carray_push(ind->params, b, ind->allocator);
+    }
+    return ind->params[index];
+}
+
+// Reads back the counters the GPU is done with, oldest first, without waiting.
+static void
+read_completed(struct d3d11_indirect_draws_t *ind, struct d3d11_context_i *ctx)
+{
+    while (ind->num_pending)
+    {
+        const struct d3d11_indirect_readback_t *r = ind->readbacks + ind->first_pending;
+
+        uint32_t signaled = 0;
+        if (!ctx->get_query_data(ctx->inst, r->query, &signaled, sizeof(signaled), false))
+            break;
+
+        const uint32_t *skipped = ctx->map(ctx->inst, r->staging, 0, MAP__READ);
+        if (skipped)
+        {
+            ind->num_args_skipped += *skipped;
+            ctx->unmap(ctx->inst, r->staging, 0);
+        }
+
+        ind->first_pending = (ind->first_pending + 1) % INDIRECT_READBACK_FRAMES;
+        --ind->num_pending;
+    }
+}
+
+bool
+d3d11_indirect_draws__init(struct d3d11_indirect_draws_t *ind, struct tm_allocator_i *allocator,
+    struct d3d11_device_i *device)
+{
+    memset(ind, 0, sizeof(*ind));
+    ind->allocator = allocator;
+    ind->device = device;
+
+    const struct d3d11_buffer_desc_t args_desc = {
+        .size       = COMPACTED_ARGS_BUFFER_SIZE,
+        .usage      = USAGE__DEFAULT,
+        .bind_flags = BIND_FLAG__UNORDERED_ACCESS,
+        .misc_flags = MISC_FLAG__DRAWINDIRECT_ARGS | MISC_FLAG__BUFFER_ALLOW_RAW_VIEWS,
+    };
+    const struct d3d11_buffer_desc_t counter_desc = {
+        .size       = 16,
+        .usage      = USAGE__DEFAULT,
+        .bind_flags = BIND_FLAG__UNORDERED_ACCESS,
+        .misc_flags = MISC_FLAG__BUFFER_ALLOW_RAW_VIEWS,
+    };
+    const struct d3d11_buffer_desc_t staging_desc = {
+        .size             = 16,
+        .usage            = USAGE__STAGING,
+        .cpu_access_flags = CPU_ACCESS__READ,
+    };
+
+    ind->shader = create_compaction_shader(ind);
+    ind->args = device->create_buffer(device->inst, &args_desc, 0);
+    ind->args_uav = ind->args ? device->create_view(device->inst, ind->args, VIEW__UAV) : 0;
+    ind->counter = device->create_buffer(device->inst, &counter_desc, 0);
+    ind->counter_uav = ind->counter ? device->create_view(device->inst, ind->counter, VIEW__UAV) : 0;
+    bool ok = ind->shader && ind->args_uav && ind->counter_uav;
+    for (uint32_t i = 0; i != INDIRECT_READBACK_FRAMES; ++i)
+    {
+        struct d3d11_indirect_readback_t *r = ind->readbacks + i;
+        r->staging = device->create_buffer(device->inst, &staging_desc, 0);
+        r->query = device->create_query(device->inst, QUERY__EVENT);
+        ok = ok && r->staging && r->query;
+    }
+
+    if (!ok)
+    {
+        d3d11_indirect_draws__shutdown(ind);
+        return false;
+    }
+    return true;
+}
+
+void
+d3d11_indirect_draws__shutdown(struct d3d11_indirect_draws_t *ind)
+{
+    struct d3d11_device_i *device = ind->device;
+    if (!device)
+        return;
+
+    void *objects[] = { ind->shader, ind->args_uav, ind->args, ind->counter_uav, ind->counter };
+    for (uint32_t i = 0; i != TM_ARRAY_COUNT(objects); ++i)
+    {
+        if (objects[i])
+            device->release(device->inst, objects[i]);
+    }
+    for (uint32_t i = 0; i != INDIRECT_READBACK_FRAMES; ++i)
+    {
+        if (ind->readbacks[i].staging)
+            device->release(device->inst, ind->readbacks[i].staging);
+        if (ind->readbacks[i].query)
+            device->release(device->inst, ind->readbacks[i].query);
+    }
+    for (void **b = ind->params; b != tm_carray_end(ind->params); ++b)
+        device->release(device->inst, *b);
+    tm_carray_free(ind->params, ind->allocator);
+    tm_carray_free(ind->draws, ind->allocator);
+    memset(ind, 0, sizeof(*ind));
+}
+
+void
+d3d11_indirect_draws__gather(struct d3d11_indirect_draws_t *ind, const struct d3d11_resource_resolver_i *resolver,
+    struct d3d11_upload_ring_t *ring, const tm_renderer_command_t *commands, uint32_t num_commands)
+{
+    tm_carray_shrink(ind->draws, 0);
+    if (!ind->shader || !ring)
+        return;
+
+    uint32_t dst_offset = 0;
+    const tm_renderer_command_t *end = commands + num_commands;
+    for (const tm_renderer_command_t *cmd = commands; cmd != end; ++cmd)
+    {
+        if (cmd->type != TM_RENDERER_COMMAND_DRAW_CALL)
+            continue;
+
+        const tm_renderer_draw_call_info_t *dc = &((const tm_renderer_draw_command_t *)cmd->data)->draw_call;
+        const bool indexed = dc->draw_type == TM_RENDERER_DRAW_TYPE_INDEXED_INDIRECT;
+        if (!indexed && dc->draw_type != TM_RENDERER_DRAW_TYPE_NON_INDEXED_INDIRECT)
+            continue;
+
+        // Single draws without a count are drawn straight from their arguments.
+        const bool has_count = dc->indirect.count_buffer.resource != 0;
+        const uint32_t num_draws = dc->indirect.num_draws;
+        if (!num_draws || (num_draws == 1 && !has_count))
+            continue;
+
+        const uint32_t args_size = indexed ? INDIRECT_DRAW_INDEXED_ARGS_SIZE : INDIRECT_DRAW_ARGS_SIZE;
+        if (tm_carray_size(ind->draws) == INDIRECT_MAX_COMPACTED_DRAWS
+            || num_draws > (COMPACTED_ARGS_BUFFER_SIZE - dst_offset) / args_size)
+        {
+            continue;
+        }
+
+        // The compaction reads the arguments and the count through UAVs.
+        if (!resolver->view(resolver->inst, dc->indirect.indirect_buffer.resource, VIEW__UAV)
+            || (has_count && !resolver->view(resolver->inst, dc->indirect.count_buffer.resource, VIEW__UAV)))
+        {
+            continue;
+        }
+
+        const struct compaction_params_t p = {
+            .src_offset   = (uint32_t)dc->indirect.argument_buffer_offset,
+            .src_stride   = dc->indirect.stride ? dc->indirect.stride : args_size,
+            .max_draws    = num_draws,
+            .count_offset = (uint32_t)dc->indirect.count_buffer_offset,
+            .dst_offset   = dst_offset,
+            .args_size    = args_size,
+            .has_count    = has_count,
+        };
+        void *params = params_buffer(ind, (uint32_t)tm_carray_size(ind->draws));
+        if (!params || !d3d11_upload_ring__copy_to_buffer(ring, params, 0, &p, sizeof(p)))
+            break;
+
+        const struct d3d11_compacted_draw_t draw = {
+            .command  = cmd,
+            .params   = params,
+            .offset   = dst_offset,
+            .num_args = num_draws,
+        };
+        tm_carray_push(ind->draws, draw, ind->allocator);
+        dst_offset += num_draws * args_size;
+    }
+}
+
+void
+d3d11_indirect_draws__begin_frame(struct d3d11_indirect_draws_t *ind, struct d3d11_context_i *immediate)
+{
+    if (!ind->shader)
+        return;
+
+    read_completed(ind, immediate);
+
+    if (tm_carray_size(ind->draws))
+    {
+        static const uint32_t zero[4];
+        immediate->update_subresource(immediate->inst, ind->counter, 0, 0, zero, 0, 0);
+    }
+}
+
+void
+d3d11_indirect_draws__compact(const struct d3d11_indirect_draws_t *ind, struct d3d11_context_i *context,
+    const struct d3d11_compacted_draw_t *draw, void *args_uav, void *count_uav)
+{
+    struct d3d11_context_i *ctx = context;
+    void *uavs[4] = { args_uav, count_uav, ind->args_uav, ind->counter_uav };
+
+    ctx->set_shader(ctx->inst, SHADER_STAGE__COMPUTE, ind->shader);
+    ctx->set_constant_buffers(ctx->inst, SHADER_STAGE__COMPUTE, 0, 1, &draw->params);
+    ctx->cs_set_unordered_access_views(ctx->inst, 0, TM_ARRAY_COUNT(uavs), uavs);
+    ctx->dispatch(ctx->inst, 1, 1, 1);
+
+    // The draws read the compacted arguments as indirect arguments, so they can't stay bound as
+    // UAVs.
+    void *unbound[4] = { 0 };
+    ctx->cs_set_unordered_access_views(ctx->inst, 0, TM_ARRAY_COUNT(unbound), unbound);
+}
+
+void
+d3d11_indirect_draws__end_frame(struct d3d11_indirect_draws_t *ind, struct d3d11_context_i *immediate)
+{
+    if (!tm_carray_size(ind->draws))
+        return;
+
+    // Never wait for the GPU, drop the oldest counter instead.
+    if (ind->num_pending == INDIRECT_READBACK_FRAMES)
+    {
+        ind->first_pending = (ind->first_pending + 1) % INDIRECT_READBACK_FRAMES;
+        --ind->num_pending;
+        ++ind->num_readbacks_dropped;
+    }
+
+    const uint32_t slot = (ind->first_pending + ind->num_pending) % INDIRECT_READBACK_FRAMES;
+    const struct d3d11_indirect_readback_t *r = ind->readbacks + slot;
+    immediate->copy_buffer_region(immediate->inst, r->staging, 0, ind->counter, 0, sizeof(uint32_t));
+    immediate->end_query(immediate->inst, r->query);
+    ++ind->num_pending;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+// Compacts the arguments of indirect multi-draws on the GPU, see `d3d11_translator__translate()`.
+//
+// D3D11 draws one set of indirect arguments per call, so a multi-draw of `num_draws` arguments is
+// issued as a bounded loop of `num_draws` indirect draws. A draw count written by the GPU to a
+// count buffer can't be read by the CPU without stalling, so instead a compute shader copies the
+// arguments of the draws below the count that draw anything (non-zero vertex or index count and
+// instance count), in order, to the front of a range of the compacted argument buffer, and zeroes
+// the rest of the range. The loop then walks the range, and the zeroed draws past the kept ones
+// are no-ops on the GPU. Multi-draws without a count buffer are compacted too, which drops their
+// zero-count draws.
+//
+// `d3d11_indirect_draws__gather()` assigns the frame's multi-draws their ranges and the constant
+// buffers that hold the compaction parameters before translation, so that translation jobs can
+// compact independently. The translator issues the compaction right before the draws, so it sees
+// the arguments written by the commands sorted before them.
+//
+// The compaction shader counts the arguments it drops in a counter that is copied to a staging
+// buffer at the end of every submit with compacted draws, and read back without waiting once the
+// GPU is done with it.
+
+// Sizes of the arguments of `DrawInstancedIndirect()` and `DrawIndexedInstancedIndirect()`.
+#define INDIRECT_DRAW_ARGS_SIZE (16)
+#define INDIRECT_DRAW_INDEXED_ARGS_SIZE (20)
+
+// Arguments that fit in the compacted argument buffer. Multi-draws past it in a frame aren't
+// compacted.
+#define INDIRECT_MAX_COMPACTED_ARGS (64 * 1024)
+
+// Multi-draws compacted per frame, each needs a constant buffer of its own.
+#define INDIRECT_MAX_COMPACTED_DRAWS (1024)
+
+// Submits whose counters can wait for the GPU before the oldest one is dropped.
+#define INDIRECT_READBACK_FRAMES (4)
+
+struct d3d11_compacted_draw_t;
+struct d3d11_context_i;
+struct d3d11_device_i;
+struct d3d11_resource_resolver_i;
+struct d3d11_upload_ring_t;
+struct tm_allocator_i;
+struct tm_renderer_command_t;
+
+struct d3d11_indirect_readback_t
+{
+    void *staging;
+    void *query;
+};
+
+struct d3d11_indirect_draws_t
+{
+    struct tm_allocator_i *allocator;
+    struct d3d11_device_i *device;
+
+    // Compaction shader, the compacted argument buffer and the dropped argument counter. All NULL
+    // if the shader couldn't be created, multi-draws with a count buffer are skipped then.
+    void *shader;
+    void *args;
+    void *args_uav;
+    void *counter;
+    void *counter_uav;
+
+    // Constant buffers with the compaction parameters, one per compacted draw of a frame. Kept
+    // between frames and only created when a frame has more compacted draws than any before it.
+    /* carray */ void **params;
+
+    // Draws found by the latest `d3d11_indirect_draws__gather()`, in command order.
+    /* carray */ struct d3d11_compacted_draw_t *draws;
+
+    // Ring of counters waiting for the GPU.
+    struct d3d11_indirect_readback_t readbacks[INDIRECT_READBACK_FRAMES];
+    uint32_t first_pending;
+    uint32_t num_pending;
+
+    // Arguments dropped by the compactions read back so far, and the number of submits whose
+    // counter was dropped because the GPU was too far behind.
+    uint64_t num_args_skipped;
+    uint64_t num_readbacks_dropped;
+};
+
+// Creates the compaction shader and buffers on `device`. Returns false if any of them couldn't be
+// created, `ind` is left without compaction then.
+bool d3d11_indirect_draws__init(struct d3d11_indirect_draws_t *ind, struct tm_allocator_i *allocator,
+    struct d3d11_device_i *device);
+
+// Releases the shader, buffers and queries. The GPU must be done with them.
+void d3d11_indirect_draws__shutdown(struct d3d11_indirect_draws_t *ind);
+
+// Replaces `ind->draws` with the multi-draws of the `num_commands` sorted `commands` to compact
+// and queues the uploads of their parameters on `ring`. The uploads are issued by the next flush
+// of the ring, which must come before the draws are translated.
+void d3d11_indirect_draws__gather(struct d3d11_indirect_draws_t *ind, const struct d3d11_resource_resolver_i *resolver,
+    struct d3d11_upload_ring_t *ring, const struct tm_renderer_command_t *commands, uint32_t num_commands);
+
+// Reads back the counters the GPU is done with, then clears the counter for the submit.
+void d3d11_indirect_draws__begin_frame(struct d3d11_indirect_draws_t *ind, struct d3d11_context_i *immediate);
+
+// Issues the compaction of `draw` on `context`. `args_uav` and `count_uav` are the UAVs of the
+// argument and count buffers of the draw, `count_uav` is NULL if it has no count buffer. Can be
+// called from several threads at once, on different contexts.
+void d3d11_indirect_draws__compact(const struct d3d11_indirect_draws_t *ind, struct d3d11_context_i *context,
+    const struct d3d11_compacted_draw_t *draw, void *args_uav, void *count_uav);
+
+// Queues the readback of the submit's counter, if it compacted any draws. The compactions must
+// have been executed on `immediate` by now.
+void d3d11_indirect_draws__end_frame(struct d3d11_indirect_draws_t *ind, struct d3d11_context_i *immediate);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+// APIs shared by the translation units of the D3D11 render backend. Defined and loaded in
+// `d3d11_render_backend.c`.
+
+extern struct tm_api_registry_api *tm_global_api_registry;
+
+extern struct tm_allocator_api *tm_allocator_api;
+extern struct tm_error_api *tm_error_api;
+extern struct tm_job_system_api *tm_job_system_api;
+extern struct tm_logger_api *tm_logger_api;
+extern struct tm_os_api *tm_os_api;
+extern struct tm_sprintf_api *tm_sprintf_api;
+extern struct tm_temp_allocator_api *tm_temp_allocator_api;
+extern struct tm_unicode_api *tm_unicode_api;
+
+extern struct tm_renderer_api *tm_renderer_api;
+
+extern struct tm_d3d11_api *tm_d3d11_api;
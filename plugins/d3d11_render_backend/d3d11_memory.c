@@ -0,0 +1,50 @@
+#include "d3d11_memory.h"
+
+#include "d3d11_internal.h"
+
+#include <foundation/allocator.h>
+
+#include <string.h>
+
+static void *
+scope_realloc(struct tm_allocator_i *a, void *ptr, uint64_t old_size, uint64_t new_size, const char *file,
+    uint32_t line)
+{
+    struct d3d11_memory_scope_t *scope = (struct d3d11_memory_scope_t *)a->inst;
+    struct d3d11_memory_counters_t *c = scope->counters;
+
+    void *res = scope->child.realloc(&scope->child, ptr, old_size, new_size, file, line);
+    if (new_size && !res)
+        return res;
+
+    if (new_size)
+        atomic_fetch_add_uint64_t(&c->num_allocations, 1);
+
+    // Unsigned wrap-around makes the shrinking case a subtraction.
+    const uint64_t live = atomic_fetch_add_uint64_t(&c->live_bytes, new_size - old_size) + new_size - old_size;
+    uint64_t peak = atomic_load_uint64_t(&c->peak_bytes);
+    while (live > peak && !atomic_compare_exchange_strong_uint64_t(&c->peak_bytes, &peak, live))
+        ;
+    return res;
+}
+
+void
+d3d11_memory_scope__init(struct d3d11_memory_scope_t *scope, struct tm_allocator_i *parent, const char *name,
+    struct d3d11_memory_counters_t *counters)
+{
+    memset(scope, 0, sizeof(*scope));
+    scope->child = tm_allocator_api->create_child(parent, name);
+    scope->counters = counters;
+    scope->allocator = (struct tm_allocator_i) {
+        .inst      = (struct tm_allocator_o *)scope,
+        .mem_scope = scope->child.mem_scope,
+        .realloc   = scope_realloc,
+    };
+}
+
+void
+d3d11_memory_scope__shutdown(struct d3d11_memory_scope_t *scope)
+{
+    tm_allocator_api->destroy_child(&scope->child);
+    memset(scope, 0, sizeof(*scope));
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <foundation/api_types.h>
+#include <foundation/allocator.h>
+#include <foundation/atomics.inl>
+
+// Allocators that track the memory of a subsystem of the backend, see `enum tm_d3d11_memory_scope`.
+//
+// A scope is a named child allocator, so its allocations show up under its name in the memory
+// tracker, wrapped to count the allocations made through it and its live and peak bytes. Jobs
+// allocate too, so the counters are atomic.
+
+struct d3d11_memory_counters_t
+{
+    atomic_uint64_t live_bytes;
+    atomic_uint64_t peak_bytes;
+
+    // Allocations and reallocations, frees aren't counted.
+    atomic_uint64_t num_allocations;
+};
+
+struct d3d11_memory_scope_t
+{
+    // Allocator handed to the subsystem, counts in `counters` and forwards to `child`.
+    struct tm_allocator_i allocator;
+    struct tm_allocator_i child;
+
+    struct d3d11_memory_counters_t *counters;
+};
+
+// Creates the child allocator `name` of `parent` and sets up `scope->allocator` to count in
+// `counters`, which may be shared by several scopes. `scope` must not move while `scope->allocator`
+// is in use.
+void d3d11_memory_scope__init(struct d3d11_memory_scope_t *scope, struct tm_allocator_i *parent, const char *name,
+    struct d3d11_memory_counters_t *counters);
+
+// Destroys the child allocator. Everything allocated from the scope must have been freed.
+void d3d11_memory_scope__shutdown(struct d3d11_memory_scope_t *scope);
@@ -0,0 +1,227 @@
+#include "d3d11_mip_streamer.h"
+
+#include "d3d11_internal.h"
+
+#include <foundation/allocator.h>
+#include <foundation/carray.inl>
+
+#include <string.h>
+
+// -------------------------------------------------------------------
+// Heap
+
+// Returns true if the image `a` should be uploaded before `b`.
+static bool
+before(const struct d3d11_mip_streamer_t *s, uint32_t a, uint32_t b)
+{
+    const struct d3d11_streamed_image_t *x = s->images + a;
+    const struct d3d11_streamed_image_t *y = s->images + b;
+    return x->priority > y->priority || (x->priority == y->priority && x->sequence < y->sequence);
+}
+
+static void
+heap_set(struct d3d11_mip_streamer_t *s, uint32_t pos, uint32_t index)
+{
+    s->heap[pos] = index;
+    s->images[index].heap_index = pos;
+}
+
+static void
+sift_up(struct d3d11_mip_streamer_t *s, uint32_t pos)
+{
+    const uint32_t index = s->heap[pos];
+    while (pos)
+    {
+        const uint32_t parent = (pos - 1) / 2;
+        if (!before(s, index, s->heap[parent]))
+            break;
+        heap_set(s, pos, s->heap[parent]);
+        pos = parent;
+    }
+    heap_set(s, pos, index);
+}
+
+static void
+sift_down(struct d3d11_mip_streamer_t *s, uint32_t pos)
+{
+    const uint32_t n = (uint32_t)tm_carray_size(s->heap);
+    const uint32_t index = s->heap[pos];
+    for (;;)
+    {
+        uint32_t child = 2 * pos + 1;
+        if (child >= n)
+            break;
+        if (child + 1 < n && before(s, s->heap[child + 1], s->heap[child]))
+            ++child;
+        if (!before(s, s->heap[child], index))
+            break;
+        heap_set(s, pos, s->heap[child]);
+        pos = child;
+    }
+    heap_set(s, pos, index);
+}
+
+static void
+heap_remove(struct d3d11_mip_streamer_t *s, uint32_t index)
+{
+    const uint32_t pos = s->images[index].heap_index;
+    const uint32_t last = tm_carray_pop(s->heap);
+    s->images[index].heap_index = UINT32_MAX;
+    if (last == index)
+        return;
+
+    heap_set(s, pos, last);
+    sift_up(s, pos);
+    sift_down(s, s->images[last].heap_index);
+}
+
+// -------------------------------------------------------------------
+// Public
+
+void
+d3d11_mip_streamer__init(struct d3d11_mip_streamer_t *streamer, struct tm_allocator_i *allocator)
+{
+    memset(streamer, 0, sizeof(*streamer));
+    streamer->allocator = allocator;
+}
+
+void
+d3d11_mip_streamer__shutdown(struct d3d11_mip_streamer_t *streamer)
+{
+    struct d3d11_mip_streamer_t *s = streamer;
+    for (uint32_t i = 0; i != tm_carray_size(s->images); ++i)
+    {
+        if (s->images[i].image)
+            d3d11_mip_streamer__remove(s, i);
+    }
+    tm_carray_free(s->images, s->allocator);
+    tm_carray_free(s->free_images, s->allocator);
+    tm_carray_free(s->heap, s->allocator);
+    memset(s, 0, sizeof(*s));
+}
+
+uint32_t
+d3d11_mip_streamer__add(struct d3d11_mip_streamer_t *streamer, uint32_t image, uint32_t resident_mip,
+    const uint64_t *mip_sizes, float priority)
+{
+    struct d3d11_mip_streamer_t *s = streamer;
+    resident_mip = tm_min(resident_mip, TM_D3D11_MAX_MIP_LEVELS - 1);
+
+    uint32_t index;
+    if (tm_carray_size(s->free_images))
+        index = tm_carray_pop(s->free_images);
+    else
+    {
+        index = (uint32_t)tm_carray_size(s->images);
+        tm_carray_resize(s->images, index + 1, s->allocator);
+    }
+
+    struct d3d11_streamed_image_t *e = s->images + index;
+    memset(e, 0, sizeof(*e));
+    e->image = image;
+    e->resident_mip = resident_mip;
+    e->heap_index = UINT32_MAX;
+    e->priority = priority;
+    e->sequence = s->next_sequence++;
+
+    for (uint32_t mip = 0; mip != resident_mip; ++mip)
+        e->mip_offsets[mip + 1] = e->mip_offsets[mip] + mip_sizes[mip];
+    const uint64_t size = e->mip_offsets[resident_mip];
+
+    ++s->resident_mips[resident_mip];
+    if (!size)
+        return index;
+
+    e->data = tm_alloc(s->allocator, size);
+    e->data_size = size;
+    s->pending_bytes += size;
+    tm_carray_push(s->heap, index, s->allocator);
+    sift_up(s, (uint32_t)tm_carray_size(s->heap) - 1);
+    return index;
+}
+
+void
+d3d11_mip_streamer__remove(struct d3d11_mip_streamer_t *streamer, uint32_t index)
+{
+    struct d3d11_mip_streamer_t *s = streamer;
+    struct d3d11_streamed_image_t *e = s->images + index;
+
+    if (e->heap_index != UINT32_MAX)
+        heap_remove(s, index);
+    if (e->data)
+        tm_free(s->allocator, e->data, e->data_size);
+
+    s->pending_bytes -= e->mip_offsets[e->resident_mip];
+    --s->resident_mips[e->resident_mip];
+    memset(e, 0, sizeof(*e));
+    tm_carray_push(s->free_images, index, s->allocator);
+}
+
+uint8_t *
+d3d11_mip_streamer__mip_data(struct d3d11_mip_streamer_t *streamer, uint32_t index, uint32_t mip)
+{
+    struct d3d11_streamed_image_t *e = streamer->images + index;
+    return e->data + e->mip_offsets[mip];
+}
+
+uint32_t
+d3d11_mip_streamer__resident_mip(const struct d3d11_mip_streamer_t *streamer, uint32_t index)
+{
+    return streamer->images[index].resident_mip;
+}
+
+void
+d3d11_mip_streamer__set_priority(struct d3d11_mip_streamer_t *streamer, uint32_t index, float priority)
+{
+    struct d3d11_mip_streamer_t *s = streamer;
+    struct d3d11_streamed_image_t *e = s->images + index;
+    if (e->priority == priority)
+        return;
+
+    const bool raised = priority > e->priority;
+    e->priority = priority;
+    if (e->heap_index == UINT32_MAX)
+        return;
+    if (raised)
+        sift_up(s, e->heap_index);
+    else
+        sift_down(s, e->heap_index);
+}
+
+uint32_t
+d3d11_mip_streamer__top(const struct d3d11_mip_streamer_t *streamer)
+{
+    return tm_carray_size(streamer->heap) ? streamer->heap[0] : UINT32_MAX;
+}
+
+uint32_t
+d3d11_mip_streamer__next_mip(const struct d3d11_mip_streamer_t *streamer, uint32_t index, uint64_t *size)
+{
+    const struct d3d11_streamed_image_t *e = streamer->images + index;
+    const uint32_t mip = e->resident_mip - 1;
+    *size = e->mip_offsets[mip + 1] - e->mip_offsets[mip];
+    return mip;
+}
+
+void
+d3d11_mip_streamer__mip_uploaded(struct d3d11_mip_streamer_t *streamer, uint32_t index)
+{
+    struct d3d11_mip_streamer_t *s = streamer;
+    struct d3d11_streamed_image_t *e = s->images + index;
+
+    uint64_t size;
+    const uint32_t mip = d3d11_mip_streamer__next_mip(s, index, &size);
+    s->pending_bytes -= size;
+    s->uploaded_bytes += size;
+    --s->resident_mips[e->resident_mip];
+    ++s->resident_mips[mip];
+    e->resident_mip = mip;
+
+    if (mip)
+        return;
+
+    heap_remove(s, index);
+    tm_free(s->allocator, e->data, e->data_size);
+    e->data = 0;
+    e->data_size = 0;
+}
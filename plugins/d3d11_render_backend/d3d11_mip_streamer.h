@@ -0,0 +1,91 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+#include "d3d11_render_backend.h"
+
+// Queue of image mips waiting to be uploaded.
+//
+// A streamed image is created with only its smallest mips uploaded. Its finest uploaded mip is its
+// *resident mip* and sampling is clamped to it with a minimum LOD. The data of the mips above it
+// is kept in system memory and uploaded one mip at a time, coarsest first, so the clamp can be
+// lowered after each upload. Images are ordered by priority in a binary heap, images with the same
+// priority in the order they were added. Images stay in the streamer, fully resident or not, until
+// they are removed, so the histogram of resident mips covers every streamed image.
+//
+// The streamer only keeps the books, uploading is up to the caller: it takes `top()`, uploads
+// `next_mip()` and calls `mip_uploaded()`.
+
+struct tm_allocator_i;
+
+struct d3d11_streamed_image_t
+{
+    // Renderer handle of the image, 0 for free entries.
+    uint32_t image;
+
+    // Finest mip that has been uploaded.
+    uint32_t resident_mip;
+
+    // Position in `heap`, or `UINT32_MAX` if the image is fully resident.
+    uint32_t heap_index;
+
+    float priority;
+    uint64_t sequence;
+
+    // Data of the mips above the initial resident mip, mip 0 first, the slices of a mip together.
+    // Mip `m` is `mip_offsets[m]` to `mip_offsets[m + 1]`. Freed once the image is fully resident.
+    uint8_t *data;
+    uint64_t data_size;
+    uint64_t mip_offsets[TM_D3D11_MAX_MIP_LEVELS + 1];
+};
+
+struct d3d11_mip_streamer_t
+{
+    struct tm_allocator_i *allocator;
+
+    /* carray */ struct d3d11_streamed_image_t *images;
+    /* carray */ uint32_t *free_images;
+
+    // Indices of the images with mips left to upload, highest priority first.
+    /* carray */ uint32_t *heap;
+
+    uint64_t next_sequence;
+
+    // Size of the mip data waiting to be uploaded, and of the data uploaded so far.
+    uint64_t pending_bytes;
+    uint64_t uploaded_bytes;
+
+    // Number of streamed images per resident mip.
+    uint32_t resident_mips[TM_D3D11_MAX_MIP_LEVELS];
+};
+
+void d3d11_mip_streamer__init(struct d3d11_mip_streamer_t *streamer, struct tm_allocator_i *allocator);
+
+void d3d11_mip_streamer__shutdown(struct d3d11_mip_streamer_t *streamer);
+
+// Adds `image`, whose mips from `resident_mip` on have been uploaded. `mip_sizes[m]` is the size
+// of mip `m`, all slices included, for the mips before `resident_mip`. Returns the index of the
+// image in the streamer, its data is filled in through `d3d11_mip_streamer__mip_data()`.
+uint32_t d3d11_mip_streamer__add(struct d3d11_mip_streamer_t *streamer, uint32_t image, uint32_t resident_mip,
+    const uint64_t *mip_sizes, float priority);
+
+// Removes the image with index `index`, dropping its pending mips.
+void d3d11_mip_streamer__remove(struct d3d11_mip_streamer_t *streamer, uint32_t index);
+
+// Returns where the data of `mip` of the image `index` is kept.
+uint8_t *d3d11_mip_streamer__mip_data(struct d3d11_mip_streamer_t *streamer, uint32_t index, uint32_t mip);
+
+// Returns the resident mip of the image `index`.
+uint32_t d3d11_mip_streamer__resident_mip(const struct d3d11_mip_streamer_t *streamer, uint32_t index);
+
+void d3d11_mip_streamer__set_priority(struct d3d11_mip_streamer_t *streamer, uint32_t index, float priority);
+
+// Returns the index of the image with the highest priority that has mips left to upload, or
+// `UINT32_MAX` if all images are fully resident.
+uint32_t d3d11_mip_streamer__top(const struct d3d11_mip_streamer_t *streamer);
+
+// Returns the next mip to upload of the image `index` and its size.
+uint32_t d3d11_mip_streamer__next_mip(const struct d3d11_mip_streamer_t *streamer, uint32_t index, uint64_t *size);
+
+// Makes the next mip of the image `index` resident.
+void d3d11_mip_streamer__mip_uploaded(struct d3d11_mip_streamer_t *streamer, uint32_t index);
@@ -0,0 +1,987 @@
+#include "d3d11_device.h"
+#include "d3d11_internal.h"
+
+#include <foundation/allocator.h>
+#include <foundation/log.h>
+
+#if defined(TM_OS_WINDOWS)
+
+#define COBJMACROS
+#include <d3d11.h>
+#include <dxgi1_4.h>
+#include <string.h>
+
+#define MAX_FRAME_LATENCY (16)
+
+struct d3d11_context_o
+{
+    ID3D11DeviceContext *ctx;
+
+    // NULL without the 11.1 runtime.
+    ID3D11DeviceContext1 *ctx1;
+};
+
+struct d3d11_device_o
+{
+    struct d3d11_device_i i;
+
+    struct tm_allocator_i *allocator;
+
+    ID3D11Device *device;
+
+    // NULL before Windows 10.
+    IDXGIAdapter3 *adapter;
+
+    D3D_FEATURE_LEVEL feature_level;
+    bool driver_command_lists;
+    bool constant_buffer_offsets;
+    TM_PAD(2);
+
+    struct d3d11_context_o immediate;
+    struct d3d11_context_i immediate_i;
+};
+
+struct deferred_context_t
+{
+    struct d3d11_context_i i;
+    struct d3d11_context_o o;
+};
+
+struct d3d11_swap_chain_o
+{
+    struct d3d11_swap_chain_i i;
+
+    struct d3d11_device_o *device;
+    IDXGISwapChain2 *swap_chain;
+    ID3D11RenderTargetView *rtv;
+
+    // Signaled whenever fewer than the maximum frame latency frames are queued.
+    HANDLE waitable;
+
+    UINT flags;
+    TM_PAD(4);
+};
+
+// -------------------------------------------------------------------
+// Context
+
+static void
+context__om_set_render_targets(struct d3d11_context_o *inst, uint32_t num_views, void *const *rtvs, void *dsv)
+{
+    ID3D11DeviceContext_OMSetRenderTargets(inst->ctx, num_views, (ID3D11RenderTargetView *const *)rtvs,
+        (ID3D11DepthStencilView *)dsv);
+}
+
+static void
+context__om_set_blend_state(struct d3d11_context_o *inst, void *state, const float blend_factor[4], uint32_t sample_mask)
+{
+    ID3D11DeviceContext_OMSetBlendState(inst->ctx, (ID3D11BlendState *)state, blend_factor, sample_mask);
+}
+
+static void
+context__om_set_depth_stencil_state(struct d3d11_context_o *inst, void *state, uint32_t stencil_ref)
+{
+    ID3D11DeviceContext_OMSetDepthStencilState(inst->ctx, (ID3D11DepthStencilState *)state, stencil_ref);
+}
+
+static void
+context__clear_render_target_view(struct d3d11_context_o *inst, void *rtv, const float color[4])
+{
+    ID3D11DeviceContext_ClearRenderTargetView(inst->ctx, (ID3D11RenderTargetView *)rtv, color);
+}
+
+static void
+context__clear_depth_stencil_view(struct d3d11_context_o *inst, void *dsv, uint32_t clear_flags, float depth, uint8_t stencil)
+{
+    ID3D11DeviceContext_ClearDepthStencilView(inst->ctx, (ID3D11DepthStencilView *)dsv, clear_flags, depth, stencil);
+}
+
+static void
+context__rs_set_state(struct d3d11_context_o *inst, void *state)
+{
+    ID3D11DeviceContext_RSSetState(inst->ctx, (ID3D11RasterizerState *)state);
+}
+
+static void
+context__rs_set_viewports(struct d3d11_context_o *inst, uint32_t num_viewports, const struct d3d11_viewport_t *viewports)
+{
+    ID3D11DeviceContext_RSSetViewports(inst->ctx, num_viewports, (const D3D11_VIEWPORT *)viewports);
+}
+
+static void
+context__rs_set_scissor_rects(struct d3d11_context_o *inst, uint32_t num_rects, const struct d3d11_rect_t *rects)
+{
+    ID3D11DeviceContext_RSSetScissorRects(inst->ctx, num_rects, (const D3D11_RECT *)rects);
+}
+
+static void
+context__ia_set_input_layout(struct d3d11_context_o *inst, void *layout)
+{
+    ID3D11DeviceContext_IASetInputLayout(inst->ctx, (ID3D11InputLayout *)layout);
+}
+
+static void
+context__ia_set_primitive_topology(struct d3d11_context_o *inst, uint32_t topology)
+{
+    ID3D11DeviceContext_IASetPrimitiveTopology(inst->ctx, (D3D11_PRIMITIVE_TOPOLOGY)topology);
+}
+
+static void
+context__ia_set_vertex_buffers(struct d3d11_context_o *inst, uint32_t start_slot, uint32_t num_buffers,
+    void *const *buffers, const uint32_t *strides, const uint32_t *offsets)
+{
+    ID3D11DeviceContext_IASetVertexBuffers(inst->ctx, start_slot, num_buffers, (ID3D11Buffer *const *)buffers,
+        strides, offsets);
+}
+
+static void
+context__ia_set_index_buffer(struct d3d11_context_o *inst, void *buffer, uint32_t format, uint32_t offset)
+{
+    ID3D11DeviceContext_IASetIndexBuffer(inst->ctx, (ID3D11Buffer *)buffer, (DXGI_FORMAT)format, offset);
+}
+
+static void
+context__set_shader(struct d3d11_context_o *inst, uint32_t stage, void *shader)
+{
+    switch (stage)
+    {
+    case SHADER_STAGE__VERTEX:   ID3D11DeviceContext_VSSetShader(inst->ctx, (ID3D11VertexShader *)shader, 0, 0); break;
+    case SHADER_STAGE__HULL:     ID3D11DeviceContext_HSSetShader(inst->ctx, (ID3D11HullShader *)shader, 0, 0); break;
+    case SHADER_STAGE__DOMAIN:   ID3D11DeviceContext_DSSetShader(inst->ctx, (ID3D11DomainShader *)shader, 0, 0); break;
+    case SHADER_STAGE__GEOMETRY: ID3D11DeviceContext_GSSetShader(inst->ctx, (ID3D11GeometryShader *)shader, 0, 0); break;
+    case SHADER_STAGE__PIXEL:    ID3D11DeviceContext_PSSetShader(inst->ctx, (ID3D11PixelShader *)shader, 0, 0); break;
+    case SHADER_STAGE__COMPUTE:  ID3D11DeviceContext_CSSetShader(inst->ctx, (ID3D11ComputeShader *)shader, 0, 0); break;
+    default: break;
+    }
+}
+
+static void
+context__set_constant_buffers(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_buffers, void *const *buffers)
+{
+    ID3D11Buffer *const *b = (ID3D11Buffer *const *)buffers;
+    switch (stage)
+    {
+    case SHADER_STAGE__VERTEX:   ID3D11DeviceContext_VSSetConstantBuffers(inst->ctx, start_slot, num_buffers, b); break;
+    case SHADER_STAGE__HULL:     ID3D11DeviceContext_HSSetConstantBuffers(inst->ctx, start_slot, num_buffers, b); break;
+    case SHADER_STAGE__DOMAIN:   ID3D11DeviceContext_DSSetConstantBuffers(inst->ctx, start_slot, num_buffers, b); break;
+    case SHADER_STAGE__GEOMETRY: ID3D11DeviceContext_GSSetConstantBuffers(inst->ctx, start_slot, num_buffers, b); break;
+    case SHADER_STAGE__PIXEL:    ID3D11DeviceContext_PSSetConstantBuffers(inst->ctx, start_slot, num_buffers, b); break;
+    case SHADER_STAGE__COMPUTE:  ID3D11DeviceContext_CSSetConstantBuffers(inst->ctx, start_slot, num_buffers, b); break;
+    default: break;
+    }
+}
+
+static void
+context__set_constant_buffers1(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_buffers, void *const *buffers, const uint32_t *first_constants, const uint32_t *num_constants)
+{
+    ID3D11DeviceContext1 *c = inst->ctx1;
+    ID3D11Buffer *const *b = (ID3D11Buffer *const *)buffers;
+    switch (stage)
+    {
+    case SHADER_STAGE__VERTEX:   ID3D11DeviceContext1_VSSetConstantBuffers1(c, start_slot, num_buffers, b, first_constants, num_constants); break;
+    case SHADER_STAGE__HULL:     ID3D11DeviceContext1_HSSetConstantBuffers1(c, start_slot, num_buffers, b, first_constants, num_constants); break;
+    case SHADER_STAGE__DOMAIN:   ID3D11DeviceContext1_DSSetConstantBuffers1(c, start_slot, num_buffers, b, first_constants, num_constants); break;
+    case SHADER_STAGE__GEOMETRY: ID3D11DeviceContext1_GSSetConstantBuffers1(c, start_slot, num_buffers, b, first_constants, num_constants); break;
+    case SHADER_STAGE__PIXEL:    ID3D11DeviceContext1_PSSetConstantBuffers1(c, start_slot, num_buffers, b, first_constants, num_constants); break;
+    case SHADER_STAGE__COMPUTE:  ID3D11DeviceContext1_CSSetConstantBuffers1(c, start_slot, num_buffers, b, first_constants, num_constants); break;
+    default: break;
+    }
+}
+
+static void
+context__set_shader_resources(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_views, void *const *views)
+{
+    ID3D11ShaderResourceView *const *v = (ID3D11ShaderResourceView *const *)views;
+    switch (stage)
+    {
+    case SHADER_STAGE__VERTEX:   ID3D11DeviceContext_VSSetShaderResources(inst->ctx, start_slot, num_views, v); break;
+    case SHADER_STAGE__HULL:     ID3D11DeviceContext_HSSetShaderResources(inst->ctx, start_slot, num_views, v); break;
+    case SHADER_STAGE__DOMAIN:   ID3D11DeviceContext_DSSetShaderResources(inst->ctx, start_slot, num_views, v); break;
+    case SHADER_STAGE__GEOMETRY: ID3D11DeviceContext_GSSetShaderResources(inst->ctx, start_slot, num_views, v); break;
+    case SHADER_STAGE__PIXEL:    ID3D11DeviceContext_PSSetShaderResources(inst->ctx, start_slot, num_views, v); break;
+    case SHADER_STAGE__COMPUTE:  ID3D11DeviceContext_CSSetShaderResources(inst->ctx, start_slot, num_views, v); break;
+    default: break;
+    }
+}
+
+static void
+context__set_samplers(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_samplers, void *const *samplers)
+{
+    ID3D11SamplerState *const *s = (ID3D11SamplerState *const *)samplers;
+    switch (stage)
+    {
+    case SHADER_STAGE__VERTEX:   ID3D11DeviceContext_VSSetSamplers(inst->ctx, start_slot, num_samplers, s); break;
+    case SHADER_STAGE__HULL:     ID3D11DeviceContext_HSSetSamplers(inst->ctx, start_slot, num_samplers, s); break;
+    case SHADER_STAGE__DOMAIN:   ID3D11DeviceContext_DSSetSamplers(inst->ctx, start_slot, num_samplers, s); break;
+    case SHADER_STAGE__GEOMETRY: ID3D11DeviceContext_GSSetSamplers(inst->ctx, start_slot, num_samplers, s); break;
+    case SHADER_STAGE__PIXEL:    ID3D11DeviceContext_PSSetSamplers(inst->ctx, start_slot, num_samplers, s); break;
+    case SHADER_STAGE__COMPUTE:  ID3D11DeviceContext_CSSetSamplers(inst->ctx, start_slot, num_samplers, s); break;
+    default: break;
+    }
+}
+
+static void
+context__cs_set_unordered_access_views(struct d3d11_context_o *inst, uint32_t start_slot, uint32_t num_views,
+    void *const *uavs)
+{
+    ID3D11DeviceContext_CSSetUnorderedAccessViews(inst->ctx, start_slot, num_views,
+        (ID3D11UnorderedAccessView *const *)uavs, 0);
+}
+
+static void
+context__draw_instanced(struct d3d11_context_o *inst, uint32_t vertex_count_per_instance, uint32_t instance_count,
+    uint32_t start_vertex, uint32_t start_instance)
+{
+    ID3D11DeviceContext_DrawInstanced(inst->ctx, vertex_count_per_instance, instance_count, start_vertex, start_instance);
+}
+
+static void
+context__draw_indexed_instanced(struct d3d11_context_o *inst, uint32_t index_count_per_instance,
+    uint32_t instance_count, uint32_t start_index, int32_t base_vertex, uint32_t start_instance)
+{
+    ID3D11DeviceContext_DrawIndexedInstanced(inst->ctx, index_count_per_instance, instance_count, start_index,
+        base_vertex, start_instance);
+}
+
+static void
+context__dispatch(struct d3d11_context_o *inst, uint32_t x, uint32_t y, uint32_t z)
+{
+    ID3D11DeviceContext_Dispatch(inst->ctx, x, y, z);
+}
+
+static void
+context__draw_instanced_indirect(struct d3d11_context_o *inst, void *args_buffer, uint32_t offset)
+{
+    ID3D11DeviceContext_DrawInstancedIndirect(inst->ctx, (ID3D11Buffer *)args_buffer, offset);
+}
+
+static void
+context__draw_indexed_instanced_indirect(struct d3d11_context_o *inst, void *args_buffer, uint32_t offset)
+{
+    ID3D11DeviceContext_DrawIndexedInstancedIndirect(inst->ctx, (ID3D11Buffer *)args_buffer, offset);
+}
+
+static void
+context__dispatch_indirect(struct d3d11_context_o *inst, void *args_buffer, uint32_t offset)
+{
+    ID3D11DeviceContext_DispatchIndirect(inst->ctx, (ID3D11Buffer *)args_buffer, offset);
+}
+
+static void
+context__copy_buffer_region(struct d3d11_context_o *inst, void *dst, uint32_t dst_offset, void *src,
+    uint32_t src_offset, uint32_t size)
+{
+    const D3D11_BOX box = { src_offset, 0, 0, src_offset + size, 1, 1 };
+    ID3D11DeviceContext_CopySubresourceRegion(inst->ctx, (ID3D11Resource *)dst, 0, dst_offset, 0, 0,
+        (ID3D11Resource *)src, 0, &box);
+}
+
+static void
+context__copy_subresource(struct d3d11_context_o *inst, void *dst, uint32_t dst_subresource, void *src,
+    uint32_t src_subresource)
+{
+    ID3D11DeviceContext_CopySubresourceRegion(inst->ctx, (ID3D11Resource *)dst, dst_subresource, 0, 0, 0,
+        (ID3D11Resource *)src, src_subresource, 0);
+}
+
+static void
+context__update_subresource(struct d3d11_context_o *inst, void *resource, uint32_t subresource,
+    const struct d3d11_box_t *box, const void *data, uint32_t row_pitch, uint32_t depth_pitch)
+{
+    ID3D11DeviceContext_UpdateSubresource(inst->ctx, (ID3D11Resource *)resource, subresource, (const D3D11_BOX *)box,
+        data, row_pitch, depth_pitch);
+}
+
+static void
+context__set_resource_min_lod(struct d3d11_context_o *inst, void *resource, float min_lod)
+{
+    ID3D11DeviceContext_SetResourceMinLOD(inst->ctx, (ID3D11Resource *)resource, min_lod);
+}
+
+static void *
+context__map(struct d3d11_context_o *inst, void *resource, uint32_t subresource, uint32_t map_type)
+{
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    HRESULT hr = ID3D11DeviceContext_Map(inst->ctx, (ID3D11Resource *)resource, subresource, (D3D11_MAP)map_type, 0, &mapped);
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Map failed: 0x%08x", (uint32_t)hr);
+        return 0;
+    }
+    return mapped.pData;
+}
+
+static void
+context__unmap(struct d3d11_context_o *inst, void *resource, uint32_t subresource)
+{
+    ID3D11DeviceContext_Unmap(inst->ctx, (ID3D11Resource *)resource, subresource);
+}
+
+static void
+context__begin_query(struct d3d11_context_o *inst, void *query)
+{
+    ID3D11DeviceContext_Begin(inst->ctx, (ID3D11Asynchronous *)query);
+}
+
+static void
+context__end_query(struct d3d11_context_o *inst, void *query)
+{
+    ID3D11DeviceContext_End(inst->ctx, (ID3D11Asynchronous *)query);
+}
+
+static bool
+context__get_query_data(struct d3d11_context_o *inst, void *query, void *data, uint32_t size, bool flush)
+{
+    const UINT flags = flush ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH;
+    return ID3D11DeviceContext_GetData(inst->ctx, (ID3D11Asynchronous *)query, data, size, flags) == S_OK;
+}
+
+static void *
+context__finish_command_list(struct d3d11_context_o *inst)
+{
+    ID3D11CommandList *list = 0;
+    HRESULT hr = ID3D11DeviceContext_FinishCommandList(inst->ctx, FALSE, &list);
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "FinishCommandList failed: 0x%08x", (uint32_t)hr);
+        return 0;
+    }
+    return list;
+}
+
+static void
+context__execute_command_list(struct d3d11_context_o *inst, void *command_list)
+{
+    ID3D11DeviceContext_ExecuteCommandList(inst->ctx, (ID3D11CommandList *)command_list, FALSE);
+}
+
+static void
+init_context_interface(struct d3d11_context_i *i, struct d3d11_context_o *inst)
+{
+    if (FAILED(ID3D11DeviceContext_QueryInterface(inst->ctx, &IID_ID3D11DeviceContext1, (void **)&inst->ctx1)))
+        inst->ctx1 = 0;
+
+    *i = (struct d3d11_context_i) {
+        .inst                            = inst,
+        .om_set_render_targets           = context__om_set_render_targets,
+        .om_set_blend_state              = context__om_set_blend_state,
+        .om_set_depth_stencil_state      = context__om_set_depth_stencil_state,
+        .clear_render_target_view        = context__clear_render_target_view,
+        .clear_depth_stencil_view        = context__clear_depth_stencil_view,
+        .rs_set_state                    = context__rs_set_state,
+        .rs_set_viewports                = context__rs_set_viewports,
+        .rs_set_scissor_rects            = context__rs_set_scissor_rects,
+        .ia_set_input_layout             = context__ia_set_input_layout,
+        .ia_set_primitive_topology       = context__ia_set_primitive_topology,
+        .ia_set_vertex_buffers           = context__ia_set_vertex_buffers,
+        .ia_set_index_buffer             = context__ia_set_index_buffer,
+        .set_shader                      = context__set_shader,
+        .set_constant_buffers            = context__set_constant_buffers,
+        .set_constant_buffers1           = context__set_constant_buffers1,
+        .set_shader_resources            = context__set_shader_resources,
+        .set_samplers                    = context__set_samplers,
+        .cs_set_unordered_access_views   = context__cs_set_unordered_access_views,
+        .draw_instanced                  = context__draw_instanced,
+        .draw_indexed_instanced          = context__draw_indexed_instanced,
+        .dispatch                        = context__dispatch,
+        .draw_instanced_indirect         = context__draw_instanced_indirect,
+        .draw_indexed_instanced_indirect = context__draw_indexed_instanced_indirect,
+        .dispatch_indirect               = context__dispatch_indirect,
+        .copy_buffer_region              = context__copy_buffer_region,
+        .copy_subresource                = context__copy_subresource,
+        .update_subresource              = context__update_subresource,
+        .set_resource_min_lod            = context__set_resource_min_lod,
+        .map                             = context__map,
+        .unmap                           = context__unmap,
+        .begin_query                     = context__begin_query,
+        .end_query                       = context__end_query,
+        .get_query_data                  = context__get_query_data,
+        .finish_command_list             = context__finish_command_list,
+        .execute_command_list            = context__execute_command_list,
+    };
+}
+
+// -------------------------------------------------------------------
+// Swap chain
+
+static bool
+create_back_buffer_view(struct d3d11_swap_chain_o *inst)
+{
+    ID3D11Texture2D *back_buffer = 0;
+    HRESULT hr = IDXGISwapChain2_GetBuffer(inst->swap_chain, 0, &IID_ID3D11Texture2D, (void **)&back_buffer);
+    if (SUCCEEDED(hr))
+    {
+        hr = ID3D11Device_CreateRenderTargetView(inst->device->device, (ID3D11Resource *)back_buffer, 0, &inst->rtv);
+        ID3D11Texture2D_Release(back_buffer);
+    }
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Creating the back buffer view failed: 0x%08x", (uint32_t)hr);
+        inst->rtv = 0;
+        return false;
+    }
+    return true;
+}
+
+static void *
+swap_chain__render_target_view(struct d3d11_swap_chain_o *inst)
+{
+    return inst->rtv;
+}
+
+static bool
+swap_chain__resize(struct d3d11_swap_chain_o *inst, uint32_t width, uint32_t height)
+{
+    if (inst->rtv)
+    {
+        ID3D11RenderTargetView_Release(inst->rtv);
+        inst->rtv = 0;
+    }
+
+    // The runtime defers destruction of unbound back buffers until the context is flushed.
+    ID3D11DeviceContext_Flush(inst->device->immediate.ctx);
+
+    HRESULT hr = IDXGISwapChain2_ResizeBuffers(inst->swap_chain, 0, width, height, DXGI_FORMAT_UNKNOWN, inst->flags);
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "ResizeBuffers failed: 0x%08x", (uint32_t)hr);
+        return false;
+    }
+    return create_back_buffer_view(inst);
+}
+
+static void
+swap_chain__present(struct d3d11_swap_chain_o *inst, uint32_t sync_interval)
+{
+    HRESULT hr = IDXGISwapChain2_Present(inst->swap_chain, sync_interval, 0);
+    if (FAILED(hr))
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Present failed: 0x%08x", (uint32_t)hr);
+}
+
+static bool
+swap_chain__wait_until_ready(struct d3d11_swap_chain_o *inst, uint32_t timeout_ms)
+{
+    return WaitForSingleObjectEx(inst->waitable, timeout_ms, TRUE) == WAIT_OBJECT_0;
+}
+
+static void
+swap_chain__set_max_frame_latency(struct d3d11_swap_chain_o *inst, uint32_t max_frame_latency)
+{
+    IDXGISwapChain2_SetMaximumFrameLatency(inst->swap_chain, tm_min(tm_max(max_frame_latency, 1), MAX_FRAME_LATENCY));
+}
+
+// -------------------------------------------------------------------
+// Device
+
+static struct d3d11_context_i *
+device__immediate_context(struct d3d11_device_o *inst)
+{
+    return &inst->immediate_i;
+}
+
+static bool
+device__supports_command_lists(struct d3d11_device_o *inst)
+{
+    return inst->driver_command_lists;
+}
+
+static bool
+device__supports_constant_buffer_offsets(struct d3d11_device_o *inst)
+{
+    return inst->constant_buffer_offsets;
+}
+
+static struct d3d11_context_i *
+device__create_deferred_context(struct d3d11_device_o *inst)
+{
+    ID3D11DeviceContext *ctx = 0;
+    HRESULT hr = ID3D11Device_CreateDeferredContext(inst->device, 0, &ctx);
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "CreateDeferredContext failed: 0x%08x", (uint32_t)hr);
+        return 0;
+    }
+
+    struct deferred_context_t *d = tm_alloc(inst->allocator, sizeof(*d));
+    d->o.ctx = ctx;
+    init_context_interface(&d->i, &d->o);
+    return &d->i;
+}
+
+static void
+device__destroy_deferred_context(struct d3d11_device_o *inst, struct d3d11_context_i *context)
+{
+    struct deferred_context_t *d = (struct deferred_context_t *)context;
+    if (d->o.ctx1)
+        ID3D11DeviceContext1_Release(d->o.ctx1);
+    ID3D11DeviceContext_Release(d->o.ctx);
+    tm_free(inst->allocator, d, sizeof(*d));
+}
+
+static void *
+device__create_buffer(struct d3d11_device_o *inst, const struct d3d11_buffer_desc_t *desc, const void *initial_data)
+{
+    const D3D11_BUFFER_DESC bd = {
+        .ByteWidth           = desc->size,
+        .Usage               = (D3D11_USAGE)desc->usage,
+        .BindFlags           = desc->bind_flags,
+        .CPUAccessFlags      = desc->cpu_access_flags,
+        .MiscFlags           = desc->misc_flags,
+        .StructureByteStride = desc->structure_stride,
+    };
+    const D3D11_SUBRESOURCE_DATA data = { .pSysMem = initial_data };
+
+    ID3D11Buffer *buffer = 0;
+    HRESULT hr = ID3D11Device_CreateBuffer(inst->device, &bd, initial_data ? &data : 0, &buffer);
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "CreateBuffer failed: 0x%08x", (uint32_t)hr);
+        return 0;
+    }
+    return buffer;
+}
+
+static void *
+device__create_texture(struct d3d11_device_o *inst, const struct d3d11_texture_desc_t *desc,
+    const struct d3d11_subresource_data_t *initial_data)
+{
+    const D3D11_SUBRESOURCE_DATA *data = (const D3D11_SUBRESOURCE_DATA *)initial_data;
+    HRESULT hr = E_INVALIDARG;
+    void *texture = 0;
+
+    switch (desc->dimension)
+    {
+    case TEXTURE_DIMENSION__1D:
+    {
+        const D3D11_TEXTURE1D_DESC td = {
+            .Width          = desc->width,
+            .MipLevels      = desc->mip_levels,
+            .ArraySize      = desc->depth_or_array_size,
+            .Format         = (DXGI_FORMAT)desc->format,
+            .Usage          = (D3D11_USAGE)desc->usage,
+            .BindFlags      = desc->bind_flags,
+            .CPUAccessFlags = desc->cpu_access_flags,
+            .MiscFlags      = desc->misc_flags,
+        };
+        hr = ID3D11Device_CreateTexture1D(inst->device, &td, data, (ID3D11Texture1D **)&texture);
+        break;
+    }
+    case TEXTURE_DIMENSION__2D:
+    {
+        const D3D11_TEXTURE2D_DESC td = {
+            .Width          = desc->width,
+            .Height         = desc->height,
+            .MipLevels      = desc->mip_levels,
+            .ArraySize      = desc->depth_or_array_size,
+            .Format         = (DXGI_FORMAT)desc->format,
+            .SampleDesc     = { .Count = desc->sample_count ? desc->sample_count : 1 },
+            .Usage          = (D3D11_USAGE)desc->usage,
+            .BindFlags      = desc->bind_flags,
+            .CPUAccessFlags = desc->cpu_access_flags,
+            .MiscFlags      = desc->misc_flags,
+        };
+        hr = ID3D11Device_CreateTexture2D(inst->device, &td, data, (ID3D11Texture2D **)&texture);
+        break;
+    }
+    case TEXTURE_DIMENSION__3D:
+    {
+        const D3D11_TEXTURE3D_DESC td = {
+            .Width          = desc->width,
+            .Height         = desc->height,
+            .Depth          = desc->depth_or_array_size,
+            .MipLevels      = desc->mip_levels,
+            .Format         = (DXGI_FORMAT)desc->format,
+            .Usage          = (D3D11_USAGE)desc->usage,
+            .BindFlags      = desc->bind_flags,
+            .CPUAccessFlags = desc->cpu_access_flags,
+            .MiscFlags      = desc->misc_flags,
+        };
+        hr = ID3D11Device_CreateTexture3D(inst->device, &td, data, (ID3D11Texture3D **)&texture);
+        break;
+    }
+    default:
+        break;
+    }
+
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "CreateTexture failed: 0x%08x", (uint32_t)hr);
+        return 0;
+    }
+    return texture;
+}
+
+static void *
+device__create_view(struct d3d11_device_o *inst, void *resource, enum d3d11_view view)
+{
+    ID3D11Resource *res = (ID3D11Resource *)resource;
+    D3D11_RESOURCE_DIMENSION dimension;
+    ID3D11Resource_GetType(res, &dimension);
+
+    // Buffers are viewed as raw `ByteAddressBuffer`s, textures through a view of the whole
+    // resource in the format it was created with.
+    D3D11_BUFFER_DESC bd = { 0 };
+    const bool buffer = dimension == D3D11_RESOURCE_DIMENSION_BUFFER;
+    if (buffer)
+        ID3D11Buffer_GetDesc((ID3D11Buffer *)res, &bd);
+
+    void *object = 0;
+    HRESULT hr = E_INVALIDARG;
+
+    switch (view)
+    {
+    case VIEW__SRV:
+    {
+        const D3D11_SHADER_RESOURCE_VIEW_DESC vd = {
+            .Format        = DXGI_FORMAT_R32_TYPELESS,
+            .ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX,
+            .BufferEx      = { .NumElements = bd.ByteWidth / 4, .Flags = D3D11_BUFFEREX_SRV_FLAG_RAW },
+        };
+        hr = ID3D11Device_CreateShaderResourceView(inst->device, res, buffer ? &vd : 0,
+            (ID3D11ShaderResourceView **)&object);
+        break;
+    }
+    case VIEW__UAV:
+    {
+        const D3D11_UNORDERED_ACCESS_VIEW_DESC vd = {
+            .Format        = DXGI_FORMAT_R32_TYPELESS,
+            .ViewDimension = D3D11_UAV_DIMENSION_BUFFER,
+            .Buffer        = { .NumElements = bd.ByteWidth / 4, .Flags = D3D11_BUFFER_UAV_FLAG_RAW },
+        };
+        hr = ID3D11Device_CreateUnorderedAccessView(inst->device, res, buffer ? &vd : 0,
+            (ID3D11UnorderedAccessView **)&object);
+        break;
+    }
+    case VIEW__RTV:
+        hr = ID3D11Device_CreateRenderTargetView(inst->device, res, 0, (ID3D11RenderTargetView **)&object);
+        break;
+    case VIEW__DSV:
+        hr = ID3D11Device_CreateDepthStencilView(inst->device, res, 0, (ID3D11DepthStencilView **)&object);
+        break;
+    default:
+        break;
+    }
+
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Creating view %u failed: 0x%08x", view, (uint32_t)hr);
+        return 0;
+    }
+    return object;
+}
+
+static void *
+device__create_sampler_state(struct d3d11_device_o *inst, const struct d3d11_sampler_desc_t *desc)
+{
+    ID3D11SamplerState *sampler = 0;
+    HRESULT hr = ID3D11Device_CreateSamplerState(inst->device, (const D3D11_SAMPLER_DESC *)desc, &sampler);
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "CreateSamplerState failed: 0x%08x", (uint32_t)hr);
+        return 0;
+    }
+    return sampler;
+}
+
+static void *
+device__create_rasterizer_state(struct d3d11_device_o *inst, const struct d3d11_rasterizer_desc_t *desc)
+{
+    ID3D11RasterizerState *state = 0;
+    HRESULT hr = ID3D11Device_CreateRasterizerState(inst->device, (const D3D11_RASTERIZER_DESC *)desc, &state);
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "CreateRasterizerState failed: 0x%08x", (uint32_t)hr);
+        return 0;
+    }
+    return state;
+}
+
+static void *
+device__create_depth_stencil_state(struct d3d11_device_o *inst, const struct d3d11_depth_stencil_desc_t *desc)
+{
+    ID3D11DepthStencilState *state = 0;
+    HRESULT hr = ID3D11Device_CreateDepthStencilState(inst->device, (const D3D11_DEPTH_STENCIL_DESC *)desc, &state);
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "CreateDepthStencilState failed: 0x%08x", (uint32_t)hr);
+        return 0;
+    }
+    return state;
+}
+
+static void *
+device__create_blend_state(struct d3d11_device_o *inst, const struct d3d11_blend_desc_t *desc)
+{
+    ID3D11BlendState *state = 0;
+    HRESULT hr = ID3D11Device_CreateBlendState(inst->device, (const D3D11_BLEND_DESC *)desc, &state);
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "CreateBlendState failed: 0x%08x", (uint32_t)hr);
+        return 0;
+    }
+    return state;
+}
+
+static void *
+device__create_query(struct d3d11_device_o *inst, uint32_t type)
+{
+    const D3D11_QUERY_DESC desc = { .Query = (D3D11_QUERY)type };
+    ID3D11Query *query = 0;
+    HRESULT hr = ID3D11Device_CreateQuery(inst->device, &desc, &query);
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "CreateQuery failed: 0x%08x", (uint32_t)hr);
+        return 0;
+    }
+    return query;
+}
+
+static void *
+device__create_shader(struct d3d11_device_o *inst, uint32_t stage, const void *bytecode, uint64_t size)
+{
+    ID3D11Device *d = inst->device;
+    void *shader = 0;
+    HRESULT hr = E_INVALIDARG;
+
+    switch (stage)
+    {
+    case SHADER_STAGE__VERTEX:   hr = ID3D11Device_CreateVertexShader(d, bytecode, size, 0, (ID3D11VertexShader **)&shader); break;
+    case SHADER_STAGE__HULL:     hr = ID3D11Device_CreateHullShader(d, bytecode, size, 0, (ID3D11HullShader **)&shader); break;
+    case SHADER_STAGE__DOMAIN:   hr = ID3D11Device_CreateDomainShader(d, bytecode, size, 0, (ID3D11DomainShader **)&shader); break;
+    case SHADER_STAGE__GEOMETRY: hr = ID3D11Device_CreateGeometryShader(d, bytecode, size, 0, (ID3D11GeometryShader **)&shader); break;
+    case SHADER_STAGE__PIXEL:    hr = ID3D11Device_CreatePixelShader(d, bytecode, size, 0, (ID3D11PixelShader **)&shader); break;
+    case SHADER_STAGE__COMPUTE:  hr = ID3D11Device_CreateComputeShader(d, bytecode, size, 0, (ID3D11ComputeShader **)&shader); break;
+    default: break;
+    }
+
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Creating shader for stage %u failed: 0x%08x", stage, (uint32_t)hr);
+        return 0;
+    }
+    return shader;
+}
+
+static void
+device__release(struct d3d11_device_o *inst, void *object)
+{
+    if (object)
+        IUnknown_Release((IUnknown *)object);
+}
+
+static struct d3d11_swap_chain_i *
+device__create_swap_chain(struct d3d11_device_o *inst, const struct d3d11_swap_chain_desc_t *desc)
+{
+    IDXGIDevice *dxgi_device = 0;
+    IDXGIAdapter *adapter = 0;
+    IDXGIFactory2 *factory = 0;
+    HRESULT hr = ID3D11Device_QueryInterface(inst->device, &IID_IDXGIDevice, (void **)&dxgi_device);
+    if (SUCCEEDED(hr))
+        hr = IDXGIDevice_GetAdapter(dxgi_device, &adapter);
+    if (SUCCEEDED(hr))
+        hr = IDXGIAdapter_GetParent(adapter, &IID_IDXGIFactory2, (void **)&factory);
+
+    // Two buffers are enough with flip model, the frame latency limits how far the CPU gets ahead.
+    DXGI_SWAP_CHAIN_DESC1 scd = {
+        .Width       = desc->width,
+        .Height      = desc->height,
+        .Format      = (DXGI_FORMAT)desc->format,
+        .SampleDesc  = { .Count = 1 },
+        .BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT,
+        .BufferCount = 2,
+        .SwapEffect  = DXGI_SWAP_EFFECT_FLIP_DISCARD,
+        .Flags       = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT,
+    };
+
+    IDXGISwapChain1 *swap_chain1 = 0;
+    if (SUCCEEDED(hr))
+    {
+        hr = IDXGIFactory2_CreateSwapChainForHwnd(factory, (IUnknown *)inst->device, (HWND)desc->window, &scd, 0, 0,
+            &swap_chain1);
+
+        // FLIP_DISCARD needs Windows 10.
+        if (FAILED(hr))
+        {
+            scd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
+            hr = IDXGIFactory2_CreateSwapChainForHwnd(factory, (IUnknown *)inst->device, (HWND)desc->window, &scd, 0, 0,
+                &swap_chain1);
+        }
+    }
+
+    IDXGISwapChain2 *swap_chain = 0;
+    if (SUCCEEDED(hr))
+        hr = IDXGISwapChain1_QueryInterface(swap_chain1, &IID_IDXGISwapChain2, (void **)&swap_chain);
+
+    if (swap_chain1)
+        IDXGISwapChain1_Release(swap_chain1);
+    if (factory)
+        IDXGIFactory2_Release(factory);
+    if (adapter)
+        IDXGIAdapter_Release(adapter);
+    if (dxgi_device)
+        IDXGIDevice_Release(dxgi_device);
+
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Creating the swap chain failed: 0x%08x", (uint32_t)hr);
+        return 0;
+    }
+
+    struct d3d11_swap_chain_o *o = tm_alloc(inst->allocator, sizeof(*o));
+    memset(o, 0, sizeof(*o));
+    o->i = (struct d3d11_swap_chain_i) {
+        .inst                  = o,
+        .render_target_view    = swap_chain__render_target_view,
+        .resize                = swap_chain__resize,
+        .present               = swap_chain__present,
+        .wait_until_ready      = swap_chain__wait_until_ready,
+        .set_max_frame_latency = swap_chain__set_max_frame_latency,
+    };
+    o->device = inst;
+    o->swap_chain = swap_chain;
+    o->flags = scd.Flags;
+
+    swap_chain__set_max_frame_latency(o, desc->max_frame_latency);
+    o->waitable = IDXGISwapChain2_GetFrameLatencyWaitableObject(swap_chain);
+    create_back_buffer_view(o);
+    return &o->i;
+}
+
+static void
+device__destroy_swap_chain(struct d3d11_device_o *inst, struct d3d11_swap_chain_i *swap_chain)
+{
+    struct d3d11_swap_chain_o *o = swap_chain->inst;
+    if (o->rtv)
+        ID3D11RenderTargetView_Release(o->rtv);
+    CloseHandle(o->waitable);
+    IDXGISwapChain2_Release(o->swap_chain);
+    tm_free(inst->allocator, o, sizeof(*o));
+}
+
+static uint64_t
+device__video_memory_budget(struct d3d11_device_o *inst)
+{
+    DXGI_QUERY_VIDEO_MEMORY_INFO info;
+    if (!inst->adapter || FAILED(IDXGIAdapter3_QueryVideoMemoryInfo(inst->adapter, 0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info)))
+        return 0;
+    return info.Budget;
+}
+
+static void
+device__destroy(struct d3d11_device_o *inst)
+{
+    struct tm_allocator_i *a = inst->allocator;
+
+    if (inst->adapter)
+        IDXGIAdapter3_Release(inst->adapter);
+
+    if (inst->immediate.ctx1)
+        ID3D11DeviceContext1_Release(inst->immediate.ctx1);
+
+    if (inst->immediate.ctx)
+    {
+        ID3D11DeviceContext_ClearState(inst->immediate.ctx);
+        ID3D11DeviceContext_Release(inst->immediate.ctx);
+    }
+
+    if (inst->device)
+        ID3D11Device_Release(inst->device);
+
+    tm_free(a, inst, sizeof(*inst));
+}
+
+struct d3d11_device_i *
+d3d11_native_device__create(struct tm_allocator_i *allocator, void *dxgi_adapter)
+{
+    static const D3D_FEATURE_LEVEL feature_levels[] = {
+        D3D_FEATURE_LEVEL_11_1,
+        D3D_FEATURE_LEVEL_11_0,
+    };
+
+    UINT flags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
+#if defined(TM_CONFIGURATION_DEBUG)
+    flags |= D3D11_CREATE_DEVICE_DEBUG;
+#endif
+
+    ID3D11Device *device = 0;
+    ID3D11DeviceContext *ctx = 0;
+    D3D_FEATURE_LEVEL feature_level;
+
+    // An explicit adapter requires D3D_DRIVER_TYPE_UNKNOWN.
+    HRESULT hr = D3D11CreateDevice((IDXGIAdapter *)dxgi_adapter, D3D_DRIVER_TYPE_UNKNOWN, 0, flags, feature_levels,
+        TM_ARRAY_COUNT(feature_levels), D3D11_SDK_VERSION, &device, &feature_level, &ctx);
+
+    // The 11.1 runtime is missing on plain Windows 7, retry without it.
+    if (hr == E_INVALIDARG)
+    {
+        hr = D3D11CreateDevice((IDXGIAdapter *)dxgi_adapter, D3D_DRIVER_TYPE_UNKNOWN, 0, flags, feature_levels + 1,
+            TM_ARRAY_COUNT(feature_levels) - 1, D3D11_SDK_VERSION, &device, &feature_level, &ctx);
+    }
+
+    if (FAILED(hr))
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "D3D11CreateDevice failed: 0x%08x", (uint32_t)hr);
+        return 0;
+    }
+
+    D3D11_FEATURE_DATA_THREADING threading = { 0 };
+    hr = ID3D11Device_CheckFeatureSupport(device, D3D11_FEATURE_THREADING, &threading, sizeof(threading));
+
+    // Suballocated constant buffers are written through a dynamic buffer mapped without overwrite,
+    // which is an 11.1 option of its own.
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options = { 0 };
+    const bool have_options = SUCCEEDED(ID3D11Device_CheckFeatureSupport(device, D3D11_FEATURE_D3D11_OPTIONS, &options,
+        sizeof(options)));
+
+    struct d3d11_device_o *o = tm_alloc(allocator, sizeof(*o));
+    memset(o, 0, sizeof(*o));
+
+    o->i.inst                             = o;
+    o->i.immediate_context                = device__immediate_context;
+    o->i.supports_command_lists           = device__supports_command_lists;
+    o->i.supports_constant_buffer_offsets = device__supports_constant_buffer_offsets;
+    o->i.create_deferred_context          = device__create_deferred_context;
+    o->i.destroy_deferred_context         = device__destroy_deferred_context;
+    o->i.create_buffer                    = device__create_buffer;
+    o->i.create_texture                   = device__create_texture;
+    o->i.create_view                      = device__create_view;
+    o->i.create_sampler_state             = device__create_sampler_state;
+    o->i.create_rasterizer_state          = device__create_rasterizer_state;
+    o->i.create_depth_stencil_state       = device__create_depth_stencil_state;
+    o->i.create_blend_state               = device__create_blend_state;
+    o->i.create_query                     = device__create_query;
+    o->i.create_shader                    = device__create_shader;
+    o->i.release                          = device__release;
+    o->i.create_swap_chain                = device__create_swap_chain;
+    o->i.destroy_swap_chain               = device__destroy_swap_chain;
+    o->i.video_memory_budget              = device__video_memory_budget;
+    o->i.destroy                          = device__destroy;
+
+    o->allocator                          = allocator;
+    o->device                             = device;
+    if (FAILED(IDXGIAdapter_QueryInterface((IDXGIAdapter *)dxgi_adapter, &IID_IDXGIAdapter3, (void **)&o->adapter)))
+        o->adapter = 0;
+    o->feature_level                      = feature_level;
+    o->driver_command_lists               = SUCCEEDED(hr) && threading.DriverCommandLists;
+    o->immediate.ctx                      = ctx;
+    init_context_interface(&o->immediate_i, &o->immediate);
+    o->constant_buffer_offsets            = have_options && o->immediate.ctx1 && options.ConstantBufferOffsetting
+        && options.MapNoOverwriteOnDynamicConstantBuffer;
+
+    return &o->i;
+}
+
+#else
+
+struct d3d11_device_i *
+d3d11_native_device__create(struct tm_allocator_i *allocator, void *dxgi_adapter)
+{
+    tm_logger_api->print(TM_LOG_TYPE_ERROR, "D3D11 devices are only available on Windows");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,243 @@
+#include "d3d11_radix_sort.h"
+#include "d3d11_internal.h"
+
+#include <foundation/job_system.h>
+
+#include <string.h>
+
+#define NUM_DIGITS (8)
+#define NUM_BUCKETS (256)
+
+// Arrays are only split over jobs if every job gets at least this many pairs.
+#define MIN_PAIRS_PER_JOB (32 * 1024)
+
+// Bucket counts of a block of pairs, per digit.
+typedef uint32_t counts_t[NUM_DIGITS][NUM_BUCKETS];
+
+enum sort_op
+{
+    // Counts all digits of the block.
+    SORT_OP__COUNT_ALL = 0,
+
+    // Counts `digit` of the block.
+    SORT_OP__COUNT,
+
+    // Scatters the block to the offsets in `counts[digit]`.
+    SORT_OP__SCATTER,
+};
+
+struct sort_job_t
+{
+    const struct d3d11_sort_pair_t *src;
+    struct d3d11_sort_pair_t *dst;
+    uint32_t begin;
+    uint32_t end;
+    uint32_t op;
+    uint32_t digit;
+    counts_t *counts;
+};
+
+static inline uint32_t
+digit_of(uint64_t key, uint32_t digit)
+{
+    return (uint32_t)(key >> (digit * 8)) & (NUM_BUCKETS - 1);
+}
+
+static uint32_t
+num_jobs_for(uint32_t num_pairs, uint32_t max_jobs)
+{
+    return tm_max(tm_min(max_jobs, num_pairs / MIN_PAIRS_PER_JOB), 1);
+}
+
+// -------------------------------------------------------------------
+// Passes
+
+// Counts every digit in a single read of the keys.
+static void
+count_all(const struct d3d11_sort_pair_t *pairs, uint32_t n, counts_t counts)
+{
+    memset(counts, 0, sizeof(counts_t));
+    for (const struct d3d11_sort_pair_t *p = pairs, *end = pairs + n; p != end; ++p)
+    {
+        const uint64_t key = p->key;
+        ++counts[0][digit_of(key, 0)];
+        ++counts[1][digit_of(key, 1)];
+        ++counts[2][digit_of(key, 2)];
+        ++counts[3][digit_of(key, 3)];
+        ++counts[4][digit_of(key, 4)];
+        ++counts[5][digit_of(key, 5)];
+        ++counts[6][digit_of(key, 6)];
+        ++counts[7][digit_of(key, 7)];
+    }
+}
+
+static void
+count(const struct d3d11_sort_pair_t *pairs, uint32_t n, uint32_t digit, uint32_t counts[NUM_BUCKETS])
+{
+    memset(counts, 0, NUM_BUCKETS * sizeof(uint32_t));
+    for (const struct d3d11_sort_pair_t *p = pairs, *end = pairs + n; p != end; ++p)
+        ++counts[digit_of(p->key, digit)];
+}
+
+static void
+scatter(const struct d3d11_sort_pair_t *src, struct d3d11_sort_pair_t *dst, uint32_t n, uint32_t digit,
+    uint32_t offsets[NUM_BUCKETS])
+{
+    for (const struct d3d11_sort_pair_t *p = src, *end = src + n; p != end; ++p)
+        dst[offsets[digit_of(p->key, digit)]++] = *p;
+}
+
+static void
+sort_job(void *data)
+{
+    struct sort_job_t *j = data;
+    const struct d3d11_sort_pair_t *src = j->src + j->begin;
+    const uint32_t n = j->end - j->begin;
+
+    switch (j->op)
+    {
+    case SORT_OP__COUNT_ALL:
+        count_all(src, n, *j->counts);
+        break;
+    case SORT_OP__COUNT:
+        count(src, n, j->digit, (*j->counts)[j->digit]);
+        break;
+    case SORT_OP__SCATTER:
+        scatter(src, j->dst, n, j->digit, (*j->counts)[j->digit]);
+        break;
+    default:
+        break;
+    }
+}
+
+// -------------------------------------------------------------------
+// Sorts
+
+static struct d3d11_sort_pair_t *
+sort_single_job(struct d3d11_sort_pair_t *pairs, struct d3d11_sort_pair_t *scratch, uint32_t n, counts_t counts)
+{
+    count_all(pairs, n, counts);
+
+    struct d3d11_sort_pair_t *src = pairs, *dst = scratch;
+    for (uint32_t digit = 0; digit != NUM_DIGITS; ++digit)
+    {
+        uint32_t *offsets = counts[digit];
+        if (offsets[digit_of(src->key, digit)] == n)
+            continue;
+
+        for (uint32_t b = 0, sum = 0; b != NUM_BUCKETS; ++b)
+        {
+            const uint32_t c = offsets[b];
+            offsets[b] = sum;
+            sum += c;
+        }
+
+        scatter(src, dst, n, digit, offsets);
+        struct d3d11_sort_pair_t *t = src;
+        src = dst;
+        dst = t;
+    }
+    return src;
+}
+
+static void
+run_wave(struct sort_job_t *jobs, tm_jobdecl_t *decls, uint32_t num_jobs, enum sort_op op, uint32_t digit,
+    const struct d3d11_sort_pair_t *src, struct d3d11_sort_pair_t *dst)
+{
+    for (uint32_t i = 0; i != num_jobs; ++i)
+    {
+        jobs[i].src = src;
+        jobs[i].dst = dst;
+        jobs[i].op = op;
+        jobs[i].digit = digit;
+        decls[i] = (tm_jobdecl_t) { .task = sort_job, .data = jobs + i };
+    }
+
+    tm_atomic_counter_o *counter = tm_job_system_api->run_jobs(decls, num_jobs);
+    tm_job_system_api->wait_for_counter_and_free(counter);
+}
+
+// Every job counts and scatters its own block. Offsets are assigned bucket by bucket and within a
+// bucket block by block, so equal keys keep their order.
+static struct d3d11_sort_pair_t *
+sort_on_jobs(struct d3d11_sort_pair_t *pairs, struct d3d11_sort_pair_t *scratch, uint32_t n, counts_t *counts,
+    struct sort_job_t *jobs, tm_jobdecl_t *decls, uint32_t num_jobs)
+{
+    for (uint32_t i = 0; i != num_jobs; ++i)
+    {
+        jobs[i] = (struct sort_job_t) {
+            .begin  = (uint32_t)((uint64_t)n * i / num_jobs),
+            .end    = (uint32_t)((uint64_t)n * (i + 1) / num_jobs),
+            .counts = counts + i,
+        };
+    }
+    run_wave(jobs, decls, num_jobs, SORT_OP__COUNT_ALL, 0, pairs, 0);
+
+    struct d3d11_sort_pair_t *src = pairs, *dst = scratch;
+    bool counted = true;
+    for (uint32_t digit = 0; digit != NUM_DIGITS; ++digit)
+    {
+        // The totals don't depend on the order, so the first counts tell which digits to skip.
+        const uint32_t first = digit_of(src->key, digit);
+        uint32_t total = 0;
+        for (uint32_t i = 0; i != num_jobs; ++i)
+            total += counts[i][digit][first];
+        if (total == n)
+            continue;
+
+        // After a scatter the blocks hold other pairs, so they must be counted again.
+        if (!counted)
+            run_wave(jobs, decls, num_jobs, SORT_OP__COUNT, digit, src, 0);
+        counted = false;
+
+        for (uint32_t b = 0, sum = 0; b != NUM_BUCKETS; ++b)
+        {
+            for (uint32_t i = 0; i != num_jobs; ++i)
+            {
+                const uint32_t c = counts[i][digit][b];
+                counts[i][digit][b] = sum;
+                sum += c;
+            }
+        }
+
+        run_wave(jobs, decls, num_jobs, SORT_OP__SCATTER, digit, src, dst);
+        struct d3d11_sort_pair_t *t = src;
+        src = dst;
+        dst = t;
+    }
+    return src;
+}
+
+// -------------------------------------------------------------------
+// Public
+
+uint64_t
+d3d11_radix_sort__memory_needed(uint32_t num_pairs, uint32_t max_jobs)
+{
+    const uint32_t num_jobs = num_jobs_for(num_pairs, max_jobs);
+    return num_pairs * sizeof(struct d3d11_sort_pair_t)
+        + num_jobs * (sizeof(counts_t) + sizeof(struct sort_job_t) + sizeof(tm_jobdecl_t));
+}
+
+struct d3d11_sort_pair_t *
+d3d11_radix_sort__sort(struct d3d11_sort_pair_t *pairs, uint32_t num_pairs, void *memory, uint32_t max_jobs)
+{
+    if (num_pairs < 2)
+        return pairs;
+
+    const uint32_t num_jobs = num_jobs_for(num_pairs, max_jobs);
+
+    uint8_t *p = memory;
+    struct d3d11_sort_pair_t *scratch = (struct d3d11_sort_pair_t *)p;
+    p += num_pairs * sizeof(struct d3d11_sort_pair_t);
+    counts_t *counts = (counts_t *)p;
+    p += num_jobs * sizeof(counts_t);
+
+    if (num_jobs == 1)
+        return sort_single_job(pairs, scratch, num_pairs, *counts);
+
+    struct sort_job_t *jobs = (struct sort_job_t *)p;
+    p += num_jobs * sizeof(struct sort_job_t);
+    tm_jobdecl_t *decls = (tm_jobdecl_t *)p;
+    return sort_on_jobs(pairs, scratch, num_pairs, counts, jobs, decls, num_jobs);
+}
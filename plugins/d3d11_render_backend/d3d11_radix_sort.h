@@ -0,0 +1,27 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+// Stable LSD radix sort of (sort key, command) pairs, eight bits per pass.
+//
+// All memory, including the job declarations, comes from a caller provided scratch buffer, so
+// sorting doesn't allocate. Passes over a byte that is the same in every key are skipped, which
+// for typical sort keys (a few bits of layer and depth, the rest zero) removes most of them. Large
+// arrays are split into blocks that are counted and scattered on the job system.
+
+struct tm_renderer_command_t;
+
+struct d3d11_sort_pair_t
+{
+    uint64_t key;
+    const struct tm_renderer_command_t *command;
+};
+
+// Returns the scratch memory needed to sort `num_pairs` pairs on at most `max_jobs` jobs.
+uint64_t d3d11_radix_sort__memory_needed(uint32_t num_pairs, uint32_t max_jobs);
+
+// Sorts `pairs` on their keys, keeping the order of pairs with equal keys. `memory` must hold
+// `d3d11_radix_sort__memory_needed()` bytes, aligned to 16 bytes. Returns the sorted pairs, which
+// are either `pairs` or in `memory`. If more than one job is used, this must be called from a job.
+struct d3d11_sort_pair_t *d3d11_radix_sort__sort(struct d3d11_sort_pair_t *pairs, uint32_t num_pairs, void *memory,
+    uint32_t max_jobs);
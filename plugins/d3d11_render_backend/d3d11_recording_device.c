@@ -0,0 +1,672 @@
+#include "d3d11_recording_device.h"
+
+#include "d3d11_device.h"
+#include "d3d11_internal.h"
+
+#include <foundation/allocator.h>
+#include <foundation/atomics.inl>
+#include <foundation/carray.inl>
+#include <foundation/os.h>
+
+#include <string.h>
+
+// CPU accessible buffers are backed by real memory so they can be mapped.
+struct mappable_t
+{
+    void *object;
+    uint8_t *memory;
+    uint64_t size;
+};
+
+struct d3d11_context_o
+{
+    struct d3d11_recording_statistics_t stats;
+    struct d3d11_device_o *device;
+};
+
+struct d3d11_device_o
+{
+    struct d3d11_device_i i;
+
+    struct tm_allocator_i *allocator;
+
+    // Objects handed out are fake, unique, non-NULL pointers that must never be dereferenced.
+    // Objects are created and released from any thread, like on a real device.
+    atomic_uint64_t next_object;
+    atomic_uint64_t num_live_objects;
+
+    // Protects `mappables`.
+    tm_critical_section_o mappables_lock;
+    /* carray */ struct mappable_t *mappables;
+
+    struct d3d11_context_o immediate;
+    struct d3d11_context_i immediate_i;
+};
+
+struct d3d11_swap_chain_o
+{
+    struct d3d11_swap_chain_i i;
+
+    struct d3d11_device_o *device;
+    void *rtv;
+
+    uint32_t max_frame_latency;
+
+    // Frames presented but not shown yet.
+    uint32_t queued_frames;
+};
+
+static const char *call_names[] = {
+    [RECORDED_CALL__OM_SET_RENDER_TARGETS]           = "OMSetRenderTargets",
+    [RECORDED_CALL__OM_SET_BLEND_STATE]              = "OMSetBlendState",
+    [RECORDED_CALL__OM_SET_DEPTH_STENCIL_STATE]      = "OMSetDepthStencilState",
+    [RECORDED_CALL__CLEAR_RENDER_TARGET_VIEW]        = "ClearRenderTargetView",
+    [RECORDED_CALL__CLEAR_DEPTH_STENCIL_VIEW]        = "ClearDepthStencilView",
+    [RECORDED_CALL__RS_SET_STATE]                    = "RSSetState",
+    [RECORDED_CALL__RS_SET_VIEWPORTS]                = "RSSetViewports",
+    [RECORDED_CALL__RS_SET_SCISSOR_RECTS]            = "RSSetScissorRects",
+    [RECORDED_CALL__IA_SET_INPUT_LAYOUT]             = "IASetInputLayout",
+    [RECORDED_CALL__IA_SET_PRIMITIVE_TOPOLOGY]       = "IASetPrimitiveTopology",
+    [RECORDED_CALL__IA_SET_VERTEX_BUFFERS]           = "IASetVertexBuffers",
+    [RECORDED_CALL__IA_SET_INDEX_BUFFER]             = "IASetIndexBuffer",
+    [RECORDED_CALL__SET_SHADER]                      = "xSSetShader",
+    [RECORDED_CALL__SET_CONSTANT_BUFFERS]            = "xSSetConstantBuffers",
+    [RECORDED_CALL__SET_CONSTANT_BUFFERS1]           = "xSSetConstantBuffers1",
+    [RECORDED_CALL__SET_SHADER_RESOURCES]            = "xSSetShaderResources",
+    [RECORDED_CALL__SET_SAMPLERS]                    = "xSSetSamplers",
+    [RECORDED_CALL__CS_SET_UNORDERED_ACCESS_VIEWS]   = "CSSetUnorderedAccessViews",
+    [RECORDED_CALL__DRAW_INSTANCED]                  = "DrawInstanced",
+    [RECORDED_CALL__DRAW_INDEXED_INSTANCED]          = "DrawIndexedInstanced",
+    [RECORDED_CALL__DISPATCH]                        = "Dispatch",
+    [RECORDED_CALL__DRAW_INSTANCED_INDIRECT]         = "DrawInstancedIndirect",
+    [RECORDED_CALL__DRAW_INDEXED_INSTANCED_INDIRECT] = "DrawIndexedInstancedIndirect",
+    [RECORDED_CALL__DISPATCH_INDIRECT]               = "DispatchIndirect",
+    [RECORDED_CALL__COPY_BUFFER_REGION]              = "CopySubresourceRegion",
+    [RECORDED_CALL__COPY_SUBRESOURCE]                = "CopySubresourceRegion",
+    [RECORDED_CALL__UPDATE_SUBRESOURCE]              = "UpdateSubresource",
+    [RECORDED_CALL__SET_RESOURCE_MIN_LOD]            = "SetResourceMinLOD",
+    [RECORDED_CALL__MAP]                             = "Map",
+    [RECORDED_CALL__UNMAP]                           = "Unmap",
+    [RECORDED_CALL__BEGIN_QUERY]                     = "Begin",
+    [RECORDED_CALL__END_QUERY]                       = "End",
+    [RECORDED_CALL__GET_QUERY_DATA]                  = "GetData",
+    [RECORDED_CALL__PRESENT]                         = "Present",
+    [RECORDED_CALL__RESIZE_BUFFERS]                  = "ResizeBuffers",
+    [RECORDED_CALL__WAIT_FOR_FRAME_LATENCY]          = "WaitForSingleObjectEx",
+};
+
+static inline void
+record(struct d3d11_context_o *inst, enum d3d11_recorded_call call)
+{
+    ++inst->stats.calls[call];
+    ++inst->stats.num_calls;
+}
+
+// -------------------------------------------------------------------
+// Context
+
+static void
+context__om_set_render_targets(struct d3d11_context_o *inst, uint32_t num_views, void *const *rtvs, void *dsv)
+{
+    record(inst, RECORDED_CALL__OM_SET_RENDER_TARGETS);
+}
+
+static void
+context__om_set_blend_state(struct d3d11_context_o *inst, void *state, const float blend_factor[4], uint32_t sample_mask)
+{
+    record(inst, RECORDED_CALL__OM_SET_BLEND_STATE);
+}
+
+static void
+context__om_set_depth_stencil_state(struct d3d11_context_o *inst, void *state, uint32_t stencil_ref)
+{
+    record(inst, RECORDED_CALL__OM_SET_DEPTH_STENCIL_STATE);
+}
+
+static void
+context__clear_render_target_view(struct d3d11_context_o *inst, void *rtv, const float color[4])
+{
+    record(inst, RECORDED_CALL__CLEAR_RENDER_TARGET_VIEW);
+}
+
+static void
+context__clear_depth_stencil_view(struct d3d11_context_o *inst, void *dsv, uint32_t clear_flags, float depth, uint8_t stencil)
+{
+    record(inst, RECORDED_CALL__CLEAR_DEPTH_STENCIL_VIEW);
+}
+
+static void
+context__rs_set_state(struct d3d11_context_o *inst, void *state)
+{
+    record(inst, RECORDED_CALL__RS_SET_STATE);
+}
+
+static void
+context__rs_set_viewports(struct d3d11_context_o *inst, uint32_t num_viewports, const struct d3d11_viewport_t *viewports)
+{
+    record(inst, RECORDED_CALL__RS_SET_VIEWPORTS);
+}
+
+static void
+context__rs_set_scissor_rects(struct d3d11_context_o *inst, uint32_t num_rects, const struct d3d11_rect_t *rects)
+{
+    record(inst, RECORDED_CALL__RS_SET_SCISSOR_RECTS);
+}
+
+static void
+context__ia_set_input_layout(struct d3d11_context_o *inst, void *layout)
+{
+    record(inst, RECORDED_CALL__IA_SET_INPUT_LAYOUT);
+}
+
+static void
+context__ia_set_primitive_topology(struct d3d11_context_o *inst, uint32_t topology)
+{
+    record(inst, RECORDED_CALL__IA_SET_PRIMITIVE_TOPOLOGY);
+}
+
+static void
+context__ia_set_vertex_buffers(struct d3d11_context_o *inst, uint32_t start_slot, uint32_t num_buffers,
+    void *const *buffers, const uint32_t *strides, const uint32_t *offsets)
+{
+    record(inst, RECORDED_CALL__IA_SET_VERTEX_BUFFERS);
+}
+
+static void
+context__ia_set_index_buffer(struct d3d11_context_o *inst, void *buffer, uint32_t format, uint32_t offset)
+{
+    record(inst, RECORDED_CALL__IA_SET_INDEX_BUFFER);
+}
+
+static void
+context__set_shader(struct d3d11_context_o *inst, uint32_t stage, void *shader)
+{
+    record(inst, RECORDED_CALL__SET_SHADER);
+}
+
+static void
+context__set_constant_buffers(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_buffers, void *const *buffers)
+{
+    record(inst, RECORDED_CALL__SET_CONSTANT_BUFFERS);
+}
+
+static void
+context__set_constant_buffers1(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_buffers, void *const *buffers, const uint32_t *first_constants, const uint32_t *num_constants)
+{
+    record(inst, RECORDED_CALL__SET_CONSTANT_BUFFERS1);
+}
+
+static void
+context__set_shader_resources(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_views, void *const *views)
+{
+    record(inst, RECORDED_CALL__SET_SHADER_RESOURCES);
+}
+
+static void
+context__set_samplers(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_samplers, void *const *samplers)
+{
+    record(inst, RECORDED_CALL__SET_SAMPLERS);
+}
+
+static void
+context__cs_set_unordered_access_views(struct d3d11_context_o *inst, uint32_t start_slot, uint32_t num_views,
+    void *const *uavs)
+{
+    record(inst, RECORDED_CALL__CS_SET_UNORDERED_ACCESS_VIEWS);
+}
+
+static void
+context__draw_instanced(struct d3d11_context_o *inst, uint32_t vertex_count_per_instance, uint32_t instance_count,
+    uint32_t start_vertex, uint32_t start_instance)
+{
+    record(inst, RECORDED_CALL__DRAW_INSTANCED);
+    ++inst->stats.num_draws;
+    inst->stats.num_instances += instance_count;
+}
+
+static void
+context__draw_indexed_instanced(struct d3d11_context_o *inst, uint32_t index_count_per_instance,
+    uint32_t instance_count, uint32_t start_index, int32_t base_vertex, uint32_t start_instance)
+{
+    record(inst, RECORDED_CALL__DRAW_INDEXED_INSTANCED);
+    ++inst->stats.num_draws;
+    inst->stats.num_instances += instance_count;
+}
+
+static void
+context__dispatch(struct d3d11_context_o *inst, uint32_t x, uint32_t y, uint32_t z)
+{
+    record(inst, RECORDED_CALL__DISPATCH);
+}
+
+// The arguments live on the GPU, so indirect draws count as draws of unknown instances.
+static void
+context__draw_instanced_indirect(struct d3d11_context_o *inst, void *args_buffer, uint32_t offset)
+{
+    record(inst, RECORDED_CALL__DRAW_INSTANCED_INDIRECT);
+    ++inst->stats.num_draws;
+}
+
+static void
+context__draw_indexed_instanced_indirect(struct d3d11_context_o *inst, void *args_buffer, uint32_t offset)
+{
+    record(inst, RECORDED_CALL__DRAW_INDEXED_INSTANCED_INDIRECT);
+    ++inst->stats.num_draws;
+}
+
+static void
+context__dispatch_indirect(struct d3d11_context_o *inst, void *args_buffer, uint32_t offset)
+{
+    record(inst, RECORDED_CALL__DISPATCH_INDIRECT);
+}
+
+static void
+context__copy_buffer_region(struct d3d11_context_o *inst, void *dst, uint32_t dst_offset, void *src,
+    uint32_t src_offset, uint32_t size)
+{
+    record(inst, RECORDED_CALL__COPY_BUFFER_REGION);
+}
+
+static void
+context__copy_subresource(struct d3d11_context_o *inst, void *dst, uint32_t dst_subresource, void *src,
+    uint32_t src_subresource)
+{
+    record(inst, RECORDED_CALL__COPY_SUBRESOURCE);
+}
+
+static void
+context__update_subresource(struct d3d11_context_o *inst, void *resource, uint32_t subresource,
+    const struct d3d11_box_t *box, const void *data, uint32_t row_pitch, uint32_t depth_pitch)
+{
+    record(inst, RECORDED_CALL__UPDATE_SUBRESOURCE);
+}
+
+static void
+context__set_resource_min_lod(struct d3d11_context_o *inst, void *resource, float min_lod)
+{
+    record(inst, RECORDED_CALL__SET_RESOURCE_MIN_LOD);
+}
+
+static struct mappable_t *
+find_mappable(struct d3d11_device_o *device, void *object)
+{
+    for (struct mappable_t *m = device->mappables; m != tm_carray_end(device->mappables); ++m)
+    {
+        if (m->object == object)
+            return m;
+    }
+    return 0;
+}
+
+static void *
+context__map(struct d3d11_context_o *inst, void *resource, uint32_t subresource, uint32_t map_type)
+{
+    record(inst, RECORDED_CALL__MAP);
+    tm_os_api->thread->enter_critical_section(&inst->device->mappables_lock);
+    const struct mappable_t *m = find_mappable(inst->device, resource);
+    void *memory = m ? m->memory : 0;
+    tm_os_api->thread->leave_critical_section(&inst->device->mappables_lock);
+    return memory;
+}
+
+static void
+context__unmap(struct d3d11_context_o *inst, void *resource, uint32_t subresource)
+{
+    record(inst, RECORDED_CALL__UNMAP);
+}
+
+static void
+context__begin_query(struct d3d11_context_o *inst, void *query)
+{
+    record(inst, RECORDED_CALL__BEGIN_QUERY);
+}
+
+static void
+context__end_query(struct d3d11_context_o *inst, void *query)
+{
+    record(inst, RECORDED_CALL__END_QUERY);
+}
+
+// There is no GPU, so every query is complete as soon as it has been issued and reads as zero,
+// except for events which read as signaled.
+static bool
+context__get_query_data(struct d3d11_context_o *inst, void *query, void *data, uint32_t size, bool flush)
+{
+    record(inst, RECORDED_CALL__GET_QUERY_DATA);
+    if (data)
+    {
+        memset(data, 0, size);
+        if (size == sizeof(uint32_t))
+            *(uint32_t *)data = 1;
+    }
+    return true;
+}
+
+// The recording device has no deferred contexts, so there are no command lists either.
+static void *
+context__finish_command_list(struct d3d11_context_o *inst)
+{
+    return 0;
+}
+
+static void
+context__execute_command_list(struct d3d11_context_o *inst, void *command_list)
+{
+}
+
+static void
+init_context_interface(struct d3d11_context_i *i, struct d3d11_context_o *inst)
+{
+    *i = (struct d3d11_context_i) {
+        .inst                            = inst,
+        .om_set_render_targets           = context__om_set_render_targets,
+        .om_set_blend_state              = context__om_set_blend_state,
+        .om_set_depth_stencil_state      = context__om_set_depth_stencil_state,
+        .clear_render_target_view        = context__clear_render_target_view,
+        .clear_depth_stencil_view        = context__clear_depth_stencil_view,
+        .rs_set_state                    = context__rs_set_state,
+        .rs_set_viewports                = context__rs_set_viewports,
+        .rs_set_scissor_rects            = context__rs_set_scissor_rects,
+        .ia_set_input_layout             = context__ia_set_input_layout,
+        .ia_set_primitive_topology       = context__ia_set_primitive_topology,
+        .ia_set_vertex_buffers           = context__ia_set_vertex_buffers,
+        .ia_set_index_buffer             = context__ia_set_index_buffer,
+        .set_shader                      = context__set_shader,
+        .set_constant_buffers            = context__set_constant_buffers,
+        .set_constant_buffers1           = context__set_constant_buffers1,
+        .set_shader_resources            = context__set_shader_resources,
+        .set_samplers                    = context__set_samplers,
+        .cs_set_unordered_access_views   = context__cs_set_unordered_access_views,
+        .draw_instanced                  = context__draw_instanced,
+        .draw_indexed_instanced          = context__draw_indexed_instanced,
+        .dispatch                        = context__dispatch,
+        .draw_instanced_indirect         = context__draw_instanced_indirect,
+        .draw_indexed_instanced_indirect = context__draw_indexed_instanced_indirect,
+        .dispatch_indirect               = context__dispatch_indirect,
+        .copy_buffer_region              = context__copy_buffer_region,
+        .copy_subresource                = context__copy_subresource,
+        .update_subresource              = context__update_subresource,
+        .set_resource_min_lod            = context__set_resource_min_lod,
+        .map                             = context__map,
+        .unmap                           = context__unmap,
+        .begin_query                     = context__begin_query,
+        .end_query                       = context__end_query,
+        .get_query_data                  = context__get_query_data,
+        .finish_command_list             = context__finish_command_list,
+        .execute_command_list            = context__execute_command_list,
+    };
+}
+
+// -------------------------------------------------------------------
+// Device
+
+static struct d3d11_context_i *
+device__immediate_context(struct d3d11_device_o *inst)
+{
+    return &inst->immediate_i;
+}
+
+// Translation into deferred contexts falls back to the backend's emulated command lists, which
+// replay onto the immediate context, so all calls are still counted there.
+static bool
+device__supports_command_lists(struct d3d11_device_o *inst)
+{
+    return false;
+}
+
+// Mapped buffers are plain memory, so constant buffers can be suballocated like on an 11.1 device.
+static bool
+device__supports_constant_buffer_offsets(struct d3d11_device_o *inst)
+{
+    return true;
+}
+
+static struct d3d11_context_i *
+device__create_deferred_context(struct d3d11_device_o *inst)
+{
+    return 0;
+}
+
+static void
+device__destroy_deferred_context(struct d3d11_device_o *inst, struct d3d11_context_i *context)
+{
+}
+
+static void *
+new_object(struct d3d11_device_o *inst)
+{
+    atomic_fetch_add_uint64_t(&inst->num_live_objects, 1);
+    return (void *)(uintptr_t)((atomic_fetch_add_uint64_t(&inst->next_object, 1) + 1) * 16);
+}
+
+static void *
+device__create_buffer(struct d3d11_device_o *inst, const struct d3d11_buffer_desc_t *desc, const void *initial_data)
+{
+    if (!desc->size)
+        return 0;
+
+    void *buffer = new_object(inst);
+    if (desc->cpu_access_flags)
+    {
+        const struct mappable_t m = { buffer, tm_alloc(inst->allocator, desc->size), desc->size };
+        if (initial_data)
+            memcpy(m.memory, initial_data, desc->size);
+        tm_os_api->thread->enter_critical_section(&inst->mappables_lock);
+        tm_carray_push(inst->mappables, m, inst->allocator);
+        tm_os_api->thread->leave_critical_section(&inst->mappables_lock);
+    }
+    return buffer;
+}
+
+static void *
+device__create_texture(struct d3d11_device_o *inst, const struct d3d11_texture_desc_t *desc,
+    const struct d3d11_subresource_data_t *initial_data)
+{
+    return desc->width && desc->mip_levels ? new_object(inst) : 0;
+}
+
+static void *
+device__create_view(struct d3d11_device_o *inst, void *resource, enum d3d11_view view)
+{
+    return resource ? new_object(inst) : 0;
+}
+
+static void *
+device__create_sampler_state(struct d3d11_device_o *inst, const struct d3d11_sampler_desc_t *desc)
+{
+    return new_object(inst);
+}
+
+static void *
+device__create_rasterizer_state(struct d3d11_device_o *inst, const struct d3d11_rasterizer_desc_t *desc)
+{
+    return new_object(inst);
+}
+
+static void *
+device__create_depth_stencil_state(struct d3d11_device_o *inst, const struct d3d11_depth_stencil_desc_t *desc)
+{
+    return new_object(inst);
+}
+
+static void *
+device__create_blend_state(struct d3d11_device_o *inst, const struct d3d11_blend_desc_t *desc)
+{
+    return new_object(inst);
+}
+
+static void *
+device__create_query(struct d3d11_device_o *inst, uint32_t type)
+{
+    return new_object(inst);
+}
+
+static void *
+device__create_shader(struct d3d11_device_o *inst, uint32_t stage, const void *bytecode, uint64_t size)
+{
+    return bytecode && size ? new_object(inst) : 0;
+}
+
+static void *
+swap_chain__render_target_view(struct d3d11_swap_chain_o *inst)
+{
+    return inst->rtv;
+}
+
+static bool
+swap_chain__resize(struct d3d11_swap_chain_o *inst, uint32_t width, uint32_t height)
+{
+    record(&inst->device->immediate, RECORDED_CALL__RESIZE_BUFFERS);
+    atomic_fetch_sub_uint64_t(&inst->device->num_live_objects, 1);
+    inst->rtv = new_object(inst->device);
+    return width && height;
+}
+
+// Presenting more frames than the latency allows blocks in DXGI until one is shown.
+static void
+swap_chain__present(struct d3d11_swap_chain_o *inst, uint32_t sync_interval)
+{
+    record(&inst->device->immediate, RECORDED_CALL__PRESENT);
+    inst->queued_frames = tm_min(inst->queued_frames + 1, inst->max_frame_latency);
+}
+
+static bool
+swap_chain__wait_until_ready(struct d3d11_swap_chain_o *inst, uint32_t timeout_ms)
+{
+    record(&inst->device->immediate, RECORDED_CALL__WAIT_FOR_FRAME_LATENCY);
+    if (inst->queued_frames < inst->max_frame_latency)
+        return true;
+    if (!timeout_ms)
+        return false;
+    --inst->queued_frames;
+    return true;
+}
+
+static void
+swap_chain__set_max_frame_latency(struct d3d11_swap_chain_o *inst, uint32_t max_frame_latency)
+{
+    inst->max_frame_latency = tm_min(tm_max(max_frame_latency, 1), 16);
+}
+
+static struct d3d11_swap_chain_i *
+device__create_swap_chain(struct d3d11_device_o *inst, const struct d3d11_swap_chain_desc_t *desc)
+{
+    if (!desc->width || !desc->height)
+        return 0;
+
+    struct d3d11_swap_chain_o *o = tm_alloc(inst->allocator, sizeof(*o));
+    *o = (struct d3d11_swap_chain_o) {
+        .i = {
+            .inst                  = o,
+            .render_target_view    = swap_chain__render_target_view,
+            .resize                = swap_chain__resize,
+            .present               = swap_chain__present,
+            .wait_until_ready      = swap_chain__wait_until_ready,
+            .set_max_frame_latency = swap_chain__set_max_frame_latency,
+        },
+        .device = inst,
+        .rtv    = new_object(inst),
+    };
+    swap_chain__set_max_frame_latency(o, desc->max_frame_latency);
+    return &o->i;
+}
+
+static void
+device__destroy_swap_chain(struct d3d11_device_o *inst, struct d3d11_swap_chain_i *swap_chain)
+{
+    atomic_fetch_sub_uint64_t(&inst->num_live_objects, 1);
+    tm_free(inst->allocator, swap_chain->inst, sizeof(*swap_chain->inst));
+}
+
+static void
+device__release(struct d3d11_device_o *inst, void *object)
+{
+    if (!object)
+        return;
+
+    atomic_fetch_sub_uint64_t(&inst->num_live_objects, 1);
+
+    tm_os_api->thread->enter_critical_section(&inst->mappables_lock);
+    struct mappable_t *m = find_mappable(inst, object);
+    if (m)
+    {
+        tm_free(inst->allocator, m->memory, m->size);
+        *m = tm_carray_pop(inst->mappables);
+    }
+    tm_os_api->thread->leave_critical_section(&inst->mappables_lock);
+}
+
+static uint64_t
+device__video_memory_budget(struct d3d11_device_o *inst)
+{
+    return 0;
+}
+
+static void
+device__destroy(struct d3d11_device_o *inst)
+{
+    for (struct mappable_t *m = inst->mappables; m != tm_carray_end(inst->mappables); ++m)
+        tm_free(inst->allocator, m->memory, m->size);
+    tm_carray_free(inst->mappables, inst->allocator);
+    tm_os_api->thread->destroy_critical_section(&inst->mappables_lock);
+
+    tm_free(inst->allocator, inst, sizeof(*inst));
+}
+
+struct d3d11_device_i *
+d3d11_recording_device__create(struct tm_allocator_i *allocator)
+{
+    struct d3d11_device_o *o = tm_alloc(allocator, sizeof(*o));
+    memset(o, 0, sizeof(*o));
+
+    o->i.inst                             = o;
+    o->i.immediate_context                = device__immediate_context;
+    o->i.supports_command_lists           = device__supports_command_lists;
+    o->i.supports_constant_buffer_offsets = device__supports_constant_buffer_offsets;
+    o->i.create_deferred_context          = device__create_deferred_context;
+    o->i.destroy_deferred_context         = device__destroy_deferred_context;
+    o->i.create_buffer                    = device__create_buffer;
+    o->i.create_texture                   = device__create_texture;
+    o->i.create_view                      = device__create_view;
+    o->i.create_sampler_state             = device__create_sampler_state;
+    o->i.create_rasterizer_state          = device__create_rasterizer_state;
+    o->i.create_depth_stencil_state       = device__create_depth_stencil_state;
+    o->i.create_blend_state               = device__create_blend_state;
+    o->i.create_query                     = device__create_query;
+    o->i.create_shader                    = device__create_shader;
+    o->i.release                          = device__release;
+    o->i.create_swap_chain                = device__create_swap_chain;
+    o->i.destroy_swap_chain               = device__destroy_swap_chain;
+    o->i.video_memory_budget              = device__video_memory_budget;
+    o->i.destroy                          = device__destroy;
+
+    o->allocator                    = allocator;
+    o->immediate.device             = o;
+    init_context_interface(&o->immediate_i, &o->immediate);
+    tm_os_api->thread->create_critical_section(&o->mappables_lock);
+
+    return &o->i;
+}
+
+const char *
+d3d11_recording_device__call_name(enum d3d11_recorded_call call)
+{
+    return call < RECORDED_CALL__COUNT ? call_names[call] : "Unknown";
+}
+
+void
+d3d11_recording_device__statistics(const struct d3d11_device_i *device, struct d3d11_recording_statistics_t *stats)
+{
+    *stats = device->inst->immediate.stats;
+    stats->num_live_objects = atomic_load_uint64_t(&device->inst->num_live_objects);
+}
+
+void
+d3d11_recording_device__reset_statistics(struct d3d11_device_i *device)
+{
+    memset(&device->inst->immediate.stats, 0, sizeof(device->inst->immediate.stats));
+}
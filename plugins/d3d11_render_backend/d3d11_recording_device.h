@@ -0,0 +1,84 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+// Stand-in D3D11 device that records the calls made on it instead of talking to a driver. It
+// implements the same `d3d11_device_i` and `d3d11_context_i` tables as the native device, so
+// the full translation path can run (and be timed) on machines without a GPU or without D3D11.
+//
+// Swap chains are mocks without a display. Presented frames stay queued until a blocking
+// `wait_until_ready()` shows one, so frame latency handling can be tested as well. Swap chain calls
+// are recorded with the calls of the immediate context.
+
+enum d3d11_recorded_call
+{
+    RECORDED_CALL__OM_SET_RENDER_TARGETS = 0,
+    RECORDED_CALL__OM_SET_BLEND_STATE,
+    RECORDED_CALL__OM_SET_DEPTH_STENCIL_STATE,
+    RECORDED_CALL__CLEAR_RENDER_TARGET_VIEW,
+    RECORDED_CALL__CLEAR_DEPTH_STENCIL_VIEW,
+    RECORDED_CALL__RS_SET_STATE,
+    RECORDED_CALL__RS_SET_VIEWPORTS,
+    RECORDED_CALL__RS_SET_SCISSOR_RECTS,
+    RECORDED_CALL__IA_SET_INPUT_LAYOUT,
+    RECORDED_CALL__IA_SET_PRIMITIVE_TOPOLOGY,
+    RECORDED_CALL__IA_SET_VERTEX_BUFFERS,
+    RECORDED_CALL__IA_SET_INDEX_BUFFER,
+    RECORDED_CALL__SET_SHADER,
+    RECORDED_CALL__SET_CONSTANT_BUFFERS,
+    RECORDED_CALL__SET_CONSTANT_BUFFERS1,
+    RECORDED_CALL__SET_SHADER_RESOURCES,
+    RECORDED_CALL__SET_SAMPLERS,
+    RECORDED_CALL__CS_SET_UNORDERED_ACCESS_VIEWS,
+    RECORDED_CALL__DRAW_INSTANCED,
+    RECORDED_CALL__DRAW_INDEXED_INSTANCED,
+    RECORDED_CALL__DISPATCH,
+    RECORDED_CALL__DRAW_INSTANCED_INDIRECT,
+    RECORDED_CALL__DRAW_INDEXED_INSTANCED_INDIRECT,
+    RECORDED_CALL__DISPATCH_INDIRECT,
+    RECORDED_CALL__COPY_BUFFER_REGION,
+    RECORDED_CALL__COPY_SUBRESOURCE,
+    RECORDED_CALL__UPDATE_SUBRESOURCE,
+    RECORDED_CALL__SET_RESOURCE_MIN_LOD,
+    RECORDED_CALL__MAP,
+    RECORDED_CALL__UNMAP,
+    RECORDED_CALL__BEGIN_QUERY,
+    RECORDED_CALL__END_QUERY,
+    RECORDED_CALL__GET_QUERY_DATA,
+    RECORDED_CALL__PRESENT,
+    RECORDED_CALL__RESIZE_BUFFERS,
+    RECORDED_CALL__WAIT_FOR_FRAME_LATENCY,
+
+    RECORDED_CALL__COUNT,
+};
+
+struct d3d11_recording_statistics_t
+{
+    // Number of calls made per `enum d3d11_recorded_call`.
+    uint64_t calls[RECORDED_CALL__COUNT];
+
+    // Total number of calls, draws and instances recorded.
+    uint64_t num_calls;
+    uint64_t num_draws;
+    uint64_t num_instances;
+
+    // Number of device objects (resources, views, states and shaders) created and not yet
+    // released.
+    uint64_t num_live_objects;
+};
+
+struct tm_allocator_i;
+struct d3d11_device_i;
+
+// Creates a recording device. It is destroyed through `d3d11_device_i->destroy()`.
+struct d3d11_device_i *d3d11_recording_device__create(struct tm_allocator_i *allocator);
+
+// Returns the name of the recorded call `call`.
+const char *d3d11_recording_device__call_name(enum d3d11_recorded_call call);
+
+// Copies the statistics gathered since the device was created (or last reset) to `stats`.
+// `device` must have been created with `d3d11_recording_device__create()`.
+void d3d11_recording_device__statistics(const struct d3d11_device_i *device, struct d3d11_recording_statistics_t *stats);
+
+// Resets the statistics of the recording `device`.
+void d3d11_recording_device__reset_statistics(struct d3d11_device_i *device);
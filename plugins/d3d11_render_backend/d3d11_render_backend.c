@@ -2,51 +2,108 @@ struct tm_api_registry_api *tm_global_api_registry;
 
 struct tm_allocator_api *tm_allocator_api;
 struct tm_error_api *tm_error_api;
+struct tm_job_system_api *tm_job_system_api;
 struct tm_logger_api *tm_logger_api;
+struct tm_os_api *tm_os_api;
 struct tm_sprintf_api *tm_sprintf_api;
 struct tm_temp_allocator_api *tm_temp_allocator_api;
 struct tm_unicode_api *tm_unicode_api;
 
+struct tm_renderer_api *tm_renderer_api;
+
 #include "d3d11_render_backend.h"
+#include "d3d11_bindless.h"
+#include "d3d11_bytecode_compiler.h"
+#include "d3d11_command_translator.h"
+#include "d3d11_device.h"
+#include "d3d11_draw_instancer.h"
+#include "d3d11_emulated_context.h"
+#include "d3d11_frame_arena.h"
+#include "d3d11_gpu_profiler.h"
+#include "d3d11_indirect_draws.h"
+#include "d3d11_internal.h"
+#include "d3d11_memory.h"
+#include "d3d11_radix_sort.h"
+#include "d3d11_recording_device.h"
+#include "d3d11_resources.h"
+#include "d3d11_shader_cache.h"
+#include "d3d11_shader_reloader.h"
+#include "d3d11_state_blocks.h"
+#include "d3d11_state_filter.h"
+#include "d3d11_upload_ring.h"
 
 #include <foundation/allocator.h>
 #include <foundation/api_registry.h>
+#include <foundation/atomics.inl>
 #include <foundation/carray.inl>
 #include <foundation/carray_print.inl>
 #include <foundation/error.h>
+#include <foundation/job_system.h>
 #include <foundation/log.h>
+#include <foundation/os.h>
 #include <foundation/sprintf.h>
 #include <foundation/temp_allocator.h>
 #include <foundation/unicode.h>
-#include <plugins/renderer/nil_render_backend.h> // TODO: remove me
 #include <plugins/renderer/render_backend.h>
+#include <plugins/renderer/render_command_buffer.h>
+#include <plugins/renderer/renderer.h>
+#include <plugins/renderer/resource_command_buffer.h>
 #include <plugins/renderer/shader_compiler.h>
 #include <plugins/renderer/shader_compiler_state_blocks_common.h>
 
+#if defined(TM_OS_WINDOWS)
 #define COBJMACROS
-#include <dxgi.h>
+#include <dxgi1_6.h>
+#else
+typedef struct IDXGIAdapter IDXGIAdapter;
+typedef struct IDXGIFactory1 IDXGIFactory1;
+#endif
+#include <stddef.h>
 #include <string.h>
 
 
 // tm_d3d11_backend_i
 
+// Adapters beyond this are ignored.
 #define MAX_ADAPTER_NUM (8)
 
-enum adapter_type_flag
-{
-    ADAPTER_TYPE__DISCRETE_GPU = 0,
-    ADAPTER_TYPE__INTEGRATED_GPU,
-    ADAPTER_TYPE__CPU,
-};
+// Adapters with less dedicated video memory than this are taken for integrated GPUs.
+#define MIN_DISCRETE_VIDEO_MEMORY (512ull * 1024 * 1024)
+
+// Device flags that select adapters.
+#define DEVICE_FLAG_MASK (TM_D3D11_DEVICE_FLAG_DISCRETE | TM_D3D11_DEVICE_FLAG_INTEGRATED | TM_D3D11_DEVICE_FLAG_SOFTWARE)
+
+// Size of the ring transient uploads are streamed through.
+#define UPLOAD_RING_SIZE (16 * 1024 * 1024)
+
+// Size of the ring the constants of each frame are suballocated from, see
+// `d3d11_resources_t.constant_arena`. The constants a frame binds must fit in it.
+#define CONSTANT_ARENA_SIZE (8 * 1024 * 1024)
+
+// Submits are only split over jobs if every job gets at least this many commands, below that the
+// cost of executing the command lists outweighs the parallel translation.
+#define MIN_COMMANDS_PER_JOB (1024)
+
+// Number of submits the GPU may be behind before its timestamps are read back.
+#define DEFAULT_GPU_TIMING_LATENCY (3)
+
+// Number of submits between queries of the video memory budget.
+#define MEMORY_BUDGET_QUERY_INTERVAL (30)
+
+// Frames a swap chain may queue for presentation before it stops being ready.
+#define DEFAULT_MAX_FRAME_LATENCY (2)
+
+// `DXGI_FORMAT_B8G8R8A8_UNORM`, the format of swap chain back buffers.
+#define SWAP_CHAIN_FORMAT (87)
 
 struct d3d11_adapter_t
 {
     IDXGIAdapter *pAdapter;
-    uint8_t name[256];
-    uint32_t vendor_id;
-    uint32_t device_id;
-    enum adapter_type_flag type;
-    TM_PAD(4);
+    struct tm_d3d11_adapter_desc_t desc;
+    double score;
+
+    // Pointed to by `desc.name`.
+    char name[256];
 };
 
 struct tm_d3d11_backend_o
@@ -54,12 +111,118 @@ struct tm_d3d11_backend_o
     struct tm_d3d11_backend_i i;
 
     struct tm_allocator_i allocator;
-    struct tm_renderer_backend_i *render_backend;
+    struct tm_renderer_backend_i render_backend;
+
+    // Allocators of the subsystems, children of `allocator`, see `scope_allocator()`. The shader
+    // cache scope is unused, shader compilers count in `shader_compiler_memory`.
+    struct d3d11_memory_scope_t memory[TM_D3D11_MEMORY_SCOPE_COUNT];
+    struct d3d11_memory_counters_t memory_counters[TM_D3D11_MEMORY_SCOPE_COUNT];
+
+    // Allocations per scope during the latest submit.
+    uint64_t frame_allocations[TM_D3D11_MEMORY_SCOPE_COUNT];
+
+    // Set with `set_allocation_check()`. Submits are checked once `allocation_check_warmup` has
+    // counted down to 0.
+    bool allocation_check;
+    TM_PAD(3);
+    uint32_t allocation_check_warmup;
+    uint64_t num_allocating_frames;
 
     struct IDXGIFactory1 *dxgi_factory;
+
+    // Enumerated once by `init()` and kept in enumeration order, `tm_d3d11_device_id` indexes it.
     /* carray */ struct d3d11_adapter_t *adapters;
+
+    // Indices of the adapters that fulfill each combination of device flags, best first.
+    uint8_t matching_adapters[DEVICE_FLAG_MASK + 1][MAX_ADAPTER_NUM];
+    uint32_t num_matching_adapters[DEVICE_FLAG_MASK + 1];
+
+    struct tm_d3d11_adapter_scorer_i adapter_scorer;
+
+    // Native or recording device, NULL until one has been created.
+    struct d3d11_device_i *device;
+    bool recording_device;
+
+    // Set if the device can create deferred contexts.
+    bool deferred_contexts;
+    TM_PAD(2);
+
+    // Submit mode set with `set_submit_mode()`.
+    enum tm_d3d11_submit_mode submit_mode;
+
+    // Set with `set_max_resource_jobs()`, 0 for one per logical processor.
+    uint32_t max_resource_jobs;
+
+    // Set with `set_draw_instancing()`.
+    struct tm_d3d11_draw_instancing_t draw_instancing;
+
+    // Set with `set_bindless()`, applied when a device is created.
+    struct tm_d3d11_bindless_t bindless_settings;
+
+    // Contexts the translation jobs record into, created on first use and kept until the device
+    // or the submit mode changes. Either all deferred or all emulated contexts.
+    /* carray */ struct d3d11_context_i **job_contexts;
+    bool job_contexts_emulated;
+    TM_PAD(7);
+
+    struct tm_renderer_command_buffer_pool_o *command_buffer_pool;
+    struct tm_renderer_resource_command_buffer_pool_o *resource_command_buffer_pool;
+
+    struct d3d11_resources_t resources;
+
+    // Only valid while there is a device.
+    struct d3d11_upload_ring_t upload_ring;
+    struct d3d11_upload_ring_t constant_arena;
+    struct d3d11_frame_arena_t frame_arena;
+    struct d3d11_draw_instancer_t draw_instancer;
+    struct d3d11_indirect_draws_t indirect_draws;
+    struct d3d11_bindless_t bindless;
+
+    // Views of the bindless heap and pools the latest submit bound, see `d3d11_bindless__views()`.
+    void *bindless_views[BINDLESS_NUM_VIEWS];
+
+    // Merged and sorted commands and the scratch memory of the radix sort, when they don't fit in
+    // the frame arena. Kept between frames, so sorting only allocates when a frame has more
+    // commands than any frame before it.
+    /* carray */ uint8_t *sort_memory;
+
+    // Indices of the statistics commands among the sorted commands.
+    /* carray */ uint32_t *statistics_commands;
+
+    // Only valid while there is a device.
+    struct d3d11_gpu_profiler_t gpu_profiler;
+    uint32_t gpu_timing_latency;
+
+    // Submits until the video memory budget is queried again.
+    uint32_t memory_budget_countdown;
+
+    // Budget source set with `set_memory_budget_source()`, `budget` is NULL for the device budget.
+    struct tm_d3d11_memory_budget_source_i memory_budget_source;
+    uint64_t memory_budget;
+
+    // Filters the calls on the immediate context when translating on the calling thread.
+    struct d3d11_state_filter_t filter;
+
+    struct tm_d3d11_statistics_t stats;
+};
+
+static const char *const memory_scope_names[TM_D3D11_MEMORY_SCOPE_COUNT] = {
+    [TM_D3D11_MEMORY_SCOPE_RESOURCES]    = "resources",
+    [TM_D3D11_MEMORY_SCOPE_TRANSLATION]  = "translation",
+    [TM_D3D11_MEMORY_SCOPE_UPLOADS]      = "uploads",
+    [TM_D3D11_MEMORY_SCOPE_SHADER_CACHE] = "shader_cache",
+    [TM_D3D11_MEMORY_SCOPE_ADAPTERS]     = "adapters",
 };
 
+// Shared by all shader compilers, see `TM_D3D11_MEMORY_SCOPE_SHADER_CACHE`.
+static struct d3d11_memory_counters_t shader_compiler_memory;
+
+static inline struct tm_allocator_i *
+scope_allocator(struct tm_d3d11_backend_o *inst, enum tm_d3d11_memory_scope scope)
+{
+    return &inst->memory[scope].allocator;
+}
+
 // https://pcisig.com/membership/member-companies
 // GPU Vendor ID
 enum
@@ -74,16 +237,16 @@ enum
 // Debug
 
 static const char *
-adapter_type_name(enum adapter_type_flag flag)
+adapter_type_name(enum tm_d3d11_adapter_type type)
 {
-    switch (flag)
+    switch (type)
     {
-    case ADAPTER_TYPE__DISCRETE_GPU:
+    case TM_D3D11_ADAPTER_TYPE_DISCRETE_GPU:
         return "Discrete GPU";
-    case ADAPTER_TYPE__INTEGRATED_GPU:
+    case TM_D3D11_ADAPTER_TYPE_INTEGRATED_GPU:
         return "Integrated GPU";
-    case ADAPTER_TYPE__CPU:
-        return "CPU";
+    case TM_D3D11_ADAPTER_TYPE_SOFTWARE:
+        return "Software";
     default:
         return "Unknown";
     }
@@ -95,101 +258,671 @@ d3d11__print_adapters(struct tm_d3d11_backend_o *inst)
     uint32_t n;
     struct d3d11_adapter_t *adapter;
     char *out = 0;
-    struct tm_allocator_i *a = &inst->allocator;
+    struct tm_allocator_i *a = scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_ADAPTERS);
 
     for (n = 0, adapter = inst->adapters; adapter != tm_carray_end(inst->adapters); ++n, ++adapter)
     {
         tm_carray_printf(&out, a, "Adapter #%u:\n", n);
-        tm_carray_printf(&out, a, "  name: %s\n", adapter->name);
-        tm_carray_printf(&out, a, "  type: %s\n", adapter_type_name(adapter->type));
-        tm_carray_printf(&out, a, "  vendor_id: 0x%x\n", adapter->vendor_id);
-        tm_carray_printf(&out, a, "  device_id: 0x%x\n", adapter->device_id);
+        const struct tm_d3d11_adapter_desc_t *desc = &adapter->desc;
+        tm_carray_printf(&out, a, "  name: %s\n", desc->name);
+        tm_carray_printf(&out, a, "  type: %s\n", adapter_type_name(desc->type));
+        tm_carray_printf(&out, a, "  vendor_id: 0x%x\n", desc->vendor_id);
+        tm_carray_printf(&out, a, "  device_id: 0x%x\n", desc->device_id);
+        tm_carray_printf(&out, a, "  dedicated_video_memory: %llu MB\n", (unsigned long long)(desc->dedicated_video_memory >> 20));
+        tm_carray_printf(&out, a, "  shared_system_memory: %llu MB\n", (unsigned long long)(desc->shared_system_memory >> 20));
+        tm_carray_printf(&out, a, "  luid: 0x%llx\n", (unsigned long long)desc->luid);
+        tm_carray_printf(&out, a, "  score: %g\n", adapter->score);
     }
 
-    tm_logger_api->print(TM_LOG_TYPE_INFO, out);
+    if (out)
+        tm_logger_api->print(TM_LOG_TYPE_INFO, out);
     tm_carray_free(out, a);
 }
 
 // -------------------------------------------------------------------
 // Create / Destroy devices
 
-static enum adapter_type_flag
-guess_adapter_type(const struct d3d11_adapter_t *adapter)
-{
-    // adapter->name == "Microsoft Basic Render Driver", a software adapter from win8
-    if (adapter->vendor_id == PCI_VENDOR_ID__MICROSOFT)
-        return ADAPTER_TYPE__CPU;
-
-    if (adapter->vendor_id == PCI_VENDOR_ID__NVIDIA || adapter->vendor_id == PCI_VENDOR_ID__AMD)
-        return ADAPTER_TYPE__DISCRETE_GPU;
-
-    return ADAPTER_TYPE__INTEGRATED_GPU;
-}
-
 static bool
 accept_adapter(const struct d3d11_adapter_t *adapter, uint32_t required_device_flags)
 {
-    bool success = required_device_flags == 0;
-    success |= (required_device_flags & TM_D3D11_DEVICE_FLAG_DISCRETE) && (adapter->type == ADAPTER_TYPE__DISCRETE_GPU);
-    success |= (required_device_flags & TM_D3D11_DEVICE_FLAG_INTEGRATED) && (adapter->type == ADAPTER_TYPE__INTEGRATED_GPU);
+    // Software adapters are opt-in, no flags only means any GPU.
+    bool success = required_device_flags == 0 && adapter->desc.type != TM_D3D11_ADAPTER_TYPE_SOFTWARE;
+    success |= (required_device_flags & TM_D3D11_DEVICE_FLAG_DISCRETE) && (adapter->desc.type == TM_D3D11_ADAPTER_TYPE_DISCRETE_GPU);
+    success |= (required_device_flags & TM_D3D11_DEVICE_FLAG_INTEGRATED) && (adapter->desc.type == TM_D3D11_ADAPTER_TYPE_INTEGRATED_GPU);
+    success |= (required_device_flags & TM_D3D11_DEVICE_FLAG_SOFTWARE) && (adapter->desc.type == TM_D3D11_ADAPTER_TYPE_SOFTWARE);
     return success;
 }
 
 static struct d3d11_adapter_t *
 find_adapter(struct tm_d3d11_backend_o *inst, uint32_t device, uint32_t required_device_flags)
 {
-    struct d3d11_adapter_t *adapter;
-    uint32_t index = 0;
-    for (adapter = inst->adapters; adapter != tm_carray_end(inst->adapters); ++adapter)
+    const uint32_t flags = required_device_flags & DEVICE_FLAG_MASK;
+    if (device >= inst->num_matching_adapters[flags])
+        return NULL;
+    return inst->adapters + inst->matching_adapters[flags][device];
+}
+
+static double
+default_adapter_score(void *inst, const struct tm_d3d11_adapter_desc_t *adapter)
+{
+    // The OS has already ranked the adapters, honoring the graphics settings of the user.
+    if (adapter->gpu_preference)
+        return -(double)adapter->enumeration_index;
+
+    const double type_score = adapter->type == TM_D3D11_ADAPTER_TYPE_DISCRETE_GPU ? 1e6 : 0.0;
+    return type_score + (double)(adapter->dedicated_video_memory >> 20);
+}
+
+// Scores the adapters and rebuilds the lists of matching adapters by descending score. The adapters
+// themselves stay in enumeration order, so the ids handed out by `physical_device_id()` keep
+// referring to the same adapter.
+static void
+rank_adapters(struct tm_d3d11_backend_o *inst)
+{
+    const struct tm_d3d11_adapter_scorer_i *scorer = &inst->adapter_scorer;
+    struct d3d11_adapter_t *adapters = inst->adapters;
+    const uint32_t n = (uint32_t)tm_carray_size(adapters);
+
+    for (uint32_t i = 0; i != n; ++i)
     {
-        if (!accept_adapter(adapter, required_device_flags))
-            continue;
+        adapters[i].desc.name = adapters[i].name;
+        adapters[i].score = scorer->score(scorer->inst, &adapters[i].desc);
+    }
 
-        if (index == device)
-            break;
+    // Stable insertion sort, there are at most `MAX_ADAPTER_NUM` adapters.
+    uint8_t ranked[MAX_ADAPTER_NUM];
+    for (uint32_t i = 0; i != n; ++i)
+    {
+        uint32_t j = i;
+        for (; j > 0 && adapters[ranked[j - 1]].score < adapters[i].score; --j)
+            ranked[j] = ranked[j - 1];
+        ranked[j] = (uint8_t)i;
+    }
+
+    for (uint32_t flags = 0; flags <= DEVICE_FLAG_MASK; ++flags)
+    {
+        inst->num_matching_adapters[flags] = 0;
+        for (uint32_t i = 0; i != n; ++i)
+        {
+            if (accept_adapter(adapters + ranked[i], flags))
+                inst->matching_adapters[flags][inst->num_matching_adapters[flags]++] = ranked[i];
+        }
     }
-    return adapter != tm_carray_end(inst->adapters) ? adapter : NULL;
 }
 
+#if defined(TM_OS_WINDOWS)
+
 static void
 d3d11__build_adapters(struct tm_d3d11_backend_o *inst)
 {
-    HRESULT hr;
-    DXGI_ADAPTER_DESC desc;
-    struct d3d11_adapter_t adapter;
-    uint32_t n;
+    // Enumerating by GPU preference needs IDXGIFactory6 (Windows 10 1803).
+    // https://docs.microsoft.com/en-us/windows/win32/api/dxgi1_6/ne-dxgi1_6-dxgi_gpu_preference
+    IDXGIFactory6 *factory6 = 0;
+    const bool gpu_preference = SUCCEEDED(IDXGIFactory1_QueryInterface(inst->dxgi_factory, &IID_IDXGIFactory6, (void **)&factory6));
+
+    // One temp allocator for the whole enumeration, so skipping an adapter can't leak it.
+    TM_INIT_TEMP_ALLOCATOR(ta);
 
-    n = 0;
-    while (1)
+    for (uint32_t n = 0; tm_carray_size(inst->adapters) < MAX_ADAPTER_NUM; ++n)
     {
-        
-        hr = IDXGIFactory1_EnumAdapters(inst->dxgi_factory, n, &adapter.pAdapter);
+        IDXGIAdapter1 *dxgi_adapter = 0;
+        const HRESULT hr = gpu_preference
+            ? IDXGIFactory6_EnumAdapterByGpuPreference(factory6, n, DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE,
+                &IID_IDXGIAdapter1, (void **)&dxgi_adapter)
+            : IDXGIFactory1_EnumAdapters1(inst->dxgi_factory, n, &dxgi_adapter);
         if (hr == DXGI_ERROR_NOT_FOUND)
             break;
+        if (FAILED(hr))
+            continue;
 
-        ++n;
+        DXGI_ADAPTER_DESC1 desc;
+        if (FAILED(IDXGIAdapter1_GetDesc1(dxgi_adapter, &desc)))
+        {
+            IDXGIAdapter1_Release(dxgi_adapter);
+            continue;
+        }
+
+        // The "Microsoft Basic Render Driver", a software adapter from win8, is kept but only
+        // matches `TM_D3D11_DEVICE_FLAG_SOFTWARE`.
+        const bool software = (desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE) || desc.VendorId == PCI_VENDOR_ID__MICROSOFT;
+        const enum tm_d3d11_adapter_type type = software ? TM_D3D11_ADAPTER_TYPE_SOFTWARE
+            : desc.DedicatedVideoMemory >= MIN_DISCRETE_VIDEO_MEMORY ? TM_D3D11_ADAPTER_TYPE_DISCRETE_GPU
+            : TM_D3D11_ADAPTER_TYPE_INTEGRATED_GPU;
+
+        struct d3d11_adapter_t adapter = {
+            .pAdapter = (IDXGIAdapter *)dxgi_adapter,
+            .desc = {
+                .vendor_id               = desc.VendorId,
+                .device_id               = desc.DeviceId,
+                .type                    = type,
+                .enumeration_index       = n,
+                .gpu_preference          = gpu_preference,
+                .dedicated_video_memory  = desc.DedicatedVideoMemory,
+                .dedicated_system_memory = desc.DedicatedSystemMemory,
+                .shared_system_memory    = desc.SharedSystemMemory,
+                .luid                    = ((uint64_t)(uint32_t)desc.AdapterLuid.HighPart << 32) | desc.AdapterLuid.LowPart,
+            },
+        };
+
+        strncpy(adapter.name, tm_unicode_api->utf16_to_utf8(desc.Description, ta), sizeof(adapter.name) - 1);
+
+        tm_carray_push(inst->adapters, adapter, scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_ADAPTERS));
+    }
 
-        TM_INIT_TEMP_ALLOCATOR(ta);
-        IDXGIAdapter_GetDesc(adapter.pAdapter, &desc);
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
 
-        strcpy(adapter.name, tm_unicode_api->utf16_to_utf8(desc.Description, ta));
-        adapter.vendor_id = desc.VendorId;
-        adapter.device_id = desc.DeviceId;
+    if (factory6)
+        IDXGIFactory6_Release(factory6);
+}
 
-        // IDXGIFactory6 can detect discrete GPU, but only win10 supports it.
-        // https://docs.microsoft.com/en-us/windows/win32/api/dxgi1_6/ne-dxgi1_6-dxgi_gpu_preference
-        //
-        // So we just guess it.
-        adapter.type = guess_adapter_type(&adapter);
-        if (adapter.type == ADAPTER_TYPE__CPU)
-            continue;
+#endif
+
+// -------------------------------------------------------------------
+// Sorting
+
+// Merges the commands of all `buffers` and radix sorts them on their sort keys. Commands with
+// equal keys keep the order they were recorded in, buffer by buffer. The sorted commands live in
+// the frame arena, or in `inst->sort_memory` if they don't fit, until the next call. The indices
+// of the statistics commands among them are stored in `inst->statistics_commands`.
+static tm_renderer_command_t *
+sort_commands(struct tm_d3d11_backend_o *inst, struct tm_renderer_command_buffer_o **buffers, uint32_t num_buffers,
+    uint32_t max_jobs, uint32_t *num_commands)
+{
+    struct tm_renderer_command_buffer_api *cb_api = tm_renderer_api->tm_renderer_command_buffer_api;
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i != num_buffers; ++i)
+        n += cb_api->num_commands(buffers[i]);
+
+    const uint64_t commands_size = ((uint64_t)n * sizeof(tm_renderer_command_t) + 15) & ~15ULL;
+    const uint64_t pairs_size = (uint64_t)n * sizeof(struct d3d11_sort_pair_t);
+    const uint64_t size = 2 * commands_size + pairs_size + d3d11_radix_sort__memory_needed(n, max_jobs);
+    uint8_t *p = d3d11_frame_arena__allocate(&inst->frame_arena, size, 16);
+    if (!p)
+    {
+        tm_carray_resize(inst->sort_memory, size, scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_TRANSLATION));
+        p = inst->sort_memory;
+    }
+
+    tm_renderer_command_t *merged = (tm_renderer_command_t *)p;
+    tm_renderer_command_t *sorted = (tm_renderer_command_t *)(p + commands_size);
+    struct d3d11_sort_pair_t *pairs = (struct d3d11_sort_pair_t *)(p + 2 * commands_size);
+    void *scratch = p + 2 * commands_size + pairs_size;
+
+    uint32_t k = 0;
+    for (uint32_t i = 0; i != num_buffers; ++i)
+    {
+        const uint32_t num = cb_api->num_commands(buffers[i]);
+        const tm_renderer_commands_t c = cb_api->commands(buffers[i]);
+        for (uint32_t j = 0; j != num; ++j, ++k)
+        {
+            merged[k] = (tm_renderer_command_t) { .sort_key = c.sort_keys[j], .type = c.types[j], .data = c.data[j] };
+            pairs[k] = (struct d3d11_sort_pair_t) { .key = c.sort_keys[j], .command = merged + k };
+        }
+    }
+
+    const struct d3d11_sort_pair_t *s = d3d11_radix_sort__sort(pairs, n, scratch, max_jobs);
+    tm_carray_shrink(inst->statistics_commands, 0);
+    for (uint32_t i = 0; i != n; ++i)
+    {
+        sorted[i] = *s[i].command;
+        if (sorted[i].type == TM_RENDERER_COMMAND_BEGIN_STATISTICS || sorted[i].type == TM_RENDERER_COMMAND_END_STATISTICS)
+            tm_carray_push(inst->statistics_commands, i, scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_TRANSLATION));
+    }
+
+    *num_commands = n;
+    return sorted;
+}
+
+// -------------------------------------------------------------------
+// Parallel translation
+
+struct translate_job_t
+{
+    struct d3d11_translate_params_t params;
+
+    const tm_renderer_command_t *commands;
+    uint32_t num_commands;
+
+    bool emulated;
+    TM_PAD(3);
+
+    // Deferred contexts only, the command list recorded by the job.
+    void *command_list;
+
+    // Sits in front of the job context, `params.context` points to it.
+    struct d3d11_state_filter_t filter;
+
+    struct d3d11_translate_statistics_t stats;
+};
+
+static enum tm_d3d11_submit_mode
+resolve_submit_mode(const struct tm_d3d11_backend_o *inst)
+{
+    switch (inst->submit_mode)
+    {
+    case TM_D3D11_SUBMIT_MODE_DEFAULT:
+        return inst->device && inst->device->supports_command_lists(inst->device->inst)
+            ? TM_D3D11_SUBMIT_MODE_DEFERRED_CONTEXTS
+            : TM_D3D11_SUBMIT_MODE_EMULATED;
+    case TM_D3D11_SUBMIT_MODE_DEFERRED_CONTEXTS:
+        return inst->deferred_contexts ? TM_D3D11_SUBMIT_MODE_DEFERRED_CONTEXTS : TM_D3D11_SUBMIT_MODE_EMULATED;
+    default:
+        return inst->submit_mode;
+    }
+}
+
+static void
+release_job_contexts(struct tm_d3d11_backend_o *inst)
+{
+    for (struct d3d11_context_i **c = inst->job_contexts; c != tm_carray_end(inst->job_contexts); ++c)
+    {
+        if (inst->job_contexts_emulated)
+            d3d11_emulated_context__destroy(*c);
+        else
+            inst->device->destroy_deferred_context(inst->device->inst, *c);
+    }
+    tm_carray_free(inst->job_contexts, scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_TRANSLATION));
+    inst->job_contexts = 0;
+}
+
+// Makes sure there are at least `n` job contexts of the right kind, returns false if deferred
+// contexts couldn't be created.
+static bool
+ensure_job_contexts(struct tm_d3d11_backend_o *inst, uint32_t n, bool emulated)
+{
+    if (inst->job_contexts_emulated != emulated)
+        release_job_contexts(inst);
+    inst->job_contexts_emulated = emulated;
+
+    struct tm_allocator_i *a = scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_TRANSLATION);
+    while (tm_carray_size(inst->job_contexts) < n)
+    {
+        struct d3d11_context_i *c = emulated ? d3d11_emulated_context__create(a)
+                                             : inst->device->create_deferred_context(inst->device->inst);
+        if (!c)
+            return false;
+        tm_carray_push(inst->job_contexts, c, a);
+    }
+    return true;
+}
+
+static void
+translate_job(void *data)
+{
+    struct translate_job_t *j = data;
+    d3d11_translator__translate(&j->params, j->commands, j->num_commands, &j->stats);
+    if (!j->emulated)
+        j->command_list = j->params.context->finish_command_list(j->params.context->inst);
+}
+
+static void
+add_translate_statistics(struct d3d11_translate_statistics_t *stats, const struct d3d11_translate_statistics_t *add)
+{
+    stats->num_commands += add->num_commands;
+    stats->num_render_passes += add->num_render_passes;
+    stats->num_draw_calls += add->num_draw_calls;
+    stats->num_instanced_draws += add->num_instanced_draws;
+    stats->num_merged_draws += add->num_merged_draws;
+    stats->num_indirect_draws += add->num_indirect_draws;
+    stats->num_dispatches += add->num_dispatches;
+    stats->num_copies += add->num_copies;
+    stats->num_skipped_commands += add->num_skipped_commands;
+}
+
+static void
+add_filter_statistics(struct tm_d3d11_statistics_t *stats, const struct d3d11_state_filter_statistics_t *add)
+{
+    stats->num_state_calls_issued += add->num_issued;
+    stats->num_state_calls_filtered += add->num_calls - add->num_issued;
+    stats->num_constant_buffer_binds += add->num_constant_buffer_binds;
+}
+
+// Splits the sorted `commands` into `num_jobs` consecutive ranges, translates them in parallel
+// and executes the results on the immediate context in order. Returns false if the job contexts
+// couldn't be created, in which case nothing has been translated.
+static bool
+translate_on_jobs(struct tm_d3d11_backend_o *inst, bool emulated, const tm_renderer_command_t *commands,
+    uint32_t num_commands, uint32_t num_jobs, struct d3d11_translate_statistics_t *stats)
+{
+    if (!ensure_job_contexts(inst, num_jobs, emulated))
+        return false;
+
+    TM_INIT_TEMP_ALLOCATOR(ta);
+
+    struct translate_job_t *jobs = tm_temp_alloc(ta, num_jobs * sizeof(*jobs));
+    tm_jobdecl_t *decls = tm_temp_alloc(ta, num_jobs * sizeof(*decls));
+    for (uint32_t i = 0; i != num_jobs; ++i)
+    {
+        const uint32_t begin = (uint32_t)((uint64_t)num_commands * i / num_jobs);
+        const uint32_t end = (uint32_t)((uint64_t)num_commands * (i + 1) / num_jobs);
+        jobs[i] = (struct translate_job_t) {
+            .params = {
+                .context              = &jobs[i].filter.i,
+                .resolver             = &inst->resources.resolver,
+                .profiler             = &inst->gpu_profiler,
+                .preceding            = commands,
+                .num_preceding        = begin,
+                .instance_buffer_slot = inst->draw_instancing.instance_buffer_slot,
+                .runs                 = inst->draw_instancer.runs,
+                .num_runs             = (uint32_t)tm_carray_size(inst->draw_instancer.runs),
+                .bindless_views       = inst->resources.bindless ? inst->bindless_views : 0,
+                .indirect_draws       = &inst->indirect_draws,
+                .compacted_draws      = inst->indirect_draws.draws,
+                .num_compacted_draws  = (uint32_t)tm_carray_size(inst->indirect_draws.draws),
+            },
+            .commands     = commands + begin,
+            .num_commands = end - begin,
+            .emulated     = emulated,
+        };
+        d3d11_state_filter__init(&jobs[i].filter, inst->job_contexts[i]);
+        decls[i] = (tm_jobdecl_t) { .task = translate_job, .data = jobs + i };
+    }
+
+    tm_atomic_counter_o *counter = tm_job_system_api->run_jobs(decls, num_jobs);
+    tm_job_system_api->wait_for_counter_and_free(counter);
+
+    struct d3d11_context_i *immediate = inst->device->immediate_context(inst->device->inst);
+    for (struct translate_job_t *j = jobs; j != jobs + num_jobs; ++j)
+    {
+        if (emulated)
+            d3d11_emulated_context__replay(j->filter.target, immediate);
+        else if (j->command_list)
+        {
+            immediate->execute_command_list(immediate->inst, j->command_list);
+            inst->device->release(inst->device->inst, j->command_list);
+        }
+        add_translate_statistics(stats, &j->stats);
+        add_filter_statistics(&inst->stats, &j->filter.stats);
+    }
+
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+    return true;
+}
+
+// -------------------------------------------------------------------
+// tm_renderer_backend_i
+
+static tm_renderer_handle_t
+render_backend__create_swap_chain(struct tm_renderer_backend_o *inst, const struct tm_renderer_swap_chain_t *swap_chain,
+    uint32_t device_affinity)
+{
+    struct tm_d3d11_backend_o *o = (struct tm_d3d11_backend_o *)inst;
+    const struct d3d11_swap_chain_desc_t desc = {
+        .window            = swap_chain->window_handle,
+        .width             = swap_chain->width,
+        .height            = swap_chain->height,
+        .format            = SWAP_CHAIN_FORMAT,
+        .max_frame_latency = DEFAULT_MAX_FRAME_LATENCY,
+    };
+    const uint32_t resource = d3d11_resources__create_swap_chain(&o->resources, &desc);
+    if (!resource)
+        tm_logger_api->print(TM_LOG_TYPE_ERROR, "Failed to create swap chain");
+
+    tm_renderer_handle_t handle = { .resource = resource };
+    return handle;
+}
+
+static void
+render_backend__destroy_swap_chain(struct tm_renderer_backend_o *inst, tm_renderer_handle_t handle, uint32_t device_affinity)
+{
+    struct tm_d3d11_backend_o *o = (struct tm_d3d11_backend_o *)inst;
+    if (d3d11_resources__swap_chain(&o->resources, handle.resource))
+        d3d11_resources__destroy(&o->resources, handle.resource);
+}
+
+static void
+render_backend__resize_swap_chain(struct tm_renderer_backend_o *inst, tm_renderer_handle_t handle, uint32_t width,
+    uint32_t height)
+{
+    struct tm_d3d11_backend_o *o = (struct tm_d3d11_backend_o *)inst;
+    struct d3d11_swap_chain_i *swap_chain = d3d11_resources__swap_chain(&o->resources, handle.resource);
+    if (!swap_chain)
+        return;
+
+    // The back buffers can't be resized while they are bound.
+    struct d3d11_context_i *immediate = o->device->immediate_context(o->device->inst);
+    immediate->om_set_render_targets(immediate->inst, 0, 0, 0);
+
+    if (!swap_chain->resize(swap_chain->inst, width, height))
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Failed to resize swap chain to %ux%u", width, height);
+}
+
+static void
+render_backend__present_swap_chain(struct tm_renderer_backend_o *inst, tm_renderer_handle_t handle)
+{
+    struct tm_d3d11_backend_o *o = (struct tm_d3d11_backend_o *)inst;
+    struct d3d11_swap_chain_i *swap_chain = d3d11_resources__swap_chain(&o->resources, handle.resource);
+    if (swap_chain)
+        swap_chain->present(swap_chain->inst, 1);
+}
+
+static void
+render_backend__create_command_buffers(struct tm_renderer_backend_o *inst,
+    struct tm_renderer_command_buffer_o **command_buffers, uint32_t num_buffers)
+{
+    struct tm_d3d11_backend_o *o = (struct tm_d3d11_backend_o *)inst;
+    struct tm_renderer_command_buffer_pool_api *pool_api = tm_renderer_api->tm_renderer_command_buffer_pool_api;
+
+    for (uint32_t i = 0; i != num_buffers; ++i)
+        command_buffers[i] = pool_api->create(o->command_buffer_pool);
+}
+
+static struct d3d11_memory_counters_t *
+scope_counters(struct tm_d3d11_backend_o *inst, enum tm_d3d11_memory_scope scope)
+{
+    return scope == TM_D3D11_MEMORY_SCOPE_SHADER_CACHE ? &shader_compiler_memory : &inst->memory_counters[scope];
+}
+
+// Stores the allocations made by each scope since `start` was taken in `inst->frame_allocations`
+// and flags the submit if it allocated, see `set_allocation_check()`.
+static void
+end_frame_allocations(struct tm_d3d11_backend_o *inst, const uint64_t start[TM_D3D11_MEMORY_SCOPE_COUNT])
+{
+    uint64_t total = 0;
+    for (uint32_t i = 0; i != TM_D3D11_MEMORY_SCOPE_COUNT; ++i)
+    {
+        inst->frame_allocations[i] = atomic_load_uint64_t(&scope_counters(inst, i)->num_allocations) - start[i];
+        if (i != TM_D3D11_MEMORY_SCOPE_SHADER_CACHE)
+            total += inst->frame_allocations[i];
+    }
+
+    if (!inst->allocation_check)
+        return;
+    if (inst->allocation_check_warmup)
+    {
+        --inst->allocation_check_warmup;
+        return;
+    }
+    if (!total)
+        return;
+
+    ++inst->num_allocating_frames;
+
+    TM_INIT_TEMP_ALLOCATOR(ta);
+    const char *scopes = "";
+    for (uint32_t i = 0; i != TM_D3D11_MEMORY_SCOPE_COUNT; ++i)
+    {
+        if (i != TM_D3D11_MEMORY_SCOPE_SHADER_CACHE && inst->frame_allocations[i])
+        {
+            scopes = tm_temp_allocator_api->printf(ta, "%s %s: %llu", scopes, memory_scope_names[i],
+                (unsigned long long)inst->frame_allocations[i]);
+        }
+    }
+    tm_logger_api->printf(TM_LOG_TYPE_INFO, "Submit %llu made %llu heap allocations in steady state,%s",
+        (unsigned long long)inst->stats.num_submits, (unsigned long long)total, scopes);
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+}
+
+static void
+render_backend__submit_command_buffers(struct tm_renderer_backend_o *inst,
+    struct tm_renderer_command_buffer_o **command_buffers, uint32_t num_buffers)
+{
+    struct tm_d3d11_backend_o *o = (struct tm_d3d11_backend_o *)inst;
+
+    if (!o->device || !num_buffers)
+        return;
+
+    const tm_clock_o start = tm_os_api->time->now();
+
+    uint64_t start_allocations[TM_D3D11_MEMORY_SCOPE_COUNT];
+    for (uint32_t i = 0; i != TM_D3D11_MEMORY_SCOPE_COUNT; ++i)
+        start_allocations[i] = atomic_load_uint64_t(&scope_counters(o, i)->num_allocations);
+
+    if (o->memory_budget_countdown)
+        --o->memory_budget_countdown;
+    else
+    {
+        const struct tm_d3d11_memory_budget_source_i *s = &o->memory_budget_source;
+        o->memory_budget = s->budget ? s->budget(s->inst) : o->device->video_memory_budget(o->device->inst);
+        o->memory_budget_countdown = MEMORY_BUDGET_QUERY_INTERVAL;
+    }
+    d3d11_frame_arena__begin_frame(&o->frame_arena);
+    d3d11_resources__begin_frame(&o->resources);
+    d3d11_resources__enforce_budget(&o->resources, o->memory_budget);
+
+    const tm_clock_o streaming_start = tm_os_api->time->now();
+    d3d11_resources__stream_mips(&o->resources);
+    o->stats.streaming_upload_seconds = tm_os_api->time->delta(tm_os_api->time->now(), streaming_start);
+
+    // Unless single threaded, large submits are sorted and translated on jobs, see
+    // `enum tm_d3d11_submit_mode`.
+    const enum tm_d3d11_submit_mode mode = resolve_submit_mode(o);
+    const uint32_t max_jobs = mode == TM_D3D11_SUBMIT_MODE_SINGLE_THREADED ? 1 : tm_os_api->info->num_logical_processors();
+
+    // Merge and sort the commands of all buffers on their sort keys, then walk them once.
+    uint32_t num_commands = 0;
+    tm_renderer_command_t *commands = sort_commands(o, command_buffers, num_buffers, max_jobs, &num_commands);
+
+    // Translation is split in consecutive ranges of the sorted commands.
+    const uint32_t num_jobs = tm_min(num_commands / MIN_COMMANDS_PER_JOB, max_jobs);
+
+    struct d3d11_context_i *immediate = o->device->immediate_context(o->device->inst);
+    d3d11_gpu_profiler__begin_frame(&o->gpu_profiler, immediate, commands, o->statistics_commands,
+        (uint32_t)tm_carray_size(o->statistics_commands));
+
+    // The instance buffers are uploaded by the flush, before the draws that read them.
+    d3d11_draw_instancer__gather(&o->draw_instancer, &o->draw_instancing, &o->resources.resolver, o->resources.upload_ring,
+        commands, num_commands);
+
+    // So are the constants of the suballocated constant buffers and the parameters of the
+    // indirect draw compactions.
+    d3d11_resources__upload_constants(&o->resources, commands, num_commands);
+    d3d11_indirect_draws__gather(&o->indirect_draws, &o->resources.resolver, o->resources.upload_ring, commands,
+        num_commands);
+    d3d11_indirect_draws__begin_frame(&o->indirect_draws, immediate);
+
+    struct d3d11_translate_statistics_t stats = { 0 };
+    d3d11_upload_ring__flush(&o->upload_ring);
+    d3d11_upload_ring__flush(&o->constant_arena);
+
+    // Bindless copies read the buffers the ring has just updated.
+    if (o->resources.bindless)
+    {
+        d3d11_bindless__flush(o->resources.bindless, true);
+        d3d11_bindless__views(o->resources.bindless, o->bindless_views);
+    }
+
+    if (num_jobs > 1 && translate_on_jobs(o, mode == TM_D3D11_SUBMIT_MODE_EMULATED, commands, num_commands, num_jobs, &stats))
+        o->stats.num_command_lists += num_jobs;
+    else
+    {
+        d3d11_state_filter__init(&o->filter, immediate);
+        const struct d3d11_translate_params_t params = {
+            .context              = &o->filter.i,
+            .resolver             = &o->resources.resolver,
+            .profiler             = &o->gpu_profiler,
+            .instance_buffer_slot = o->draw_instancing.instance_buffer_slot,
+            .runs                 = o->draw_instancer.runs,
+            .num_runs             = (uint32_t)tm_carray_size(o->draw_instancer.runs),
+            .bindless_views       = o->resources.bindless ? o->bindless_views : 0,
+            .indirect_draws       = &o->indirect_draws,
+            .compacted_draws      = o->indirect_draws.draws,
+            .num_compacted_draws  = (uint32_t)tm_carray_size(o->indirect_draws.draws),
+        };
+        d3d11_translator__translate(&params, commands, num_commands, &stats);
+        add_filter_statistics(&o->stats, &o->filter.stats);
+    }
+    d3d11_upload_ring__end_frame(&o->upload_ring);
+    d3d11_upload_ring__end_frame(&o->constant_arena);
+    d3d11_frame_arena__end_frame(&o->frame_arena);
+    d3d11_indirect_draws__end_frame(&o->indirect_draws, immediate);
+    d3d11_gpu_profiler__end_frame(&o->gpu_profiler, immediate);
+
+    o->stats.num_submits += 1;
+    o->stats.num_commands += stats.num_commands;
+    o->stats.num_draw_calls += stats.num_draw_calls;
+    o->stats.num_instanced_draws += stats.num_instanced_draws;
+    o->stats.num_merged_draws += stats.num_merged_draws;
+    o->stats.num_indirect_draws += stats.num_indirect_draws;
+    o->stats.num_dispatches += stats.num_dispatches;
+    o->stats.num_skipped_commands += stats.num_skipped_commands;
+    o->stats.translation_seconds += tm_os_api->time->delta(tm_os_api->time->now(), start);
+
+    end_frame_allocations(o, start_allocations);
+}
+
+static void
+render_backend__destroy_command_buffers(struct tm_renderer_backend_o *inst,
+    struct tm_renderer_command_buffer_o **command_buffers, uint32_t num_buffers)
+{
+    struct tm_d3d11_backend_o *o = (struct tm_d3d11_backend_o *)inst;
+    struct tm_renderer_command_buffer_pool_api *pool_api = tm_renderer_api->tm_renderer_command_buffer_pool_api;
+
+    for (uint32_t i = 0; i != num_buffers; ++i)
+    {
+        pool_api->destroy(o->command_buffer_pool, command_buffers[i]);
+        command_buffers[i] = 0;
+    }
+}
+
+static void
+render_backend__create_resource_command_buffers(struct tm_renderer_backend_o *inst,
+    struct tm_renderer_resource_command_buffer_o **resource_buffers, uint32_t num_buffers)
+{
+    struct tm_d3d11_backend_o *o = (struct tm_d3d11_backend_o *)inst;
+    struct tm_renderer_resource_command_buffer_pool_api *pool_api = tm_renderer_api->tm_renderer_resource_command_buffer_pool_api;
+
+    for (uint32_t i = 0; i != num_buffers; ++i)
+        resource_buffers[i] = pool_api->create(o->resource_command_buffer_pool);
+}
+
+static void
+render_backend__submit_resource_command_buffers(struct tm_renderer_backend_o *inst,
+    struct tm_renderer_resource_command_buffer_o **resource_buffers, uint32_t num_buffers)
+{
+    struct tm_d3d11_backend_o *o = (struct tm_d3d11_backend_o *)inst;
+
+    const tm_clock_o start = tm_os_api->time->now();
+
+    uint32_t max_jobs = o->max_resource_jobs ? o->max_resource_jobs : tm_os_api->info->num_logical_processors();
+    if (resolve_submit_mode(o) == TM_D3D11_SUBMIT_MODE_SINGLE_THREADED)
+        max_jobs = 1;
+    d3d11_resources__submit(&o->resources, resource_buffers, num_buffers, max_jobs);
 
-        tm_carray_push(inst->adapters, adapter, &inst->allocator);
+    o->stats.resource_seconds += tm_os_api->time->delta(tm_os_api->time->now(), start);
+}
+
+static void
+render_backend__destroy_resource_command_buffers(struct tm_renderer_backend_o *inst,
+    struct tm_renderer_resource_command_buffer_o **resource_buffers, uint32_t num_buffers)
+{
+    struct tm_d3d11_backend_o *o = (struct tm_d3d11_backend_o *)inst;
+    struct tm_renderer_resource_command_buffer_pool_api *pool_api = tm_renderer_api->tm_renderer_resource_command_buffer_pool_api;
 
-        TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+    for (uint32_t i = 0; i != num_buffers; ++i)
+    {
+        pool_api->destroy(o->resource_command_buffer_pool, resource_buffers[i]);
+        resource_buffers[i] = 0;
     }
 }
 
+static bool
+render_backend__read_complete(struct tm_renderer_backend_o *inst, uint32_t read_back_id, uint32_t device_affinity_mask)
+{
+    return true;
+}
+
 // Public
 
 static bool
@@ -197,67 +930,83 @@ d3d11__init(struct tm_d3d11_backend_o *inst)
 {
     tm_logger_api->print(TM_LOG_TYPE_DEBUG, "d3d11__init");
 
-    HRESULT hr = CreateDXGIFactory1(&IID_IDXGIFactory, (void**)(&inst->dxgi_factory));
+    inst->command_buffer_pool = tm_renderer_api->tm_renderer_command_buffer_pool_api->create_pool(
+        scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_TRANSLATION));
+
+    // Handles are allocated by our pools when resources are recorded, see `d3d11_resources_t`.
+    d3d11_resources__init(&inst->resources, scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_RESOURCES));
+    inst->resource_command_buffer_pool = tm_renderer_api->tm_renderer_resource_command_buffer_pool_api->create_pool(
+        scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_RESOURCES), &inst->resources.handle_allocator);
+
+#if defined(TM_OS_WINDOWS)
+    HRESULT hr = CreateDXGIFactory1(&IID_IDXGIFactory1, (void**)(&inst->dxgi_factory));
     if (FAILED(hr))
         return false;
 
     d3d11__build_adapters(inst);
+#endif
+    rank_adapters(inst);
     d3d11__print_adapters(inst);
 
     return true;
 }
 
+static void d3d11__destroy_device(struct tm_d3d11_backend_o *inst);
+
 static void
 d3d11__shutdown(struct tm_d3d11_backend_o *inst)
 {
-    struct d3d11_adapter_t *adapter;
-
     tm_logger_api->print(TM_LOG_TYPE_DEBUG, "d3d11__shutdown");
 
+    d3d11__destroy_device(inst);
+    d3d11_resources__shutdown(&inst->resources);
+
+#if defined(TM_OS_WINDOWS)
+    struct d3d11_adapter_t *adapter;
     for (adapter = inst->adapters; adapter != tm_carray_end(inst->adapters); ++adapter)
     {
         IDXGIAdapter_Release(adapter->pAdapter);
         adapter->pAdapter = 0;
     }
-    tm_carray_free(inst->adapters, &inst->allocator);
 
     if (inst->dxgi_factory)
     {
         IDXGIFactory_Release(inst->dxgi_factory);
         inst->dxgi_factory = 0;
     }
+#endif
+    tm_carray_free(inst->adapters, scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_ADAPTERS));
+    inst->adapters = 0;
+    memset(inst->num_matching_adapters, 0, sizeof(inst->num_matching_adapters));
 
-    if (inst->render_backend)
+    tm_carray_free(inst->sort_memory, scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_TRANSLATION));
+    inst->sort_memory = 0;
+    tm_carray_free(inst->statistics_commands, scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_TRANSLATION));
+    inst->statistics_commands = 0;
+
+    if (inst->resource_command_buffer_pool)
+    {
+        tm_renderer_api->tm_renderer_resource_command_buffer_pool_api->destroy_pool(inst->resource_command_buffer_pool);
+        inst->resource_command_buffer_pool = 0;
+    }
+
+    if (inst->command_buffer_pool)
     {
-        struct tm_nil_renderer_backend_api *tm_nil_renderer_backend_api = tm_global_api_registry->get(TM_NIL_RENDER_BACKEND_API_NAME);
-        tm_nil_renderer_backend_api->destroy(inst->render_backend);
-        inst->render_backend = 0;
+        tm_renderer_api->tm_renderer_command_buffer_pool_api->destroy_pool(inst->command_buffer_pool);
+        inst->command_buffer_pool = 0;
     }
 }
 
 static struct tm_renderer_backend_i *
 d3d11__agnostic_render_backend(struct tm_d3d11_backend_o *inst)
 {
-    if (!inst->render_backend)
-    {
-        struct tm_nil_renderer_backend_api *tm_nil_renderer_backend_api = tm_global_api_registry->get(TM_NIL_RENDER_BACKEND_API_NAME);
-        inst->render_backend = tm_nil_renderer_backend_api->create(&inst->allocator);
-    }
-
-    return inst->render_backend;
+    return &inst->render_backend;
 }
 
 static uint32_t
 d3d11__num_physical_devices(struct tm_d3d11_backend_o *inst, uint32_t required_device_flags)
 {
-    struct d3d11_adapter_t *adapter;
-    uint32_t num_devices = 0;
-    for (adapter = inst->adapters; adapter != tm_carray_end(inst->adapters); ++adapter)
-    {
-        if (accept_adapter(adapter, required_device_flags))
-            num_devices++;
-    }
-    return num_devices;
+    return inst->num_matching_adapters[required_device_flags & DEVICE_FLAG_MASK];
 }
 
 static const char *
@@ -271,12 +1020,26 @@ d3d11__physical_device_name(struct tm_d3d11_backend_o *inst, uint32_t device,
         return "";
 
     if (vendor_id)
-        *vendor_id = adapter->vendor_id;
+        *vendor_id = adapter->desc.vendor_id;
 
     if (device_id)
-        *device_id = adapter->device_id;
+        *device_id = adapter->desc.device_id;
+
+    return adapter->desc.name;
+}
 
-    return adapter->name;
+static const struct tm_d3d11_adapter_desc_t *
+d3d11__physical_device_desc(struct tm_d3d11_backend_o *inst, uint32_t device, uint32_t required_device_flags)
+{
+    const struct d3d11_adapter_t *adapter = find_adapter(inst, device, required_device_flags);
+    return adapter ? &adapter->desc : NULL;
+}
+
+static void
+d3d11__set_adapter_scorer(struct tm_d3d11_backend_o *inst, const struct tm_d3d11_adapter_scorer_i *scorer)
+{
+    inst->adapter_scorer = scorer ? *scorer : (struct tm_d3d11_adapter_scorer_i) { .score = default_adapter_score };
+    rank_adapters(inst);
 }
 
 static bool
@@ -293,16 +1056,291 @@ d3d11__physical_device_id(struct tm_d3d11_backend_o *inst, uint32_t device,
     return true;
 }
 
+static void
+d3d11__set_device(struct tm_d3d11_backend_o *inst, struct d3d11_device_i *device, bool recording)
+{
+    inst->device = device;
+    inst->recording_device = recording;
+
+    struct d3d11_context_i *deferred = device->create_deferred_context(device->inst);
+    inst->deferred_contexts = deferred != 0;
+    if (deferred)
+        device->destroy_deferred_context(device->inst, deferred);
+    d3d11_resources__set_device(&inst->resources, device);
+    inst->memory_budget_countdown = 0;
+
+    struct tm_allocator_i *uploads = scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_UPLOADS);
+    if (d3d11_upload_ring__init(&inst->upload_ring, uploads, device, UPLOAD_RING_SIZE,
+            BIND_FLAG__VERTEX_BUFFER | BIND_FLAG__INDEX_BUFFER))
+    {
+        inst->resources.upload_ring = &inst->upload_ring;
+    }
+    else
+        tm_logger_api->print(TM_LOG_TYPE_ERROR, "Failed to create the upload ring, updating resources directly");
+
+    // Without D3D11.1 offsets constant buffers fall back to the pool.
+    if (device->supports_constant_buffer_offsets(device->inst)
+        && d3d11_upload_ring__init(&inst->constant_arena, uploads, device, CONSTANT_ARENA_SIZE, BIND_FLAG__CONSTANT_BUFFER))
+    {
+        inst->resources.constant_arena = &inst->constant_arena;
+    }
+    const struct tm_d3d11_bindless_t *bindless = &inst->bindless_settings;
+    if (bindless->enabled)
+    {
+        const uint32_t heap_size = bindless->heap_size ? bindless->heap_size : BINDLESS_DEFAULT_HEAP_SIZE;
+        if (d3d11_bindless__init(&inst->bindless, scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_RESOURCES), device, heap_size))
+            inst->resources.bindless = &inst->bindless;
+        else
+            tm_logger_api->print(TM_LOG_TYPE_ERROR, "Failed to create the bindless heap, bindless is disabled");
+    }
+    struct tm_allocator_i *translation = scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_TRANSLATION);
+    if (!d3d11_frame_arena__init(&inst->frame_arena, translation, device))
+        tm_logger_api->print(TM_LOG_TYPE_ERROR, "Failed to create the frame arena, sorting on the heap");
+    d3d11_gpu_profiler__init(&inst->gpu_profiler, translation, device, inst->gpu_timing_latency);
+    d3d11_draw_instancer__init(&inst->draw_instancer, translation, device);
+    if (!d3d11_indirect_draws__init(&inst->indirect_draws, translation, device))
+    {
+        tm_logger_api->print(TM_LOG_TYPE_ERROR,
+            "Failed to create the indirect draw compaction shader, indirect draws with a count buffer are skipped");
+    }
+    memset(&inst->stats, 0, sizeof(inst->stats));
+    memset(&inst->resources.stats, 0, sizeof(inst->resources.stats));
+    inst->allocation_check_warmup = TM_D3D11_ALLOCATION_CHECK_WARMUP;
+}
+
 static bool
 d3d11__create_device(struct tm_d3d11_backend_o *inst, struct tm_d3d11_device_id device_id)
 {
-    return false;
+    if (inst->device || device_id.opaque >= tm_carray_size(inst->adapters))
+        return false;
+
+    struct d3d11_device_i *device = d3d11_native_device__create(scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_RESOURCES),
+        inst->adapters[device_id.opaque].pAdapter);
+    if (!device)
+        return false;
+
+    d3d11__set_device(inst, device, false);
+    return true;
+}
+
+static bool
+d3d11__create_recording_device(struct tm_d3d11_backend_o *inst)
+{
+    if (inst->device)
+        return false;
+
+    d3d11__set_device(inst, d3d11_recording_device__create(scope_allocator(inst, TM_D3D11_MEMORY_SCOPE_RESOURCES)), true);
+    return true;
 }
 
 static void
 d3d11__destroy_device(struct tm_d3d11_backend_o *inst)
 {
+    if (!inst->device)
+        return;
+
+    release_job_contexts(inst);
+    d3d11_resources__set_device(&inst->resources, 0);
+    inst->resources.upload_ring = 0;
+    inst->resources.constant_arena = 0;
+    if (inst->resources.bindless)
+        d3d11_bindless__shutdown(&inst->bindless);
+    inst->resources.bindless = 0;
+    d3d11_upload_ring__shutdown(&inst->upload_ring);
+    d3d11_upload_ring__shutdown(&inst->constant_arena);
+    d3d11_frame_arena__shutdown(&inst->frame_arena);
+    d3d11_draw_instancer__shutdown(&inst->draw_instancer);
+    d3d11_indirect_draws__shutdown(&inst->indirect_draws);
+    d3d11_gpu_profiler__shutdown(&inst->gpu_profiler);
+    inst->device->destroy(inst->device->inst);
+    inst->device = 0;
+    inst->recording_device = false;
+    inst->deferred_contexts = false;
+}
+
+static void
+d3d11__set_submit_mode(struct tm_d3d11_backend_o *inst, enum tm_d3d11_submit_mode mode)
+{
+    inst->submit_mode = mode;
+}
+
+static enum tm_d3d11_submit_mode
+d3d11__submit_mode(struct tm_d3d11_backend_o *inst)
+{
+    return resolve_submit_mode(inst);
+}
+
+static void
+d3d11__set_max_resource_jobs(struct tm_d3d11_backend_o *inst, uint32_t max_jobs)
+{
+    inst->max_resource_jobs = max_jobs;
+}
+
+static void
+d3d11__set_draw_instancing(struct tm_d3d11_backend_o *inst, const struct tm_d3d11_draw_instancing_t *settings)
+{
+    inst->draw_instancing = *settings;
+    inst->resources.shadow_constants = settings->enabled;
+}
+
+static void
+d3d11__set_shader_draw_instancing(struct tm_d3d11_backend_o *inst, tm_renderer_handle_t shader, bool enabled)
+{
+    d3d11_resources__set_shader_draw_instancing(&inst->resources, shader.resource, enabled);
+}
+
+static void
+d3d11__set_bindless(struct tm_d3d11_backend_o *inst, const struct tm_d3d11_bindless_t *settings)
+{
+    inst->bindless_settings = *settings;
+}
+
+static uint32_t
+d3d11__bindless_handle(struct tm_d3d11_backend_o *inst, tm_renderer_handle_t resource)
+{
+    return d3d11_resources__bindless_handle(&inst->resources, resource.resource);
+}
+
+static void
+d3d11__set_memory_budget_source(struct tm_d3d11_backend_o *inst, const struct tm_d3d11_memory_budget_source_i *source)
+{
+    inst->memory_budget_source = source ? *source : (struct tm_d3d11_memory_budget_source_i) { 0 };
+    inst->memory_budget_countdown = 0;
+}
+
+static void
+d3d11__set_texture_streaming(struct tm_d3d11_backend_o *inst, const struct tm_d3d11_texture_streaming_t *settings)
+{
+    struct tm_d3d11_texture_streaming_t *s = &inst->resources.streaming;
+    s->enabled = settings->enabled;
+    if (settings->resident_mip_size)
+        s->resident_mip_size = settings->resident_mip_size;
+    if (settings->upload_budget)
+        s->upload_budget = settings->upload_budget;
+}
+
+static void
+d3d11__set_image_stream_priority(struct tm_d3d11_backend_o *inst, tm_renderer_handle_t image, float priority)
+{
+    d3d11_resources__set_stream_priority(&inst->resources, image.resource, priority);
+}
+
+static void
+d3d11__set_gpu_timing_latency(struct tm_d3d11_backend_o *inst, uint32_t num_submits)
+{
+    inst->gpu_timing_latency = num_submits;
+    if (inst->device)
+        d3d11_gpu_profiler__set_num_frames(&inst->gpu_profiler, num_submits);
+}
+
+static void
+d3d11__set_max_frame_latency(struct tm_d3d11_backend_o *inst, tm_renderer_handle_t swap_chain,
+    uint32_t max_frame_latency)
+{
+    struct d3d11_swap_chain_i *s = d3d11_resources__swap_chain(&inst->resources, swap_chain.resource);
+    if (s)
+        s->set_max_frame_latency(s->inst, max_frame_latency);
+}
+
+static bool
+d3d11__wait_for_swap_chain(struct tm_d3d11_backend_o *inst, tm_renderer_handle_t swap_chain, float timeout)
+{
+    struct d3d11_swap_chain_i *s = d3d11_resources__swap_chain(&inst->resources, swap_chain.resource);
+    if (!s)
+        return false;
+
+    const uint32_t timeout_ms = timeout > 0.0f ? (uint32_t)(timeout * 1000.0f + 0.5f) : 0;
+    return s->wait_until_ready(s->inst, timeout_ms);
+}
+
+static uint32_t
+d3d11__gpu_timings(struct tm_d3d11_backend_o *inst, struct tm_d3d11_gpu_scope_timing_t *scopes, uint32_t max_scopes,
+    uint64_t *submit)
+{
+    const struct d3d11_gpu_profiler_t *p = &inst->gpu_profiler;
+    const uint32_t n = (uint32_t)tm_carray_size(p->timings);
+    if (scopes)
+        memcpy(scopes, p->timings, tm_min(n, max_scopes) * sizeof(*scopes));
+    if (submit)
+        *submit = p->timings_submit;
+    return n;
+}
+
+static bool
+d3d11__reload_shader(struct tm_d3d11_backend_o *inst, tm_renderer_handle_t shader, const tm_renderer_shader_blob_t *blobs)
+{
+    return d3d11_resources__reload_shader(&inst->resources, shader.resource, blobs);
+}
+
+static void
+d3d11__statistics(struct tm_d3d11_backend_o *inst, struct tm_d3d11_statistics_t *stats)
+{
+    *stats = inst->stats;
+    stats->num_buffers = d3d11_resources__num_live(&inst->resources, RESOURCE_POOL__BUFFER);
+    stats->num_images = d3d11_resources__num_live(&inst->resources, RESOURCE_POOL__IMAGE);
+    stats->num_samplers = d3d11_resources__num_live(&inst->resources, RESOURCE_POOL__SAMPLER);
+    stats->num_shaders = d3d11_resources__num_live(&inst->resources, RESOURCE_POOL__SHADER);
+    stats->num_resource_binders = d3d11_resources__num_live(&inst->resources, RESOURCE_POOL__RESOURCE_BINDER);
+    stats->num_stale_handles = atomic_load_uint64_t(&inst->resources.num_stale_handles);
+    stats->num_resource_commands = inst->resources.stats.num_commands;
+    stats->num_resource_job_commands = inst->resources.stats.num_job_commands;
+    stats->constant_arena_bytes = inst->resources.stats.constant_arena_bytes;
+    stats->num_pooled_constant_buffers = inst->resources.stats.num_pooled_constant_buffers;
+    stats->frame_arena_high_water = inst->frame_arena.stats.high_water;
+    stats->num_frame_arena_overflows = inst->frame_arena.stats.num_overflows;
+    stats->num_frame_arena_stalls = inst->frame_arena.stats.num_stalls;
+    stats->num_shader_reloads = inst->resources.stats.num_shader_reloads;
+    stats->bindless_heap_bytes = inst->bindless.stats.heap_bytes;
+    stats->bindless_bytes_copied = inst->bindless.stats.bytes_copied;
+    stats->num_bindless_image_copies = inst->bindless.stats.num_image_copies;
+    stats->num_indirect_args_skipped = inst->indirect_draws.num_args_skipped;
+    stats->upload_bytes = inst->upload_ring.stats.bytes_uploaded;
+    stats->num_upload_wraps = inst->upload_ring.stats.num_wraps;
+    stats->num_upload_wrap_stalls = inst->upload_ring.stats.num_wrap_stalls;
+    stats->upload_stall_seconds = inst->upload_ring.stats.stall_seconds;
+    stats->num_state_objects = inst->resources.state_cache.num_objects;
+    stats->num_state_cache_hits = inst->resources.state_cache.stats.num_hits;
+    stats->num_state_cache_misses = inst->resources.state_cache.stats.num_misses;
+    stats->num_gpu_timings_dropped = inst->gpu_profiler.num_dropped;
+    stats->memory_budget = inst->memory_budget;
+    stats->resident_bytes = inst->resources.residency.resident_bytes;
+    stats->evicted_bytes = inst->resources.residency.evicted_bytes;
+    stats->num_evictions = inst->resources.residency.num_evictions;
+    stats->num_restores = inst->resources.residency.num_restores;
+    stats->streaming_pending_bytes = inst->resources.streamer.pending_bytes;
+    stats->streaming_uploaded_bytes = inst->resources.streamer.uploaded_bytes;
+    memcpy(stats->streaming_resident_mips, inst->resources.streamer.resident_mips, sizeof(stats->streaming_resident_mips));
+
+    if (inst->recording_device)
+    {
+        struct d3d11_recording_statistics_t rs;
+        d3d11_recording_device__statistics(inst->device, &rs);
+        stats->num_device_calls = rs.num_calls;
+    }
+}
+
+static void
+d3d11__memory_statistics(struct tm_d3d11_backend_o *inst, struct tm_d3d11_memory_statistics_t *stats)
+{
+    for (uint32_t i = 0; i != TM_D3D11_MEMORY_SCOPE_COUNT; ++i)
+    {
+        struct d3d11_memory_counters_t *c = scope_counters(inst, i);
+        stats->scopes[i] = (struct tm_d3d11_memory_scope_statistics_t) {
+            .name              = memory_scope_names[i],
+            .live_bytes        = atomic_load_uint64_t(&c->live_bytes),
+            .peak_bytes        = atomic_load_uint64_t(&c->peak_bytes),
+            .num_allocations   = atomic_load_uint64_t(&c->num_allocations),
+            .frame_allocations = inst->frame_allocations[i],
+        };
+    }
+    stats->num_allocating_frames = inst->num_allocating_frames;
+}
 
+static void
+d3d11__set_allocation_check(struct tm_d3d11_backend_o *inst, bool enabled)
+{
+    inst->allocation_check = enabled;
+    inst->allocation_check_warmup = TM_D3D11_ALLOCATION_CHECK_WARMUP;
 }
 
 
@@ -311,14 +1349,45 @@ d3d11__destroy_device(struct tm_d3d11_backend_o *inst)
 
 struct d3d11_shader_compiler_o
 {
+    // Allocator the compiler was created with, and the shader cache scope allocator everything
+    // else is allocated with.
+    struct tm_allocator_i *parent;
     struct tm_allocator_i *allocator;
+    struct d3d11_memory_scope_t memory;
+
+    const struct tm_d3d11_bytecode_compiler_i *compiler;
+
+    bool use_cache;
+
+    // Copied from `tm_d3d11_shader_compiler_config_t.bindless`.
+    bool bindless;
+    TM_PAD(6);
+    struct d3d11_shader_cache_t cache;
+
+    atomic_uint64_t num_failures;
 };
 
+// Set by `configure_shader_compiler()`, `cache_path` points to `shader_cache_path`.
+static struct tm_d3d11_shader_compiler_config_t shader_compiler_config;
+static char shader_cache_path[1024];
+
 static struct tm_renderer_shader_compiler_o *
 shader_compiler__init(struct tm_allocator_i *allocator)
 {
     struct d3d11_shader_compiler_o *o = tm_alloc(allocator, sizeof(*o));
-    o->allocator = allocator;
+    memset(o, 0, sizeof(*o));
+    o->parent = allocator;
+    d3d11_memory_scope__init(&o->memory, allocator, memory_scope_names[TM_D3D11_MEMORY_SCOPE_SHADER_CACHE],
+        &shader_compiler_memory);
+    o->allocator = &o->memory.allocator;
+
+    const struct tm_d3d11_shader_compiler_config_t *config = &shader_compiler_config;
+    o->compiler = config->compiler ? config->compiler : d3d11_bytecode_compiler__default();
+    o->use_cache = config->cache_path != 0;
+    o->bindless = config->bindless;
+    if (o->use_cache)
+        d3d11_shader_cache__open(&o->cache, o->allocator, config->cache_path, config->max_cache_size);
+
     return (struct tm_renderer_shader_compiler_o *) o;
 }
 
@@ -326,7 +1395,10 @@ static void
 shader_compiler__shutdown(struct tm_renderer_shader_compiler_o *inst)
 {
     struct d3d11_shader_compiler_o *o = (struct d3d11_shader_compiler_o *) inst;
-    tm_free(o->allocator, o, sizeof(*o));
+    if (o->use_cache)
+        d3d11_shader_cache__close(&o->cache);
+    d3d11_memory_scope__shutdown(&o->memory);
+    tm_free(o->parent, o, sizeof(*o));
 }
 
 static const uint32_t supported_block_types[] = {
@@ -464,24 +1536,45 @@ shader_compiler__enum_value(struct tm_renderer_shader_compiler_o *inst, uint32_t
 static bool
 shader_compiler__bindless(struct tm_renderer_shader_compiler_o *inst)
 {
-    return false;
+    const struct d3d11_shader_compiler_o *o = (const struct d3d11_shader_compiler_o *) inst;
+    return o->bindless;
 }
 
+// Bindless resources live in register space 0, at the registers the backend binds them to, see
+// `d3d11_bindless.h`.
 static tm_renderer_bindless_accessor_t
-shader_compiler__bindless_access_buffer(struct tm_renderer_shader_compiler_o *inst, uint32_t usage_flags)
+bindless_accessor(uint32_t binding)
 {
-    tm_renderer_bindless_accessor_t ba = {0};
+    tm_renderer_bindless_accessor_t ba = { 0 };
+    ba.set = 0;
+    ba.binding = binding;
     return ba;
 }
 
+// Buffers are read from the heap. The heap is read-only, written buffers have no bindless access.
+static tm_renderer_bindless_accessor_t
+shader_compiler__bindless_access_buffer(struct tm_renderer_shader_compiler_o *inst, uint32_t usage_flags)
+{
+    tm_renderer_bindless_accessor_t ba = { 0 };
+    if (!shader_compiler__bindless(inst) || (usage_flags & TM_RENDERER_BUFFER_USAGE_UAV))
+        return ba;
+    return bindless_accessor(BINDLESS_HEAP_REGISTER);
+}
+
+// Only sampled 2D images are pooled. The accessor points at the first pool, the handle selects
+// the pool and the slice.
 static tm_renderer_bindless_accessor_t
 shader_compiler__bindless_access_image(struct tm_renderer_shader_compiler_o *inst, uint32_t type,
     uint32_t usage_flags)
 {
     tm_renderer_bindless_accessor_t ba = { 0 };
-    return ba;
+    const uint32_t written = TM_RENDERER_IMAGE_USAGE_RENDER_TARGET | TM_RENDERER_IMAGE_USAGE_UAV;
+    if (!shader_compiler__bindless(inst) || type != TM_RENDERER_IMAGE_TYPE_2D || (usage_flags & written))
+        return ba;
+    return bindless_accessor(BINDLESS_HEAP_REGISTER + 1);
 }
 
+// Samplers are bound through resource binders and D3D11 has no acceleration structures.
 static tm_renderer_bindless_accessor_t
 shader_compiler__bindless_access_sampler(struct tm_renderer_shader_compiler_o *inst)
 {
@@ -500,7 +1593,43 @@ static struct tm_renderer_shader_blob_t
 shader_compiler__compile_state_block(struct tm_renderer_shader_compiler_o *inst, uint32_t bind_type,
     uint32_t block_type, const tm_renderer_state_value_pair_t *states, uint32_t num_raster_states)
 {
+    struct d3d11_shader_compiler_o *o = (struct d3d11_shader_compiler_o *) inst;
+    return d3d11_state_block__compile(o->allocator, block_type, states, num_raster_states);
+}
+
+static struct tm_renderer_shader_blob_t
+compile_source(struct d3d11_shader_compiler_o *o, const char *source, const char *entry_point, uint32_t source_language,
+    uint32_t stage)
+{
+    const struct tm_d3d11_bytecode_compiler_i *compiler = o->compiler;
     struct tm_renderer_shader_blob_t blob = { 0 };
+
+    // Cached bytecode is owned by the cache, `release_blob()` leaves it alone.
+    struct d3d11_shader_key_t key;
+    if (o->use_cache)
+    {
+        key = d3d11_shader_cache__key(source, entry_point, source_language, stage, compiler->version);
+        blob.data = (void *)d3d11_shader_cache__find(&o->cache, &key, &blob.size);
+        if (blob.data)
+            return blob;
+    }
+
+    void *bytecode = compiler->compile(compiler->inst, source, entry_point, stage, o->allocator, &blob.size);
+    if (!bytecode)
+    {
+        atomic_fetch_add_uint64_t(&o->num_failures, 1);
+        blob.size = 0;
+        return blob;
+    }
+
+    if (!o->use_cache)
+    {
+        blob.data = bytecode;
+        return blob;
+    }
+
+    blob.data = (void *)d3d11_shader_cache__insert(&o->cache, &key, bytecode, blob.size);
+    tm_free(o->allocator, bytecode, blob.size);
     return blob;
 }
 
@@ -508,14 +1637,25 @@ static struct tm_renderer_shader_blob_t
 shader_compiler__compile_shader(struct tm_renderer_shader_compiler_o *inst, const char *source,
     const char *entry_point, uint32_t source_language, uint32_t stage)
 {
-    struct tm_renderer_shader_blob_t blob = { 0 };
+    struct d3d11_shader_compiler_o *o = (struct d3d11_shader_compiler_o *) inst;
+    if (!o->bindless)
+        return compile_source(o, source, entry_point, source_language, stage);
+
+    // The bindless declarations are part of the source, and so of the cache key.
+    TM_INIT_TEMP_ALLOCATOR(ta);
+    const char *full_source = tm_temp_allocator_api->printf(ta, "%s%s", d3d11_bindless__hlsl(), source);
+    const struct tm_renderer_shader_blob_t blob = compile_source(o, full_source, entry_point, source_language, stage);
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
     return blob;
 }
 
 static void
 shader_compiler__release_blob(struct tm_renderer_shader_compiler_o *inst, tm_renderer_shader_blob_t blob)
 {
-
+    struct d3d11_shader_compiler_o *o = (struct d3d11_shader_compiler_o *) inst;
+    if (!blob.data || (o->use_cache && d3d11_shader_cache__owns(&o->cache, blob.data)))
+        return;
+    tm_free(o->allocator, blob.data, blob.size);
 }
 
 static struct tm_renderer_shader_compiler_api d3d11_shader_compiler = {
@@ -540,7 +1680,7 @@ static struct tm_renderer_shader_compiler_api d3d11_shader_compiler = {
     // Shader compilation
     .compile_shader        = shader_compiler__compile_shader,
 
-    // Bindless (D3D11 don't support)
+    // Bindless, emulated, see `tm_d3d11_bindless_t`
     .bindless                               = shader_compiler__bindless,
     .bindless_access_buffer                 = shader_compiler__bindless_access_buffer,
     .bindless_access_image                  = shader_compiler__bindless_access_image,
@@ -561,17 +1701,61 @@ api__create_backend(struct tm_allocator_i *allocator, struct tm_error_i *error)
     struct tm_d3d11_backend_o *o = tm_alloc(&a, sizeof(*o));
     memset(o, 0, sizeof(*o));
 
-    o->i.inst                    = o;
-    o->i.init                    = d3d11__init;
-    o->i.shutdown                = d3d11__shutdown;
-    o->i.agnostic_render_backend = d3d11__agnostic_render_backend;
-    o->i.num_physical_devices    = d3d11__num_physical_devices;
-    o->i.physical_device_name    = d3d11__physical_device_name;
-    o->i.physical_device_id      = d3d11__physical_device_id;
-    o->i.create_device           = d3d11__create_device;
-    o->i.destroy_device          = d3d11__destroy_device;
+    o->i.inst                       = o;
+    o->i.init                       = d3d11__init;
+    o->i.shutdown                   = d3d11__shutdown;
+    o->i.agnostic_render_backend    = d3d11__agnostic_render_backend;
+    o->i.num_physical_devices       = d3d11__num_physical_devices;
+    o->i.physical_device_name       = d3d11__physical_device_name;
+    o->i.physical_device_id         = d3d11__physical_device_id;
+    o->i.physical_device_desc       = d3d11__physical_device_desc;
+    o->i.set_adapter_scorer         = d3d11__set_adapter_scorer;
+    o->i.create_device              = d3d11__create_device;
+    o->i.create_recording_device    = d3d11__create_recording_device;
+    o->i.destroy_device             = d3d11__destroy_device;
+    o->i.set_submit_mode            = d3d11__set_submit_mode;
+    o->i.submit_mode                = d3d11__submit_mode;
+    o->i.set_max_resource_jobs      = d3d11__set_max_resource_jobs;
+    o->i.set_draw_instancing        = d3d11__set_draw_instancing;
+    o->i.set_shader_draw_instancing = d3d11__set_shader_draw_instancing;
+    o->i.set_bindless               = d3d11__set_bindless;
+    o->i.bindless_handle            = d3d11__bindless_handle;
+    o->i.set_max_frame_latency      = d3d11__set_max_frame_latency;
+    o->i.wait_for_swap_chain        = d3d11__wait_for_swap_chain;
+    o->i.set_memory_budget_source   = d3d11__set_memory_budget_source;
+    o->i.set_texture_streaming      = d3d11__set_texture_streaming;
+    o->i.set_image_stream_priority  = d3d11__set_image_stream_priority;
+    o->i.set_gpu_timing_latency     = d3d11__set_gpu_timing_latency;
+    o->i.gpu_timings                = d3d11__gpu_timings;
+    o->i.reload_shader              = d3d11__reload_shader;
+    o->i.statistics                 = d3d11__statistics;
+    o->i.memory_statistics          = d3d11__memory_statistics;
+    o->i.set_allocation_check       = d3d11__set_allocation_check;
+
+    o->allocator                   = a;
+    o->gpu_timing_latency          = DEFAULT_GPU_TIMING_LATENCY;
+    o->adapter_scorer.score        = default_adapter_score;
+
+    for (uint32_t i = 0; i != TM_D3D11_MEMORY_SCOPE_COUNT; ++i)
+    {
+        if (i != TM_D3D11_MEMORY_SCOPE_SHADER_CACHE)
+            d3d11_memory_scope__init(&o->memory[i], &o->allocator, memory_scope_names[i], &o->memory_counters[i]);
+    }
 
-    o->allocator                 = a;
+    o->render_backend = (struct tm_renderer_backend_i) {
+        .inst                             = (struct tm_renderer_backend_o *)o,
+        .create_swap_chain                = render_backend__create_swap_chain,
+        .destroy_swap_chain               = render_backend__destroy_swap_chain,
+        .resize_swap_chain                = render_backend__resize_swap_chain,
+        .present_swap_chain               = render_backend__present_swap_chain,
+        .create_command_buffers           = render_backend__create_command_buffers,
+        .submit_command_buffers           = render_backend__submit_command_buffers,
+        .destroy_command_buffers          = render_backend__destroy_command_buffers,
+        .create_resource_command_buffers  = render_backend__create_resource_command_buffers,
+        .submit_resource_command_buffers  = render_backend__submit_resource_command_buffers,
+        .destroy_resource_command_buffers = render_backend__destroy_resource_command_buffers,
+        .read_complete                    = render_backend__read_complete,
+    };
 
     return &o->i;
 }
@@ -580,6 +1764,12 @@ static void
 api__destroy_backend(struct tm_d3d11_backend_i *backend)
 {
     struct tm_d3d11_backend_o *o = backend->inst;
+    for (uint32_t i = 0; i != TM_D3D11_MEMORY_SCOPE_COUNT; ++i)
+    {
+        if (i != TM_D3D11_MEMORY_SCOPE_SHADER_CACHE)
+            d3d11_memory_scope__shutdown(&o->memory[i]);
+    }
+
     struct tm_allocator_i a = o->allocator;
     tm_free(&a, o, sizeof(*o));
     tm_allocator_api->destroy_child(&a);
@@ -591,10 +1781,120 @@ api__shader_compiler(void)
     return &d3d11_shader_compiler;
 }
 
+// Shared by the jobs of a `compile_shaders()` call. Each job keeps taking the next request until
+// all are taken, which balances shaders of very different compile times.
+struct compile_shaders_t
+{
+    struct tm_renderer_shader_compiler_o *compiler;
+    const struct tm_d3d11_shader_compile_request_t *requests;
+    tm_renderer_shader_blob_t *results;
+    uint32_t num_requests;
+    atomic_uint32_t next;
+};
+
+static void
+compile_shaders_job(void *data)
+{
+    struct compile_shaders_t *c = data;
+    for (uint32_t i = atomic_fetch_add_uint32_t(&c->next, 1); i < c->num_requests;
+         i = atomic_fetch_add_uint32_t(&c->next, 1))
+    {
+        const struct tm_d3d11_shader_compile_request_t *r = c->requests + i;
+        c->results[i] = shader_compiler__compile_shader(c->compiler, r->source, r->entry_point, r->source_language,
+            r->stage);
+    }
+}
+
+static void
+api__compile_shaders(struct tm_renderer_shader_compiler_o *inst, const struct tm_d3d11_shader_compile_request_t *requests,
+    uint32_t num_requests, tm_renderer_shader_blob_t *results, uint32_t max_jobs)
+{
+    struct compile_shaders_t c = {
+        .compiler     = inst,
+        .requests     = requests,
+        .results      = results,
+        .num_requests = num_requests,
+    };
+
+    uint32_t num_jobs = tm_min(num_requests, tm_os_api->info->num_logical_processors());
+    if (max_jobs)
+        num_jobs = tm_min(num_jobs, max_jobs);
+    if (num_jobs <= 1)
+    {
+        compile_shaders_job(&c);
+        return;
+    }
+
+    TM_INIT_TEMP_ALLOCATOR(ta);
+    tm_jobdecl_t *jobs = tm_temp_alloc(ta, num_jobs * sizeof(*jobs));
+    for (uint32_t i = 0; i != num_jobs; ++i)
+        jobs[i] = (tm_jobdecl_t) { .task = compile_shaders_job, .data = &c };
+
+    tm_atomic_counter_o *counter = tm_job_system_api->run_jobs(jobs, num_jobs);
+    tm_job_system_api->wait_for_counter_and_free(counter);
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+}
+
+static void
+api__configure_shader_compiler(const struct tm_d3d11_shader_compiler_config_t *config)
+{
+    shader_compiler_config = *config;
+
+    if (config->cache_path)
+    {
+        if (strlen(config->cache_path) >= sizeof(shader_cache_path))
+        {
+            tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Shader cache path too long: %s", config->cache_path);
+            shader_compiler_config.cache_path = 0;
+            return;
+        }
+        strcpy(shader_cache_path, config->cache_path);
+        shader_compiler_config.cache_path = shader_cache_path;
+    }
+}
+
+static void
+api__shader_compiler_statistics(struct tm_renderer_shader_compiler_o *inst,
+    struct tm_d3d11_shader_compiler_statistics_t *stats)
+{
+    struct d3d11_shader_compiler_o *o = (struct d3d11_shader_compiler_o *) inst;
+    *stats = (struct tm_d3d11_shader_compiler_statistics_t) {
+        .num_cache_hits   = o->cache.stats.num_hits,
+        .num_cache_misses = o->cache.stats.num_misses,
+        .num_failures     = atomic_load_uint64_t(&o->num_failures),
+        .num_evictions    = o->cache.stats.num_evictions,
+        .cache_size       = o->cache.size,
+    };
+}
+
+// The public pairs are handed to the radix sort as they are.
+TM_STATIC_ASSERT(sizeof(struct tm_d3d11_sort_pair_t) == sizeof(struct d3d11_sort_pair_t));
+TM_STATIC_ASSERT(offsetof(struct tm_d3d11_sort_pair_t, key) == offsetof(struct d3d11_sort_pair_t, key));
+TM_STATIC_ASSERT(offsetof(struct tm_d3d11_sort_pair_t, command) == offsetof(struct d3d11_sort_pair_t, command));
+
+static struct tm_d3d11_sort_pair_t *
+api__sort_commands(struct tm_d3d11_sort_pair_t *pairs, uint32_t num_pairs, void *memory, uint32_t max_jobs)
+{
+    return (struct tm_d3d11_sort_pair_t *)d3d11_radix_sort__sort((struct d3d11_sort_pair_t *)pairs, num_pairs, memory,
+        max_jobs);
+}
+
 static struct tm_d3d11_api tm_d3d11_api_instance = {
-    .create_backend  = api__create_backend,
-    .destroy_backend = api__destroy_backend,
-    .shader_compiler = api__shader_compiler,
+    .create_backend              = api__create_backend,
+    .destroy_backend             = api__destroy_backend,
+    .shader_compiler             = api__shader_compiler,
+    .compile_shaders             = api__compile_shaders,
+    .configure_shader_compiler   = api__configure_shader_compiler,
+    .shader_compiler_statistics  = api__shader_compiler_statistics,
+    .create_shader_reloader      = d3d11_shader_reloader__create,
+    .destroy_shader_reloader     = d3d11_shader_reloader__destroy,
+    .watch_shader                = d3d11_shader_reloader__watch,
+    .unwatch_shader              = d3d11_shader_reloader__unwatch,
+    .begin_shader_reload         = d3d11_shader_reloader__begin,
+    .end_shader_reload           = d3d11_shader_reloader__end,
+    .shader_reload_statistics    = d3d11_shader_reloader__statistics,
+    .sort_commands_memory_needed = d3d11_radix_sort__memory_needed,
+    .sort_commands               = api__sort_commands,
 };
 
 struct tm_d3d11_api *tm_d3d11_api = &tm_d3d11_api_instance;
@@ -606,10 +1906,15 @@ TM_DLL_EXPORT void tm_load_plugin(struct tm_api_registry_api *reg, bool load)
     // foundation apis
     tm_allocator_api           = reg->get(TM_ALLOCATOR_API_NAME);
     tm_error_api               = reg->get(TM_ERROR_API_NAME);
+    tm_job_system_api          = reg->get(TM_JOB_SYSTEM_API_NAME);
     tm_logger_api              = reg->get(TM_LOGGER_API_NAME);
+    tm_os_api                  = reg->get(TM_OS_API_NAME);
     tm_sprintf_api             = reg->get(TM_SPRINTF_API_NAME);
     tm_temp_allocator_api      = reg->get(TM_TEMP_ALLOCATOR_API_NAME);
     tm_unicode_api             = reg->get(TM_UNICODE_API_NAME);
 
+    // other plugin apis
+    tm_renderer_api            = reg->get(TM_RENDERER_API_NAME);
+
     tm_set_or_remove_api(reg, load, TM_D3D11_API_NAME, tm_d3d11_api);
 }
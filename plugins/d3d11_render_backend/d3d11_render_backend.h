@@ -5,6 +5,7 @@
 
 struct tm_allocator_i;
 struct tm_error_i;
+struct tm_renderer_shader_compiler_o;
 
 // Create / Destroy devices
 
@@ -15,6 +16,11 @@ enum tm_d3d11_device_flag
 
     // Set to include integrated GPUs when reasoning about physical device.
     TM_D3D11_DEVICE_FLAG_INTEGRATED = 0x2,
+
+    // Set to include software adapters, like the "Microsoft Basic Render Driver" (WARP), when
+    // reasoning about physical device. They are left out unless this is set, also when no flags
+    // are set. Lets the backend run on machines without a GPU, such as build agents.
+    TM_D3D11_DEVICE_FLAG_SOFTWARE   = 0x4,
 };
 
 struct tm_d3d11_device_id
@@ -22,6 +28,441 @@ struct tm_d3d11_device_id
     uint32_t opaque;
 };
 
+enum tm_d3d11_adapter_type
+{
+    TM_D3D11_ADAPTER_TYPE_DISCRETE_GPU = 0,
+    TM_D3D11_ADAPTER_TYPE_INTEGRATED_GPU,
+    TM_D3D11_ADAPTER_TYPE_SOFTWARE,
+};
+
+// Description of a physical device, read once when the backend is initialized.
+struct tm_d3d11_adapter_desc_t
+{
+    const char *name;
+    uint32_t vendor_id;
+    uint32_t device_id;
+
+    // Integrated GPUs are told apart from discrete ones by their dedicated video memory, so an
+    // integrated GPU with a large carve-out may be reported as discrete.
+    enum tm_d3d11_adapter_type type;
+
+    // Position of the adapter in the DXGI enumeration. If `gpu_preference` is set, the adapters were
+    // enumerated by `IDXGIFactory6::EnumAdapterByGpuPreference()`, high performance first, which
+    // takes the per application GPU preference of the user into account.
+    uint32_t enumeration_index;
+    bool gpu_preference;
+    TM_PAD(7);
+
+    // Memory sizes reported by `DXGI_ADAPTER_DESC1`, in bytes.
+    uint64_t dedicated_video_memory;
+    uint64_t dedicated_system_memory;
+    uint64_t shared_system_memory;
+
+    // Locally unique identifier of the adapter, stable until reboot.
+    uint64_t luid;
+};
+
+// Ranks physical devices. Devices are numbered by descending score, so device 0 is the best one
+// that fulfills the `required_device_flags`.
+struct tm_d3d11_adapter_scorer_i
+{
+    void *inst;
+
+    double (*score)(void *inst, const struct tm_d3d11_adapter_desc_t *adapter);
+};
+
+// Command submission
+
+// How `submit_command_buffers()` turns the sorted commands into D3D11 calls. Large submits are split
+// into ranges that are translated on the job system, one D3D11 context per job, and executed on the
+// immediate context in order.
+enum tm_d3d11_submit_mode
+{
+    // Uses `TM_D3D11_SUBMIT_MODE_DEFERRED_CONTEXTS` if the driver builds command lists natively,
+    // `TM_D3D11_SUBMIT_MODE_EMULATED` otherwise.
+    TM_D3D11_SUBMIT_MODE_DEFAULT = 0,
+
+    // Translates all commands on the calling thread, straight into the immediate context.
+    TM_D3D11_SUBMIT_MODE_SINGLE_THREADED,
+
+    // Translates into D3D11 deferred contexts and executes the resulting command lists. Falls back
+    // to `TM_D3D11_SUBMIT_MODE_EMULATED` on devices without deferred contexts.
+    TM_D3D11_SUBMIT_MODE_DEFERRED_CONTEXTS,
+
+    // Translates into the backend's own command streams and replays them on the immediate context.
+    TM_D3D11_SUBMIT_MODE_EMULATED,
+};
+
+// Texture streaming
+
+// Most mip levels an image can have.
+#define TM_D3D11_MAX_MIP_LEVELS 16
+
+struct tm_d3d11_texture_streaming_t
+{
+    // Images created while this is set stream their mips, see `set_texture_streaming()`.
+    bool enabled;
+    TM_PAD(3);
+
+    // Mips whose width and height are at most this many pixels are uploaded when the image is
+    // created. The default is 64.
+    uint32_t resident_mip_size;
+
+    // Bytes of mip data uploaded per submit. A mip larger than this is uploaded on its own. The
+    // default is 4 MB.
+    uint64_t upload_budget;
+};
+
+// Draw instancing
+
+// Settings of `set_draw_instancing()`.
+struct tm_d3d11_draw_instancing_t
+{
+    bool enabled;
+    TM_PAD(3);
+
+    // Constant buffer register (`b#`) of the per-draw constants of instanced shaders.
+    uint32_t constant_buffer_slot;
+
+    // Shader resource register (`t#`) the gathered per-draw constants are bound to, as a
+    // `ByteAddressBuffer` with one record per instance. A record is as large as the constant buffer,
+    // rounded up to 16 bytes.
+    uint32_t instance_buffer_slot;
+};
+
+// Bindless
+
+// Bindless handle of resources that have none, see `bindless_handle()`.
+#define TM_D3D11_INVALID_BINDLESS_HANDLE 0xffffffff
+
+// Settings of `set_bindless()`.
+struct tm_d3d11_bindless_t
+{
+    bool enabled;
+    TM_PAD(3);
+
+    // Size of the heap storage buffers are copied to. 0 uses the default of 64 MB.
+    uint32_t heap_size;
+};
+
+// Statistics
+
+struct tm_d3d11_statistics_t
+{
+    // Command translation, accumulated over all calls to `submit_command_buffers()`.
+    uint64_t num_submits;
+    uint64_t num_commands;
+    uint64_t num_draw_calls;
+    uint64_t num_dispatches;
+    uint64_t num_skipped_commands;
+
+    // Number of calls made on the device context. Only counted by the recording device.
+    uint64_t num_device_calls;
+
+    // Number of command ranges translated on jobs and executed as command lists, natively or
+    // emulated.
+    uint64_t num_command_lists;
+
+    // Number of state calls (shaders, buffers, views, samplers and fixed function state) made on
+    // the device context and the number of redundant ones the backend dropped instead. Adjacent
+    // slots bound by separate commands are merged and count as one issued call.
+    uint64_t num_state_calls_issued;
+    uint64_t num_state_calls_filtered;
+
+    // Instanced draws issued for runs of compatible draws, and the number of draws they replaced.
+    // See `set_draw_instancing()`.
+    uint64_t num_instanced_draws;
+    uint64_t num_merged_draws;
+
+    // Indirect draw calls issued, a multi-draw issues one per argument, and the number of
+    // arguments dropped by the GPU compaction of multi-draws because they were past the draw count
+    // or drew nothing. Dropped arguments are read back from the GPU a few submits late.
+    uint64_t num_indirect_draws;
+    uint64_t num_indirect_args_skipped;
+
+    // Constant buffer bind calls made on the device context. On devices with constant buffer
+    // offsets, small constant buffers are suballocated from a per-frame arena, which took
+    // `constant_arena_bytes` in the latest submit. Without them, constant buffers come from a pool
+    // of buffers by size class and `num_pooled_constant_buffers` were created from the pool.
+    uint64_t num_constant_buffer_binds;
+    uint64_t constant_arena_bytes;
+    uint64_t num_pooled_constant_buffers;
+
+    // Per-frame data of submits, like the sorted commands, is bump allocated from a frame arena of
+    // three 8 MB regions used in turn, each reset once the GPU has retired its previous frame.
+    // `frame_arena_high_water` is the most a submit has asked for, a size for the regions that
+    // would have fit every submit. Allocations that didn't fit fell back to the heap, and stalls
+    // are submits that waited for the GPU to retire a region.
+    uint64_t frame_arena_high_water;
+    uint64_t num_frame_arena_overflows;
+    uint64_t num_frame_arena_stalls;
+
+    // Shaders whose programs were replaced by `reload_shader()`.
+    uint64_t num_shader_reloads;
+
+    // Bindless emulation: bytes of the heap taken by buffers, bytes copied to the heap and images
+    // copied to the image pools. See `set_bindless()`.
+    uint64_t bindless_heap_bytes;
+    uint64_t bindless_bytes_copied;
+    uint64_t num_bindless_image_copies;
+
+    // Total time spent sorting and translating commands.
+    double translation_seconds;
+
+    // Resource commands executed by `submit_resource_command_buffers()`, how many of them ran on
+    // jobs, and the total time spent executing them.
+    uint64_t num_resource_commands;
+    uint64_t num_resource_job_commands;
+    double resource_seconds;
+
+    // Live resources per type.
+    uint32_t num_buffers;
+    uint32_t num_images;
+    uint32_t num_samplers;
+    uint32_t num_shaders;
+    uint32_t num_resource_binders;
+    TM_PAD(4);
+
+    // Number of times a stale or unknown resource handle was looked up.
+    uint64_t num_stale_handles;
+
+    // Bytes streamed through the upload ring, number of times it wrapped and how many of those
+    // wraps had to wait for the GPU (and for how long).
+    uint64_t upload_bytes;
+    uint64_t num_upload_wraps;
+    uint64_t num_upload_wrap_stalls;
+    double upload_stall_seconds;
+
+    // Number of live D3D11 pipeline and sampler state objects, and how many state lookups found
+    // an existing object or had to create one.
+    uint32_t num_state_objects;
+    TM_PAD(4);
+    uint64_t num_state_cache_hits;
+    uint64_t num_state_cache_misses;
+
+    // Number of submits whose GPU timings were thrown away, because the GPU was still more than
+    // the GPU timing latency behind or the timestamps were disjoint.
+    uint64_t num_gpu_timings_dropped;
+
+    // Video memory budget (0 if unknown), video memory taken by buffers and images, and the size
+    // of the images evicted to system memory. See `set_memory_budget_source()`.
+    uint64_t memory_budget;
+    uint64_t resident_bytes;
+    uint64_t evicted_bytes;
+
+    // Number of times images were evicted to system memory and restored.
+    uint64_t num_evictions;
+    uint64_t num_restores;
+
+    // Texture streaming: mip data waiting to be uploaded and mip data uploaded so far, in bytes,
+    // and the time the latest submit spent uploading mips.
+    uint64_t streaming_pending_bytes;
+    uint64_t streaming_uploaded_bytes;
+    double streaming_upload_seconds;
+
+    // Number of streamed images per finest resident mip, fully resident images at index 0.
+    uint32_t streaming_resident_mips[TM_D3D11_MAX_MIP_LEVELS];
+};
+
+// Memory
+
+// Subsystems whose heap allocations are tracked separately. Each has a child allocator of the
+// allocator passed to `create_backend()`, named like the scope in lower case.
+enum tm_d3d11_memory_scope
+{
+    // Resource pools and handles, device objects and the bindless heap.
+    TM_D3D11_MEMORY_SCOPE_RESOURCES,
+
+    // Command buffers, sorting, translation job contexts, draw instancing, indirect draws and GPU
+    // timings.
+    TM_D3D11_MEMORY_SCOPE_TRANSLATION,
+
+    // Upload ring and constant arena.
+    TM_D3D11_MEMORY_SCOPE_UPLOADS,
+
+    // Shader compilers and their caches. Shader compilers aren't created by a backend, so this
+    // scope is shared by all backends.
+    TM_D3D11_MEMORY_SCOPE_SHADER_CACHE,
+
+    // Enumerated adapters.
+    TM_D3D11_MEMORY_SCOPE_ADAPTERS,
+
+    TM_D3D11_MEMORY_SCOPE_COUNT,
+};
+
+// Submits after enabling the allocation check that may still allocate, while pools and rings grow
+// to their steady-state size. See `set_allocation_check()`.
+#define TM_D3D11_ALLOCATION_CHECK_WARMUP 16
+
+struct tm_d3d11_memory_scope_statistics_t
+{
+    // Static name of the scope.
+    const char *name;
+
+    // Bytes currently allocated and the most ever allocated at once.
+    uint64_t live_bytes;
+    uint64_t peak_bytes;
+
+    // Allocations (reallocations included) made since the backend was created, and during the
+    // latest `submit_command_buffers()`.
+    uint64_t num_allocations;
+    uint64_t frame_allocations;
+};
+
+struct tm_d3d11_memory_statistics_t
+{
+    // Indexed by `enum tm_d3d11_memory_scope`.
+    struct tm_d3d11_memory_scope_statistics_t scopes[TM_D3D11_MEMORY_SCOPE_COUNT];
+
+    // Steady-state submits that allocated, see `set_allocation_check()`.
+    uint64_t num_allocating_frames;
+};
+
+// Video memory budget
+
+// Reports how much video memory the backend may use.
+struct tm_d3d11_memory_budget_source_i
+{
+    void *inst;
+
+    // Returns the budget in bytes, or 0 if there is no limit.
+    uint64_t (*budget)(void *inst);
+};
+
+// GPU timings
+
+// Longest supported GPU timing latency, see `set_gpu_timing_latency()`.
+#define TM_D3D11_MAX_GPU_TIMING_LATENCY 16
+
+// GPU time spent in a statistics scope (`TM_RENDERER_COMMAND_BEGIN_STATISTICS` to
+// `TM_RENDERER_COMMAND_END_STATISTICS`) of a submit.
+struct tm_d3d11_gpu_scope_timing_t
+{
+    // Copied from the `tm_renderer_statistics_scope_command_t` that began the scope. `category` is
+    // expected to be a static string.
+    const char *category;
+    uint64_t scope;
+    uint32_t flags;
+
+    // Number of scopes this scope is nested in.
+    uint32_t depth;
+
+    // Start of the scope, relative to the start of the first scope of the submit, and its duration,
+    // in seconds.
+    double start;
+    double duration;
+};
+
+// Shader compilation
+
+// Compiles shader source to D3D11 bytecode. Called by the shader compiler on shader cache misses.
+struct tm_d3d11_bytecode_compiler_i
+{
+    void *inst;
+
+    // Identifies the compiler and the flags it compiles with. Part of the shader cache key, so that
+    // bytecode produced by another compiler version or with other flags is never reused.
+    uint64_t version;
+
+    // Compiles `entry_point` of `source` for `stage` (`TM_RENDERER_SHADER_STAGE_*`). Returns the
+    // bytecode allocated with `allocator` and stores its size in `size`, or returns NULL on failure.
+    void *(*compile)(void *inst, const char *source, const char *entry_point, uint32_t stage,
+        struct tm_allocator_i *allocator, uint64_t *size);
+};
+
+struct tm_d3d11_shader_compiler_config_t
+{
+    // Pack file compiled bytecode is cached in across runs. NULL disables the cache.
+    const char *cache_path;
+
+    // Size cap of the pack file. The least recently used bytecode is evicted to stay under it. 0
+    // means no limit.
+    uint64_t max_cache_size;
+
+    // Compiler used on cache misses. NULL uses `D3DCompile()` on Windows and a stand-in compiler
+    // that wraps the source in a fake bytecode blob elsewhere.
+    const struct tm_d3d11_bytecode_compiler_i *compiler;
+
+    // Reports the shader compiler as bindless and prepends the declarations of the emulated
+    // bindless heap and image pools to every shader, see `set_bindless()`.
+    bool bindless;
+    TM_PAD(7);
+};
+
+// Shader to compile with `compile_shaders()`, the arguments of `compile_shader()`.
+struct tm_d3d11_shader_compile_request_t
+{
+    const char *source;
+    const char *entry_point;
+    uint32_t source_language;
+    uint32_t stage;
+};
+
+struct tm_d3d11_shader_compiler_statistics_t
+{
+    uint64_t num_cache_hits;
+    uint64_t num_cache_misses;
+
+    // Number of shaders that failed to compile.
+    uint64_t num_failures;
+
+    // Number of shaders evicted from the cache to stay under `max_cache_size`.
+    uint64_t num_evictions;
+
+    // Size the pack file will have when the shader compiler shuts down.
+    uint64_t cache_size;
+};
+
+// Shader hot-reload
+
+// Watches the HLSL sources of shader programs and recompiles the programs whose sources, or any
+// file they `#include`, have changed. The files are only checked when a file system watcher on
+// the reloader's directory reports changes, and only the files of watched shaders are checked.
+// Recompiled programs replace the old ones with `tm_d3d11_backend_i->reload_shader()`.
+struct tm_d3d11_shader_reloader_o;
+
+// Shader program watched by a shader reloader.
+struct tm_d3d11_watched_shader_t
+{
+    // Shader created from the compiled source. Its pipeline states are kept on reload.
+    tm_renderer_handle_t shader;
+    TM_PAD(4);
+
+    // HLSL source file. Quoted `#include`s are resolved relative to the including file.
+    const char *path;
+
+    // Entry point of each stage (`TM_RENDERER_SHADER_STAGE_*`), NULL for stages the shader
+    // doesn't have.
+    const char *entry_points[TM_RENDERER_SHADER_STAGE_MAX];
+};
+
+struct tm_d3d11_shader_reload_statistics_t
+{
+    // Source files and watched shaders the reloader tracks.
+    uint32_t num_files;
+    uint32_t num_shaders;
+
+    // Times changes were found, shaders recompiled and reloaded, and shaders that failed to compile
+    // and kept their old programs.
+    uint64_t num_reloads;
+    uint64_t num_reloaded_shaders;
+    uint64_t num_failures;
+
+    // Latest reload, in seconds: from the newest change being saved to it being found, the time
+    // spent recompiling, and from the save to the end of the submit of the first frame drawn
+    // with the new programs.
+    double detect_seconds;
+    double compile_seconds;
+    double latency_seconds;
+};
+
+// A command and the key it is sorted on, as sorted by `tm_d3d11_api->sort_commands()`.
+struct tm_d3d11_sort_pair_t
+{
+    uint64_t key;
+    const struct tm_renderer_command_t *command;
+};
+
 struct tm_d3d11_backend_o;
 
 struct tm_d3d11_backend_i
@@ -54,11 +495,177 @@ struct tm_d3d11_backend_i
     bool (*physical_device_id)(struct tm_d3d11_backend_o *inst, uint32_t device,
         uint32_t required_device_flags, struct tm_d3d11_device_id *result);
 
+    // Returns the description of the physical device with index `device` that fulfills the
+    // `required_device_flags`, or NULL if there is no such device.
+    const struct tm_d3d11_adapter_desc_t *(*physical_device_desc)(struct tm_d3d11_backend_o *inst,
+        uint32_t device, uint32_t required_device_flags);
+
+    // Changes how physical devices are ranked, which renumbers the device indices. Ids already
+    // returned by `physical_device_id()` keep referring to the same device. NULL restores the
+    // default ranking: the order of GPU preference enumeration if available, otherwise discrete
+    // GPUs before integrated ones and more dedicated video memory first. `scorer` is copied.
+    void (*set_adapter_scorer)(struct tm_d3d11_backend_o *inst, const struct tm_d3d11_adapter_scorer_i *scorer);
+
     // Create D3D11 device using `device_id`.
     bool (*create_device)(struct tm_d3d11_backend_o *inst, struct tm_d3d11_device_id device_id);
 
+    // Creates a stand-in device that records the D3D11 calls the backend would make instead of
+    // issuing them to a driver. Works without a GPU and on platforms without D3D11, which makes it
+    // useful for measuring the CPU cost of command translation.
+    bool (*create_recording_device)(struct tm_d3d11_backend_o *inst);
+
     // Destroys D3D11 device already created.
     void (*destroy_device)(struct tm_d3d11_backend_o *inst);
+
+    // Command submission
+
+    // Sets how later calls to `submit_command_buffers()` translate commands. Mostly useful for
+    // comparing the modes, the default picks the fastest one the device supports.
+    void (*set_submit_mode)(struct tm_d3d11_backend_o *inst, enum tm_d3d11_submit_mode mode);
+
+    // Returns the submit mode in effect on the current device, never
+    // `TM_D3D11_SUBMIT_MODE_DEFAULT`.
+    enum tm_d3d11_submit_mode (*submit_mode)(struct tm_d3d11_backend_o *inst);
+
+    // Sets how many jobs `submit_resource_command_buffers()` may create resources on, 0 (the
+    // default) for one per logical processor. Creation and resource binder writes of different
+    // handles run concurrently, updates and destruction run on the calling thread after them.
+    // `TM_D3D11_SUBMIT_MODE_SINGLE_THREADED` executes every resource command on the calling thread.
+    void (*set_max_resource_jobs)(struct tm_d3d11_backend_o *inst, uint32_t max_jobs);
+
+    // Draw instancing
+
+    // With draw instancing, runs of consecutive draws (in sort order) that use the same instanced
+    // shader, draw the same single instance of the same geometry and bind the same resources
+    // except for the constant buffer at `constant_buffer_slot` are issued as one instanced draw.
+    // The contents of their constant buffers are gathered into an instance buffer, in draw order,
+    // which the shader indexes with `SV_InstanceID`. The constant buffer of the first draw of the
+    // run stays bound as well.
+    //
+    // Not every draw of an instanced shader ends up in a run: single draws, draws that can't be
+    // joined, runs cut short at a job range boundary and draws beyond the instance buffers of a
+    // frame are drawn on their own, without an instance buffer. Instanced shaders must therefore
+    // read the constants of instance 0 from the constant buffer, and only read the record at
+    // `SV_InstanceID` for instances 1 and up. Their draws must be single instance.
+    //
+    // The constants are gathered from system memory copies of the constant buffers, which are
+    // only kept for constant buffers of at most 256 bytes created while instancing is enabled, and
+    // only track updates made with `update_buffer()`.
+
+    // Sets how later submits instance draws. Instancing is off by default. `settings` is copied.
+    void (*set_draw_instancing)(struct tm_d3d11_backend_o *inst, const struct tm_d3d11_draw_instancing_t *settings);
+
+    // Marks `shader` as reading its per-draw constants from the instance buffer, which makes its
+    // draws candidates for instancing. Shaders aren't instanced by default.
+    void (*set_shader_draw_instancing)(struct tm_d3d11_backend_o *inst, tm_renderer_handle_t shader, bool enabled);
+
+    // Bindless
+
+    // D3D11 shaders can't index descriptors, so bindless access is emulated. Storage buffers are
+    // copied into a heap, one large buffer that shaders read as a `ByteAddressBuffer`, and sampled
+    // 2D images without render target or UAV usage into `Texture2DArray` pools of images with the
+    // same format, size and mips (up to 15 pools). The heap and the pools are bound once per
+    // translated range of commands, at registers `t48` to `t63`, and shaders reach a resource
+    // through its handle with the `tm_bindless_*()` functions the shader compiler declares when
+    // configured with `bindless`.
+    //
+    // The copies are read-only. They follow updates made with resource commands and streamed mips,
+    // and buffers with UAV usage are copied again on every submit.
+
+    // Sets whether resources created on devices created after this call get bindless handles.
+    // Bindless is off by default. `settings` is copied.
+    void (*set_bindless)(struct tm_d3d11_backend_o *inst, const struct tm_d3d11_bindless_t *settings);
+
+    // Returns the bindless handle of the buffer or image `resource`, which shaders pass to the
+    // `tm_bindless_*()` functions, or `TM_D3D11_INVALID_BINDLESS_HANDLE` if it has none.
+    uint32_t (*bindless_handle)(struct tm_d3d11_backend_o *inst, tm_renderer_handle_t resource);
+
+    // Swap chains
+
+    // Swap chains created with `create_swap_chain()` use the flip model and present with vertical
+    // sync. Their handles can be bound as render targets. Frame pacing is done by waiting for the
+    // swap chain before building a frame, instead of sleeping.
+
+    // Sets how many presented frames `swap_chain` may queue before it stops being ready, between 1
+    // and 16. Lower values reduce input latency, higher values smooth out uneven frames. Swap
+    // chains are created with a maximum frame latency of 2.
+    void (*set_max_frame_latency)(struct tm_d3d11_backend_o *inst, tm_renderer_handle_t swap_chain,
+        uint32_t max_frame_latency);
+
+    // Waits up to `timeout` seconds for `swap_chain` to be ready for another frame, that is for
+    // fewer than its maximum frame latency frames to be queued. Returns true if it is ready.
+    bool (*wait_for_swap_chain)(struct tm_d3d11_backend_o *inst, tm_renderer_handle_t swap_chain, float timeout);
+
+    // Video memory budget
+
+    // The backend keeps the video memory taken by its buffers and images under a budget, which is
+    // queried every few submits. When over budget, images that haven't been used for a few
+    // submits are evicted to system memory, least recently used first, keeping only their
+    // smallest mips in video memory. Evicted images are restored once they are used again and fit.
+
+    // Sets where the budget comes from. NULL uses the budget DXGI reports for the adapter
+    // (`IDXGIAdapter3::QueryVideoMemoryInfo()`), which is unknown on the recording device. `source`
+    // is copied.
+    void (*set_memory_budget_source)(struct tm_d3d11_backend_o *inst, const struct tm_d3d11_memory_budget_source_i *source);
+
+    // Texture streaming
+
+    // A streamed image is created with only its small mips in video memory and sampling clamped to
+    // the finest of them (`SetResourceMinLOD()`). The data of the larger mips is kept in system
+    // memory and uploaded during later submits, coarsest first and within the upload budget,
+    // lowering the clamp as each mip arrives. Only sampled images with initial data and no render
+    // target or UAV usage are streamed.
+
+    // Sets how images created after this call are streamed. Streaming is off by default. `settings`
+    // is copied, zero sizes use the defaults.
+    void (*set_texture_streaming)(struct tm_d3d11_backend_o *inst, const struct tm_d3d11_texture_streaming_t *settings);
+
+    // Sets the priority of the streamed `image`. Images with higher priority get their mips first,
+    // images with the same priority in creation order. Meant to be fed by the renderer every frame,
+    // for example with the screen size of what the image is drawn on. Images start at priority 0.
+    void (*set_image_stream_priority)(struct tm_d3d11_backend_o *inst, tm_renderer_handle_t image, float priority);
+
+    // GPU timings
+
+    // Sets how many submits may be in flight on the GPU before the timestamps of the oldest one are
+    // read back, between 1 and `TM_D3D11_MAX_GPU_TIMING_LATENCY`. The default is 3. If the GPU is
+    // further behind than that, the oldest timings are dropped instead of waited for.
+    void (*set_gpu_timing_latency)(struct tm_d3d11_backend_o *inst, uint32_t num_submits);
+
+    // Copies up to `max_scopes` scope timings of the latest submit that has been read back to
+    // `scopes`, in the order the scopes began. Returns the number of scopes of that submit, which
+    // may be more than `max_scopes`. If `submit` is non-NULL, it receives the number of the submit,
+    // counting from 1 since the device was created, or 0 if nothing has been read back yet. Never
+    // waits for the GPU.
+    uint32_t (*gpu_timings)(struct tm_d3d11_backend_o *inst, struct tm_d3d11_gpu_scope_timing_t *scopes,
+        uint32_t max_scopes, uint64_t *submit);
+
+    // Shader hot-reload
+
+    // Replaces the programs of `shader` by the ones compiled to the non-empty `blobs`, one per
+    // stage (`TM_RENDERER_SHADER_STAGE_*`) up to the compute stage. The swap happens at the start
+    // of the next submit, so all draws of a frame use the same version of the shader. Pipeline
+    // states and draw instancing settings are kept. Returns false if `shader` isn't a shader or the
+    // programs can't be created, in which case the old programs stay. Can be called from any
+    // thread, also during a submit.
+    bool (*reload_shader)(struct tm_d3d11_backend_o *inst, tm_renderer_handle_t shader,
+        const tm_renderer_shader_blob_t *blobs);
+
+    // Statistics
+
+    // Copies the statistics accumulated since the device was created to `stats`.
+    void (*statistics)(struct tm_d3d11_backend_o *inst, struct tm_d3d11_statistics_t *stats);
+
+    // Copies the heap allocation statistics of each `enum tm_d3d11_memory_scope` to `stats`.
+    void (*memory_statistics)(struct tm_d3d11_backend_o *inst, struct tm_d3d11_memory_statistics_t *stats);
+
+    // Debug mode that holds `submit_command_buffers()` to no heap allocations. While enabled, each
+    // submit that allocates once the first `TM_D3D11_ALLOCATION_CHECK_WARMUP` submits since
+    // enabling it (or since the device was created) have passed logs the scopes it allocated from
+    // as a `TM_LOG_TYPE_INFO` message, a diagnostic rather than an error, and counts in
+    // `num_allocating_frames`. Shader cache allocations are left out, since shaders compile on
+    // other threads. Off by default.
+    void (*set_allocation_check)(struct tm_d3d11_backend_o *inst, bool enabled);
 };
 
 
@@ -69,4 +676,58 @@ struct tm_d3d11_api
     struct tm_d3d11_backend_i *(*create_backend)(struct tm_allocator_i *allocator, struct tm_error_i *error);
     void (*destroy_backend)(struct tm_d3d11_backend_i *backend);
     struct tm_renderer_shader_compiler_api *(*shader_compiler)(void);
+
+    // Compiles `num_requests` shaders with the shader compiler `inst`, spread over at most
+    // `max_jobs` jobs (0 for one per logical processor), and waits for them. The blob of
+    // `requests[i]` is stored in `results[i]`, failed compiles give empty blobs. The blobs are
+    // released with `release_blob()`. Must be called from a job.
+    void (*compile_shaders)(struct tm_renderer_shader_compiler_o *inst,
+        const struct tm_d3d11_shader_compile_request_t *requests, uint32_t num_requests,
+        tm_renderer_shader_blob_t *results, uint32_t max_jobs);
+
+    // Sets the configuration of shader compilers created by `shader_compiler()->init()` after this
+    // call. The configuration is copied.
+    void (*configure_shader_compiler)(const struct tm_d3d11_shader_compiler_config_t *config);
+
+    // Copies the statistics of the shader compiler `inst` to `stats`.
+    void (*shader_compiler_statistics)(struct tm_renderer_shader_compiler_o *inst,
+        struct tm_d3d11_shader_compiler_statistics_t *stats);
+
+    // Creates a shader reloader that watches the sources in `directory` and its subdirectories,
+    // compiles them with the shader compiler `compiler` and reloads them on `backend`. Without a
+    // file system watcher, the files are checked on every `begin_shader_reload()`.
+    struct tm_d3d11_shader_reloader_o *(*create_shader_reloader)(struct tm_allocator_i *allocator,
+        struct tm_d3d11_backend_i *backend, struct tm_renderer_shader_compiler_o *compiler, const char *directory);
+    void (*destroy_shader_reloader)(struct tm_d3d11_shader_reloader_o *reloader);
+
+    // Starts watching `shader` and the files its source includes. `shader` is copied. Returns false
+    // if the source can't be read.
+    bool (*watch_shader)(struct tm_d3d11_shader_reloader_o *reloader, const struct tm_d3d11_watched_shader_t *shader);
+
+    // Stops watching the shader `shader`. Call before destroying it.
+    void (*unwatch_shader)(struct tm_d3d11_shader_reloader_o *reloader, tm_renderer_handle_t shader);
+
+    // Recompiles the watched shaders affected by changed files and queues the new programs, which
+    // the next submit swaps in. Call once per frame, before the frame is submitted. May run on
+    // another thread than the submits, but not concurrently with the other functions of the same
+    // reloader. Returns the number of shaders queued.
+    uint32_t (*begin_shader_reload)(struct tm_d3d11_shader_reloader_o *reloader);
+
+    // Call once per frame, after the frame has been submitted. Completes the latency of the
+    // shaders queued by `begin_shader_reload()` and logs it.
+    void (*end_shader_reload)(struct tm_d3d11_shader_reloader_o *reloader);
+
+    // Copies the statistics of `reloader` to `stats`.
+    void (*shader_reload_statistics)(struct tm_d3d11_shader_reloader_o *reloader,
+        struct tm_d3d11_shader_reload_statistics_t *stats);
+
+    // Returns the scratch memory `sort_commands()` needs for `num_pairs` pairs on `max_jobs` jobs.
+    uint64_t (*sort_commands_memory_needed)(uint32_t num_pairs, uint32_t max_jobs);
+
+    // Sorts `pairs` on their keys with the radix sort submits use, keeping the order of pairs with
+    // equal keys. `memory` must hold `sort_commands_memory_needed()` bytes, aligned to 16 bytes.
+    // Returns the sorted pairs, which are either `pairs` or in `memory`. If more than one job is
+    // used, this must be called from a job.
+    struct tm_d3d11_sort_pair_t *(*sort_commands)(struct tm_d3d11_sort_pair_t *pairs, uint32_t num_pairs,
+        void *memory, uint32_t max_jobs);
 };
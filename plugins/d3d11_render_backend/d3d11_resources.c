@@ -0,0 +1,1759 @@
+#include "d3d11_resources.h"
+#include "d3d11_bindless.h"
+#include "d3d11_internal.h"
+#include "d3d11_state_blocks.h"
+#include "d3d11_upload_ring.h"
+
+#include <foundation/allocator.h>
+#include <foundation/carray.inl>
+#include <foundation/job_system.h>
+#include <foundation/log.h>
+#include <foundation/os.h>
+#include <foundation/temp_allocator.h>
+#include <plugins/renderer/render_command_buffer.h>
+#include <plugins/renderer/renderer.h>
+#include <plugins/renderer/resource_command_buffer.h>
+#include <plugins/renderer/shader_compiler_state_blocks_common.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+// Images looked up within this many frames are never evicted.
+#define EVICTION_MIN_IDLE_FRAMES (3)
+
+// Number of mips an evicted image drops.
+#define EVICTION_MIP_DROP (2)
+
+// Eviction stops, and restores have to stay, below this fraction of the budget (in 1/16ths), so
+// that images aren't evicted and restored on alternate frames.
+#define EVICTION_TARGET_SIXTEENTHS (15)
+
+// Resource commands are only spread over jobs if every job gets at least this many of them.
+#define MIN_RESOURCE_COMMANDS_PER_JOB (64)
+
+// Defaults of `tm_d3d11_texture_streaming_t`.
+#define DEFAULT_STREAMING_RESIDENT_MIP_SIZE (64)
+#define DEFAULT_STREAMING_UPLOAD_BUDGET (4 * 1024 * 1024)
+
+// -------------------------------------------------------------------
+// Records
+//
+// Hot records hold what the command translator reads, views are indexed by `enum d3d11_view`.
+// Everything else lives in the cold records.
+
+struct buffer_hot_t
+{
+    uint32_t generation;
+    uint32_t size;
+    void *views[VIEW__UAV + 1];
+};
+
+struct buffer_cold_t
+{
+    struct d3d11_buffer_desc_t desc;
+
+    // System memory copy of a small constant buffer, see `d3d11_resources_t.shadow_constants`,
+    // or the contents of a suballocated one.
+    uint8_t *constants;
+
+    // Set for constant buffers suballocated from the arena, which have no device buffer, and for
+    // constant buffers taken from the pool, whose `desc.size` is the size of their size class.
+    bool suballocated;
+    bool pooled;
+    TM_PAD(2);
+
+    // Frame the constants were last copied to the arena and their offset in the arena buffer.
+    uint32_t arena_frame;
+    uint32_t arena_offset;
+
+    // Bindless handle of the buffer plus one, 0 if it has none.
+    uint32_t bindless_index;
+};
+
+struct image_hot_t
+{
+    uint32_t generation;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    void *views[VIEW__COUNT];
+
+    // Frame of the latest lookup, see `d3d11_residency_t`.
+    atomic_uint32_t last_used;
+    bool evicted;
+    TM_PAD(3);
+};
+
+struct image_cold_t
+{
+    struct d3d11_texture_desc_t desc;
+    uint32_t bytes_per_block;
+    uint32_t block_size;
+
+    // Size of the full texture and of the texture in `views[VIEW__RESOURCE]`.
+    uint64_t size;
+    uint64_t resident_size;
+
+    // System memory copy of the full texture while evicted.
+    void *staging;
+
+    // Index of the image in the mip streamer plus one, 0 if the image isn't streamed.
+    uint32_t stream_index;
+
+    // Bindless handle of the image plus one, 0 if it has none.
+    uint32_t bindless_index;
+};
+
+struct sampler_hot_t
+{
+    uint32_t generation;
+    TM_PAD(4);
+    void *sampler;
+};
+
+struct shader_hot_t
+{
+    uint32_t generation;
+    TM_PAD(4);
+};
+
+struct shader_cold_t
+{
+    struct d3d11_shader_t shader;
+};
+
+struct resource_binder_hot_t
+{
+    uint32_t generation;
+    uint32_t num_binds;
+};
+
+struct resource_binder_cold_t
+{
+    struct d3d11_resource_binder_t binder;
+    struct d3d11_bind_t binds[MAX_BINDER_BINDS];
+
+    // Frame the suballocated constant buffers of the binder were last uploaded.
+    uint32_t constants_frame;
+    TM_PAD(4);
+};
+
+struct swap_chain_hot_t
+{
+    uint32_t generation;
+    TM_PAD(4);
+    struct d3d11_swap_chain_i *swap_chain;
+};
+
+TM_STATIC_ASSERT(sizeof(struct buffer_hot_t) == 32);
+TM_STATIC_ASSERT(sizeof(struct image_hot_t) == 64);
+TM_STATIC_ASSERT(sizeof(struct sampler_hot_t) == 16);
+TM_STATIC_ASSERT(sizeof(struct swap_chain_hot_t) == 16);
+
+static const uint32_t hot_sizes[RESOURCE_POOL__COUNT] = {
+    [RESOURCE_POOL__BUFFER]          = sizeof(struct buffer_hot_t),
+    [RESOURCE_POOL__IMAGE]           = sizeof(struct image_hot_t),
+    [RESOURCE_POOL__SAMPLER]         = sizeof(struct sampler_hot_t),
+    [RESOURCE_POOL__SHADER]          = sizeof(struct shader_hot_t),
+    [RESOURCE_POOL__RESOURCE_BINDER] = sizeof(struct resource_binder_hot_t),
+    [RESOURCE_POOL__SWAP_CHAIN]      = sizeof(struct swap_chain_hot_t),
+};
+
+static const uint32_t cold_sizes[RESOURCE_POOL__COUNT] = {
+    [RESOURCE_POOL__BUFFER]          = sizeof(struct buffer_cold_t),
+    [RESOURCE_POOL__IMAGE]           = sizeof(struct image_cold_t),
+    [RESOURCE_POOL__SAMPLER]         = 0,
+    [RESOURCE_POOL__SHADER]          = sizeof(struct shader_cold_t),
+    [RESOURCE_POOL__RESOURCE_BINDER] = sizeof(struct resource_binder_cold_t),
+    [RESOURCE_POOL__SWAP_CHAIN]      = 0,
+};
+
+static enum d3d11_resource_pool
+pool_from_resource_type(uint32_t resource_type)
+{
+    switch (resource_type)
+    {
+    case TM_RENDERER_RESOURCE_TYPE_BUFFER:          return RESOURCE_POOL__BUFFER;
+    case TM_RENDERER_RESOURCE_TYPE_IMAGE:           return RESOURCE_POOL__IMAGE;
+    case TM_RENDERER_RESOURCE_TYPE_SAMPLER:         return RESOURCE_POOL__SAMPLER;
+    case TM_RENDERER_RESOURCE_TYPE_SHADER:          return RESOURCE_POOL__SHADER;
+    case TM_RENDERER_RESOURCE_TYPE_RESOURCE_BINDER: return RESOURCE_POOL__RESOURCE_BINDER;
+    default:                                        return RESOURCE_POOL__COUNT;
+    }
+}
+
+// Returns the hot record of `handle` if it is a live handle of `pool`, counting the miss otherwise.
+static inline void *
+lookup(struct d3d11_resources_t *res, enum d3d11_resource_pool pool, uint32_t handle)
+{
+    void *hot = d3d11_handle_pool__hot(&res->pools[pool], handle);
+    if (!hot)
+        atomic_fetch_add_uint64_t(&res->num_stale_handles, 1);
+    return hot;
+}
+
+// -------------------------------------------------------------------
+// Formats
+
+struct format_t
+{
+    // `DXGI_FORMAT`.
+    uint32_t dxgi;
+
+    // Size of a pixel, or of a 4x4 block for compressed formats.
+    uint32_t bytes_per_block;
+    uint32_t block_size;
+    bool depth;
+    TM_PAD(3);
+};
+
+static const struct format_t formats[TM_RENDERER_FORMAT_MAX_FORMATS] = {
+    [TM_RENDERER_FORMAT_R8G8B8A8_UNORM]      = { 28, 4, 1 },
+    [TM_RENDERER_FORMAT_R8G8B8A8_SRGB]       = { 29, 4, 1 },
+    [TM_RENDERER_FORMAT_B8G8R8A8_UNORM]      = { 87, 4, 1 },
+    [TM_RENDERER_FORMAT_R16G16B16A16_SFLOAT] = { 10, 8, 1 },
+    [TM_RENDERER_FORMAT_R32G32B32A32_SFLOAT] = { 2, 16, 1 },
+    [TM_RENDERER_FORMAT_R32_SFLOAT]          = { 41, 4, 1 },
+    [TM_RENDERER_FORMAT_R8_UNORM]            = { 61, 1, 1 },
+    [TM_RENDERER_FORMAT_BC1_RGBA_UNORM]      = { 71, 8, 4 },
+    [TM_RENDERER_FORMAT_BC3_UNORM]           = { 77, 16, 4 },
+    [TM_RENDERER_FORMAT_BC7_UNORM]           = { 98, 16, 4 },
+    [TM_RENDERER_FORMAT_D32_SFLOAT]          = { 40, 4, 1, true },
+    [TM_RENDERER_FORMAT_D24_UNORM_S8_UINT]   = { 45, 4, 1, true },
+};
+
+static void
+subresource_pitch(const struct image_cold_t *image, uint32_t mip, uint32_t *row_pitch, uint32_t *slice_pitch)
+{
+    const uint32_t b = image->block_size;
+    const uint32_t width = tm_max(image->desc.width >> mip, 1);
+    const uint32_t height = tm_max(image->desc.height >> mip, 1);
+    *row_pitch = (width + b - 1) / b * image->bytes_per_block;
+    *slice_pitch = (height + b - 1) / b * *row_pitch;
+}
+
+// Returns the number of array slices of `desc`, the subresources are `mip + slice * mip_levels`.
+static uint32_t
+num_slices(const struct d3d11_texture_desc_t *desc)
+{
+    return desc->dimension == TEXTURE_DIMENSION__3D ? 1 : desc->depth_or_array_size;
+}
+
+// Returns the size of the mips of `image` from `first_mip` on.
+static uint64_t
+image_size(const struct image_cold_t *image, uint32_t first_mip)
+{
+    const struct d3d11_texture_desc_t *desc = &image->desc;
+    uint64_t size = 0;
+    for (uint32_t mip = first_mip; mip < desc->mip_levels; ++mip)
+    {
+        uint32_t row_pitch, slice_pitch;
+        subresource_pitch(image, mip, &row_pitch, &slice_pitch);
+        const uint32_t depth = desc->dimension == TEXTURE_DIMENSION__3D ? tm_max(desc->depth_or_array_size >> mip, 1) : 1;
+        size += (uint64_t)slice_pitch * depth;
+    }
+    return size * num_slices(desc) * desc->sample_count;
+}
+
+// -------------------------------------------------------------------
+// Creation & destruction
+
+// Creation may run on resource jobs, see `d3d11_resources__submit()`. Buffers and images return the
+// video memory they take, which the caller adds to `residency.resident_bytes`.
+
+static inline bool
+uniform_only(uint32_t usage)
+{
+    return usage == TM_RENDERER_BUFFER_USAGE_UNIFORM || usage == (TM_RENDERER_BUFFER_USAGE_UNIFORM | TM_RENDERER_BUFFER_USAGE_UPDATABLE);
+}
+
+// Returns the size class of constant buffers of `size` bytes in `constant_pool`, or
+// `CONSTANT_POOL_NUM_CLASSES` if they are too large to be pooled.
+static uint32_t
+constant_pool_class(uint32_t size)
+{
+    uint32_t c = 0;
+    while (c != CONSTANT_POOL_NUM_CLASSES && (1u << (CONSTANT_POOL_MIN_SIZE_LOG2 + c)) < size)
+        ++c;
+    return c;
+}
+
+// Size a suballocated constant buffer takes in the arena. Ranges are bound in units of 16
+// constants, so they are padded to 256 bytes.
+static inline uint32_t
+arena_size(uint32_t size)
+{
+    return (size + 255) & ~255u;
+}
+
+static uint64_t
+create_buffer(struct d3d11_resources_t *res, const tm_renderer_create_buffer_command_t *cmd)
+{
+    struct d3d11_device_i *device = res->device;
+    struct buffer_hot_t *hot = lookup(res, RESOURCE_POOL__BUFFER, cmd->handle.resource);
+    if (!hot || !device)
+        return 0;
+
+    struct buffer_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__BUFFER], cmd->handle.resource);
+    const uint32_t usage = cmd->desc.usage_flags;
+    struct d3d11_buffer_desc_t *desc = &cold->desc;
+
+    // D3D11 doesn't allow constant buffers to have any other bind flag, so a buffer is only
+    // created as one if it is used for nothing else. Raw views need a multiple of 4 bytes.
+    if (uniform_only(usage))
+    {
+        desc->size = (cmd->desc.size + 15) & ~15u;
+        desc->bind_flags = BIND_FLAG__CONSTANT_BUFFER;
+    }
+    else
+    {
+        desc->size = (cmd->desc.size + 3) & ~3u;
+        desc->bind_flags |= (usage & TM_RENDERER_BUFFER_USAGE_VERTEX) ? BIND_FLAG__VERTEX_BUFFER : 0;
+        desc->bind_flags |= (usage & TM_RENDERER_BUFFER_USAGE_INDEX) ? BIND_FLAG__INDEX_BUFFER : 0;
+        desc->bind_flags |= (usage & TM_RENDERER_BUFFER_USAGE_STORAGE) ? BIND_FLAG__SHADER_RESOURCE : 0;
+        desc->bind_flags |= (usage & TM_RENDERER_BUFFER_USAGE_UAV) ? BIND_FLAG__UNORDERED_ACCESS : 0;
+        if (desc->bind_flags & (BIND_FLAG__SHADER_RESOURCE | BIND_FLAG__UNORDERED_ACCESS))
+            desc->misc_flags |= MISC_FLAG__BUFFER_ALLOW_RAW_VIEWS;
+        if (usage & TM_RENDERER_BUFFER_USAGE_INDIRECT)
+            desc->misc_flags |= MISC_FLAG__DRAWINDIRECT_ARGS;
+    }
+    desc->usage = USAGE__DEFAULT;
+
+    // Small constant buffers only live in system memory until a frame binds them.
+    if (desc->bind_flags == BIND_FLAG__CONSTANT_BUFFER && res->constant_arena
+        && desc->size <= MAX_SUBALLOCATED_CONSTANTS_SIZE)
+    {
+        cold->suballocated = true;
+        cold->constants = tm_alloc(res->allocator, desc->size);
+        memset(cold->constants, 0, desc->size);
+        if (cmd->data)
+            memcpy(cold->constants, cmd->data, cmd->desc.size);
+        hot->size = cmd->desc.size;
+        return 0;
+    }
+
+    // Without an arena constant buffers come from the pool, as large as their size class.
+    const uint32_t pool_class = desc->bind_flags == BIND_FLAG__CONSTANT_BUFFER && !res->constant_arena
+        ? constant_pool_class(desc->size)
+        : CONSTANT_POOL_NUM_CLASSES;
+    if (pool_class != CONSTANT_POOL_NUM_CLASSES)
+    {
+        desc->size = 1u << (CONSTANT_POOL_MIN_SIZE_LOG2 + pool_class);
+        cold->pooled = true;
+    }
+
+    // Initial data must cover the rounded up size.
+    TM_INIT_TEMP_ALLOCATOR(ta);
+    const void *data = cmd->data;
+    if (data && desc->size != cmd->desc.size)
+    {
+        uint8_t *padded = tm_temp_alloc(ta, desc->size);
+        memcpy(padded, cmd->data, cmd->desc.size);
+        memset(padded + cmd->desc.size, 0, desc->size - cmd->desc.size);
+        data = padded;
+    }
+
+    void *buffer = 0;
+    if (cold->pooled && tm_carray_size(res->constant_pool[pool_class]))
+    {
+        // Pooled buffers hold the contents of their previous use.
+        buffer = tm_carray_pop(res->constant_pool[pool_class]);
+        if (data)
+        {
+            struct d3d11_context_i *ctx = device->immediate_context(device->inst);
+            ctx->update_subresource(ctx->inst, buffer, 0, 0, data, 0, 0);
+        }
+        ++res->stats.num_pooled_constant_buffers;
+    }
+    else
+        buffer = device->create_buffer(device->inst, desc, data);
+
+    if (buffer && res->shadow_constants && desc->bind_flags == BIND_FLAG__CONSTANT_BUFFER
+        && desc->size <= MAX_SHADOWED_CONSTANTS_SIZE)
+    {
+        cold->constants = tm_alloc(res->allocator, desc->size);
+        if (data)
+            memcpy(cold->constants, data, desc->size);
+        else
+            memset(cold->constants, 0, desc->size);
+    }
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+    if (!buffer)
+        return 0;
+
+    hot->size = cmd->desc.size;
+    hot->views[VIEW__RESOURCE] = buffer;
+    if (desc->bind_flags & BIND_FLAG__SHADER_RESOURCE)
+        hot->views[VIEW__SRV] = device->create_view(device->inst, buffer, VIEW__SRV);
+    if (desc->bind_flags & BIND_FLAG__UNORDERED_ACCESS)
+        hot->views[VIEW__UAV] = device->create_view(device->inst, buffer, VIEW__UAV);
+
+    if (res->bindless && d3d11_bindless__buffer_eligible(desc->bind_flags))
+    {
+        const bool gpu_written = desc->bind_flags & BIND_FLAG__UNORDERED_ACCESS;
+        // `BINDLESS_INVALID_HANDLE` wraps around to 0.
+        cold->bindless_index = d3d11_bindless__add_buffer(res->bindless, buffer, desc->size, gpu_written) + 1;
+    }
+    return desc->size;
+}
+
+static void
+create_image_views(struct d3d11_device_i *device, struct image_hot_t *hot, uint32_t bind_flags, void *texture)
+{
+    hot->views[VIEW__RESOURCE] = texture;
+    if (bind_flags & BIND_FLAG__SHADER_RESOURCE)
+        hot->views[VIEW__SRV] = device->create_view(device->inst, texture, VIEW__SRV);
+    if (bind_flags & BIND_FLAG__UNORDERED_ACCESS)
+        hot->views[VIEW__UAV] = device->create_view(device->inst, texture, VIEW__UAV);
+    if (bind_flags & BIND_FLAG__RENDER_TARGET)
+        hot->views[VIEW__RTV] = device->create_view(device->inst, texture, VIEW__RTV);
+    if (bind_flags & BIND_FLAG__DEPTH_STENCIL)
+        hot->views[VIEW__DSV] = device->create_view(device->inst, texture, VIEW__DSV);
+}
+
+// Returns the finest mip of a new image that is uploaded right away, or 0 if the image isn't
+// streamed.
+static uint32_t
+streamed_resident_mip(const struct d3d11_resources_t *res, const struct d3d11_texture_desc_t *desc)
+{
+    if (!res->streaming.enabled || desc->bind_flags != BIND_FLAG__SHADER_RESOURCE
+        || desc->mip_levels > TM_D3D11_MAX_MIP_LEVELS)
+        return 0;
+
+    uint32_t mip = 0;
+    while (mip + 1 < desc->mip_levels && tm_max(desc->width >> mip, desc->height >> mip) > res->streaming.resident_mip_size)
+        ++mip;
+    return mip;
+}
+
+// Uploads all slices of `mip` from `data`, where they are tightly packed one after the other.
+static void
+upload_mip(struct d3d11_context_i *ctx, void *texture, const struct image_cold_t *image, uint32_t mip, const uint8_t *data)
+{
+    const struct d3d11_texture_desc_t *desc = &image->desc;
+    uint32_t row_pitch, slice_pitch;
+    subresource_pitch(image, mip, &row_pitch, &slice_pitch);
+    const uint32_t depth = desc->dimension == TEXTURE_DIMENSION__3D ? tm_max(desc->depth_or_array_size >> mip, 1) : 1;
+    for (uint32_t slice = 0; slice != num_slices(desc); ++slice, data += (uint64_t)slice_pitch * depth)
+        ctx->update_subresource(ctx->inst, texture, mip + slice * desc->mip_levels, 0, data, row_pitch, slice_pitch);
+}
+
+// Uploads the mips of a new, empty `texture` from `resident_mip` on, clamps sampling to them and
+// hands copies of the larger mips to the streamer. `data` holds every subresource of the image.
+static void
+stream_image(struct d3d11_resources_t *res, uint32_t handle, struct image_cold_t *cold, void *texture,
+    const struct d3d11_subresource_data_t *data, uint32_t resident_mip)
+{
+    struct d3d11_context_i *ctx = res->device->immediate_context(res->device->inst);
+    const struct d3d11_texture_desc_t *desc = &cold->desc;
+    const uint32_t slices = num_slices(desc);
+
+    for (uint32_t s = 0; s != slices * desc->mip_levels; ++s)
+    {
+        if (s % desc->mip_levels >= resident_mip)
+            ctx->update_subresource(ctx->inst, texture, s, 0, data[s].data, data[s].row_pitch, data[s].slice_pitch);
+    }
+    ctx->set_resource_min_lod(ctx->inst, texture, (float)resident_mip);
+
+    uint64_t mip_sizes[TM_D3D11_MAX_MIP_LEVELS];
+    for (uint32_t mip = 0; mip != resident_mip; ++mip)
+        mip_sizes[mip] = image_size(cold, mip) - image_size(cold, mip + 1);
+
+    const uint32_t index = d3d11_mip_streamer__add(&res->streamer, handle, resident_mip, mip_sizes, 0.0f);
+    for (uint32_t mip = 0; mip != resident_mip; ++mip)
+    {
+        uint8_t *dst = d3d11_mip_streamer__mip_data(&res->streamer, index, mip);
+        const uint64_t slice_size = mip_sizes[mip] / slices;
+        for (uint32_t slice = 0; slice != slices; ++slice)
+            memcpy(dst + slice * slice_size, data[mip + slice * desc->mip_levels].data, slice_size);
+    }
+    cold->stream_index = index + 1;
+}
+
+static uint64_t
+create_image(struct d3d11_resources_t *res, const tm_renderer_create_image_command_t *cmd)
+{
+    struct d3d11_device_i *device = res->device;
+    struct image_hot_t *hot = lookup(res, RESOURCE_POOL__IMAGE, cmd->handle.resource);
+    if (!hot || !device)
+        return 0;
+
+    const tm_renderer_image_desc_t *src = &cmd->desc;
+    const struct format_t *format = src->format < TM_RENDERER_FORMAT_MAX_FORMATS ? &formats[src->format] : 0;
+    if (!format || !format->dxgi)
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Unsupported image format %u", src->format);
+        return 0;
+    }
+
+    struct image_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__IMAGE], cmd->handle.resource);
+    cold->bytes_per_block = format->bytes_per_block;
+    cold->block_size = format->block_size;
+
+    struct d3d11_texture_desc_t *desc = &cold->desc;
+    const bool cube = src->type == TM_RENDERER_IMAGE_TYPE_CUBE;
+    const uint32_t layers = tm_max(src->layer_count, 1);
+    desc->dimension = src->type == TM_RENDERER_IMAGE_TYPE_1D ? TEXTURE_DIMENSION__1D
+        : src->type == TM_RENDERER_IMAGE_TYPE_3D              ? TEXTURE_DIMENSION__3D
+                                                              : TEXTURE_DIMENSION__2D;
+    desc->width = src->width;
+    desc->height = tm_max(src->height, 1);
+    desc->depth_or_array_size = desc->dimension == TEXTURE_DIMENSION__3D ? tm_max(src->depth, 1) : layers * (cube ? 6 : 1);
+    desc->mip_levels = tm_max(src->mip_levels, 1);
+    desc->format = format->dxgi;
+    desc->sample_count = tm_max(src->sample_count, 1);
+    desc->usage = USAGE__DEFAULT;
+    desc->misc_flags = cube ? MISC_FLAG__TEXTURECUBE : 0;
+    if (format->depth)
+        desc->bind_flags = BIND_FLAG__DEPTH_STENCIL;
+    else
+    {
+        desc->bind_flags = BIND_FLAG__SHADER_RESOURCE;
+        desc->bind_flags |= (src->usage_flags & TM_RENDERER_IMAGE_USAGE_RENDER_TARGET) ? BIND_FLAG__RENDER_TARGET : 0;
+        desc->bind_flags |= (src->usage_flags & TM_RENDERER_IMAGE_USAGE_UAV) ? BIND_FLAG__UNORDERED_ACCESS : 0;
+    }
+
+    // Initial data is tightly packed in subresource order, slice by slice, mip by mip.
+    TM_INIT_TEMP_ALLOCATOR(ta);
+    struct d3d11_subresource_data_t *data = 0;
+    if (cmd->data && desc->sample_count == 1)
+    {
+        const uint32_t slices = desc->dimension == TEXTURE_DIMENSION__3D ? 1 : desc->depth_or_array_size;
+        data = tm_temp_alloc(ta, sizeof(*data) * slices * desc->mip_levels);
+
+        const uint8_t *p = cmd->data;
+        const uint8_t *end = p + cmd->data_size;
+        for (uint32_t slice = 0; slice != slices; ++slice)
+        {
+            for (uint32_t mip = 0; mip != desc->mip_levels; ++mip)
+            {
+                struct d3d11_subresource_data_t *sd = data + slice * desc->mip_levels + mip;
+                subresource_pitch(cold, mip, &sd->row_pitch, &sd->slice_pitch);
+                const uint32_t depth = desc->dimension == TEXTURE_DIMENSION__3D ? tm_max(desc->depth_or_array_size >> mip, 1) : 1;
+                sd->data = p;
+                p += (uint64_t)sd->slice_pitch * depth;
+            }
+        }
+
+        if (p > end)
+        {
+            tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Image data is %llu bytes, expected %llu", (unsigned long long)cmd->data_size,
+                (unsigned long long)(p - (const uint8_t *)cmd->data));
+            data = 0;
+        }
+    }
+
+    // Streamed images are created empty, only their small mips are uploaded right away.
+    const uint32_t resident_mip = data ? streamed_resident_mip(res, desc) : 0;
+    void *texture = device->create_texture(device->inst, desc, resident_mip ? 0 : data);
+    if (texture && resident_mip)
+        stream_image(res, cmd->handle.resource, cold, texture, data, resident_mip);
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+    if (!texture)
+        return 0;
+
+    hot->format = src->format;
+    hot->width = desc->width;
+    hot->height = desc->height;
+    atomic_store_uint32_t(&hot->last_used, res->residency.frame);
+    create_image_views(device, hot, desc->bind_flags, texture);
+    if (res->bindless && d3d11_bindless__image_eligible(desc))
+        cold->bindless_index = d3d11_bindless__add_image(res->bindless, texture, desc) + 1;
+
+    cold->size = image_size(cold, 0);
+    cold->resident_size = cold->size;
+    return cold->size;
+}
+
+static const struct d3d11_sampler_desc_t default_sampler_desc = {
+    .filter          = 0x15, // D3D11_FILTER_MIN_MAG_MIP_LINEAR
+    .address_u       = 1,    // D3D11_TEXTURE_ADDRESS_WRAP
+    .address_v       = 1,
+    .address_w       = 1,
+    .max_anisotropy  = 1,
+    .comparison_func = 1,    // D3D11_COMPARISON_NEVER
+    .max_lod         = 3.402823466e+38f,
+};
+
+static void
+create_sampler(struct d3d11_resources_t *res, const tm_renderer_create_sampler_command_t *cmd)
+{
+    struct d3d11_device_i *device = res->device;
+    struct sampler_hot_t *hot = lookup(res, RESOURCE_POOL__SAMPLER, cmd->handle.resource);
+    if (!hot || !device)
+        return;
+
+    // Sampler state blocks that weren't compiled by our shader compiler fall back to the shared
+    // default sampler.
+    const struct d3d11_state_block_t *block = d3d11_state_block__from_blob(&cmd->sampler_states,
+        TM_RENDERER_STATE_BLOCK_TYPE_TEXTURE_SAMPLER);
+    if (block)
+    {
+        tm_os_api->thread->enter_critical_section(&res->state_cache_lock);
+        hot->sampler = d3d11_state_cache__sampler(&res->state_cache, block);
+        tm_os_api->thread->leave_critical_section(&res->state_cache_lock);
+    }
+}
+
+static void
+create_shader(struct d3d11_resources_t *res, const tm_renderer_create_shader_command_t *cmd)
+{
+    struct d3d11_device_i *device = res->device;
+    if (!lookup(res, RESOURCE_POOL__SHADER, cmd->handle.resource) || !device)
+        return;
+
+    struct shader_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__SHADER], cmd->handle.resource);
+    struct d3d11_shader_t *shader = &cold->shader;
+
+    for (uint32_t stage = 0; stage != SHADER_STAGE__COUNT; ++stage)
+    {
+        const tm_renderer_shader_blob_t *blob = &cmd->shader.stages[stage];
+        if (blob->size)
+            shader->stages[stage] = device->create_shader(device->inst, stage, blob->data, blob->size);
+    }
+
+    // Missing state blocks give the D3D11 defaults. Tessellation states have no D3D11
+    // counterpart, the hull and domain shaders carry them.
+    const tm_renderer_shader_t *s = &cmd->shader;
+    const struct d3d11_state_block_t *raster = d3d11_state_block__from_blob(&s->raster_states, TM_RENDERER_STATE_BLOCK_TYPE_RASTER);
+    const struct d3d11_state_block_t *depth_stencil = d3d11_state_block__from_blob(&s->depth_stencil_states, TM_RENDERER_STATE_BLOCK_TYPE_DEPTH_STENCIL);
+    const struct d3d11_state_block_t *multi_sample = d3d11_state_block__from_blob(&s->multi_sample_states, TM_RENDERER_STATE_BLOCK_TYPE_MULTI_SAMPLE);
+    const struct d3d11_state_block_t *blend = d3d11_state_block__from_blob(&s->blend_states, TM_RENDERER_STATE_BLOCK_TYPE_BLEND);
+    if (!blend)
+        blend = d3d11_state_block__from_blob(&s->blend_states, TM_RENDERER_STATE_BLOCK_TYPE_RENDER_TARGET_BLEND);
+
+    tm_os_api->thread->enter_critical_section(&res->state_cache_lock);
+    shader->rasterizer_state = d3d11_state_cache__rasterizer(&res->state_cache, raster, multi_sample);
+    shader->depth_stencil_state = d3d11_state_cache__depth_stencil(&res->state_cache, depth_stencil, &shader->stencil_ref);
+    shader->blend_state = d3d11_state_cache__blend(&res->state_cache, blend, multi_sample, &shader->sample_mask);
+    tm_os_api->thread->leave_critical_section(&res->state_cache_lock);
+}
+
+static uint8_t
+bind_type(uint32_t bind_point_type)
+{
+    switch (bind_point_type)
+    {
+    case TM_RENDERER_BIND_POINT_TYPE_CONSTANT_BUFFER: return BIND_TYPE__CONSTANT_BUFFER;
+    case TM_RENDERER_BIND_POINT_TYPE_BUFFER:          return BIND_TYPE__SHADER_RESOURCE;
+    case TM_RENDERER_BIND_POINT_TYPE_IMAGE:           return BIND_TYPE__SHADER_RESOURCE;
+    case TM_RENDERER_BIND_POINT_TYPE_RW_BUFFER:       return BIND_TYPE__UNORDERED_ACCESS;
+    case TM_RENDERER_BIND_POINT_TYPE_RW_IMAGE:        return BIND_TYPE__UNORDERED_ACCESS;
+    case TM_RENDERER_BIND_POINT_TYPE_SAMPLER:         return BIND_TYPE__SAMPLER;
+    default:                                          return BIND_TYPE__VERTEX_BUFFER;
+    }
+}
+
+static void
+create_resource_binder(struct d3d11_resources_t *res, const tm_renderer_create_resource_binder_command_t *cmd)
+{
+    struct resource_binder_hot_t *hot = lookup(res, RESOURCE_POOL__RESOURCE_BINDER, cmd->handle.resource);
+    if (!hot)
+        return;
+
+    struct resource_binder_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__RESOURCE_BINDER], cmd->handle.resource);
+
+    uint32_t n = cmd->num_bind_points;
+    if (n > MAX_BINDER_BINDS)
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Resource binder has %u bind points, only %u are supported", n, MAX_BINDER_BINDS);
+        n = MAX_BINDER_BINDS;
+    }
+
+    // `TM_RENDERER_SHADER_STAGE_FLAG_*` bits are laid out like `1 << SHADER_STAGE__*`.
+    for (uint32_t i = 0; i != n; ++i)
+    {
+        const tm_renderer_resource_bind_point_t *bp = &cmd->bind_points[i];
+        cold->binds[i] = (struct d3d11_bind_t) {
+            .type       = bind_type(bp->type),
+            .slot       = (uint8_t)bp->binding,
+            .stage_mask = (uint8_t)bp->stage_flags,
+            .stride     = bp->stride,
+        };
+    }
+
+    hot->num_binds = n;
+    cold->binder.binds = cold->binds;
+    cold->binder.num_binds = n;
+}
+
+static void
+set_resource(struct d3d11_resources_t *res, const tm_renderer_set_resource_command_t *cmd)
+{
+    struct resource_binder_hot_t *hot = lookup(res, RESOURCE_POOL__RESOURCE_BINDER, cmd->binder.resource);
+    if (!hot || cmd->bind_point >= hot->num_binds)
+        return;
+
+    struct resource_binder_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__RESOURCE_BINDER], cmd->binder.resource);
+    cold->binds[cmd->bind_point].resource = cmd->resource.resource;
+    cold->binds[cmd->bind_point].offset = cmd->offset;
+}
+
+static void
+update_buffer(struct d3d11_resources_t *res, const tm_renderer_update_buffer_command_t *cmd)
+{
+    struct d3d11_device_i *device = res->device;
+    struct buffer_hot_t *hot = lookup(res, RESOURCE_POOL__BUFFER, cmd->handle.resource);
+    if (!hot || !device || cmd->offset + cmd->size > hot->size)
+        return;
+
+    const struct buffer_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__BUFFER], cmd->handle.resource);
+    if (cold->constants)
+        memcpy(cold->constants + cmd->offset, cmd->data, cmd->size);
+
+    // Suballocated constant buffers are copied to the arena when a frame binds them.
+    if (cold->suballocated || !hot->views[VIEW__RESOURCE])
+        return;
+
+    // The bindless copy is made after the update, by the flush that follows the ring's.
+    if (cold->bindless_index)
+        d3d11_bindless__changed(res->bindless, cold->bindless_index - 1, hot->views[VIEW__RESOURCE], cold->desc.size);
+
+    // Staging through the ring keeps transient updates from each renaming or stalling on the
+    // destination buffer. The copy is issued when the ring is flushed.
+    if (res->upload_ring
+        && d3d11_upload_ring__copy_to_buffer(res->upload_ring, hot->views[VIEW__RESOURCE], cmd->offset, cmd->data, cmd->size))
+    {
+        return;
+    }
+
+    // Direct updates must not overtake the copies queued before them.
+    if (res->upload_ring)
+        d3d11_upload_ring__flush(res->upload_ring);
+
+    struct d3d11_context_i *ctx = device->immediate_context(device->inst);
+
+    // Constant buffers can't be partially updated on 11.0 drivers, full updates go without a box.
+    const struct d3d11_box_t box = { cmd->offset, 0, 0, cmd->offset + cmd->size, 1, 1 };
+    const bool whole = cmd->offset == 0 && cmd->size == hot->size;
+    if (cold->desc.bind_flags == BIND_FLAG__CONSTANT_BUFFER && !whole)
+        tm_logger_api->print(TM_LOG_TYPE_ERROR, "Partial constant buffer updates are not supported");
+    else if (whole && cold->desc.size != cmd->size)
+    {
+        // Updates without a box write the whole buffer, which is rounded up or pooled.
+        TM_INIT_TEMP_ALLOCATOR(ta);
+        uint8_t *padded = tm_temp_alloc(ta, cold->desc.size);
+        memcpy(padded, cmd->data, cmd->size);
+        memset(padded + cmd->size, 0, cold->desc.size - cmd->size);
+        ctx->update_subresource(ctx->inst, hot->views[VIEW__RESOURCE], 0, 0, padded, 0, 0);
+        TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+    }
+    else
+        ctx->update_subresource(ctx->inst, hot->views[VIEW__RESOURCE], 0, whole ? 0 : &box, cmd->data, 0, 0);
+}
+
+static bool restore_image(struct d3d11_resources_t *res, struct image_hot_t *hot, struct image_cold_t *cold);
+
+static void
+update_image(struct d3d11_resources_t *res, const tm_renderer_update_image_command_t *cmd)
+{
+    struct d3d11_device_i *device = res->device;
+    struct image_hot_t *hot = lookup(res, RESOURCE_POOL__IMAGE, cmd->handle.resource);
+    if (!hot || !device)
+        return;
+
+    struct image_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__IMAGE], cmd->handle.resource);
+    if (hot->evicted && !restore_image(res, hot, cold))
+        return;
+    if (!hot->views[VIEW__RESOURCE] || cmd->mip_level >= cold->desc.mip_levels)
+        return;
+
+    uint32_t row_pitch, slice_pitch;
+    subresource_pitch(cold, cmd->mip_level, &row_pitch, &slice_pitch);
+
+    struct d3d11_context_i *ctx = device->immediate_context(device->inst);
+    const uint32_t subresource = cmd->mip_level + cmd->layer * cold->desc.mip_levels;
+    ctx->update_subresource(ctx->inst, hot->views[VIEW__RESOURCE], subresource, 0, cmd->data, row_pitch, slice_pitch);
+    if (cold->bindless_index)
+        d3d11_bindless__changed(res->bindless, cold->bindless_index - 1, hot->views[VIEW__RESOURCE], 0);
+}
+
+static void
+release_objects(struct d3d11_device_i *device, void *const *objects, uint32_t n)
+{
+    for (uint32_t i = n; i-- > 0;)
+    {
+        if (objects[i])
+            device->release(device->inst, objects[i]);
+    }
+}
+
+static void
+destroy_resource(struct d3d11_resources_t *res, uint32_t handle)
+{
+    const enum d3d11_resource_pool pool = handle_type(handle);
+    if (pool >= RESOURCE_POOL__COUNT)
+        return;
+
+    void *hot = lookup(res, pool, handle);
+    if (!hot)
+        return;
+
+    // Queued uploads may still reference the resource.
+    if (res->upload_ring && pool == RESOURCE_POOL__BUFFER)
+        d3d11_upload_ring__flush(res->upload_ring);
+
+    // Pending mips are dropped with the image.
+    if (pool == RESOURCE_POOL__IMAGE)
+    {
+        struct image_cold_t *c = d3d11_handle_pool__cold(&res->pools[pool], handle);
+        if (c->stream_index)
+            d3d11_mip_streamer__remove(&res->streamer, c->stream_index - 1);
+    }
+
+    if (pool == RESOURCE_POOL__BUFFER)
+    {
+        struct buffer_cold_t *c = d3d11_handle_pool__cold(&res->pools[pool], handle);
+        if (c->constants)
+            tm_free(res->allocator, c->constants, c->desc.size);
+    }
+
+    struct d3d11_device_i *device = res->device;
+    if (device)
+    {
+        switch (pool)
+        {
+        case RESOURCE_POOL__BUFFER:
+        {
+            struct buffer_hot_t *b = hot;
+            const struct buffer_cold_t *c = d3d11_handle_pool__cold(&res->pools[pool], handle);
+            if (c->bindless_index)
+                d3d11_bindless__remove(res->bindless, c->bindless_index - 1, b->views[VIEW__RESOURCE], c->desc.size);
+            if (b->views[VIEW__RESOURCE])
+                res->residency.resident_bytes -= c->desc.size;
+            if (c->pooled && b->views[VIEW__RESOURCE])
+            {
+                tm_carray_push(res->constant_pool[constant_pool_class(c->desc.size)], b->views[VIEW__RESOURCE], res->allocator);
+                b->views[VIEW__RESOURCE] = 0;
+            }
+            release_objects(device, b->views, TM_ARRAY_COUNT(b->views));
+            break;
+        }
+        case RESOURCE_POOL__IMAGE:
+        {
+            struct image_hot_t *i = hot;
+            struct image_cold_t *c = d3d11_handle_pool__cold(&res->pools[pool], handle);
+            if (c->bindless_index)
+                d3d11_bindless__remove(res->bindless, c->bindless_index - 1, i->views[VIEW__RESOURCE], 0);
+            release_objects(device, i->views, TM_ARRAY_COUNT(i->views));
+            res->residency.resident_bytes -= c->resident_size;
+            if (c->staging)
+            {
+                device->release(device->inst, c->staging);
+                res->residency.evicted_bytes -= c->size;
+            }
+            break;
+        }
+        case RESOURCE_POOL__SAMPLER:
+        {
+            struct sampler_hot_t *s = hot;
+            d3d11_state_cache__release(&res->state_cache, s->sampler);
+            break;
+        }
+        case RESOURCE_POOL__SHADER:
+        {
+            struct shader_cold_t *s = d3d11_handle_pool__cold(&res->pools[pool], handle);
+            release_objects(device, s->shader.stages, SHADER_STAGE__COUNT);
+            d3d11_state_cache__release(&res->state_cache, s->shader.rasterizer_state);
+            d3d11_state_cache__release(&res->state_cache, s->shader.depth_stencil_state);
+            d3d11_state_cache__release(&res->state_cache, s->shader.blend_state);
+            break;
+        }
+        case RESOURCE_POOL__SWAP_CHAIN:
+        {
+            struct swap_chain_hot_t *s = hot;
+            device->destroy_swap_chain(device->inst, s->swap_chain);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    d3d11_handle_pool__free(&res->pools[pool], handle);
+}
+
+// Releases the programs of reloads that haven't been swapped in.
+static void
+release_shader_reloads(struct d3d11_resources_t *res)
+{
+    tm_os_api->thread->enter_critical_section(&res->shader_reload_lock);
+    for (struct d3d11_shader_reload_t *r = res->shader_reloads; r != tm_carray_end(res->shader_reloads); ++r)
+        release_objects(res->device, r->stages, SHADER_STAGE__COUNT);
+    tm_carray_shrink(res->shader_reloads, 0);
+    tm_os_api->thread->leave_critical_section(&res->shader_reload_lock);
+}
+
+static void
+release_all(struct d3d11_resources_t *res)
+{
+    if (res->device)
+        release_shader_reloads(res);
+
+    for (uint32_t pool = 0; pool != RESOURCE_POOL__COUNT; ++pool)
+    {
+        const uint32_t n = res->pools[pool].next_index;
+        for (uint32_t index = 1; index < n; ++index)
+        {
+            const uint32_t handle = d3d11_handle_pool__handle_at(&res->pools[pool], index);
+            if (handle)
+                destroy_resource(res, handle);
+        }
+    }
+
+    for (uint32_t i = 0; i != CONSTANT_POOL_NUM_CLASSES; ++i)
+    {
+        if (res->device)
+            release_objects(res->device, res->constant_pool[i], (uint32_t)tm_carray_size(res->constant_pool[i]));
+        tm_carray_shrink(res->constant_pool[i], 0);
+    }
+
+    if (res->default_sampler)
+    {
+        res->device->release(res->device->inst, res->default_sampler);
+        res->default_sampler = 0;
+    }
+
+    if (res->device)
+        d3d11_state_cache__shutdown(&res->state_cache);
+}
+
+// -------------------------------------------------------------------
+// Residency
+
+// Only plain sampled images are evicted, render targets and UAVs hold results that are expensive
+// to move and are usually in use every frame anyway. Images still streaming in are left alone.
+static bool
+evictable(const struct d3d11_resources_t *res, const struct image_hot_t *hot, const struct image_cold_t *cold)
+{
+    const struct d3d11_texture_desc_t *desc = &cold->desc;
+    if (cold->stream_index && d3d11_mip_streamer__resident_mip(&res->streamer, cold->stream_index - 1))
+        return false;
+    return hot->views[VIEW__RESOURCE] && !hot->evicted && desc->bind_flags == BIND_FLAG__SHADER_RESOURCE
+        && desc->usage == USAGE__DEFAULT && desc->sample_count == 1;
+}
+
+// Copies the image to a staging texture and replaces it with a texture of its mips from
+// `EVICTION_MIP_DROP` on, or with nothing if it doesn't have enough mips.
+static bool
+evict_image(struct d3d11_resources_t *res, struct image_hot_t *hot, struct image_cold_t *cold)
+{
+    struct d3d11_device_i *device = res->device;
+    struct d3d11_context_i *ctx = device->immediate_context(device->inst);
+    const struct d3d11_texture_desc_t *desc = &cold->desc;
+    const uint32_t slices = num_slices(desc);
+    void *texture = hot->views[VIEW__RESOURCE];
+
+    struct d3d11_texture_desc_t staging_desc = *desc;
+    staging_desc.usage = USAGE__STAGING;
+    staging_desc.bind_flags = 0;
+    staging_desc.cpu_access_flags = CPU_ACCESS__READ;
+    staging_desc.misc_flags = 0;
+    void *staging = device->create_texture(device->inst, &staging_desc, 0);
+    if (!staging)
+        return false;
+
+    for (uint32_t s = 0; s != desc->mip_levels * slices; ++s)
+        ctx->copy_subresource(ctx->inst, staging, s, texture, s);
+
+    // The pool slice keeps the full image, but a pending copy to it must not outlive the texture.
+    if (cold->bindless_index)
+        d3d11_bindless__flush(res->bindless, false);
+
+    // The top mip of block compressed textures must be made of whole blocks.
+    const uint32_t width = desc->width >> EVICTION_MIP_DROP;
+    const uint32_t height = desc->height >> EVICTION_MIP_DROP;
+    const uint32_t b = cold->block_size;
+    void *reduced = 0;
+    uint64_t reduced_size = 0;
+    if (desc->mip_levels > EVICTION_MIP_DROP && (b == 1 || (width && height && width % b == 0 && height % b == 0)))
+    {
+        struct d3d11_texture_desc_t reduced_desc = *desc;
+        reduced_desc.width = tm_max(width, 1);
+        reduced_desc.height = tm_max(height, 1);
+        if (desc->dimension == TEXTURE_DIMENSION__3D)
+            reduced_desc.depth_or_array_size = tm_max(desc->depth_or_array_size >> EVICTION_MIP_DROP, 1);
+        reduced_desc.mip_levels = desc->mip_levels - EVICTION_MIP_DROP;
+
+        reduced = device->create_texture(device->inst, &reduced_desc, 0);
+        for (uint32_t slice = 0; reduced && slice != slices; ++slice)
+        {
+            for (uint32_t mip = 0; mip != reduced_desc.mip_levels; ++mip)
+            {
+                ctx->copy_subresource(ctx->inst, reduced, mip + slice * reduced_desc.mip_levels, texture,
+                    mip + EVICTION_MIP_DROP + slice * desc->mip_levels);
+            }
+        }
+        reduced_size = reduced ? image_size(cold, EVICTION_MIP_DROP) : 0;
+    }
+
+    release_objects(device, hot->views, VIEW__COUNT);
+    memset(hot->views, 0, sizeof(hot->views));
+    if (reduced)
+        create_image_views(device, hot, desc->bind_flags, reduced);
+
+    struct d3d11_residency_t *r = &res->residency;
+    r->resident_bytes -= cold->resident_size - reduced_size;
+    r->evicted_bytes += cold->size;
+    ++r->num_evictions;
+
+    cold->resident_size = reduced_size;
+    cold->staging = staging;
+    hot->evicted = true;
+    return true;
+}
+
+// Recreates the full texture of an evicted image from its staging copy.
+static bool
+restore_image(struct d3d11_resources_t *res, struct image_hot_t *hot, struct image_cold_t *cold)
+{
+    struct d3d11_device_i *device = res->device;
+    struct d3d11_context_i *ctx = device->immediate_context(device->inst);
+    const struct d3d11_texture_desc_t *desc = &cold->desc;
+
+    void *texture = device->create_texture(device->inst, desc, 0);
+    if (!texture)
+    {
+        tm_logger_api->print(TM_LOG_TYPE_ERROR, "Failed to restore evicted image");
+        return false;
+    }
+
+    for (uint32_t s = 0; s != desc->mip_levels * num_slices(desc); ++s)
+        ctx->copy_subresource(ctx->inst, texture, s, cold->staging, s);
+
+    release_objects(device, hot->views, VIEW__COUNT);
+    memset(hot->views, 0, sizeof(hot->views));
+    create_image_views(device, hot, desc->bind_flags, texture);
+    device->release(device->inst, cold->staging);
+
+    struct d3d11_residency_t *r = &res->residency;
+    r->resident_bytes += cold->size - cold->resident_size;
+    r->evicted_bytes -= cold->size;
+    ++r->num_restores;
+
+    cold->resident_size = cold->size;
+    cold->staging = 0;
+    hot->evicted = false;
+    return true;
+}
+
+struct lru_entry_t
+{
+    uint32_t idle_frames;
+    uint32_t handle;
+};
+
+// Orders the longest idle images first.
+static int
+lru_entry__compare(const void *a, const void *b)
+{
+    const uint32_t x = ((const struct lru_entry_t *)a)->idle_frames;
+    const uint32_t y = ((const struct lru_entry_t *)b)->idle_frames;
+    return x > y ? -1 : x < y;
+}
+
+// -------------------------------------------------------------------
+// Resolver
+
+static void *
+resolver__view(struct d3d11_resource_resolver_o *inst, uint32_t resource, enum d3d11_view view)
+{
+    struct d3d11_resources_t *res = (struct d3d11_resources_t *)inst;
+
+    switch (handle_type(resource))
+    {
+    case RESOURCE_POOL__BUFFER:
+    {
+        const struct buffer_hot_t *b = lookup(res, RESOURCE_POOL__BUFFER, resource);
+        return b && view < TM_ARRAY_COUNT(b->views) ? b->views[view] : 0;
+    }
+    case RESOURCE_POOL__IMAGE:
+    {
+        struct image_hot_t *i = lookup(res, RESOURCE_POOL__IMAGE, resource);
+        if (!i || view >= VIEW__COUNT)
+            return 0;
+
+        // Only written when it changes, so lookups of the same image from several jobs don't keep
+        // stealing the cache line from each other.
+        const uint32_t frame = res->residency.frame;
+        if (atomic_load_uint32_t(&i->last_used) != frame)
+            atomic_store_uint32_t(&i->last_used, frame);
+        if (i->evicted)
+            atomic_store_uint32_t(&res->residency.restore_requested, 1);
+        return i->views[view];
+    }
+    case RESOURCE_POOL__SAMPLER:
+    {
+        const struct sampler_hot_t *s = lookup(res, RESOURCE_POOL__SAMPLER, resource);
+        if (!s || view != VIEW__RESOURCE)
+            return 0;
+        return s->sampler ? s->sampler : res->default_sampler;
+    }
+    case RESOURCE_POOL__SWAP_CHAIN:
+    {
+        const struct swap_chain_hot_t *s = lookup(res, RESOURCE_POOL__SWAP_CHAIN, resource);
+        return s && view == VIEW__RTV ? s->swap_chain->render_target_view(s->swap_chain->inst) : 0;
+    }
+    default:
+        atomic_fetch_add_uint64_t(&res->num_stale_handles, 1);
+        return 0;
+    }
+}
+
+static const struct d3d11_shader_t *
+resolver__shader(struct d3d11_resource_resolver_o *inst, uint32_t resource)
+{
+    struct d3d11_resources_t *res = (struct d3d11_resources_t *)inst;
+    if (!lookup(res, RESOURCE_POOL__SHADER, resource))
+        return 0;
+
+    const struct shader_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__SHADER], resource);
+    return &cold->shader;
+}
+
+static const struct d3d11_resource_binder_t *
+resolver__resource_binder(struct d3d11_resource_resolver_o *inst, uint32_t resource)
+{
+    struct d3d11_resources_t *res = (struct d3d11_resources_t *)inst;
+    if (!lookup(res, RESOURCE_POOL__RESOURCE_BINDER, resource))
+        return 0;
+
+    const struct resource_binder_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__RESOURCE_BINDER], resource);
+    return &cold->binder;
+}
+
+static const void *
+resolver__constants(struct d3d11_resource_resolver_o *inst, uint32_t resource, uint32_t *size)
+{
+    struct d3d11_resources_t *res = (struct d3d11_resources_t *)inst;
+    if (!lookup(res, RESOURCE_POOL__BUFFER, resource))
+        return 0;
+
+    const struct buffer_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__BUFFER], resource);
+    *size = cold->desc.size;
+    return cold->constants;
+}
+
+static void *
+resolver__constant_buffer(struct d3d11_resource_resolver_o *inst, uint32_t resource, uint32_t *first_constant,
+    uint32_t *num_constants)
+{
+    struct d3d11_resources_t *res = (struct d3d11_resources_t *)inst;
+    *first_constant = 0;
+    *num_constants = 0;
+    if (handle_type(resource) != RESOURCE_POOL__BUFFER)
+        return resolver__view(inst, resource, VIEW__RESOURCE);
+
+    const struct buffer_hot_t *hot = lookup(res, RESOURCE_POOL__BUFFER, resource);
+    if (!hot || hot->views[VIEW__RESOURCE])
+        return hot ? hot->views[VIEW__RESOURCE] : 0;
+
+    const struct buffer_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__BUFFER], resource);
+    if (!cold->suballocated || cold->arena_frame != res->residency.frame)
+        return 0;
+
+    *first_constant = cold->arena_offset / 16;
+    *num_constants = arena_size(cold->desc.size) / 16;
+    return res->constant_arena->buffer;
+}
+
+// -------------------------------------------------------------------
+// Handle allocator
+
+// Called by the resource command buffers when a resource is recorded, possibly from several
+// threads at once.
+static uint32_t
+handle_allocator__allocate(struct tm_renderer_handle_allocator_o *inst, uint32_t resource_type)
+{
+    struct d3d11_resources_t *res = (struct d3d11_resources_t *)inst;
+    const enum d3d11_resource_pool pool = pool_from_resource_type(resource_type);
+    return pool < RESOURCE_POOL__COUNT ? d3d11_handle_pool__allocate(&res->pools[pool]) : 0;
+}
+
+// -------------------------------------------------------------------
+// Resource jobs
+//
+// Creating resources is mostly spent in the driver, and `ID3D11Device` is free-threaded, so large
+// submits create their resources on jobs. Creation and resource binder writes only touch the
+// device and the records of their own handle. Everything else goes through the immediate context,
+// the upload ring or the mip streamer and stays on the submitting thread. The commands of a handle
+// always run on the same job, in the order they were recorded.
+
+struct resource_command_t
+{
+    uint32_t type;
+
+    // Handle the command works on if it may run on a job, else 0.
+    uint32_t job_handle;
+
+    const void *data;
+};
+
+struct resource_job_t
+{
+    struct d3d11_resources_t *res;
+    const struct resource_command_t *commands;
+
+    // Indices of the commands of the job, in recorded order.
+    const uint32_t *indices;
+    uint32_t num_indices;
+    TM_PAD(4);
+
+    // Video memory taken by the resources the job created.
+    uint64_t resident_bytes;
+};
+
+static uint32_t
+job_handle(const struct d3d11_resources_t *res, uint32_t type, const void *data)
+{
+    switch (type)
+    {
+    case TM_RENDERER_RESOURCE_COMMAND_CREATE_BUFFER:
+    {
+        // Pooled constant buffers are shared by all handles and written on the immediate context.
+        // So are the heap ranges of bindless buffers.
+        const tm_renderer_create_buffer_command_t *cmd = data;
+        const uint32_t usage = cmd->desc.usage_flags;
+        if ((!res->constant_arena && uniform_only(usage)) || (res->bindless && (usage & TM_RENDERER_BUFFER_USAGE_STORAGE)))
+            return 0;
+        return cmd->handle.resource;
+    }
+    case TM_RENDERER_RESOURCE_COMMAND_CREATE_IMAGE:
+    {
+        // Streamed images upload their small mips on the immediate context, bindless images take
+        // pool slices.
+        const tm_renderer_create_image_command_t *cmd = data;
+        const uint32_t written = TM_RENDERER_IMAGE_USAGE_RENDER_TARGET | TM_RENDERER_IMAGE_USAGE_UAV;
+        if ((res->streaming.enabled && cmd->data)
+            || (res->bindless && cmd->desc.type == TM_RENDERER_IMAGE_TYPE_2D && !(cmd->desc.usage_flags & written)))
+        {
+            return 0;
+        }
+        return cmd->handle.resource;
+    }
+    case TM_RENDERER_RESOURCE_COMMAND_CREATE_SAMPLER:
+        return ((const tm_renderer_create_sampler_command_t *)data)->handle.resource;
+    case TM_RENDERER_RESOURCE_COMMAND_CREATE_SHADER:
+        return ((const tm_renderer_create_shader_command_t *)data)->handle.resource;
+    case TM_RENDERER_RESOURCE_COMMAND_CREATE_RESOURCE_BINDER:
+        return ((const tm_renderer_create_resource_binder_command_t *)data)->handle.resource;
+    case TM_RENDERER_RESOURCE_COMMAND_SET_RESOURCE:
+        return ((const tm_renderer_set_resource_command_t *)data)->binder.resource;
+    default:
+        return 0;
+    }
+}
+
+// Executes a resource command and returns the video memory taken by the resource it created.
+static uint64_t
+execute_command(struct d3d11_resources_t *res, uint32_t type, const void *data)
+{
+    switch (type)
+    {
+    case TM_RENDERER_RESOURCE_COMMAND_CREATE_BUFFER:
+        return create_buffer(res, data);
+    case TM_RENDERER_RESOURCE_COMMAND_CREATE_IMAGE:
+        return create_image(res, data);
+    case TM_RENDERER_RESOURCE_COMMAND_CREATE_SAMPLER:
+        create_sampler(res, data);
+        break;
+    case TM_RENDERER_RESOURCE_COMMAND_CREATE_SHADER:
+        create_shader(res, data);
+        break;
+    case TM_RENDERER_RESOURCE_COMMAND_CREATE_RESOURCE_BINDER:
+        create_resource_binder(res, data);
+        break;
+    case TM_RENDERER_RESOURCE_COMMAND_SET_RESOURCE:
+        set_resource(res, data);
+        break;
+    case TM_RENDERER_RESOURCE_COMMAND_UPDATE_BUFFER:
+        update_buffer(res, data);
+        break;
+    case TM_RENDERER_RESOURCE_COMMAND_UPDATE_IMAGE:
+        update_image(res, data);
+        break;
+    case TM_RENDERER_RESOURCE_COMMAND_DESTROY_RESOURCE:
+        destroy_resource(res, ((const tm_renderer_destroy_resource_command_t *)data)->handle.resource);
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+static void
+resource_job(void *data)
+{
+    struct resource_job_t *j = data;
+    for (uint32_t i = 0; i != j->num_indices; ++i)
+    {
+        const struct resource_command_t *c = j->commands + j->indices[i];
+        j->resident_bytes += execute_command(j->res, c->type, c->data);
+    }
+}
+
+// Spreads the `num_job_commands` commands with a job handle over `num_jobs` jobs, by handle, and
+// waits for them.
+static void
+execute_on_jobs(struct d3d11_resources_t *res, const struct resource_command_t *commands, uint32_t num_commands,
+    uint32_t num_job_commands, uint32_t num_jobs)
+{
+    TM_INIT_TEMP_ALLOCATOR(ta);
+
+    // Counting sort of the command indices on their job. Handle indices are handed out in
+    // sequence, which spreads the commands evenly.
+    uint32_t *first = tm_temp_alloc(ta, (num_jobs + 1) * sizeof(*first));
+    memset(first, 0, (num_jobs + 1) * sizeof(*first));
+    for (uint32_t i = 0; i != num_commands; ++i)
+    {
+        if (commands[i].job_handle)
+            ++first[handle_index(commands[i].job_handle) % num_jobs + 1];
+    }
+    for (uint32_t job = 0; job != num_jobs; ++job)
+        first[job + 1] += first[job];
+
+    uint32_t *indices = tm_temp_alloc(ta, num_job_commands * sizeof(*indices));
+    uint32_t *next = tm_temp_alloc(ta, num_jobs * sizeof(*next));
+    memcpy(next, first, num_jobs * sizeof(*next));
+    for (uint32_t i = 0; i != num_commands; ++i)
+    {
+        if (commands[i].job_handle)
+            indices[next[handle_index(commands[i].job_handle) % num_jobs]++] = i;
+    }
+
+    struct resource_job_t *jobs = tm_temp_alloc(ta, num_jobs * sizeof(*jobs));
+    tm_jobdecl_t *decls = tm_temp_alloc(ta, num_jobs * sizeof(*decls));
+    for (uint32_t job = 0; job != num_jobs; ++job)
+    {
+        jobs[job] = (struct resource_job_t) {
+            .res         = res,
+            .commands    = commands,
+            .indices     = indices + first[job],
+            .num_indices = first[job + 1] - first[job],
+        };
+        decls[job] = (tm_jobdecl_t) { .task = resource_job, .data = jobs + job };
+    }
+
+    tm_atomic_counter_o *counter = tm_job_system_api->run_jobs(decls, num_jobs);
+    tm_job_system_api->wait_for_counter_and_free(counter);
+
+    for (uint32_t job = 0; job != num_jobs; ++job)
+        res->residency.resident_bytes += jobs[job].resident_bytes;
+
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+}
+
+// -------------------------------------------------------------------
+// Public
+
+void
+d3d11_resources__init(struct d3d11_resources_t *res, struct tm_allocator_i *allocator)
+{
+    memset(res, 0, sizeof(*res));
+    res->allocator = allocator;
+
+    for (uint32_t pool = 0; pool != RESOURCE_POOL__COUNT; ++pool)
+        d3d11_handle_pool__init(&res->pools[pool], allocator, pool, hot_sizes[pool], cold_sizes[pool]);
+
+    res->streaming = (struct tm_d3d11_texture_streaming_t) {
+        .resident_mip_size = DEFAULT_STREAMING_RESIDENT_MIP_SIZE,
+        .upload_budget     = DEFAULT_STREAMING_UPLOAD_BUDGET,
+    };
+    d3d11_mip_streamer__init(&res->streamer, allocator);
+    tm_os_api->thread->create_critical_section(&res->state_cache_lock);
+    tm_os_api->thread->create_critical_section(&res->shader_reload_lock);
+
+    res->resolver = (struct d3d11_resource_resolver_i) {
+        .inst            = (struct d3d11_resource_resolver_o *)res,
+        .view            = resolver__view,
+        .shader          = resolver__shader,
+        .resource_binder = resolver__resource_binder,
+        .constants       = resolver__constants,
+        .constant_buffer = resolver__constant_buffer,
+    };
+
+    res->handle_allocator = (tm_renderer_handle_allocator_i) {
+        .inst     = (struct tm_renderer_handle_allocator_o *)res,
+        .allocate = handle_allocator__allocate,
+    };
+}
+
+void
+d3d11_resources__shutdown(struct d3d11_resources_t *res)
+{
+    release_all(res);
+    d3d11_mip_streamer__shutdown(&res->streamer);
+    tm_os_api->thread->destroy_critical_section(&res->state_cache_lock);
+    tm_os_api->thread->destroy_critical_section(&res->shader_reload_lock);
+
+    for (uint32_t i = 0; i != CONSTANT_POOL_NUM_CLASSES; ++i)
+        tm_carray_free(res->constant_pool[i], res->allocator);
+    tm_carray_free(res->shader_reloads, res->allocator);
+
+    for (uint32_t pool = 0; pool != RESOURCE_POOL__COUNT; ++pool)
+        d3d11_handle_pool__shutdown(&res->pools[pool]);
+}
+
+void
+d3d11_resources__set_device(struct d3d11_resources_t *res, struct d3d11_device_i *device)
+{
+    if (res->device)
+        release_all(res);
+
+    res->device = device;
+
+    if (device)
+    {
+        res->default_sampler = device->create_sampler_state(device->inst, &default_sampler_desc);
+        d3d11_state_cache__init(&res->state_cache, res->allocator, device);
+    }
+}
+
+void
+d3d11_resources__submit(struct d3d11_resources_t *res, struct tm_renderer_resource_command_buffer_o *const *buffers,
+    uint32_t num_buffers, uint32_t max_jobs)
+{
+    struct tm_renderer_resource_command_buffer_api *rcb_api = tm_renderer_api->tm_renderer_resource_command_buffer_api;
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i != num_buffers; ++i)
+        n += rcb_api->num_commands(buffers[i]);
+    if (!n)
+        return;
+
+    TM_INIT_TEMP_ALLOCATOR(ta);
+
+    struct resource_command_t *commands = tm_temp_alloc(ta, n * sizeof(*commands));
+    uint32_t num_job_commands = 0;
+    for (uint32_t i = 0, k = 0; i != num_buffers; ++i)
+    {
+        const uint32_t num = rcb_api->num_commands(buffers[i]);
+        const tm_renderer_resource_commands_t c = rcb_api->commands(buffers[i]);
+        for (uint32_t j = 0; j != num; ++j, ++k)
+        {
+            const uint32_t handle = job_handle(res, c.types[j], c.data[j]);
+            commands[k] = (struct resource_command_t) { .type = c.types[j], .job_handle = handle, .data = c.data[j] };
+            num_job_commands += handle != 0;
+        }
+    }
+
+    // The job commands run first. That keeps the order of the commands of each handle, since a
+    // handle is created before it is updated or destroyed, and a binder written after it has been
+    // destroyed ends up destroyed either way.
+    const uint32_t num_jobs = res->device ? tm_min(num_job_commands / MIN_RESOURCE_COMMANDS_PER_JOB, max_jobs) : 0;
+    const bool on_jobs = num_jobs > 1;
+    if (on_jobs)
+    {
+        execute_on_jobs(res, commands, n, num_job_commands, num_jobs);
+        res->stats.num_job_commands += num_job_commands;
+    }
+
+    for (const struct resource_command_t *c = commands; c != commands + n; ++c)
+    {
+        if (!on_jobs || !c->job_handle)
+            res->residency.resident_bytes += execute_command(res, c->type, c->data);
+    }
+    res->stats.num_commands += n;
+
+    if (res->upload_ring)
+        d3d11_upload_ring__flush(res->upload_ring);
+    if (res->bindless)
+        d3d11_bindless__flush(res->bindless, false);
+
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+}
+
+void
+d3d11_resources__begin_frame(struct d3d11_resources_t *res)
+{
+    ++res->residency.frame;
+
+    // The old programs may still be referenced by work in flight, the device keeps them alive
+    // until it is done with them.
+    tm_os_api->thread->enter_critical_section(&res->shader_reload_lock);
+    for (struct d3d11_shader_reload_t *r = res->shader_reloads; r != tm_carray_end(res->shader_reloads); ++r)
+    {
+        if (!lookup(res, RESOURCE_POOL__SHADER, r->handle))
+        {
+            release_objects(res->device, r->stages, SHADER_STAGE__COUNT);
+            continue;
+        }
+
+        struct shader_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__SHADER], r->handle);
+        for (uint32_t stage = 0; stage != SHADER_STAGE__COUNT; ++stage)
+        {
+            if (!r->stages[stage])
+                continue;
+            if (cold->shader.stages[stage])
+                res->device->release(res->device->inst, cold->shader.stages[stage]);
+            cold->shader.stages[stage] = r->stages[stage];
+        }
+        ++res->stats.num_shader_reloads;
+    }
+    tm_carray_shrink(res->shader_reloads, 0);
+    tm_os_api->thread->leave_critical_section(&res->shader_reload_lock);
+}
+
+// Stamps the suballocated constant buffers bound by the binders of `si` that haven't been uploaded
+// this frame with their offset from the start of the frame's constants, and pushes their handles to
+// `buffers`. Returns the bytes they take.
+static uint32_t
+place_constants(struct d3d11_resources_t *res, const tm_renderer_shader_info_t *si, uint32_t offset,
+    /* carray */ uint32_t **buffers, struct tm_allocator_i *ta)
+{
+    const uint32_t frame = res->residency.frame;
+    const uint32_t start = offset;
+    for (uint32_t i = 0; i != si->num_resource_binders; ++i)
+    {
+        // Stale handles are counted by the translator.
+        const uint32_t binder_handle = si->resource_binders[i].resource;
+        if (!d3d11_handle_pool__hot(&res->pools[RESOURCE_POOL__RESOURCE_BINDER], binder_handle))
+            continue;
+
+        struct resource_binder_cold_t *binder = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__RESOURCE_BINDER], binder_handle);
+        if (binder->constants_frame == frame)
+            continue;
+        binder->constants_frame = frame;
+
+        for (uint32_t j = 0; j != binder->binder.num_binds; ++j)
+        {
+            const struct d3d11_bind_t *bind = binder->binds + j;
+            if (bind->type != BIND_TYPE__CONSTANT_BUFFER || handle_type(bind->resource) != RESOURCE_POOL__BUFFER
+                || !d3d11_handle_pool__hot(&res->pools[RESOURCE_POOL__BUFFER], bind->resource))
+            {
+                continue;
+            }
+
+            struct buffer_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__BUFFER], bind->resource);
+            if (!cold->suballocated || cold->arena_frame == frame)
+                continue;
+
+            cold->arena_frame = frame;
+            cold->arena_offset = offset;
+            offset += arena_size(cold->desc.size);
+            tm_carray_temp_push(*buffers, bind->resource, ta);
+        }
+    }
+    return offset - start;
+}
+
+void
+d3d11_resources__upload_constants(struct d3d11_resources_t *res, const tm_renderer_command_t *commands,
+    uint32_t num_commands)
+{
+    res->stats.constant_arena_bytes = 0;
+    if (!res->constant_arena)
+        return;
+
+    TM_INIT_TEMP_ALLOCATOR(ta);
+
+    /* carray */ uint32_t *buffers = 0;
+    uint32_t size = 0;
+    for (const tm_renderer_command_t *cmd = commands; cmd != commands + num_commands; ++cmd)
+    {
+        if (cmd->type == TM_RENDERER_COMMAND_DRAW_CALL)
+            size += place_constants(res, &((const tm_renderer_draw_command_t *)cmd->data)->shader_info, size, &buffers, ta);
+        else if (cmd->type == TM_RENDERER_COMMAND_COMPUTE_DISPATCH)
+            size += place_constants(res, &((const tm_renderer_compute_command_t *)cmd->data)->shader_info, size, &buffers, ta);
+    }
+
+    // A single allocation per frame, so the arena never wraps, and renames its buffer, in the
+    // middle of the frame's constants.
+    uint32_t base = 0;
+    uint8_t *p = size ? d3d11_upload_ring__allocate(res->constant_arena, size, 256, &base) : 0;
+    if (size && !p)
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Failed to allocate %u bytes of constants from the arena", size);
+
+    for (const uint32_t *h = buffers; h != tm_carray_end(buffers); ++h)
+    {
+        struct buffer_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__BUFFER], *h);
+        if (p)
+        {
+            memcpy(p + cold->arena_offset, cold->constants, cold->desc.size);
+            cold->arena_offset += base;
+        }
+        else
+            cold->arena_frame = 0;
+    }
+    res->stats.constant_arena_bytes = p ? size : 0;
+
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+}
+
+void
+d3d11_resources__enforce_budget(struct d3d11_resources_t *res, uint64_t budget)
+{
+    struct d3d11_residency_t *r = &res->residency;
+    const bool over_budget = budget && r->resident_bytes > budget;
+    if (!res->device || (!over_budget && !atomic_load_uint32_t(&r->restore_requested)))
+        return;
+    atomic_store_uint32_t(&r->restore_requested, 0);
+
+    const uint64_t target = budget / 16 * EVICTION_TARGET_SIXTEENTHS;
+    struct d3d11_handle_pool_t *pool = &res->pools[RESOURCE_POOL__IMAGE];
+
+    TM_INIT_TEMP_ALLOCATOR(ta);
+    /* carray */ struct lru_entry_t *candidates = 0;
+
+    const uint32_t n = pool->next_index;
+    for (uint32_t index = 1; index < n; ++index)
+    {
+        const uint32_t handle = d3d11_handle_pool__handle_at(pool, index);
+        struct image_hot_t *hot = handle ? d3d11_handle_pool__hot(pool, handle) : 0;
+        if (!hot)
+            continue;
+
+        struct image_cold_t *cold = d3d11_handle_pool__cold(pool, handle);
+        const uint32_t idle_frames = r->frame - atomic_load_uint32_t(&hot->last_used);
+        if (hot->evicted && idle_frames < EVICTION_MIN_IDLE_FRAMES)
+        {
+            if (!budget || r->resident_bytes + cold->size - cold->resident_size <= target)
+                restore_image(res, hot, cold);
+        }
+        else if (over_budget && idle_frames >= EVICTION_MIN_IDLE_FRAMES && evictable(res, hot, cold))
+        {
+            const struct lru_entry_t e = { .idle_frames = idle_frames, .handle = handle };
+            tm_carray_temp_push(candidates, e, ta);
+        }
+    }
+
+    qsort(candidates, tm_carray_size(candidates), sizeof(*candidates), lru_entry__compare);
+    for (const struct lru_entry_t *e = candidates; e != tm_carray_end(candidates) && r->resident_bytes > target; ++e)
+        evict_image(res, d3d11_handle_pool__hot(pool, e->handle), d3d11_handle_pool__cold(pool, e->handle));
+
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+}
+
+void
+d3d11_resources__stream_mips(struct d3d11_resources_t *res)
+{
+    struct d3d11_device_i *device = res->device;
+    if (!device)
+        return;
+
+    struct d3d11_context_i *ctx = device->immediate_context(device->inst);
+    struct d3d11_mip_streamer_t *s = &res->streamer;
+    struct d3d11_handle_pool_t *pool = &res->pools[RESOURCE_POOL__IMAGE];
+
+    uint64_t uploaded = 0;
+    for (uint32_t index = d3d11_mip_streamer__top(s); index != UINT32_MAX; index = d3d11_mip_streamer__top(s))
+    {
+        // A mip larger than the whole budget still goes through, on its own.
+        uint64_t size;
+        const uint32_t mip = d3d11_mip_streamer__next_mip(s, index, &size);
+        if (uploaded && uploaded + size > res->streaming.upload_budget)
+            break;
+
+        // Streamed images can't be evicted, so the texture is the full one.
+        const uint32_t handle = s->images[index].image;
+        const struct image_hot_t *hot = d3d11_handle_pool__hot(pool, handle);
+        const struct image_cold_t *cold = d3d11_handle_pool__cold(pool, handle);
+        void *texture = hot->views[VIEW__RESOURCE];
+        upload_mip(ctx, texture, cold, mip, d3d11_mip_streamer__mip_data(s, index, mip));
+        ctx->set_resource_min_lod(ctx->inst, texture, (float)mip);
+        if (cold->bindless_index)
+            d3d11_bindless__changed(res->bindless, cold->bindless_index - 1, texture, 0);
+
+        d3d11_mip_streamer__mip_uploaded(s, index);
+        uploaded += size;
+    }
+}
+
+void
+d3d11_resources__set_stream_priority(struct d3d11_resources_t *res, uint32_t handle, float priority)
+{
+    if (!lookup(res, RESOURCE_POOL__IMAGE, handle))
+        return;
+
+    const struct image_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__IMAGE], handle);
+    if (cold->stream_index)
+        d3d11_mip_streamer__set_priority(&res->streamer, cold->stream_index - 1, priority);
+}
+
+uint32_t
+d3d11_resources__create_swap_chain(struct d3d11_resources_t *res, const struct d3d11_swap_chain_desc_t *desc)
+{
+    if (!res->device)
+        return 0;
+
+    struct d3d11_swap_chain_i *swap_chain = res->device->create_swap_chain(res->device->inst, desc);
+    if (!swap_chain)
+        return 0;
+
+    const uint32_t handle = d3d11_handle_pool__allocate(&res->pools[RESOURCE_POOL__SWAP_CHAIN]);
+    if (!handle)
+    {
+        res->device->destroy_swap_chain(res->device->inst, swap_chain);
+        return 0;
+    }
+
+    struct swap_chain_hot_t *hot = d3d11_handle_pool__hot(&res->pools[RESOURCE_POOL__SWAP_CHAIN], handle);
+    hot->swap_chain = swap_chain;
+    return handle;
+}
+
+bool
+d3d11_resources__reload_shader(struct d3d11_resources_t *res, uint32_t handle, const tm_renderer_shader_blob_t *blobs)
+{
+    struct d3d11_device_i *device = res->device;
+    if (!device || handle_type(handle) != RESOURCE_POOL__SHADER || !lookup(res, RESOURCE_POOL__SHADER, handle))
+        return false;
+
+    struct d3d11_shader_reload_t reload = { .handle = handle };
+    for (uint32_t stage = 0; stage != SHADER_STAGE__COUNT; ++stage)
+    {
+        if (!blobs[stage].size)
+            continue;
+        reload.stages[stage] = device->create_shader(device->inst, stage, blobs[stage].data, blobs[stage].size);
+        if (!reload.stages[stage])
+        {
+            release_objects(device, reload.stages, SHADER_STAGE__COUNT);
+            return false;
+        }
+    }
+
+    tm_os_api->thread->enter_critical_section(&res->shader_reload_lock);
+    tm_carray_push(res->shader_reloads, reload, res->allocator);
+    tm_os_api->thread->leave_critical_section(&res->shader_reload_lock);
+    return true;
+}
+
+void
+d3d11_resources__set_shader_draw_instancing(struct d3d11_resources_t *res, uint32_t handle, bool enabled)
+{
+    if (!lookup(res, RESOURCE_POOL__SHADER, handle))
+        return;
+
+    struct shader_cold_t *cold = d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__SHADER], handle);
+    cold->shader.draw_instancing = enabled;
+}
+
+uint32_t
+d3d11_resources__bindless_handle(struct d3d11_resources_t *res, uint32_t handle)
+{
+    uint32_t index = 0;
+    if (handle_type(handle) == RESOURCE_POOL__BUFFER && lookup(res, RESOURCE_POOL__BUFFER, handle))
+        index = ((const struct buffer_cold_t *)d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__BUFFER], handle))->bindless_index;
+    else if (handle_type(handle) == RESOURCE_POOL__IMAGE && lookup(res, RESOURCE_POOL__IMAGE, handle))
+        index = ((const struct image_cold_t *)d3d11_handle_pool__cold(&res->pools[RESOURCE_POOL__IMAGE], handle))->bindless_index;
+    return index - 1;
+}
+
+struct d3d11_swap_chain_i *
+d3d11_resources__swap_chain(struct d3d11_resources_t *res, uint32_t handle)
+{
+    const struct swap_chain_hot_t *hot = lookup(res, RESOURCE_POOL__SWAP_CHAIN, handle);
+    return hot ? hot->swap_chain : 0;
+}
+
+void
+d3d11_resources__destroy(struct d3d11_resources_t *res, uint32_t handle)
+{
+    destroy_resource(res, handle);
+}
+
+uint32_t
+d3d11_resources__num_live(const struct d3d11_resources_t *res, enum d3d11_resource_pool pool)
+{
+    return pool < RESOURCE_POOL__COUNT ? res->pools[pool].num_live : 0;
+}
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <foundation/api_types.h>
+#include <foundation/atomics.inl>
+#include <plugins/renderer/resource_command_buffer.h>
+
+#include "d3d11_device.h"
+#include "d3d11_handle_pool.h"
+#include "d3d11_mip_streamer.h"
+#include "d3d11_state_cache.h"
+
+// Backend side representation of the renderer resources the command translator binds, and the
+// resolver interface it uses to map renderer handles to them.
+
+enum d3d11_bind_type
+{
+    BIND_TYPE__CONSTANT_BUFFER = 0,
+    BIND_TYPE__SHADER_RESOURCE,
+    BIND_TYPE__SAMPLER,
+    BIND_TYPE__UNORDERED_ACCESS,
+    BIND_TYPE__VERTEX_BUFFER,
+};
+
+// A single slot binding of a resource binder.
+struct d3d11_bind_t
+{
+    // `enum d3d11_bind_type`.
+    uint8_t type;
+
+    // Register (or vertex buffer slot) to bind to.
+    uint8_t slot;
+
+    // Bit mask of `enum d3d11_shader_stage`s that see the binding. Ignored for vertex buffers.
+    uint8_t stage_mask;
+    TM_PAD(1);
+
+    // Renderer resource handle (`tm_renderer_handle_t.resource`) bound to the slot.
+    uint32_t resource;
+
+    // Vertex buffer stride and offset.
+    uint32_t stride;
+    uint32_t offset;
+};
+
+struct d3d11_resource_binder_t
+{
+    const struct d3d11_bind_t *binds;
+    uint32_t num_binds;
+    TM_PAD(4);
+};
+
+// A created shader program together with the pipeline state compiled from its state blocks.
+struct d3d11_shader_t
+{
+    void *stages[SHADER_STAGE__COUNT];
+    void *input_layout;
+
+    void *rasterizer_state;
+    void *depth_stencil_state;
+    void *blend_state;
+
+    float blend_factor[4];
+    uint32_t stencil_ref;
+    uint32_t sample_mask;
+
+    // Set if the shader reads its per-draw constants from the instance buffer, see
+    // `tm_d3d11_draw_instancing_t`.
+    bool draw_instancing;
+    TM_PAD(7);
+};
+
+struct d3d11_resource_resolver_o;
+
+struct d3d11_resource_resolver_i
+{
+    struct d3d11_resource_resolver_o *inst;
+
+    // Returns the device object for `view` of the renderer resource `resource` or NULL if the
+    // resource doesn't exist or doesn't have such a view.
+    void *(*view)(struct d3d11_resource_resolver_o *inst, uint32_t resource, enum d3d11_view view);
+
+    // Returns the shader program with the renderer handle `resource` or NULL.
+    const struct d3d11_shader_t *(*shader)(struct d3d11_resource_resolver_o *inst, uint32_t resource);
+
+    // Returns the resource binder with the renderer handle `resource` or NULL.
+    const struct d3d11_resource_binder_t *(*resource_binder)(struct d3d11_resource_resolver_o *inst, uint32_t resource);
+
+    // Returns the system memory copy of the constant buffer `resource` and stores its size in
+    // `size`, or returns NULL if the buffer doesn't exist or has no copy, see `shadow_constants`.
+    const void *(*constants)(struct d3d11_resource_resolver_o *inst, uint32_t resource, uint32_t *size);
+
+    // Returns the device buffer of the constant buffer `resource` and stores the range of it to
+    // bind, in 16 byte constants, in `first_constant` and `num_constants`. `num_constants` is 0 if
+    // the whole buffer is bound. Returns NULL if the buffer doesn't exist or its constants haven't
+    // been uploaded to the arena this frame, see `constant_arena`.
+    void *(*constant_buffer)(struct d3d11_resource_resolver_o *inst, uint32_t resource, uint32_t *first_constant,
+        uint32_t *num_constants);
+};
+
+// -------------------------------------------------------------------
+// Resource storage
+
+// Maximum number of bind points of a resource binder.
+#define MAX_BINDER_BINDS (32)
+
+// Largest constant buffer that keeps a system memory copy of its contents, see `shadow_constants`.
+#define MAX_SHADOWED_CONSTANTS_SIZE (256)
+
+// Largest constant buffer suballocated from the constant arena, see `constant_arena`.
+#define MAX_SUBALLOCATED_CONSTANTS_SIZE (4096)
+
+// Size classes of the constant buffer pool, powers of two from 256 bytes to 64 KB, see
+// `constant_pool`.
+#define CONSTANT_POOL_MIN_SIZE_LOG2 (8)
+#define CONSTANT_POOL_NUM_CLASSES (9)
+
+enum d3d11_resource_pool
+{
+    RESOURCE_POOL__BUFFER = 0,
+    RESOURCE_POOL__IMAGE,
+    RESOURCE_POOL__SAMPLER,
+    RESOURCE_POOL__SHADER,
+    RESOURCE_POOL__RESOURCE_BINDER,
+
+    // Swap chains, not created through resource commands. Their handles can be bound as render
+    // targets, which renders to the current back buffer.
+    RESOURCE_POOL__SWAP_CHAIN,
+
+    RESOURCE_POOL__COUNT,
+};
+
+// Video memory accounting and least recently used tracking of images.
+//
+// Every lookup of an image stamps it with the current frame. When the resources take more video
+// memory than the budget, images that haven't been looked up for a few frames are evicted, least
+// recently used first. An evicted image is copied to a staging texture in system memory. Its
+// smallest mips stay resident, so it can still be sampled at a lower resolution. Images with too
+// few mips for that are evicted entirely and read as unbound. An evicted image that is looked up
+// again is restored as soon as it fits in the budget.
+struct d3d11_residency_t
+{
+    // Frame number images are stamped with, see `d3d11_resources__begin_frame()`.
+    uint32_t frame;
+
+    // Set by lookups of evicted images.
+    atomic_uint32_t restore_requested;
+
+    // Video memory taken by buffers and images, and the size of the evicted images in system memory.
+    uint64_t resident_bytes;
+    uint64_t evicted_bytes;
+
+    uint64_t num_evictions;
+    uint64_t num_restores;
+};
+
+struct d3d11_resource_statistics_t
+{
+    // Resource commands executed, and how many of them were executed on jobs.
+    uint64_t num_commands;
+    uint64_t num_job_commands;
+
+    // Constant buffers created from buffers in `constant_pool` instead of on the device.
+    uint64_t num_pooled_constant_buffers;
+
+    // Bytes of constants copied to the arena by the latest `d3d11_resources__upload_constants()`.
+    uint64_t constant_arena_bytes;
+
+    // Shaders whose programs were replaced by `d3d11_resources__reload_shader()`.
+    uint64_t num_shader_reloads;
+};
+
+// Programs created by `d3d11_resources__reload_shader()` waiting to replace the ones of the shader
+// `handle`. NULL stages keep their program.
+struct d3d11_shader_reload_t
+{
+    uint32_t handle;
+    TM_PAD(4);
+    void *stages[SHADER_STAGE__COUNT];
+};
+
+// Owns every renderer resource of a backend, one handle pool per resource type. Handles are
+// allocated by the pools (through `handle_allocator`) when the resource is recorded, so
+// `tm_renderer_handle_t.resource` *is* the pool handle and its type bits select the pool.
+struct d3d11_bindless_t;
+struct d3d11_upload_ring_t;
+
+struct d3d11_resources_t
+{
+    struct d3d11_handle_pool_t pools[RESOURCE_POOL__COUNT];
+
+    struct tm_allocator_i *allocator;
+
+    // Device resources are created on, NULL while the backend has no device.
+    struct d3d11_device_i *device;
+
+    // Ring buffer updates are staged through, NULL to update resources directly.
+    struct d3d11_upload_ring_t *upload_ring;
+
+    // Sampler used when a sampler state block can't be decoded.
+    void *default_sampler;
+
+    // Shared pipeline and sampler states of the device. The lock serializes the lookups of the
+    // resource jobs.
+    struct d3d11_state_cache_t state_cache;
+    tm_critical_section_o state_cache_lock;
+
+    // Number of lookups and commands that referred to stale or unknown handles. Atomic since
+    // lookups are made from every translation job.
+    atomic_uint64_t num_stale_handles;
+
+    struct d3d11_residency_t residency;
+
+    // Streaming settings of new images and the mips still waiting to be uploaded.
+    struct tm_d3d11_texture_streaming_t streaming;
+    struct d3d11_mip_streamer_t streamer;
+
+    // Constant buffers of at most `MAX_SHADOWED_CONSTANTS_SIZE` bytes created while this is set
+    // keep a copy of their contents in system memory, which draw instancing gathers from.
+    bool shadow_constants;
+    TM_PAD(7);
+
+    // Arena of the frame's constants, NULL unless the device supports constant buffer offsets.
+    //
+    // Uniform-only buffers of at most `MAX_SUBALLOCATED_CONSTANTS_SIZE` bytes created while it is
+    // set don't get a device buffer. Their contents live in system memory and the ones the frame
+    // binds are copied to 256 byte aligned ranges of the arena by
+    // `d3d11_resources__upload_constants()`, which are bound with `set_constant_buffers1()`.
+    struct d3d11_upload_ring_t *constant_arena;
+
+    // Free device buffers by size class, used for constant buffers when there is no arena. A
+    // destroyed constant buffer goes back to its class instead of being released, so transient
+    // constant buffers don't create a device buffer each.
+    /* carray */ void **constant_pool[CONSTANT_POOL_NUM_CLASSES];
+
+    // Bindless heap and image pools, NULL unless bindless is enabled. Storage buffers and plain
+    // sampled 2D images created while it is set get bindless handles, see `d3d11_bindless.h`.
+    struct d3d11_bindless_t *bindless;
+
+    // Reloaded shader programs swapped in by the next `d3d11_resources__begin_frame()`. The lock
+    // lets shaders be reloaded from another thread than the one submitting.
+    /* carray */ struct d3d11_shader_reload_t *shader_reloads;
+    tm_critical_section_o shader_reload_lock;
+
+    struct d3d11_resource_statistics_t stats;
+
+    struct d3d11_resource_resolver_i resolver;
+    tm_renderer_handle_allocator_i handle_allocator;
+};
+
+void d3d11_resources__init(struct d3d11_resources_t *res, struct tm_allocator_i *allocator);
+
+// Releases all resources and frees the pools.
+void d3d11_resources__shutdown(struct d3d11_resources_t *res);
+
+// Sets the device new resources are created on. Resources created on the previous device are
+// released and their handles become stale.
+void d3d11_resources__set_device(struct d3d11_resources_t *res, struct d3d11_device_i *device);
+
+// Executes the commands of `buffers` (creation, updates and destruction of resources). Resources
+// are created on up to `max_jobs` jobs if there are enough of them, the other commands run on the
+// calling thread afterwards, in recorded order. Must be called from a job if `max_jobs` > 1.
+void d3d11_resources__submit(struct d3d11_resources_t *res, struct tm_renderer_resource_command_buffer_o *const *buffers,
+    uint32_t num_buffers, uint32_t max_jobs);
+
+// Starts a new frame of the least recently used tracking and swaps in the programs of reloaded
+// shaders. Called once per submit, before the commands are translated.
+void d3d11_resources__begin_frame(struct d3d11_resources_t *res);
+
+struct tm_renderer_command_t;
+
+// Copies the contents of the suballocated constant buffers bound by the `num_commands` render
+// `commands` to the constant arena, once per buffer. Called on the submitting thread after
+// `d3d11_resources__begin_frame()` and before the arena is flushed and the commands translated.
+// Does nothing without an arena.
+void d3d11_resources__upload_constants(struct d3d11_resources_t *res, const struct tm_renderer_command_t *commands,
+    uint32_t num_commands);
+
+// Evicts least recently used images while the resident bytes exceed `budget`, and restores evicted
+// images that have been looked up again if they fit. A `budget` of 0 means there is no limit.
+void d3d11_resources__enforce_budget(struct d3d11_resources_t *res, uint64_t budget);
+
+// Uploads pending mips of streamed images, highest priority first, until `streaming.upload_budget`
+// bytes have been uploaded, and lowers the minimum LOD of the images as their mips arrive.
+void d3d11_resources__stream_mips(struct d3d11_resources_t *res);
+
+// Sets the streaming priority of the image `handle`, ignored if the image isn't streamed.
+void d3d11_resources__set_stream_priority(struct d3d11_resources_t *res, uint32_t handle, float priority);
+
+// Creates a swap chain on the device and returns its handle, or 0 on failure. Destroyed like any
+// other resource.
+uint32_t d3d11_resources__create_swap_chain(struct d3d11_resources_t *res, const struct d3d11_swap_chain_desc_t *desc);
+
+// Creates programs from the non-empty `blobs`, indexed by `enum d3d11_shader_stage`, and queues
+// them to replace the programs of the shader `handle` at the next `d3d11_resources__begin_frame()`,
+// so all commands of a submit see the same version of the shader. Pipeline states are kept.
+// Returns false, queuing nothing, if `handle` isn't a shader or a program can't be created. Can be
+// called from any thread, also while a submit is in progress.
+bool d3d11_resources__reload_shader(struct d3d11_resources_t *res, uint32_t handle,
+    const tm_renderer_shader_blob_t *blobs);
+
+// Sets whether the shader `handle` reads its per-draw constants from the instance buffer of
+// instanced draws. Ignored if `handle` isn't a shader.
+void d3d11_resources__set_shader_draw_instancing(struct d3d11_resources_t *res, uint32_t handle, bool enabled);
+
+// Returns the bindless handle of the buffer or image `handle`, or `BINDLESS_INVALID_HANDLE` if it
+// has none.
+uint32_t d3d11_resources__bindless_handle(struct d3d11_resources_t *res, uint32_t handle);
+
+// Returns the swap chain with the handle `handle` or NULL.
+struct d3d11_swap_chain_i *d3d11_resources__swap_chain(struct d3d11_resources_t *res, uint32_t handle);
+
+// Destroys the resource `handle` of any type.
+void d3d11_resources__destroy(struct d3d11_resources_t *res, uint32_t handle);
+
+// Returns the number of live resources in `pool` (`enum d3d11_resource_pool`).
+uint32_t d3d11_resources__num_live(const struct d3d11_resources_t *res, enum d3d11_resource_pool pool);
@@ -0,0 +1,393 @@
+#include "d3d11_shader_cache.h"
+#include "d3d11_internal.h"
+
+#include <foundation/allocator.h>
+#include <foundation/carray.inl>
+#include <foundation/log.h>
+#include <foundation/murmurhash64a.inl>
+#include <foundation/temp_allocator.h>
+#include <foundation/unicode.h>
+
+#if defined(TM_OS_WINDOWS)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <string.h>
+
+// -------------------------------------------------------------------
+// Pack file
+//
+// A header followed by entries until the end of the file. Each entry is a `pack_entry_t` followed
+// by the bytecode, padded to `PACK_ALIGNMENT`.
+
+#define PACK_MAGIC 0x4b504353 // "SCPK"
+#define PACK_VERSION 1
+#define PACK_ALIGNMENT 16
+
+struct pack_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t session;
+};
+
+struct pack_entry_t
+{
+    struct d3d11_shader_key_t key;
+    uint64_t size;
+    uint64_t last_used;
+};
+
+static inline uint64_t
+pack_entry_size(uint64_t size)
+{
+    return (sizeof(struct pack_entry_t) + size + PACK_ALIGNMENT - 1) & ~(uint64_t)(PACK_ALIGNMENT - 1);
+}
+
+// The mapping is writable so that hits can update the `last_used` stamps in place.
+#if defined(TM_OS_WINDOWS)
+
+static uint8_t *
+map_file(const char *path, uint64_t *size)
+{
+    TM_INIT_TEMP_ALLOCATOR(ta);
+    HANDLE file = CreateFileW((LPCWSTR)tm_unicode_api->utf8_to_utf16(path, ta), GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+    if (file == INVALID_HANDLE_VALUE)
+        return 0;
+
+    uint8_t *p = 0;
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart)
+    {
+        // The view keeps the mapping and the file open.
+        HANDLE mapping = CreateFileMappingW(file, 0, PAGE_READWRITE, 0, 0, 0);
+        if (mapping)
+        {
+            p = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+        *size = file_size.QuadPart;
+    }
+    CloseHandle(file);
+    return p;
+}
+
+static void
+unmap_file(uint8_t *p, uint64_t size)
+{
+    UnmapViewOfFile(p);
+}
+
+#else
+
+static uint8_t *
+map_file(const char *path, uint64_t *size)
+{
+    const int fd = open(path, O_RDWR);
+    if (fd < 0)
+        return 0;
+
+    uint8_t *p = 0;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size)
+    {
+        void *m = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        p = m == MAP_FAILED ? 0 : m;
+        *size = st.st_size;
+    }
+    close(fd);
+    return p;
+}
+
+static void
+unmap_file(uint8_t *p, uint64_t size)
+{
+    munmap(p, size);
+}
+
+#endif
+
+// -------------------------------------------------------------------
+// Index
+
+// The hash table reserves the two largest keys.
+static inline uint64_t
+index_key(const struct d3d11_shader_key_t *key)
+{
+    return key->h[0] >= 0xfffffffffffffffeULL ? key->h[0] - 2 : key->h[0];
+}
+
+static void
+add_entry(struct d3d11_shader_cache_t *cache, const struct d3d11_shader_cache_entry_t *entry)
+{
+    tm_carray_push(cache->entries, *entry, cache->allocator);
+    tm_hash_add(&cache->index, index_key(&entry->key), (uint32_t)tm_carray_size(cache->entries));
+    cache->size += pack_entry_size(entry->size);
+}
+
+static inline uint64_t
+last_used(const struct d3d11_shader_cache_t *cache, const struct d3d11_shader_cache_entry_t *e)
+{
+    return e->last_used ? *e->last_used : cache->session;
+}
+
+// Evicts the least recently used entries, except `keep`, until the pack file fits in the size cap.
+// Misses are rare and expensive, so a linear search for the oldest entry is fine.
+static void
+evict(struct d3d11_shader_cache_t *cache, const struct d3d11_shader_cache_entry_t *keep)
+{
+    if (!cache->max_size)
+        return;
+
+    while (cache->size > cache->max_size)
+    {
+        struct d3d11_shader_cache_entry_t *oldest = 0;
+        for (struct d3d11_shader_cache_entry_t *e = cache->entries; e != tm_carray_end(cache->entries); ++e)
+        {
+            if (!e->evicted && e != keep && (!oldest || last_used(cache, e) < last_used(cache, oldest)))
+                oldest = e;
+        }
+        if (!oldest)
+            break;
+
+        if (tm_hash_get(&cache->index, index_key(&oldest->key)) == (uint32_t)(oldest - cache->entries) + 1)
+            tm_hash_remove(&cache->index, index_key(&oldest->key));
+        oldest->evicted = true;
+        cache->size -= pack_entry_size(oldest->size);
+        cache->dirty = true;
+        ++cache->stats.num_evictions;
+    }
+}
+
+static struct d3d11_shader_cache_entry_t *
+find_entry(struct d3d11_shader_cache_t *cache, const struct d3d11_shader_key_t *key)
+{
+    const uint32_t index = tm_hash_get(&cache->index, index_key(key));
+    if (!index)
+        return 0;
+
+    struct d3d11_shader_cache_entry_t *e = cache->entries + index - 1;
+    return !e->evicted && e->key.h[0] == key->h[0] && e->key.h[1] == key->h[1] ? e : 0;
+}
+
+// -------------------------------------------------------------------
+// Writing
+
+// Writes the entries that aren't evicted to a new pack file and replaces the mapped one with it.
+static void
+write_pack(struct d3d11_shader_cache_t *cache)
+{
+    TM_INIT_TEMP_ALLOCATOR(ta);
+
+    const char *tmp_path = tm_temp_allocator_api->printf(ta, "%s.tmp", cache->path);
+    tm_file_o f = tm_os_api->file_io->open_output(tmp_path);
+    bool ok = f.valid;
+
+    const struct pack_header_t header = { PACK_MAGIC, PACK_VERSION, cache->session };
+    ok = ok && tm_os_api->file_io->write(f, &header, sizeof(header));
+
+    static const uint8_t padding[PACK_ALIGNMENT] = { 0 };
+    for (const struct d3d11_shader_cache_entry_t *e = cache->entries; ok && e != tm_carray_end(cache->entries); ++e)
+    {
+        if (e->evicted)
+            continue;
+
+        const struct pack_entry_t pe = { e->key, e->size, last_used(cache, e) };
+        ok = tm_os_api->file_io->write(f, &pe, sizeof(pe))
+            && tm_os_api->file_io->write(f, e->data, e->size)
+            && tm_os_api->file_io->write(f, padding, pack_entry_size(e->size) - sizeof(pe) - e->size);
+    }
+
+    if (f.valid)
+        tm_os_api->file_io->close(f);
+
+    // The pack file can't be replaced while it is mapped.
+    if (cache->mapped)
+    {
+        unmap_file(cache->mapped, cache->mapped_size);
+        cache->mapped = 0;
+    }
+
+    if (ok)
+    {
+        tm_os_api->file_system->remove_file(cache->path);
+        ok = tm_os_api->file_system->rename(tmp_path, cache->path);
+    }
+    if (!ok)
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Failed to write shader cache `%s`", cache->path);
+        tm_os_api->file_system->remove_file(tmp_path);
+    }
+
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+}
+
+// -------------------------------------------------------------------
+// Public
+
+struct d3d11_shader_key_t
+d3d11_shader_cache__key(const char *source, const char *entry_point, uint32_t source_language, uint32_t stage,
+    uint64_t compiler_version)
+{
+    const uint64_t values[5] = {
+        tm_murmur_hash_64a(source, strlen(source), 0),
+        tm_murmur_hash_64a(entry_point, strlen(entry_point), 0),
+        source_language,
+        stage,
+        compiler_version,
+    };
+
+    const struct d3d11_shader_key_t key = { {
+        tm_murmur_hash_64a(values, sizeof(values), 0),
+        tm_murmur_hash_64a(values, sizeof(values), 1),
+    } };
+    return key;
+}
+
+void
+d3d11_shader_cache__open(struct d3d11_shader_cache_t *cache, struct tm_allocator_i *allocator, const char *path,
+    uint64_t max_size)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->allocator = allocator;
+    cache->max_size = max_size;
+    cache->index.allocator = allocator;
+    cache->owned.allocator = allocator;
+    tm_os_api->thread->create_critical_section(&cache->lock);
+
+    const uint64_t path_size = strlen(path) + 1;
+    cache->path = tm_alloc(allocator, path_size);
+    memcpy(cache->path, path, path_size);
+
+    cache->size = sizeof(struct pack_header_t);
+    cache->mapped = map_file(path, &cache->mapped_size);
+    struct pack_header_t *header = (struct pack_header_t *)cache->mapped;
+    if (cache->mapped && (cache->mapped_size < sizeof(*header) || header->magic != PACK_MAGIC
+        || header->version != PACK_VERSION))
+    {
+        unmap_file(cache->mapped, cache->mapped_size);
+        cache->mapped = 0;
+        cache->dirty = true;
+    }
+
+    if (!cache->mapped)
+    {
+        cache->session = 1;
+        return;
+    }
+
+    cache->session = ++header->session;
+
+    uint64_t pos = sizeof(*header);
+    while (pos + sizeof(struct pack_entry_t) <= cache->mapped_size)
+    {
+        struct pack_entry_t *pe = (struct pack_entry_t *)(cache->mapped + pos);
+        if (pe->size > cache->mapped_size - pos - sizeof(*pe))
+        {
+            // Truncated, drop the rest on close.
+            cache->dirty = true;
+            break;
+        }
+
+        const struct d3d11_shader_cache_entry_t e = {
+            .key       = pe->key,
+            .data      = (const uint8_t *)(pe + 1),
+            .size      = pe->size,
+            .last_used = &pe->last_used,
+        };
+        add_entry(cache, &e);
+        pos += pack_entry_size(pe->size);
+    }
+
+    evict(cache, 0);
+}
+
+void
+d3d11_shader_cache__close(struct d3d11_shader_cache_t *cache)
+{
+    if (cache->dirty)
+        write_pack(cache);
+
+    if (cache->mapped)
+        unmap_file(cache->mapped, cache->mapped_size);
+
+    for (const struct d3d11_shader_cache_entry_t *e = cache->entries; e != tm_carray_end(cache->entries); ++e)
+    {
+        if (!e->last_used)
+            tm_free(cache->allocator, (void *)e->data, e->size);
+    }
+
+    tm_carray_free(cache->entries, cache->allocator);
+    tm_hash_free(&cache->index);
+    tm_hash_free(&cache->owned);
+    tm_free(cache->allocator, cache->path, strlen(cache->path) + 1);
+    tm_os_api->thread->destroy_critical_section(&cache->lock);
+    memset(cache, 0, sizeof(*cache));
+}
+
+const void *
+d3d11_shader_cache__find(struct d3d11_shader_cache_t *cache, const struct d3d11_shader_key_t *key, uint64_t *size)
+{
+    const void *data = 0;
+
+    tm_os_api->thread->enter_critical_section(&cache->lock);
+    struct d3d11_shader_cache_entry_t *e = find_entry(cache, key);
+    if (e)
+    {
+        if (e->last_used)
+            *e->last_used = cache->session;
+        data = e->data;
+        *size = e->size;
+        ++cache->stats.num_hits;
+    }
+    else
+        ++cache->stats.num_misses;
+    tm_os_api->thread->leave_critical_section(&cache->lock);
+
+    return data;
+}
+
+const void *
+d3d11_shader_cache__insert(struct d3d11_shader_cache_t *cache, const struct d3d11_shader_key_t *key,
+    const void *bytecode, uint64_t size)
+{
+    tm_os_api->thread->enter_critical_section(&cache->lock);
+
+    const struct d3d11_shader_cache_entry_t *e = find_entry(cache, key);
+    const void *data = e ? e->data : 0;
+    if (!data)
+    {
+        uint8_t *copy = tm_alloc(cache->allocator, size);
+        memcpy(copy, bytecode, size);
+
+        const struct d3d11_shader_cache_entry_t entry = { .key = *key, .data = copy, .size = size };
+        add_entry(cache, &entry);
+        tm_hash_add(&cache->owned, (uint64_t)copy, 1);
+        cache->dirty = true;
+        data = copy;
+
+        evict(cache, tm_carray_end(cache->entries) - 1);
+    }
+
+    tm_os_api->thread->leave_critical_section(&cache->lock);
+    return data;
+}
+
+bool
+d3d11_shader_cache__owns(struct d3d11_shader_cache_t *cache, const void *p)
+{
+    const uint8_t *b = p;
+    if (cache->mapped && b >= cache->mapped && b < cache->mapped + cache->mapped_size)
+        return true;
+
+    tm_os_api->thread->enter_critical_section(&cache->lock);
+    const bool owned = tm_hash_has(&cache->owned, (uint64_t)p);
+    tm_os_api->thread->leave_critical_section(&cache->lock);
+    return owned;
+}
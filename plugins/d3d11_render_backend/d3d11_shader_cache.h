@@ -0,0 +1,106 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+#include <foundation/hash.inl>
+#include <foundation/os.h>
+
+// Content addressed cache of compiled shader bytecode, persisted in a single pack file.
+//
+// The pack file is memory mapped when the cache is opened, so bytecode found in it is returned
+// without copying and stays valid until the cache is closed. Bytecode added while the cache is
+// open is kept in memory and appended to the pack file on close. Every hit stamps the entry with
+// the current session number in the mapping. When the pack file would grow past its size cap, the
+// entries used least recently are evicted and left out when the file is rewritten.
+
+// 128-bit key of a shader, see `d3d11_shader_cache__key()`.
+struct d3d11_shader_key_t
+{
+    uint64_t h[2];
+};
+
+struct d3d11_shader_cache_entry_t
+{
+    struct d3d11_shader_key_t key;
+
+    // Bytecode, either in the mapped pack file or owned by the cache.
+    const uint8_t *data;
+    uint64_t size;
+
+    // Session stamp in the pack file, NULL for entries that were added since the cache was opened.
+    uint64_t *last_used;
+
+    // Evicted entries are kept until close, since their bytecode may still be in use.
+    bool evicted;
+    TM_PAD(7);
+};
+
+struct d3d11_shader_cache_statistics_t
+{
+    uint64_t num_hits;
+    uint64_t num_misses;
+    uint64_t num_evictions;
+};
+
+struct d3d11_shader_cache_t
+{
+    struct tm_allocator_i *allocator;
+
+    char *path;
+    uint64_t max_size;
+
+    // Mapped pack file, NULL if there was none.
+    uint8_t *mapped;
+    uint64_t mapped_size;
+
+    // Number of this session, stored in the pack file header.
+    uint64_t session;
+
+    /* carray */ struct d3d11_shader_cache_entry_t *entries;
+
+    // Maps the low half of keys to indices into `entries`, offset by one.
+    struct TM_HASH_T(uint64_t, uint32_t) index;
+
+    // Set of the bytecode copies owned by the cache.
+    struct TM_HASH_T(uint64_t, uint32_t) owned;
+
+    // Size of the pack file with all entries that aren't evicted.
+    uint64_t size;
+
+    // Set when the pack file must be rewritten on close.
+    bool dirty;
+    TM_PAD(7);
+
+    struct d3d11_shader_cache_statistics_t stats;
+
+    tm_critical_section_o lock;
+};
+
+// Computes the key of `entry_point` in `source`, compiled for `stage` by a compiler identified by
+// `compiler_version`.
+struct d3d11_shader_key_t d3d11_shader_cache__key(const char *source, const char *entry_point, uint32_t source_language,
+    uint32_t stage, uint64_t compiler_version);
+
+// Opens the cache and maps the pack file at `path`, if there is one. Pack files with an unknown
+// format are replaced on close. `max_size` of 0 means no size cap, a pack file that is already
+// larger than `max_size` is trimmed right away.
+void d3d11_shader_cache__open(struct d3d11_shader_cache_t *cache, struct tm_allocator_i *allocator, const char *path,
+    uint64_t max_size);
+
+// Rewrites the pack file if entries were added or evicted and unmaps it. All bytecode returned by
+// the cache becomes invalid.
+void d3d11_shader_cache__close(struct d3d11_shader_cache_t *cache);
+
+// Returns the bytecode of `key` and stores its size in `size`, or returns NULL on a miss. Thread
+// safe.
+const void *d3d11_shader_cache__find(struct d3d11_shader_cache_t *cache, const struct d3d11_shader_key_t *key,
+    uint64_t *size);
+
+// Adds a copy of `bytecode` under `key` and returns the copy, evicting other entries if the cache
+// grows past its size cap. If `key` was added concurrently, the existing bytecode is returned.
+// Thread safe.
+const void *d3d11_shader_cache__insert(struct d3d11_shader_cache_t *cache, const struct d3d11_shader_key_t *key,
+    const void *bytecode, uint64_t size);
+
+// Returns true if `p` points to bytecode owned by the cache.
+bool d3d11_shader_cache__owns(struct d3d11_shader_cache_t *cache, const void *p);
@@ -0,0 +1,478 @@
+#include "d3d11_shader_reloader.h"
+
+#include "d3d11_internal.h"
+#include "d3d11_render_backend.h"
+
+#include <foundation/allocator.h>
+#include <foundation/carray.inl>
+#include <foundation/carray_print.inl>
+#include <foundation/log.h>
+#include <foundation/os.h>
+#include <foundation/temp_allocator.h>
+#include <plugins/renderer/shader_compiler.h>
+
+#include <string.h>
+
+struct source_file_t
+{
+    // Allocated with the reloader's allocator.
+    char *path;
+
+    // Whether the file existed when it was last read, and its modification time then.
+    bool exists;
+    TM_PAD(7);
+    tm_file_time_o modified;
+
+    // Indices of the files it includes, in `tm_d3d11_shader_reloader_o.files`.
+    /* carray */ uint32_t *includes;
+};
+
+struct watched_shader_t
+{
+    tm_renderer_handle_t shader;
+
+    // Index of the source file.
+    uint32_t file;
+
+    // Allocated with the reloader's allocator, NULL for stages the shader doesn't have.
+    char *entry_points[TM_RENDERER_SHADER_STAGE_MAX];
+};
+
+struct tm_d3d11_shader_reloader_o
+{
+    struct tm_allocator_i *allocator;
+    struct tm_d3d11_backend_i *backend;
+    struct tm_renderer_shader_compiler_o *compiler;
+
+    // NULL if the platform has no file system watcher, then every file is checked each frame.
+    struct tm_file_system_watcher_o *watcher;
+
+    // Files are never removed, a file no longer included by any watched shader is just checked
+    // for nothing.
+    /* carray */ struct source_file_t *files;
+    /* carray */ struct watched_shader_t *shaders;
+
+    // Set by `d3d11_shader_reloader__begin()` when it queued shaders, with the modification time of
+    // the newest change among them.
+    bool pending;
+    TM_PAD(7);
+    tm_file_time_o pending_saved;
+
+    struct tm_d3d11_shader_reload_statistics_t stats;
+};
+
+static char *
+copy_string(struct tm_allocator_i *a, const char *s)
+{
+    const uint64_t size = strlen(s) + 1;
+    char *copy = tm_alloc(a, size);
+    memcpy(copy, s, size);
+    return copy;
+}
+
+static void
+free_string(struct tm_allocator_i *a, char *s)
+{
+    if (s)
+        tm_free(a, s, strlen(s) + 1);
+}
+
+// Returns the contents of `path` with a terminating zero, allocated with `ta`, or NULL if the file
+// can't be read.
+static char *
+read_file(const char *path, struct tm_temp_allocator_i *ta)
+{
+    const tm_file_stat_t stat = tm_os_api->file_system->stat(path);
+    if (!stat.exists || stat.is_directory)
+        return 0;
+
+    char *text = tm_temp_alloc(ta, stat.size + 1);
+    tm_file_o f = tm_os_api->file_io->open_input(path);
+    const bool read = f.valid && tm_os_api->file_io->read(f, text, stat.size) == (int64_t)stat.size;
+    if (f.valid)
+        tm_os_api->file_io->close(f);
+    if (!read)
+        return 0;
+
+    text[stat.size] = 0;
+    return text;
+}
+
+// If `line` is a quoted `#include`, returns the path it names relative to `includer`, allocated
+// with `ta`, otherwise NULL.
+static char *
+include_path(const char *line, const char *includer, struct tm_temp_allocator_i *ta)
+{
+    const char *c = line;
+    while (*c == ' ' || *c == '\t')
+        ++c;
+    if (*c++ != '#')
+        return 0;
+    while (*c == ' ' || *c == '\t')
+        ++c;
+    if (strncmp(c, "include", 7))
+        return 0;
+    c += 7;
+    while (*c == ' ' || *c == '\t')
+        ++c;
+    if (*c++ != '"')
+        return 0;
+
+    const char *name = c;
+    while (*c && *c != '"' && *c != '\n')
+        ++c;
+    if (*c != '"')
+        return 0;
+
+    const char *slash = strrchr(includer, '/');
+    const char *backslash = strrchr(includer, '\\');
+    if (backslash > slash)
+        slash = backslash;
+    const int dir_len = slash ? (int)(slash - includer + 1) : 0;
+    return tm_temp_allocator_api->printf(ta, "%.*s%.*s", dir_len, includer, (int)(c - name), name);
+}
+
+static const char *
+next_line(const char *s)
+{
+    const char *nl = strchr(s, '\n');
+    return nl ? nl + 1 : s + strlen(s);
+}
+
+static uint32_t
+find_file(const struct tm_d3d11_shader_reloader_o *o, const char *path)
+{
+    for (uint32_t i = 0; i != tm_carray_size(o->files); ++i)
+    {
+        if (!strcmp(o->files[i].path, path))
+            return i;
+    }
+    return UINT32_MAX;
+}
+
+static uint32_t add_file(struct tm_d3d11_shader_reloader_o *o, const char *path, struct tm_temp_allocator_i *ta);
+
+// Reads file `i` again and rebuilds its includes, adding the included files that are new to the
+// graph.
+static void
+refresh_file(struct tm_d3d11_shader_reloader_o *o, uint32_t i, struct tm_temp_allocator_i *ta)
+{
+    const tm_file_stat_t stat = tm_os_api->file_system->stat(o->files[i].path);
+    o->files[i].exists = stat.exists;
+    o->files[i].modified = stat.last_modified_time;
+    tm_carray_shrink(o->files[i].includes, 0);
+
+    const char *text = read_file(o->files[i].path, ta);
+    if (!text)
+        return;
+
+    // `o->files` may grow while the includes are added, so the file is looked up by index.
+    for (const char *line = text; *line; line = next_line(line))
+    {
+        const char *path = include_path(line, o->files[i].path, ta);
+        if (path)
+        {
+            const uint32_t include = add_file(o, path, ta);
+            tm_carray_push(o->files[i].includes, include, o->allocator);
+        }
+    }
+}
+
+// Returns the index of the file `path`, adding it and the files it includes if it is new.
+static uint32_t
+add_file(struct tm_d3d11_shader_reloader_o *o, const char *path, struct tm_temp_allocator_i *ta)
+{
+    const uint32_t existing = find_file(o, path);
+    if (existing != UINT32_MAX)
+        return existing;
+
+    const struct source_file_t file = { .path = copy_string(o->allocator, path) };
+    tm_carray_push(o->files, file, o->allocator);
+    const uint32_t i = (uint32_t)tm_carray_size(o->files) - 1;
+    refresh_file(o, i, ta);
+    return i;
+}
+
+// Appends the source of file `i` to `source` with its includes inlined. Each file is inlined once,
+// like with `#pragma once`, so include cycles end. `#line` directives keep compile errors pointing
+// at the original files.
+static void
+expand_source(const struct tm_d3d11_shader_reloader_o *o, uint32_t i, bool *inlined, char **source,
+    struct tm_temp_allocator_i *ta)
+{
+    if (inlined[i])
+        return;
+    inlined[i] = true;
+
+    const char *path = o->files[i].path;
+    const char *text = read_file(path, ta);
+    if (!text)
+        return;
+
+    tm_carray_printf(source, o->allocator, "#line 1 \"%s\"\n", path);
+    uint32_t line_number = 1;
+    for (const char *line = text; *line; line = next_line(line), ++line_number)
+    {
+        const char *include = include_path(line, path, ta);
+        const uint32_t included = include ? find_file(o, include) : UINT32_MAX;
+        if (included == UINT32_MAX)
+        {
+            const char *end = next_line(line);
+            tm_carray_printf(source, o->allocator, "%.*s", (int)(end - line), line);
+            continue;
+        }
+
+        expand_source(o, included, inlined, source, ta);
+        tm_carray_printf(source, o->allocator, "\n#line %u \"%s\"\n", line_number + 1, path);
+    }
+    tm_carray_printf(source, o->allocator, "\n");
+}
+
+struct tm_d3d11_shader_reloader_o *
+d3d11_shader_reloader__create(struct tm_allocator_i *allocator, struct tm_d3d11_backend_i *backend,
+    struct tm_renderer_shader_compiler_o *compiler, const char *directory)
+{
+    struct tm_d3d11_shader_reloader_o *o = tm_alloc(allocator, sizeof(*o));
+    *o = (struct tm_d3d11_shader_reloader_o) {
+        .allocator = allocator,
+        .backend   = backend,
+        .compiler  = compiler,
+        .watcher   = tm_os_api->file_system->create_file_system_watcher(directory),
+    };
+    return o;
+}
+
+void
+d3d11_shader_reloader__destroy(struct tm_d3d11_shader_reloader_o *o)
+{
+    struct tm_allocator_i *a = o->allocator;
+
+    if (o->watcher)
+        tm_os_api->file_system->destroy_file_system_watcher(o->watcher);
+
+    for (struct source_file_t *f = o->files; f != tm_carray_end(o->files); ++f)
+    {
+        free_string(a, f->path);
+        tm_carray_free(f->includes, a);
+    }
+    tm_carray_free(o->files, a);
+
+    for (struct watched_shader_t *s = o->shaders; s != tm_carray_end(o->shaders); ++s)
+    {
+        for (uint32_t stage = 0; stage != TM_RENDERER_SHADER_STAGE_MAX; ++stage)
+            free_string(a, s->entry_points[stage]);
+    }
+    tm_carray_free(o->shaders, a);
+
+    tm_free(a, o, sizeof(*o));
+}
+
+bool
+d3d11_shader_reloader__watch(struct tm_d3d11_shader_reloader_o *o, const struct tm_d3d11_watched_shader_t *shader)
+{
+    TM_INIT_TEMP_ALLOCATOR(ta);
+    const uint32_t file = add_file(o, shader->path, ta);
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+
+    if (!o->files[file].exists)
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Shader reload: can't read `%s`", shader->path);
+        return false;
+    }
+
+    struct watched_shader_t s = { .shader = shader->shader, .file = file };
+    for (uint32_t stage = 0; stage != TM_RENDERER_SHADER_STAGE_MAX; ++stage)
+    {
+        if (shader->entry_points[stage])
+            s.entry_points[stage] = copy_string(o->allocator, shader->entry_points[stage]);
+    }
+    tm_carray_push(o->shaders, s, o->allocator);
+    return true;
+}
+
+void
+d3d11_shader_reloader__unwatch(struct tm_d3d11_shader_reloader_o *o, tm_renderer_handle_t shader)
+{
+    for (uint32_t i = 0; i != tm_carray_size(o->shaders); ++i)
+    {
+        struct watched_shader_t *s = o->shaders + i;
+        if (s->shader.resource != shader.resource)
+            continue;
+
+        for (uint32_t stage = 0; stage != TM_RENDERER_SHADER_STAGE_MAX; ++stage)
+            free_string(o->allocator, s->entry_points[stage]);
+        *s = o->shaders[tm_carray_size(o->shaders) - 1];
+        tm_carray_pop(o->shaders);
+        return;
+    }
+}
+
+// Recompiles the shaders in `dirty` files and queues the new programs. Returns the number queued.
+static uint32_t
+reload_shaders(struct tm_d3d11_shader_reloader_o *o, const bool *dirty, struct tm_temp_allocator_i *ta)
+{
+    struct tm_renderer_shader_compiler_api *compiler_api = tm_d3d11_api->shader_compiler();
+    const uint32_t num_files = (uint32_t)tm_carray_size(o->files);
+
+    // One request per stage of each affected shader. `first_request[i]` is the first request of
+    // the i:th shader, or UINT32_MAX if it isn't affected.
+    /* carray */ struct tm_d3d11_shader_compile_request_t *requests = 0;
+    /* carray */ char **sources = 0;
+    const uint32_t num_shaders = (uint32_t)tm_carray_size(o->shaders);
+    uint32_t *first_request = tm_temp_alloc(ta, num_shaders * sizeof(*first_request));
+    for (uint32_t i = 0; i != num_shaders; ++i)
+    {
+        const struct watched_shader_t *s = o->shaders + i;
+        first_request[i] = UINT32_MAX;
+        if (!dirty[s->file])
+            continue;
+
+        bool *inlined = tm_temp_alloc(ta, num_files);
+        memset(inlined, 0, num_files);
+        char *source = 0;
+        expand_source(o, s->file, inlined, &source, ta);
+        tm_carray_push(source, 0, o->allocator);
+        tm_carray_temp_push(sources, source, ta);
+
+        first_request[i] = (uint32_t)tm_carray_size(requests);
+        for (uint32_t stage = 0; stage != TM_RENDERER_SHADER_STAGE_MAX; ++stage)
+        {
+            if (!s->entry_points[stage])
+                continue;
+            const struct tm_d3d11_shader_compile_request_t r = {
+                .source          = source,
+                .entry_point     = s->entry_points[stage],
+                .source_language = TM_RENDERER_SHADER_SOURCE_LANGUAGE_HLSL,
+                .stage           = stage,
+            };
+            tm_carray_temp_push(requests, r, ta);
+        }
+    }
+
+    const uint32_t num_requests = (uint32_t)tm_carray_size(requests);
+    tm_renderer_shader_blob_t *results = tm_temp_alloc(ta, num_requests * sizeof(*results));
+    tm_d3d11_api->compile_shaders(o->compiler, requests, num_requests, results, 0);
+
+    uint32_t num_queued = 0;
+    for (uint32_t i = 0; i != num_shaders; ++i)
+    {
+        if (first_request[i] == UINT32_MAX)
+            continue;
+
+        const struct watched_shader_t *s = o->shaders + i;
+        tm_renderer_shader_blob_t blobs[TM_RENDERER_SHADER_STAGE_MAX] = { 0 };
+        bool compiled = true;
+        for (uint32_t stage = 0, r = first_request[i]; stage != TM_RENDERER_SHADER_STAGE_MAX; ++stage)
+        {
+            if (!s->entry_points[stage])
+                continue;
+            blobs[stage] = results[r++];
+            compiled = compiled && blobs[stage].size;
+        }
+
+        if (compiled && o->backend->reload_shader(o->backend->inst, s->shader, blobs))
+            ++num_queued;
+        else
+        {
+            ++o->stats.num_failures;
+            tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Shader reload: `%s` failed, keeping the old shader",
+                o->files[s->file].path);
+        }
+    }
+
+    for (uint32_t i = 0; i != num_requests; ++i)
+        compiler_api->release_blob(o->compiler, results[i]);
+    for (char **source = sources; source != tm_carray_end(sources); ++source)
+        tm_carray_free(*source, o->allocator);
+    return num_queued;
+}
+
+uint32_t
+d3d11_shader_reloader__begin(struct tm_d3d11_shader_reloader_o *o)
+{
+    if (o->watcher && !tm_os_api->file_system->file_system_watcher_any_changes(o->watcher))
+        return 0;
+
+    TM_INIT_TEMP_ALLOCATOR(ta);
+
+    // Files added while the changed files are read again are new and up to date, they are checked
+    // from the next change on.
+    const uint32_t num_files = (uint32_t)tm_carray_size(o->files);
+    bool *dirty = tm_temp_alloc(ta, num_files + 1);
+    bool any_dirty = false;
+    tm_file_time_o saved = { 0 };
+    for (uint32_t i = 0; i != num_files; ++i)
+    {
+        const struct source_file_t *f = o->files + i;
+        const tm_file_stat_t stat = tm_os_api->file_system->stat(f->path);
+        dirty[i] = stat.exists != f->exists
+            || (stat.exists && tm_os_api->time->file_time_delta(stat.last_modified_time, f->modified) != 0.0);
+        if (!dirty[i])
+            continue;
+
+        if (!any_dirty || tm_os_api->time->file_time_delta(stat.last_modified_time, saved) > 0.0)
+            saved = stat.last_modified_time;
+        any_dirty = true;
+    }
+
+    uint32_t num_queued = 0;
+    if (any_dirty)
+    {
+        const tm_file_time_o found = tm_os_api->time->file_time_now();
+        const tm_clock_o start = tm_os_api->time->now();
+
+        for (uint32_t i = 0; i != num_files; ++i)
+        {
+            if (dirty[i])
+                refresh_file(o, i, ta);
+        }
+
+        // A file is dirty if it includes a dirty file. Repeats until nothing changes, which takes
+        // as many passes as the longest include chain.
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (uint32_t i = 0; i != num_files; ++i)
+            {
+                for (const uint32_t *inc = o->files[i].includes; !dirty[i] && inc != tm_carray_end(o->files[i].includes); ++inc)
+                {
+                    if (*inc < num_files && dirty[*inc])
+                        dirty[i] = changed = true;
+                }
+            }
+        }
+
+        num_queued = reload_shaders(o, dirty, ta);
+
+        ++o->stats.num_reloads;
+        o->stats.num_reloaded_shaders += num_queued;
+        o->stats.detect_seconds = tm_os_api->time->file_time_delta(found, saved);
+        o->stats.compile_seconds = tm_os_api->time->delta(tm_os_api->time->now(), start);
+        o->pending = num_queued > 0;
+        o->pending_saved = saved;
+    }
+
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+    return num_queued;
+}
+
+void
+d3d11_shader_reloader__end(struct tm_d3d11_shader_reloader_o *o)
+{
+    if (!o->pending)
+        return;
+
+    o->pending = false;
+    o->stats.latency_seconds = tm_os_api->time->file_time_delta(tm_os_api->time->file_time_now(), o->pending_saved);
+    tm_logger_api->printf(TM_LOG_TYPE_INFO,
+        "Shader reload: %.1f ms from save to first frame (found after %.1f ms, compiled in %.1f ms)",
+        o->stats.latency_seconds * 1000.0, o->stats.detect_seconds * 1000.0, o->stats.compile_seconds * 1000.0);
+}
+
+void
+d3d11_shader_reloader__statistics(struct tm_d3d11_shader_reloader_o *o, struct tm_d3d11_shader_reload_statistics_t *stats)
+{
+    *stats = o->stats;
+    stats->num_files = (uint32_t)tm_carray_size(o->files);
+    stats->num_shaders = (uint32_t)tm_carray_size(o->shaders);
+}
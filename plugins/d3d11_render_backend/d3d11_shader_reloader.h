@@ -0,0 +1,37 @@
+#pragma once
+
+#include <foundation/api_types.h>
+#include <plugins/renderer/renderer_api_types.h>
+
+// Shader hot-reload, see `struct tm_d3d11_shader_reloader_o` in `d3d11_render_backend.h`.
+//
+// The reloader keeps a graph of the source files of the watched shaders: each file knows the files
+// it includes. When the file system watcher reports changes, the files of the graph are checked
+// for new modification times, the changed ones are parsed again for includes, and the change is
+// propagated to every file that includes a changed file, directly or not. Only the shaders whose
+// source file ends up changed are recompiled. Their sources are compiled with the includes
+// inlined, so the bytecode compiler never touches the file system.
+
+struct tm_allocator_i;
+struct tm_d3d11_backend_i;
+struct tm_d3d11_shader_reload_statistics_t;
+struct tm_d3d11_shader_reloader_o;
+struct tm_d3d11_watched_shader_t;
+struct tm_renderer_shader_compiler_o;
+
+struct tm_d3d11_shader_reloader_o *d3d11_shader_reloader__create(struct tm_allocator_i *allocator,
+    struct tm_d3d11_backend_i *backend, struct tm_renderer_shader_compiler_o *compiler, const char *directory);
+
+void d3d11_shader_reloader__destroy(struct tm_d3d11_shader_reloader_o *reloader);
+
+bool d3d11_shader_reloader__watch(struct tm_d3d11_shader_reloader_o *reloader,
+    const struct tm_d3d11_watched_shader_t *shader);
+
+void d3d11_shader_reloader__unwatch(struct tm_d3d11_shader_reloader_o *reloader, tm_renderer_handle_t shader);
+
+uint32_t d3d11_shader_reloader__begin(struct tm_d3d11_shader_reloader_o *reloader);
+
+void d3d11_shader_reloader__end(struct tm_d3d11_shader_reloader_o *reloader);
+
+void d3d11_shader_reloader__statistics(struct tm_d3d11_shader_reloader_o *reloader,
+    struct tm_d3d11_shader_reload_statistics_t *stats);
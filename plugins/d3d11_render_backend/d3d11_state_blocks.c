@@ -0,0 +1,326 @@
+#include "d3d11_state_blocks.h"
+
+#include "d3d11_device.h"
+#include "d3d11_internal.h"
+
+#include <foundation/allocator.h>
+#include <foundation/log.h>
+#include <foundation/murmurhash64a.inl>
+#include <plugins/renderer/renderer_api_types.h>
+#include <plugins/renderer/shader_compiler_state_blocks_common.h>
+
+#include <string.h>
+
+static uint32_t
+popcount(uint32_t n)
+{
+    n = n - ((n >> 1) & 0x55555555);
+    n = (n & 0x33333333) + ((n >> 2) & 0x33333333);
+    return (((n + (n >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+}
+
+static inline uint64_t
+descriptor_size(uint32_t set_mask)
+{
+    return sizeof(struct d3d11_state_block_t) + sizeof(uint32_t) * popcount(set_mask);
+}
+
+static inline uint64_t
+align_to_block(uint64_t size)
+{
+    return (size + sizeof(uint64_t) - 1) & ~(uint64_t)(sizeof(uint64_t) - 1);
+}
+
+// Number of render targets a blend block can reference.
+#define NUM_BLEND_TARGETS (TM_RENDERER_BLEND_STATE_RENDER_TARGET_7 - TM_RENDERER_BLEND_STATE_RENDER_TARGET_0 + 1)
+
+TM_STATIC_ASSERT(NUM_BLEND_TARGETS == 8);
+
+static inline bool
+is_render_target_reference(uint32_t block_type, uint32_t state)
+{
+    return block_type == TM_RENDERER_STATE_BLOCK_TYPE_BLEND && state >= TM_RENDERER_BLEND_STATE_RENDER_TARGET_0
+        && state <= TM_RENDERER_BLEND_STATE_RENDER_TARGET_7;
+}
+
+tm_renderer_shader_blob_t
+d3d11_state_block__compile(struct tm_allocator_i *allocator, uint32_t block_type,
+    const tm_renderer_state_value_pair_t *states, uint32_t num_states)
+{
+    uint32_t values[STATE_BLOCK_MAX_STATES];
+    uint32_t set_mask = 0;
+
+    // Render target blend blocks referenced by a blend block, copied into it below.
+    const struct d3d11_state_block_t *nested[STATE_BLOCK_MAX_STATES] = { 0 };
+
+    for (uint32_t i = 0; i != num_states; ++i)
+    {
+        const uint32_t state = states[i].state;
+        if (state >= STATE_BLOCK_MAX_STATES)
+            continue;
+
+        if (is_render_target_reference(block_type, state))
+        {
+            const tm_renderer_shader_blob_t *rt_blob = states[i].nested_state;
+            nested[state] = rt_blob ? d3d11_state_block__from_blob(rt_blob, TM_RENDERER_STATE_BLOCK_TYPE_RENDER_TARGET_BLEND) : 0;
+            if (!nested[state])
+            {
+                tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Blend state of render target %u isn't a compiled render "
+                    "target blend block, the target doesn't blend", state - TM_RENDERER_BLEND_STATE_RENDER_TARGET_0);
+                set_mask &= ~(1u << state);
+                continue;
+            }
+        }
+
+        values[state] = states[i].value;
+        set_mask |= 1u << state;
+    }
+
+    // Referenced blocks follow the values, each 8 byte aligned. Their offsets from the start of
+    // the block replace the references, so the block is self-contained and its hash covers them.
+    const uint64_t values_size = align_to_block(descriptor_size(set_mask));
+    uint64_t size = values_size;
+    for (uint32_t state = 0; state != STATE_BLOCK_MAX_STATES; ++state)
+    {
+        if (!nested[state] || !(set_mask & (1u << state)))
+            continue;
+        values[state] = (uint32_t)size;
+        size += align_to_block(descriptor_size(nested[state]->set_mask));
+    }
+    if (size == values_size)
+        size = descriptor_size(set_mask);
+
+    struct d3d11_state_block_t *block = tm_alloc(allocator, size);
+    memset(block, 0, size);
+    block->block_type = block_type;
+    block->set_mask = set_mask;
+
+    uint32_t n = 0;
+    for (uint32_t mask = set_mask; mask; mask &= mask - 1)
+    {
+        const uint32_t state = popcount((mask & (0u - mask)) - 1);
+        block->values[n++] = values[state];
+        if (nested[state])
+            memcpy((uint8_t *)block + values[state], nested[state], descriptor_size(nested[state]->set_mask));
+    }
+
+    block->hash = tm_murmur_hash_64a(&block->block_type, size - sizeof(block->hash), 0);
+
+    const tm_renderer_shader_blob_t blob = { .size = size, .data = block };
+    return blob;
+}
+
+const struct d3d11_state_block_t *
+d3d11_state_block__from_blob(const tm_renderer_shader_blob_t *blob, uint32_t block_type)
+{
+    if (!blob->data || blob->size < sizeof(struct d3d11_state_block_t))
+        return 0;
+
+    // Only blend blocks carry referenced blocks after their values.
+    const struct d3d11_state_block_t *block = blob->data;
+    const uint64_t size = descriptor_size(block->set_mask);
+    if (block->block_type != block_type
+        || (block_type == TM_RENDERER_STATE_BLOCK_TYPE_BLEND ? blob->size < size : blob->size != size))
+        return 0;
+
+    return block;
+}
+
+// -------------------------------------------------------------------
+// Value translation
+//
+// Renderer enum values are indices into the value lists of the shader compiler.
+
+static inline float
+as_float(uint32_t value)
+{
+    float f;
+    memcpy(&f, &value, sizeof(f));
+    return f;
+}
+
+// `D3D11_COMPARISON_FUNC`, `D3D11_STENCIL_OP`, `D3D11_BLEND_OP` and `D3D11_TEXTURE_ADDRESS_MODE`
+// list their values in the same order as the renderer, starting at 1.
+static inline uint32_t
+one_based(uint32_t value)
+{
+    return value + 1;
+}
+
+// `D3D11_BLEND` for each `TM_RENDERER_BLEND_FACTOR_*`. D3D11 has no separate constant alpha
+// factor, it uses the blend factor for both.
+static const uint32_t blend_factors[TM_RENDERER_BLEND_FACTOR_MAX_VALUES] = {
+    1,  // ZERO
+    2,  // ONE
+    3,  // SOURCE_COLOR
+    4,  // ONE_MINUS_SOURCE_COLOR
+    9,  // DESTINATION_COLOR
+    10, // ONE_MINUS_DESTINATION_COLOR
+    5,  // SOURCE_ALPHA
+    6,  // ONE_MINUS_SOURCE_ALPHA
+    7,  // DESTINATION_ALPHA
+    8,  // ONE_MINUS_DESTINATION_ALPHA
+    14, // CONSTANT_COLOR
+    15, // ONE_MINUS_CONSTANT_COLOR
+    14, // CONSTANT_ALPHA
+    15, // ONE_MINUS_CONSTANT_ALPHA
+    11, // SOURCE_ALPHA_SATURATE
+    16, // SOURCE1_COLOR
+    17, // ONE_MINUS_SOURCE1_COLOR
+    18, // SOURCE1_ALPHA
+    19, // ONE_MINUS_SOURCE1_ALPHA
+};
+
+static inline uint32_t
+blend_factor(uint32_t value, uint32_t default_value)
+{
+    return value < TM_RENDERER_BLEND_FACTOR_MAX_VALUES ? blend_factors[value] : default_value;
+}
+
+// -------------------------------------------------------------------
+// D3D11 descriptions
+
+void
+d3d11_state_block__rasterizer_desc(const struct d3d11_state_block_t *raster,
+    const struct d3d11_state_block_t *multi_sample, struct d3d11_rasterizer_desc_t *desc)
+{
+    const uint32_t polygon_mode = d3d11_state_block__value(raster, TM_RENDERER_RASTER_STATE_POLYGON_MODE, 0);
+    const bool depth_bias = d3d11_state_block__value(raster, TM_RENDERER_RASTER_STATE_DEPTH_BIAS_ENABLE, 0);
+
+    *desc = (struct d3d11_rasterizer_desc_t) {
+        .fill_mode               = polygon_mode == 1 ? 2 : 3, // D3D11_FILL_WIREFRAME : D3D11_FILL_SOLID
+        .cull_mode               = one_based(d3d11_state_block__value(raster, TM_RENDERER_RASTER_STATE_CULL_MODE, 2)),
+        .front_counter_clockwise = d3d11_state_block__value(raster, TM_RENDERER_RASTER_STATE_FRONT_FACE, 1) == 0,
+        .depth_clip_enable       = !d3d11_state_block__value(raster, TM_RENDERER_RASTER_STATE_DEPTH_CLAMP_ENABLE, 0),
+        .multisample_enable      = multi_sample != 0,
+    };
+
+    if (depth_bias)
+    {
+        desc->depth_bias = (int32_t)as_float(d3d11_state_block__value(raster, TM_RENDERER_RASTER_STATE_DEPTH_BIAS_CONSTANT_FACTOR, 0));
+        desc->depth_bias_clamp = as_float(d3d11_state_block__value(raster, TM_RENDERER_RASTER_STATE_DEPTH_BIAS_CLAMP, 0));
+        desc->slope_scaled_depth_bias = as_float(d3d11_state_block__value(raster, TM_RENDERER_RASTER_STATE_DEPTH_BIAS_SLOPE_FACTOR, 0));
+    }
+}
+
+static struct d3d11_stencil_op_desc_t
+stencil_op_desc(const struct d3d11_state_block_t *ds, uint32_t fail_op, uint32_t pass_op, uint32_t depth_fail_op,
+    uint32_t compare_op)
+{
+    const struct d3d11_stencil_op_desc_t desc = {
+        .fail_op       = one_based(d3d11_state_block__value(ds, fail_op, 0)),
+        .depth_fail_op = one_based(d3d11_state_block__value(ds, depth_fail_op, 0)),
+        .pass_op       = one_based(d3d11_state_block__value(ds, pass_op, 0)),
+        .func          = one_based(d3d11_state_block__value(ds, compare_op, 7)),
+    };
+    return desc;
+}
+
+void
+d3d11_state_block__depth_stencil_desc(const struct d3d11_state_block_t *ds, struct d3d11_depth_stencil_desc_t *desc,
+    uint32_t *stencil_ref)
+{
+    // D3D11 has a single read and write mask, the front face ones are used for both faces.
+    *desc = (struct d3d11_depth_stencil_desc_t) {
+        .depth_enable       = d3d11_state_block__value(ds, TM_RENDERER_DEPTH_STENCIL_STATE_DEPTH_TEST_ENABLE, 1) != 0,
+        .depth_write_mask   = d3d11_state_block__value(ds, TM_RENDERER_DEPTH_STENCIL_STATE_DEPTH_WRITE_ENABLE, 1) != 0,
+        .depth_func         = one_based(d3d11_state_block__value(ds, TM_RENDERER_DEPTH_STENCIL_STATE_DEPTH_COMPARE_OP, 1)),
+        .stencil_enable     = d3d11_state_block__value(ds, TM_RENDERER_DEPTH_STENCIL_STATE_STENCIL_TEST_ENABLE, 0) != 0,
+        .stencil_read_mask  = (uint8_t)d3d11_state_block__value(ds, TM_RENDERER_DEPTH_STENCIL_STATE_STENCIL_FRONT_COMPARE_MASK, 0xff),
+        .stencil_write_mask = (uint8_t)d3d11_state_block__value(ds, TM_RENDERER_DEPTH_STENCIL_STATE_STENCIL_FRONT_WRITE_MASK, 0xff),
+        .front_face         = stencil_op_desc(ds, TM_RENDERER_DEPTH_STENCIL_STATE_STENCIL_FRONT_FAIL_OP,
+            TM_RENDERER_DEPTH_STENCIL_STATE_STENCIL_FRONT_PASS_OP, TM_RENDERER_DEPTH_STENCIL_STATE_STENCIL_FRONT_DEPTH_FAIL_OP,
+            TM_RENDERER_DEPTH_STENCIL_STATE_STENCIL_FRONT_COMPARE_OP),
+        .back_face          = stencil_op_desc(ds, TM_RENDERER_DEPTH_STENCIL_STATE_STENCIL_BACK_FAIL_OP,
+            TM_RENDERER_DEPTH_STENCIL_STATE_STENCIL_BACK_PASS_OP, TM_RENDERER_DEPTH_STENCIL_STATE_STENCIL_BACK_DEPTH_FAIL_OP,
+            TM_RENDERER_DEPTH_STENCIL_STATE_STENCIL_BACK_COMPARE_OP),
+    };
+
+    *stencil_ref = d3d11_state_block__value(ds, TM_RENDERER_DEPTH_STENCIL_STATE_STENCIL_FRONT_REFERENCE, 0);
+}
+
+static struct d3d11_render_target_blend_desc_t
+render_target_blend_desc(const struct d3d11_state_block_t *rt)
+{
+    const uint32_t write_mask = d3d11_state_block__value(rt, TM_RENDERER_RENDER_TARGET_BLEND_STATE_WRITE_MASK, ~0u);
+
+    const struct d3d11_render_target_blend_desc_t desc = {
+        .blend_enable             = d3d11_state_block__value(rt, TM_RENDERER_RENDER_TARGET_BLEND_STATE_BLEND_ENABLE, 0) != 0,
+        .src_blend                = blend_factor(d3d11_state_block__value(rt, TM_RENDERER_RENDER_TARGET_BLEND_STATE_SOURCE_BLEND_FACTOR_COLOR, 1), 2),
+        .dest_blend               = blend_factor(d3d11_state_block__value(rt, TM_RENDERER_RENDER_TARGET_BLEND_STATE_DESTINATION_BLEND_FACTOR_COLOR, 0), 1),
+        .blend_op                 = one_based(d3d11_state_block__value(rt, TM_RENDERER_RENDER_TARGET_BLEND_STATE_BLEND_OP_COLOR, 0)),
+        .src_blend_alpha          = blend_factor(d3d11_state_block__value(rt, TM_RENDERER_RENDER_TARGET_BLEND_STATE_SOURCE_BLEND_FACTOR_ALPHA, 1), 2),
+        .dest_blend_alpha         = blend_factor(d3d11_state_block__value(rt, TM_RENDERER_RENDER_TARGET_BLEND_STATE_DESTINATION_BLEND_FACTOR_ALPHA, 0), 1),
+        .blend_op_alpha           = one_based(d3d11_state_block__value(rt, TM_RENDERER_RENDER_TARGET_BLEND_STATE_BLEND_OP_ALPHA, 0)),
+        .render_target_write_mask = write_mask < TM_RENDERER_BLEND_WRITE_MASK_MAX_VALUES
+            ? (uint8_t)tm_renderer_enum_value_write_mask[write_mask] : 0xf,
+    };
+    return desc;
+}
+
+void
+d3d11_state_block__blend_desc(const struct d3d11_state_block_t *blend, const struct d3d11_state_block_t *multi_sample,
+    struct d3d11_blend_desc_t *desc, uint32_t *sample_mask)
+{
+    memset(desc, 0, sizeof(*desc));
+
+    if (blend && blend->block_type == TM_RENDERER_STATE_BLOCK_TYPE_BLEND)
+    {
+        // Targets without a render target blend block get the defaults.
+        desc->independent_blend_enable = true;
+        for (uint32_t i = 0; i != NUM_BLEND_TARGETS; ++i)
+        {
+            const uint32_t offset = d3d11_state_block__value(blend, TM_RENDERER_BLEND_STATE_RENDER_TARGET_0 + i, 0);
+            const struct d3d11_state_block_t *rt = offset ? (const struct d3d11_state_block_t *)((const uint8_t *)blend + offset) : 0;
+            desc->render_target[i] = render_target_blend_desc(rt);
+        }
+    }
+    else
+    {
+        const struct d3d11_state_block_t *rt = blend && blend->block_type == TM_RENDERER_STATE_BLOCK_TYPE_RENDER_TARGET_BLEND ? blend : 0;
+        const struct d3d11_render_target_blend_desc_t rt_desc = render_target_blend_desc(rt);
+        for (uint32_t i = 0; i != TM_ARRAY_COUNT(desc->render_target); ++i)
+            desc->render_target[i] = rt_desc;
+    }
+
+    desc->alpha_to_coverage_enable = d3d11_state_block__value(multi_sample, TM_RENDERER_MULTI_SAMPLE_STATE_ALPHA_TO_COVERAGE_ENABLE, 0) != 0;
+    *sample_mask = d3d11_state_block__value(multi_sample, TM_RENDERER_MULTI_SAMPLE_STATE_SAMPLE_MASK, 0xffffffff);
+}
+
+void
+d3d11_state_block__sampler_desc(const struct d3d11_state_block_t *sampler, struct d3d11_sampler_desc_t *desc)
+{
+    const uint32_t min = d3d11_state_block__value(sampler, TM_RENDERER_SAMPLER_STATE_MIN_FILTER, 1);
+    const uint32_t mag = d3d11_state_block__value(sampler, TM_RENDERER_SAMPLER_STATE_MAG_FILTER, 1);
+    const uint32_t mip = d3d11_state_block__value(sampler, TM_RENDERER_SAMPLER_STATE_MIP_MODE, 1);
+    const bool anisotropic = d3d11_state_block__value(sampler, TM_RENDERER_SAMPLER_STATE_ANISOTROPY_ENABLE, 0);
+    const bool compare = d3d11_state_block__value(sampler, TM_RENDERER_SAMPLER_STATE_COMPARE_ENABLE, 0);
+
+    // `D3D11_FILTER` encodes min, mag and mip as one bit each (set for linear), anisotropic
+    // filtering as 0x55 and comparison as 0x80.
+    uint32_t filter = anisotropic ? 0x55 : ((min & 1) << 4) | ((mag & 1) << 2) | (mip & 1);
+    if (compare)
+        filter |= 0x80;
+
+    static const float border_colors[3][4] = {
+        { 0, 0, 0, 0 },
+        { 0, 0, 0, 1 },
+        { 1, 1, 1, 1 },
+    };
+    const uint32_t border = d3d11_state_block__value(sampler, TM_RENDERER_SAMPLER_STATE_BORDER_COLOR, 2);
+
+    *desc = (struct d3d11_sampler_desc_t) {
+        .filter          = filter,
+        .address_u       = one_based(d3d11_state_block__value(sampler, TM_RENDERER_SAMPLER_STATE_ADDRESS_U, 2)),
+        .address_v       = one_based(d3d11_state_block__value(sampler, TM_RENDERER_SAMPLER_STATE_ADDRESS_V, 2)),
+        .address_w       = one_based(d3d11_state_block__value(sampler, TM_RENDERER_SAMPLER_STATE_ADDRESS_W, 2)),
+        .mip_lod_bias    = as_float(d3d11_state_block__value(sampler, TM_RENDERER_SAMPLER_STATE_MIP_LOD_BIAS, 0)),
+        .max_anisotropy  = anisotropic ? d3d11_state_block__value(sampler, TM_RENDERER_SAMPLER_STATE_MAX_ANISOTROPY, 16) : 1,
+        .comparison_func = one_based(d3d11_state_block__value(sampler, TM_RENDERER_SAMPLER_STATE_COMPARE_OP, 0)),
+        .min_lod         = sampler && (sampler->set_mask & (1u << TM_RENDERER_SAMPLER_STATE_MIN_LOD))
+            ? as_float(d3d11_state_block__value(sampler, TM_RENDERER_SAMPLER_STATE_MIN_LOD, 0)) : -3.402823466e+38f,
+        .max_lod         = sampler && (sampler->set_mask & (1u << TM_RENDERER_SAMPLER_STATE_MAX_LOD))
+            ? as_float(d3d11_state_block__value(sampler, TM_RENDERER_SAMPLER_STATE_MAX_LOD, 0)) : 3.402823466e+38f,
+    };
+    memcpy(desc->border_color, border_colors[border < 3 ? border : 2], sizeof(desc->border_color));
+}
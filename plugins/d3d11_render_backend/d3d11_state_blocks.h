@@ -0,0 +1,85 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+// Compiled form of a renderer state block, as returned by `compile_state_block()`.
+//
+// The `tm_renderer_state_value_pair_t` list is packed into a canonical descriptor: states are
+// sorted by their index, later duplicates override earlier ones, and only the states that were
+// set are stored. Two lists that describe the same state therefore compile to byte-identical
+// descriptors with the same `hash`, no matter the order or redundancy of the input. The device
+// uses the hash to share one D3D11 state object between all identical blocks.
+//
+// A blend block references the render target blend blocks of its targets. Compiling it copies
+// them after its values and replaces each reference by the offset of the copy from the start of
+// the block, so the blend block stays valid when the referenced blobs are released and its hash
+// covers the blend states of every target.
+
+#define STATE_BLOCK_MAX_STATES (32)
+
+struct d3d11_state_block_t
+{
+    // Hash of everything after this member.
+    uint64_t hash;
+
+    // `TM_RENDERER_STATE_BLOCK_TYPE_*`.
+    uint32_t block_type;
+
+    // Bit `i` is set if state `i` is stored in `values`.
+    uint32_t set_mask;
+
+    // Values of the set states, in state order.
+    uint32_t values[];
+};
+
+struct tm_allocator_i;
+struct tm_renderer_state_value_pair_t;
+struct tm_renderer_shader_blob_t;
+
+// Packs `states` into a descriptor allocated with `allocator` and returns it as a blob. States
+// with an index of `STATE_BLOCK_MAX_STATES` or higher are ignored.
+struct tm_renderer_shader_blob_t d3d11_state_block__compile(struct tm_allocator_i *allocator, uint32_t block_type,
+    const struct tm_renderer_state_value_pair_t *states, uint32_t num_states);
+
+// Returns the descriptor in `blob` if it holds one of `block_type`, else NULL.
+const struct d3d11_state_block_t *d3d11_state_block__from_blob(const struct tm_renderer_shader_blob_t *blob,
+    uint32_t block_type);
+
+// Returns the value of `state` in `block`, or `default_value` if the state isn't set or `block` is
+// NULL.
+static inline uint32_t
+d3d11_state_block__value(const struct d3d11_state_block_t *block, uint32_t state, uint32_t default_value)
+{
+    if (!block || !(block->set_mask & (1u << state)))
+        return default_value;
+
+    // Index of the value is the number of set states before it.
+    uint32_t n = block->set_mask & ((1u << state) - 1);
+    n = n - ((n >> 1) & 0x55555555);
+    n = (n & 0x33333333) + ((n >> 2) & 0x33333333);
+    n = (((n + (n >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+    return block->values[n];
+}
+
+struct d3d11_rasterizer_desc_t;
+struct d3d11_depth_stencil_desc_t;
+struct d3d11_blend_desc_t;
+struct d3d11_sampler_desc_t;
+
+// Translation to D3D11 descriptions. Any block may be NULL, which gives the D3D11 defaults.
+
+void d3d11_state_block__rasterizer_desc(const struct d3d11_state_block_t *raster,
+    const struct d3d11_state_block_t *multi_sample, struct d3d11_rasterizer_desc_t *desc);
+
+// Also returns the stencil reference value, which D3D11 sets at bind time.
+void d3d11_state_block__depth_stencil_desc(const struct d3d11_state_block_t *depth_stencil,
+    struct d3d11_depth_stencil_desc_t *desc, uint32_t *stencil_ref);
+
+// `blend` may be a `TM_RENDERER_STATE_BLOCK_TYPE_BLEND` block, which sets each render target
+// from the render target blend block it references, or a
+// `TM_RENDERER_STATE_BLOCK_TYPE_RENDER_TARGET_BLEND` block, which then applies to all render
+// targets. Also returns the sample mask, which D3D11 sets at bind time.
+void d3d11_state_block__blend_desc(const struct d3d11_state_block_t *blend,
+    const struct d3d11_state_block_t *multi_sample, struct d3d11_blend_desc_t *desc, uint32_t *sample_mask);
+
+void d3d11_state_block__sampler_desc(const struct d3d11_state_block_t *sampler, struct d3d11_sampler_desc_t *desc);
@@ -0,0 +1,202 @@
+#include "d3d11_state_cache.h"
+
+#include "d3d11_device.h"
+#include "d3d11_state_blocks.h"
+
+#include <foundation/allocator.h>
+#include <foundation/carray.inl>
+#include <foundation/murmurhash64a.inl>
+
+#include <string.h>
+
+// Size of the description of each `enum d3d11_state_kind`.
+static const uint32_t desc_sizes[] = {
+    [STATE_KIND__RASTERIZER]    = sizeof(struct d3d11_rasterizer_desc_t),
+    [STATE_KIND__DEPTH_STENCIL] = sizeof(struct d3d11_depth_stencil_desc_t),
+    [STATE_KIND__BLEND]         = sizeof(struct d3d11_blend_desc_t),
+    [STATE_KIND__SAMPLER]       = sizeof(struct d3d11_sampler_desc_t),
+};
+
+// Hashes the description a state object is created from into a key. The two largest values are
+// reserved by the hash table.
+static uint64_t
+state_key(enum d3d11_state_kind kind, const void *desc)
+{
+    const uint64_t key = tm_murmur_hash_64a(desc, desc_sizes[kind], kind);
+    return key >= 0xfffffffffffffffeULL ? 1 : key;
+}
+
+// Returns the cached object created from `desc` with an added reference, or NULL. Keys whose
+// entry has another description collided, the next key is tried then. `*key` is set to the key
+// the object was found at, or the free key to insert it at. Releasing an entry can cut the chain
+// of keys after it, the descriptions further down then miss and go through `insert()` again.
+static void *
+find(struct d3d11_state_cache_t *cache, uint64_t *key, enum d3d11_state_kind kind, const void *desc)
+{
+    for (;;)
+    {
+        const uint32_t index = tm_hash_get(&cache->key_to_entry, *key);
+        if (!index)
+            return 0;
+
+        struct d3d11_state_cache_entry_t *e = cache->entries + index - 1;
+        if (e->kind == kind && !memcmp(&e->desc, desc, desc_sizes[kind]))
+        {
+            ++e->ref_count;
+            ++cache->stats.num_hits;
+            return e->object;
+        }
+
+        *key = *key + 1 >= 0xfffffffffffffffeULL ? 1 : *key + 1;
+    }
+}
+
+static void *
+insert(struct d3d11_state_cache_t *cache, uint64_t key, enum d3d11_state_kind kind, const void *desc, void *object)
+{
+    ++cache->stats.num_misses;
+    if (!object)
+        return 0;
+
+    // The native device returns the existing object for a description it has seen, with an added
+    // reference. That happens when `find()` missed an entry because its chain of keys was cut.
+    const uint32_t existing = tm_hash_get(&cache->object_to_entry, (uint64_t)object);
+    if (existing)
+    {
+        ++cache->entries[existing - 1].ref_count;
+        cache->device->release(cache->device->inst, object);
+        return object;
+    }
+
+    uint32_t index = cache->first_free;
+    if (index != UINT32_MAX)
+        cache->first_free = cache->entries[index].next_free;
+    else
+    {
+        index = (uint32_t)tm_carray_size(cache->entries);
+        tm_carray_push(cache->entries, (struct d3d11_state_cache_entry_t) { 0 }, cache->allocator);
+    }
+
+    cache->entries[index] = (struct d3d11_state_cache_entry_t) {
+        .key       = key,
+        .object    = object,
+        .ref_count = 1,
+        .next_free = UINT32_MAX,
+        .kind      = kind,
+    };
+    memcpy(&cache->entries[index].desc, desc, desc_sizes[kind]);
+    tm_hash_add(&cache->key_to_entry, key, index + 1);
+    tm_hash_add(&cache->object_to_entry, (uint64_t)object, index + 1);
+    ++cache->num_objects;
+    return object;
+}
+
+void
+d3d11_state_cache__init(struct d3d11_state_cache_t *cache, struct tm_allocator_i *allocator,
+    struct d3d11_device_i *device)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->allocator = allocator;
+    cache->device = device;
+    cache->first_free = UINT32_MAX;
+    cache->key_to_entry.allocator = allocator;
+    cache->object_to_entry.allocator = allocator;
+}
+
+void
+d3d11_state_cache__shutdown(struct d3d11_state_cache_t *cache)
+{
+    struct d3d11_device_i *device = cache->device;
+    for (struct d3d11_state_cache_entry_t *e = cache->entries; e != tm_carray_end(cache->entries); ++e)
+    {
+        if (e->ref_count)
+            device->release(device->inst, e->object);
+    }
+
+    tm_carray_free(cache->entries, cache->allocator);
+    tm_hash_free(&cache->key_to_entry);
+    tm_hash_free(&cache->object_to_entry);
+    memset(cache, 0, sizeof(*cache));
+}
+
+void *
+d3d11_state_cache__rasterizer(struct d3d11_state_cache_t *cache, const struct d3d11_state_block_t *raster,
+    const struct d3d11_state_block_t *multi_sample)
+{
+    struct d3d11_rasterizer_desc_t desc;
+    d3d11_state_block__rasterizer_desc(raster, multi_sample, &desc);
+
+    uint64_t key = state_key(STATE_KIND__RASTERIZER, &desc);
+    void *object = find(cache, &key, STATE_KIND__RASTERIZER, &desc);
+    if (object)
+        return object;
+
+    return insert(cache, key, STATE_KIND__RASTERIZER, &desc, cache->device->create_rasterizer_state(cache->device->inst, &desc));
+}
+
+void *
+d3d11_state_cache__depth_stencil(struct d3d11_state_cache_t *cache,
+    const struct d3d11_state_block_t *depth_stencil, uint32_t *stencil_ref)
+{
+    struct d3d11_depth_stencil_desc_t desc;
+    d3d11_state_block__depth_stencil_desc(depth_stencil, &desc, stencil_ref);
+
+    uint64_t key = state_key(STATE_KIND__DEPTH_STENCIL, &desc);
+    void *object = find(cache, &key, STATE_KIND__DEPTH_STENCIL, &desc);
+    if (object)
+        return object;
+
+    return insert(cache, key, STATE_KIND__DEPTH_STENCIL, &desc, cache->device->create_depth_stencil_state(cache->device->inst, &desc));
+}
+
+void *
+d3d11_state_cache__blend(struct d3d11_state_cache_t *cache, const struct d3d11_state_block_t *blend,
+    const struct d3d11_state_block_t *multi_sample, uint32_t *sample_mask)
+{
+    struct d3d11_blend_desc_t desc;
+    d3d11_state_block__blend_desc(blend, multi_sample, &desc, sample_mask);
+
+    uint64_t key = state_key(STATE_KIND__BLEND, &desc);
+    void *object = find(cache, &key, STATE_KIND__BLEND, &desc);
+    if (object)
+        return object;
+
+    return insert(cache, key, STATE_KIND__BLEND, &desc, cache->device->create_blend_state(cache->device->inst, &desc));
+}
+
+void *
+d3d11_state_cache__sampler(struct d3d11_state_cache_t *cache, const struct d3d11_state_block_t *sampler)
+{
+    struct d3d11_sampler_desc_t desc;
+    d3d11_state_block__sampler_desc(sampler, &desc);
+
+    uint64_t key = state_key(STATE_KIND__SAMPLER, &desc);
+    void *object = find(cache, &key, STATE_KIND__SAMPLER, &desc);
+    if (object)
+        return object;
+
+    return insert(cache, key, STATE_KIND__SAMPLER, &desc, cache->device->create_sampler_state(cache->device->inst, &desc));
+}
+
+void
+d3d11_state_cache__release(struct d3d11_state_cache_t *cache, void *object)
+{
+    if (!object)
+        return;
+
+    const uint32_t index = tm_hash_get(&cache->object_to_entry, (uint64_t)object);
+    if (!index)
+        return;
+
+    struct d3d11_state_cache_entry_t *e = cache->entries + index - 1;
+    if (--e->ref_count)
+        return;
+
+    cache->device->release(cache->device->inst, e->object);
+    tm_hash_remove(&cache->key_to_entry, e->key);
+    tm_hash_remove(&cache->object_to_entry, (uint64_t)object);
+    e->object = 0;
+    e->next_free = cache->first_free;
+    cache->first_free = index - 1;
+    --cache->num_objects;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+#include <foundation/hash.inl>
+
+#include "d3d11_device.h"
+
+// Device level cache of D3D11 state objects.
+//
+// State objects are looked up by a hash of the D3D11 description the state blocks produce, so
+// all blocks that end up with the same description share one reference counted object. Each
+// entry keeps the description of its object, and a hit only counts if the descriptions match, so
+// colliding hashes never share an object. This keeps the number of live state objects well below
+// the D3D11 limit of 4096 per type and lets the command translator detect redundant state binds
+// with a pointer compare.
+
+struct d3d11_state_block_t;
+struct tm_allocator_i;
+
+enum d3d11_state_kind {
+    STATE_KIND__RASTERIZER,
+    STATE_KIND__DEPTH_STENCIL,
+    STATE_KIND__BLEND,
+    STATE_KIND__SAMPLER,
+};
+
+// Description of a state object, the member is picked by `enum d3d11_state_kind`.
+union d3d11_state_desc_t
+{
+    struct d3d11_rasterizer_desc_t rasterizer;
+    struct d3d11_depth_stencil_desc_t depth_stencil;
+    struct d3d11_blend_desc_t blend;
+    struct d3d11_sampler_desc_t sampler;
+};
+
+struct d3d11_state_cache_entry_t
+{
+    uint64_t key;
+    void *object;
+    uint32_t ref_count;
+
+    // Next entry in the free list, if this entry is free.
+    uint32_t next_free;
+
+    // `enum d3d11_state_kind`, and the description `object` was created from.
+    uint32_t kind;
+    union d3d11_state_desc_t desc;
+};
+
+struct d3d11_state_cache_statistics_t
+{
+    uint64_t num_hits;
+    uint64_t num_misses;
+};
+
+struct d3d11_state_cache_t
+{
+    struct tm_allocator_i *allocator;
+    struct d3d11_device_i *device;
+
+    /* carray */ struct d3d11_state_cache_entry_t *entries;
+
+    // Head of the free list of `entries`, `UINT32_MAX` if empty.
+    uint32_t first_free;
+
+    // Number of live state objects.
+    uint32_t num_objects;
+
+    // Maps keys and state objects to indices into `entries`, offset by one.
+    struct TM_HASH_T(uint64_t, uint32_t) key_to_entry;
+    struct TM_HASH_T(uint64_t, uint32_t) object_to_entry;
+
+    struct d3d11_state_cache_statistics_t stats;
+};
+
+void d3d11_state_cache__init(struct d3d11_state_cache_t *cache, struct tm_allocator_i *allocator,
+    struct d3d11_device_i *device);
+
+// Releases all state objects, whether still referenced or not.
+void d3d11_state_cache__shutdown(struct d3d11_state_cache_t *cache);
+
+// The functions below return a referenced state object for the blocks, creating it if needed.
+// Any block may be NULL for the D3D11 defaults. The objects are released with
+// `d3d11_state_cache__release()`.
+
+void *d3d11_state_cache__rasterizer(struct d3d11_state_cache_t *cache, const struct d3d11_state_block_t *raster,
+    const struct d3d11_state_block_t *multi_sample);
+
+// Also returns the stencil reference value of `depth_stencil`.
+void *d3d11_state_cache__depth_stencil(struct d3d11_state_cache_t *cache,
+    const struct d3d11_state_block_t *depth_stencil, uint32_t *stencil_ref);
+
+// Also returns the sample mask of `multi_sample`.
+void *d3d11_state_cache__blend(struct d3d11_state_cache_t *cache, const struct d3d11_state_block_t *blend,
+    const struct d3d11_state_block_t *multi_sample, uint32_t *sample_mask);
+
+void *d3d11_state_cache__sampler(struct d3d11_state_cache_t *cache, const struct d3d11_state_block_t *sampler);
+
+// Drops a reference to `object` and releases it when it was the last one. NULL is ignored.
+void d3d11_state_cache__release(struct d3d11_state_cache_t *cache, void *object);
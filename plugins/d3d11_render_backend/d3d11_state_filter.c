@@ -0,0 +1,790 @@
+#include "d3d11_state_filter.h"
+#include "d3d11_internal.h"
+
+#include <string.h>
+
+// Shadow value of state the target may have bound to anything.
+#define UNKNOWN ((void *)~(uintptr_t)0)
+#define UNKNOWN_COUNT (0xffffffffu)
+
+// Range that binds a whole constant buffer in a `set_constant_buffers1()` call. Constants past the
+// end of the buffer read as zero.
+#define WHOLE_CONSTANT_BUFFER (4096)
+
+static inline struct d3d11_state_filter_t *
+filter_of(struct d3d11_context_o *inst)
+{
+    return (struct d3d11_state_filter_t *)inst;
+}
+
+static inline uint64_t
+range_mask(uint32_t start, uint32_t n)
+{
+    return (n >= 64 ? ~0ULL : (1ULL << n) - 1) << start;
+}
+
+static void
+forget_state(struct d3d11_state_filter_t *f)
+{
+    for (uint32_t stage = 0; stage != SHADER_STAGE__COUNT; ++stage)
+        f->shaders[stage] = UNKNOWN;
+    f->input_layout = UNKNOWN;
+    f->topology = UNKNOWN_COUNT;
+    f->index_buffer = UNKNOWN;
+    f->rasterizer_state = UNKNOWN;
+    f->depth_stencil_state = UNKNOWN;
+    f->blend_state = UNKNOWN;
+    f->num_render_targets = UNKNOWN_COUNT;
+    f->num_viewports = UNKNOWN_COUNT;
+    f->num_scissor_rects = UNKNOWN_COUNT;
+
+    for (uint32_t stage = 0; stage != SHADER_STAGE__COUNT; ++stage)
+    {
+        for (uint32_t kind = 0; kind != SLOT_KIND__COUNT; ++kind)
+        {
+            struct d3d11_slot_shadow_t *s = &f->slots[stage][kind];
+            for (uint32_t slot = 0; slot != STATE_FILTER_MAX_SLOTS; ++slot)
+                s->bound[slot] = UNKNOWN;
+            memset(s->pending, 0, sizeof(s->pending));
+            s->dirty = 0;
+        }
+    }
+
+    memset(f->constant_ranges, 0, sizeof(f->constant_ranges));
+
+    struct d3d11_slot_shadow_t *uavs = &f->unordered_access_views;
+    for (uint32_t slot = 0; slot != STATE_FILTER_MAX_SLOTS; ++slot)
+        uavs->bound[slot] = UNKNOWN;
+    memset(uavs->pending, 0, sizeof(uavs->pending));
+    uavs->dirty = 0;
+
+    for (uint32_t slot = 0; slot != TM_ARRAY_COUNT(f->bound_vertex_buffers); ++slot)
+        f->bound_vertex_buffers[slot] = (struct d3d11_vertex_buffer_binding_t) { .buffer = UNKNOWN };
+    memset(f->pending_vertex_buffers, 0, sizeof(f->pending_vertex_buffers));
+    f->dirty_vertex_buffers = 0;
+}
+
+// The target may have unbound any non-NULL object in `s`, so it is bound again.
+static void
+forget_slots(struct d3d11_slot_shadow_t *s)
+{
+    for (uint32_t slot = 0; slot != STATE_FILTER_MAX_SLOTS; ++slot)
+    {
+        if (s->pending[slot])
+        {
+            s->bound[slot] = UNKNOWN;
+            s->dirty |= 1ULL << slot;
+        }
+    }
+}
+
+// Called when outputs change. Inputs that view the same resources as the new outputs have been
+// unbound by D3D11.
+static void
+forget_inputs(struct d3d11_state_filter_t *f)
+{
+    for (uint32_t stage = 0; stage != SHADER_STAGE__COUNT; ++stage)
+        forget_slots(&f->slots[stage][SLOT_KIND__SHADER_RESOURCE]);
+
+    for (uint32_t slot = 0; slot != TM_ARRAY_COUNT(f->bound_vertex_buffers); ++slot)
+    {
+        if (f->pending_vertex_buffers[slot].buffer)
+        {
+            f->bound_vertex_buffers[slot].buffer = UNKNOWN;
+            f->dirty_vertex_buffers |= 1ULL << slot;
+        }
+    }
+    f->index_buffer = UNKNOWN;
+}
+
+// Stores `objects` as the pending objects of `n` slots from `start` and returns the number of
+// objects past the filtered slots.
+static uint32_t
+set_slots(struct d3d11_slot_shadow_t *s, uint32_t start, uint32_t n, void *const *objects)
+{
+    const uint32_t filtered = start < STATE_FILTER_MAX_SLOTS ? tm_min(n, STATE_FILTER_MAX_SLOTS - start) : 0;
+    for (uint32_t i = 0; i != filtered; ++i)
+    {
+        const uint32_t slot = start + i;
+        s->pending[slot] = objects[i];
+        if (objects[i] != s->bound[slot])
+            s->dirty |= 1ULL << slot;
+        else
+            s->dirty &= ~(1ULL << slot);
+    }
+    return n - filtered;
+}
+
+// Stores the ranges of the constant buffers set with `set_slots()`, NULL ranges binding whole
+// buffers, and marks the slots whose range changed as dirty.
+static void
+set_constant_ranges(struct d3d11_slot_shadow_t *s, struct d3d11_constant_ranges_t *r, uint32_t start, uint32_t n,
+    const uint32_t *first_constants, const uint32_t *num_constants)
+{
+    const uint32_t filtered = start < STATE_FILTER_MAX_SLOTS ? tm_min(n, STATE_FILTER_MAX_SLOTS - start) : 0;
+    for (uint32_t i = 0; i != filtered; ++i)
+    {
+        const uint32_t slot = start + i;
+        const struct d3d11_constant_range_t range = {
+            .first = first_constants ? first_constants[i] : 0,
+            .num   = num_constants ? num_constants[i] : 0,
+        };
+        r->pending[slot] = range;
+        if (range.first != r->bound[slot].first || range.num != r->bound[slot].num)
+            s->dirty |= 1ULL << slot;
+    }
+}
+
+// Unordered access views are only filtered for the compute stage and live outside `slots`.
+#define SLOT_KIND__UNORDERED_ACCESS SLOT_KIND__COUNT
+
+static void
+issue_slots(struct d3d11_state_filter_t *f, uint32_t stage, uint32_t kind, uint32_t start_slot, uint32_t n,
+    void *const *objects)
+{
+    struct d3d11_context_i *t = f->target;
+    switch (kind)
+    {
+    case SLOT_KIND__CONSTANT_BUFFER:
+        t->set_constant_buffers(t->inst, stage, start_slot, n, objects);
+        ++f->stats.num_constant_buffer_binds;
+        break;
+    case SLOT_KIND__SHADER_RESOURCE:
+        t->set_shader_resources(t->inst, stage, start_slot, n, objects);
+        break;
+    case SLOT_KIND__SAMPLER:
+        t->set_samplers(t->inst, stage, start_slot, n, objects);
+        break;
+    case SLOT_KIND__UNORDERED_ACCESS:
+        t->cs_set_unordered_access_views(t->inst, start_slot, n, objects);
+        break;
+    default:
+        break;
+    }
+    ++f->stats.num_issued;
+}
+
+// Binds `n` pending constant buffers from `start_slot` of `stage`, with their ranges if any of them
+// has one. The others are bound whole in the same call.
+static void
+issue_constant_buffers(struct d3d11_state_filter_t *f, uint32_t stage, uint32_t start_slot, uint32_t n,
+    void *const *buffers)
+{
+    struct d3d11_constant_ranges_t *r = f->constant_ranges + stage;
+    uint32_t first_constants[STATE_FILTER_MAX_SLOTS], num_constants[STATE_FILTER_MAX_SLOTS];
+    bool ranged = false;
+    for (uint32_t i = 0; i != n; ++i)
+    {
+        first_constants[i] = r->pending[start_slot + i].first;
+        num_constants[i] = r->pending[start_slot + i].num;
+        ranged |= num_constants[i] != 0;
+    }
+    for (uint32_t i = 0; ranged && i != n; ++i)
+        num_constants[i] = num_constants[i] ? num_constants[i] : WHOLE_CONSTANT_BUFFER;
+    memcpy(r->bound + start_slot, r->pending + start_slot, n * sizeof(*r->bound));
+
+    if (!ranged)
+    {
+        issue_slots(f, stage, SLOT_KIND__CONSTANT_BUFFER, start_slot, n, buffers);
+        return;
+    }
+
+    f->target->set_constant_buffers1(f->target->inst, stage, start_slot, n, buffers, first_constants, num_constants);
+    ++f->stats.num_issued;
+    ++f->stats.num_constant_buffer_binds;
+}
+
+// Binds every run of adjacent dirty slots with a single call.
+static void
+flush_slots(struct d3d11_state_filter_t *f, struct d3d11_slot_shadow_t *s, uint32_t stage, uint32_t kind)
+{
+    uint64_t dirty = s->dirty;
+    uint32_t start = 0;
+    while (dirty)
+    {
+        while (!(dirty & (1ULL << start)))
+            ++start;
+        uint32_t end = start + 1;
+        while (end != STATE_FILTER_MAX_SLOTS && (dirty & (1ULL << end)))
+            ++end;
+
+        if (kind == SLOT_KIND__CONSTANT_BUFFER)
+            issue_constant_buffers(f, stage, start, end - start, s->pending + start);
+        else
+            issue_slots(f, stage, kind, start, end - start, s->pending + start);
+        memcpy(s->bound + start, s->pending + start, (end - start) * sizeof(void *));
+
+        dirty &= ~range_mask(start, end - start);
+        start = end;
+    }
+    s->dirty = 0;
+}
+
+static void
+flush_vertex_buffers(struct d3d11_state_filter_t *f)
+{
+    uint64_t dirty = f->dirty_vertex_buffers;
+    uint32_t start = 0;
+    while (dirty)
+    {
+        while (!(dirty & (1ULL << start)))
+            ++start;
+        uint32_t end = start + 1;
+        while (end != TM_ARRAY_COUNT(f->pending_vertex_buffers) && (dirty & (1ULL << end)))
+            ++end;
+
+        void *buffers[TM_ARRAY_COUNT(f->pending_vertex_buffers)];
+        uint32_t strides[TM_ARRAY_COUNT(f->pending_vertex_buffers)];
+        uint32_t offsets[TM_ARRAY_COUNT(f->pending_vertex_buffers)];
+        for (uint32_t slot = start; slot != end; ++slot)
+        {
+            const struct d3d11_vertex_buffer_binding_t *b = f->pending_vertex_buffers + slot;
+            buffers[slot - start] = b->buffer;
+            strides[slot - start] = b->stride;
+            offsets[slot - start] = b->offset;
+            f->bound_vertex_buffers[slot] = *b;
+        }
+        f->target->ia_set_vertex_buffers(f->target->inst, start, end - start, buffers, strides, offsets);
+        ++f->stats.num_issued;
+
+        dirty &= ~range_mask(start, end - start);
+        start = end;
+    }
+    f->dirty_vertex_buffers = 0;
+}
+
+// Binds the pending slots of the stages used by the next draw or dispatch. UAVs go first, since
+// binding them can unbind shader resources.
+static void
+flush(struct d3d11_state_filter_t *f, bool compute)
+{
+    if (compute)
+    {
+        if (f->unordered_access_views.dirty)
+        {
+            flush_slots(f, &f->unordered_access_views, SHADER_STAGE__COMPUTE, SLOT_KIND__UNORDERED_ACCESS);
+            forget_inputs(f);
+            f->num_render_targets = UNKNOWN_COUNT;
+        }
+    }
+    else if (f->dirty_vertex_buffers)
+        flush_vertex_buffers(f);
+
+    const uint32_t first = compute ? SHADER_STAGE__COMPUTE : SHADER_STAGE__VERTEX;
+    const uint32_t last = compute ? SHADER_STAGE__COMPUTE : SHADER_STAGE__PIXEL;
+    for (uint32_t stage = first; stage <= last; ++stage)
+    {
+        struct d3d11_slot_shadow_t *s = f->slots[stage];
+        if (s[SLOT_KIND__CONSTANT_BUFFER].dirty)
+            flush_slots(f, s + SLOT_KIND__CONSTANT_BUFFER, stage, SLOT_KIND__CONSTANT_BUFFER);
+        if (s[SLOT_KIND__SHADER_RESOURCE].dirty)
+            flush_slots(f, s + SLOT_KIND__SHADER_RESOURCE, stage, SLOT_KIND__SHADER_RESOURCE);
+        if (s[SLOT_KIND__SAMPLER].dirty)
+            flush_slots(f, s + SLOT_KIND__SAMPLER, stage, SLOT_KIND__SAMPLER);
+    }
+}
+
+// -------------------------------------------------------------------
+// Output merger
+
+static void
+filter__om_set_render_targets(struct d3d11_context_o *inst, uint32_t num_views, void *const *rtvs, void *dsv)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    ++f->stats.num_calls;
+
+    const uint32_t n = tm_min(num_views, (uint32_t)TM_ARRAY_COUNT(f->render_targets));
+    if (num_views == f->num_render_targets && dsv == f->depth_stencil_view
+        && !memcmp(rtvs, f->render_targets, n * sizeof(void *)))
+        return;
+
+    f->target->om_set_render_targets(f->target->inst, num_views, rtvs, dsv);
+    ++f->stats.num_issued;
+
+    f->num_render_targets = num_views <= TM_ARRAY_COUNT(f->render_targets) ? num_views : UNKNOWN_COUNT;
+    memcpy(f->render_targets, rtvs, n * sizeof(void *));
+    f->depth_stencil_view = dsv;
+
+    forget_inputs(f);
+    forget_slots(&f->unordered_access_views);
+}
+
+static void
+filter__om_set_blend_state(struct d3d11_context_o *inst, void *state, const float blend_factor[4], uint32_t sample_mask)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    ++f->stats.num_calls;
+
+    static const float default_blend_factor[4] = { 1, 1, 1, 1 };
+    const float *factor = blend_factor ? blend_factor : default_blend_factor;
+    if (state == f->blend_state && sample_mask == f->sample_mask && !memcmp(factor, f->blend_factor, sizeof(f->blend_factor)))
+        return;
+
+    f->target->om_set_blend_state(f->target->inst, state, blend_factor, sample_mask);
+    ++f->stats.num_issued;
+
+    f->blend_state = state;
+    f->sample_mask = sample_mask;
+    memcpy(f->blend_factor, factor, sizeof(f->blend_factor));
+}
+
+static void
+filter__om_set_depth_stencil_state(struct d3d11_context_o *inst, void *state, uint32_t stencil_ref)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    ++f->stats.num_calls;
+
+    if (state == f->depth_stencil_state && stencil_ref == f->stencil_ref)
+        return;
+
+    f->target->om_set_depth_stencil_state(f->target->inst, state, stencil_ref);
+    ++f->stats.num_issued;
+
+    f->depth_stencil_state = state;
+    f->stencil_ref = stencil_ref;
+}
+
+static void
+filter__clear_render_target_view(struct d3d11_context_o *inst, void *rtv, const float color[4])
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    f->target->clear_render_target_view(f->target->inst, rtv, color);
+}
+
+static void
+filter__clear_depth_stencil_view(struct d3d11_context_o *inst, void *dsv, uint32_t clear_flags, float depth, uint8_t stencil)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    f->target->clear_depth_stencil_view(f->target->inst, dsv, clear_flags, depth, stencil);
+}
+
+// -------------------------------------------------------------------
+// Rasterizer
+
+static void
+filter__rs_set_state(struct d3d11_context_o *inst, void *state)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    ++f->stats.num_calls;
+
+    if (state == f->rasterizer_state)
+        return;
+
+    f->target->rs_set_state(f->target->inst, state);
+    ++f->stats.num_issued;
+    f->rasterizer_state = state;
+}
+
+static void
+filter__rs_set_viewports(struct d3d11_context_o *inst, uint32_t num_viewports, const struct d3d11_viewport_t *viewports)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    ++f->stats.num_calls;
+
+    if (num_viewports == f->num_viewports && !memcmp(viewports, f->viewports, num_viewports * sizeof(*viewports)))
+        return;
+
+    f->target->rs_set_viewports(f->target->inst, num_viewports, viewports);
+    ++f->stats.num_issued;
+
+    if (num_viewports <= TM_ARRAY_COUNT(f->viewports))
+    {
+        f->num_viewports = num_viewports;
+        memcpy(f->viewports, viewports, num_viewports * sizeof(*viewports));
+    }
+    else
+        f->num_viewports = UNKNOWN_COUNT;
+}
+
+static void
+filter__rs_set_scissor_rects(struct d3d11_context_o *inst, uint32_t num_rects, const struct d3d11_rect_t *rects)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    ++f->stats.num_calls;
+
+    if (num_rects == f->num_scissor_rects && !memcmp(rects, f->scissor_rects, num_rects * sizeof(*rects)))
+        return;
+
+    f->target->rs_set_scissor_rects(f->target->inst, num_rects, rects);
+    ++f->stats.num_issued;
+
+    if (num_rects <= TM_ARRAY_COUNT(f->scissor_rects))
+    {
+        f->num_scissor_rects = num_rects;
+        memcpy(f->scissor_rects, rects, num_rects * sizeof(*rects));
+    }
+    else
+        f->num_scissor_rects = UNKNOWN_COUNT;
+}
+
+// -------------------------------------------------------------------
+// Input assembler
+
+static void
+filter__ia_set_input_layout(struct d3d11_context_o *inst, void *layout)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    ++f->stats.num_calls;
+
+    if (layout == f->input_layout)
+        return;
+
+    f->target->ia_set_input_layout(f->target->inst, layout);
+    ++f->stats.num_issued;
+    f->input_layout = layout;
+}
+
+static void
+filter__ia_set_primitive_topology(struct d3d11_context_o *inst, uint32_t topology)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    ++f->stats.num_calls;
+
+    if (topology == f->topology)
+        return;
+
+    f->target->ia_set_primitive_topology(f->target->inst, topology);
+    ++f->stats.num_issued;
+    f->topology = topology;
+}
+
+static void
+filter__ia_set_vertex_buffers(struct d3d11_context_o *inst, uint32_t start_slot, uint32_t num_buffers,
+    void *const *buffers, const uint32_t *strides, const uint32_t *offsets)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    ++f->stats.num_calls;
+
+    const uint32_t max_slots = TM_ARRAY_COUNT(f->pending_vertex_buffers);
+    if (start_slot + num_buffers > max_slots)
+    {
+        f->target->ia_set_vertex_buffers(f->target->inst, start_slot, num_buffers, buffers, strides, offsets);
+        ++f->stats.num_issued;
+        return;
+    }
+
+    for (uint32_t i = 0; i != num_buffers; ++i)
+    {
+        const uint32_t slot = start_slot + i;
+        const struct d3d11_vertex_buffer_binding_t b = { buffers[i], strides[i], offsets[i] };
+        const struct d3d11_vertex_buffer_binding_t *bound = f->bound_vertex_buffers + slot;
+        f->pending_vertex_buffers[slot] = b;
+        if (b.buffer != bound->buffer || b.stride != bound->stride || b.offset != bound->offset)
+            f->dirty_vertex_buffers |= 1ULL << slot;
+        else
+            f->dirty_vertex_buffers &= ~(1ULL << slot);
+    }
+}
+
+static void
+filter__ia_set_index_buffer(struct d3d11_context_o *inst, void *buffer, uint32_t format, uint32_t offset)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    ++f->stats.num_calls;
+
+    if (buffer == f->index_buffer && format == f->index_format && offset == f->index_offset)
+        return;
+
+    f->target->ia_set_index_buffer(f->target->inst, buffer, format, offset);
+    ++f->stats.num_issued;
+
+    f->index_buffer = buffer;
+    f->index_format = format;
+    f->index_offset = offset;
+}
+
+// -------------------------------------------------------------------
+// Shader stages
+
+static void
+filter__set_shader(struct d3d11_context_o *inst, uint32_t stage, void *shader)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    ++f->stats.num_calls;
+
+    if (stage < SHADER_STAGE__COUNT && shader == f->shaders[stage])
+        return;
+
+    f->target->set_shader(f->target->inst, stage, shader);
+    ++f->stats.num_issued;
+    if (stage < SHADER_STAGE__COUNT)
+        f->shaders[stage] = shader;
+}
+
+static void
+set_stage_slots(struct d3d11_state_filter_t *f, uint32_t stage, uint32_t kind, uint32_t start_slot, uint32_t n,
+    void *const *objects)
+{
+    ++f->stats.num_calls;
+
+    if (stage >= SHADER_STAGE__COUNT)
+    {
+        issue_slots(f, stage, kind, start_slot, n, objects);
+        return;
+    }
+
+    const uint32_t rest = set_slots(&f->slots[stage][kind], start_slot, n, objects);
+    if (rest)
+        issue_slots(f, stage, kind, start_slot + n - rest, rest, objects + n - rest);
+}
+
+static void
+filter__set_constant_buffers(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_buffers, void *const *buffers)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    set_stage_slots(f, stage, SLOT_KIND__CONSTANT_BUFFER, start_slot, num_buffers, buffers);
+    if (stage < SHADER_STAGE__COUNT)
+    {
+        set_constant_ranges(&f->slots[stage][SLOT_KIND__CONSTANT_BUFFER], f->constant_ranges + stage, start_slot,
+            num_buffers, 0, 0);
+    }
+}
+
+static void
+filter__set_constant_buffers1(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_buffers, void *const *buffers, const uint32_t *first_constants, const uint32_t *num_constants)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    ++f->stats.num_calls;
+
+    const uint32_t rest = stage < SHADER_STAGE__COUNT
+        ? set_slots(&f->slots[stage][SLOT_KIND__CONSTANT_BUFFER], start_slot, num_buffers, buffers)
+        : num_buffers;
+    if (stage < SHADER_STAGE__COUNT)
+    {
+        set_constant_ranges(&f->slots[stage][SLOT_KIND__CONSTANT_BUFFER], f->constant_ranges + stage, start_slot,
+            num_buffers, first_constants, num_constants);
+    }
+
+    if (rest)
+    {
+        const uint32_t skip = num_buffers - rest;
+        f->target->set_constant_buffers1(f->target->inst, stage, start_slot + skip, rest, buffers + skip,
+            first_constants + skip, num_constants + skip);
+        ++f->stats.num_issued;
+        ++f->stats.num_constant_buffer_binds;
+    }
+}
+
+static void
+filter__set_shader_resources(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_views, void *const *views)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    set_stage_slots(f, stage, SLOT_KIND__SHADER_RESOURCE, start_slot, num_views, views);
+}
+
+static void
+filter__set_samplers(struct d3d11_context_o *inst, uint32_t stage, uint32_t start_slot,
+    uint32_t num_samplers, void *const *samplers)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    set_stage_slots(f, stage, SLOT_KIND__SAMPLER, start_slot, num_samplers, samplers);
+}
+
+static void
+filter__cs_set_unordered_access_views(struct d3d11_context_o *inst, uint32_t start_slot, uint32_t num_views,
+    void *const *uavs)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    ++f->stats.num_calls;
+
+    const uint32_t rest = set_slots(&f->unordered_access_views, start_slot, num_views, uavs);
+    if (rest)
+    {
+        issue_slots(f, SHADER_STAGE__COMPUTE, SLOT_KIND__UNORDERED_ACCESS, start_slot + num_views - rest, rest,
+            uavs + num_views - rest);
+        forget_inputs(f);
+        f->num_render_targets = UNKNOWN_COUNT;
+    }
+}
+
+// -------------------------------------------------------------------
+// Draw & dispatch
+
+static void
+filter__draw_instanced(struct d3d11_context_o *inst, uint32_t vertex_count_per_instance, uint32_t instance_count,
+    uint32_t start_vertex, uint32_t start_instance)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    flush(f, false);
+    f->target->draw_instanced(f->target->inst, vertex_count_per_instance, instance_count, start_vertex, start_instance);
+}
+
+static void
+filter__draw_indexed_instanced(struct d3d11_context_o *inst, uint32_t index_count_per_instance,
+    uint32_t instance_count, uint32_t start_index, int32_t base_vertex, uint32_t start_instance)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    flush(f, false);
+    f->target->draw_indexed_instanced(f->target->inst, index_count_per_instance, instance_count, start_index,
+        base_vertex, start_instance);
+}
+
+static void
+filter__dispatch(struct d3d11_context_o *inst, uint32_t x, uint32_t y, uint32_t z)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    flush(f, true);
+    f->target->dispatch(f->target->inst, x, y, z);
+}
+
+static void
+filter__draw_instanced_indirect(struct d3d11_context_o *inst, void *args_buffer, uint32_t offset)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    flush(f, false);
+    f->target->draw_instanced_indirect(f->target->inst, args_buffer, offset);
+}
+
+static void
+filter__draw_indexed_instanced_indirect(struct d3d11_context_o *inst, void *args_buffer, uint32_t offset)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    flush(f, false);
+    f->target->draw_indexed_instanced_indirect(f->target->inst, args_buffer, offset);
+}
+
+static void
+filter__dispatch_indirect(struct d3d11_context_o *inst, void *args_buffer, uint32_t offset)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    flush(f, true);
+    f->target->dispatch_indirect(f->target->inst, args_buffer, offset);
+}
+
+// -------------------------------------------------------------------
+// Pass through
+
+static void
+filter__copy_buffer_region(struct d3d11_context_o *inst, void *dst, uint32_t dst_offset, void *src,
+    uint32_t src_offset, uint32_t size)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    f->target->copy_buffer_region(f->target->inst, dst, dst_offset, src, src_offset, size);
+}
+
+static void
+filter__copy_subresource(struct d3d11_context_o *inst, void *dst, uint32_t dst_subresource, void *src,
+    uint32_t src_subresource)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    f->target->copy_subresource(f->target->inst, dst, dst_subresource, src, src_subresource);
+}
+
+static void
+filter__update_subresource(struct d3d11_context_o *inst, void *resource, uint32_t subresource,
+    const struct d3d11_box_t *box, const void *data, uint32_t row_pitch, uint32_t depth_pitch)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    f->target->update_subresource(f->target->inst, resource, subresource, box, data, row_pitch, depth_pitch);
+}
+
+static void
+filter__set_resource_min_lod(struct d3d11_context_o *inst, void *resource, float min_lod)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    f->target->set_resource_min_lod(f->target->inst, resource, min_lod);
+}
+
+static void *
+filter__map(struct d3d11_context_o *inst, void *resource, uint32_t subresource, uint32_t map_type)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    return f->target->map(f->target->inst, resource, subresource, map_type);
+}
+
+static void
+filter__unmap(struct d3d11_context_o *inst, void *resource, uint32_t subresource)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    f->target->unmap(f->target->inst, resource, subresource);
+}
+
+static void
+filter__begin_query(struct d3d11_context_o *inst, void *query)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    f->target->begin_query(f->target->inst, query);
+}
+
+static void
+filter__end_query(struct d3d11_context_o *inst, void *query)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    f->target->end_query(f->target->inst, query);
+}
+
+static bool
+filter__get_query_data(struct d3d11_context_o *inst, void *query, void *data, uint32_t size, bool flush)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    return f->target->get_query_data(f->target->inst, query, data, size, flush);
+}
+
+// Both leave the target context with default state.
+static void *
+filter__finish_command_list(struct d3d11_context_o *inst)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    forget_state(f);
+    return f->target->finish_command_list(f->target->inst);
+}
+
+static void
+filter__execute_command_list(struct d3d11_context_o *inst, void *command_list)
+{
+    struct d3d11_state_filter_t *f = filter_of(inst);
+    forget_state(f);
+    f->target->execute_command_list(f->target->inst, command_list);
+}
+
+// -------------------------------------------------------------------
+// Public
+
+void
+d3d11_state_filter__init(struct d3d11_state_filter_t *filter, struct d3d11_context_i *target)
+{
+    filter->i = (struct d3d11_context_i) {
+        .inst                            = (struct d3d11_context_o *)filter,
+        .om_set_render_targets           = filter__om_set_render_targets,
+        .om_set_blend_state              = filter__om_set_blend_state,
+        .om_set_depth_stencil_state      = filter__om_set_depth_stencil_state,
+        .clear_render_target_view        = filter__clear_render_target_view,
+        .clear_depth_stencil_view        = filter__clear_depth_stencil_view,
+        .rs_set_state                    = filter__rs_set_state,
+        .rs_set_viewports                = filter__rs_set_viewports,
+        .rs_set_scissor_rects            = filter__rs_set_scissor_rects,
+        .ia_set_input_layout             = filter__ia_set_input_layout,
+        .ia_set_primitive_topology       = filter__ia_set_primitive_topology,
+        .ia_set_vertex_buffers           = filter__ia_set_vertex_buffers,
+        .ia_set_index_buffer             = filter__ia_set_index_buffer,
+        .set_shader                      = filter__set_shader,
+        .set_constant_buffers            = filter__set_constant_buffers,
+        .set_constant_buffers1           = filter__set_constant_buffers1,
+        .set_shader_resources            = filter__set_shader_resources,
+        .set_samplers                    = filter__set_samplers,
+        .cs_set_unordered_access_views   = filter__cs_set_unordered_access_views,
+        .draw_instanced                  = filter__draw_instanced,
+        .draw_indexed_instanced          = filter__draw_indexed_instanced,
+        .dispatch                        = filter__dispatch,
+        .draw_instanced_indirect         = filter__draw_instanced_indirect,
+        .draw_indexed_instanced_indirect = filter__draw_indexed_instanced_indirect,
+        .dispatch_indirect               = filter__dispatch_indirect,
+        .copy_buffer_region              = filter__copy_buffer_region,
+        .copy_subresource                = filter__copy_subresource,
+        .update_subresource              = filter__update_subresource,
+        .set_resource_min_lod            = filter__set_resource_min_lod,
+        .map                             = filter__map,
+        .unmap                           = filter__unmap,
+        .begin_query                     = filter__begin_query,
+        .end_query                       = filter__end_query,
+        .get_query_data                  = filter__get_query_data,
+        .finish_command_list             = filter__finish_command_list,
+        .execute_command_list            = filter__execute_command_list,
+    };
+    filter->target = target;
+    filter->stats = (struct d3d11_state_filter_statistics_t) { 0 };
+    forget_state(filter);
+}
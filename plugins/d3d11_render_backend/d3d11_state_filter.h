@@ -0,0 +1,118 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+#include "d3d11_device.h"
+
+// Context that sits in front of another context and drops calls that would bind state the
+// target already has bound.
+//
+// Shaders, input layout, topology, index buffer, rasterizer, blend and depth stencil states,
+// render targets, viewports and scissor rects are compared with a shadow copy and forwarded
+// only when they change. Vertex buffers, constant buffers, shader resources, samplers and
+// unordered access views are collected per stage and slot and bound right before the next draw
+// or dispatch, with each run of adjacent changed slots merged into a single call. Runs of constant
+// buffers that bind a range of any of their buffers are bound with `set_constant_buffers1()`.
+//
+// D3D11 silently unbinds inputs that get bound as outputs. Whenever render targets or unordered
+// access views change, the shadow copies of the affected inputs are forgotten, so they are bound
+// again before the next draw or dispatch.
+
+// Slots above this are passed through without filtering.
+#define STATE_FILTER_MAX_SLOTS (64)
+
+enum d3d11_slot_kind
+{
+    SLOT_KIND__CONSTANT_BUFFER = 0,
+    SLOT_KIND__SHADER_RESOURCE,
+    SLOT_KIND__SAMPLER,
+
+    SLOT_KIND__COUNT,
+};
+
+struct d3d11_slot_shadow_t
+{
+    // Objects the target has bound and the objects that should be bound at the next draw.
+    void *bound[STATE_FILTER_MAX_SLOTS];
+    void *pending[STATE_FILTER_MAX_SLOTS];
+
+    // Slots where `pending` differs from `bound`.
+    uint64_t dirty;
+};
+
+// Part of a constant buffer bound with `set_constant_buffers1()`, in 16 byte constants. A `num`
+// of zero binds the whole buffer.
+struct d3d11_constant_range_t
+{
+    uint32_t first;
+    uint32_t num;
+};
+
+// Ranges of the constant buffers in the matching `d3d11_slot_shadow_t`. A slot is dirty if either
+// its buffer or its range changed.
+struct d3d11_constant_ranges_t
+{
+    struct d3d11_constant_range_t bound[STATE_FILTER_MAX_SLOTS];
+    struct d3d11_constant_range_t pending[STATE_FILTER_MAX_SLOTS];
+};
+
+struct d3d11_vertex_buffer_binding_t
+{
+    void *buffer;
+    uint32_t stride;
+    uint32_t offset;
+};
+
+struct d3d11_state_filter_statistics_t
+{
+    // State calls made on the filter and how many of them reached the target context, merged
+    // ranges counting as a single call.
+    uint64_t num_calls;
+    uint64_t num_issued;
+
+    // Constant buffer bind calls that reached the target context.
+    uint64_t num_constant_buffer_binds;
+};
+
+struct d3d11_state_filter_t
+{
+    // Filtering context, calls made on it end up on `target`.
+    struct d3d11_context_i i;
+    struct d3d11_context_i *target;
+
+    void *shaders[SHADER_STAGE__COUNT];
+    void *input_layout;
+    uint32_t topology;
+    uint32_t index_format;
+    void *index_buffer;
+    uint32_t index_offset;
+    uint32_t stencil_ref;
+    void *rasterizer_state;
+    void *depth_stencil_state;
+    void *blend_state;
+    float blend_factor[4];
+    uint32_t sample_mask;
+
+    uint32_t num_render_targets;
+    void *render_targets[8];
+    void *depth_stencil_view;
+
+    uint32_t num_viewports;
+    uint32_t num_scissor_rects;
+    struct d3d11_viewport_t viewports[16];
+    struct d3d11_rect_t scissor_rects[16];
+
+    struct d3d11_slot_shadow_t slots[SHADER_STAGE__COUNT][SLOT_KIND__COUNT];
+    struct d3d11_slot_shadow_t unordered_access_views;
+    struct d3d11_constant_ranges_t constant_ranges[SHADER_STAGE__COUNT];
+
+    struct d3d11_vertex_buffer_binding_t bound_vertex_buffers[32];
+    struct d3d11_vertex_buffer_binding_t pending_vertex_buffers[32];
+    uint64_t dirty_vertex_buffers;
+
+    struct d3d11_state_filter_statistics_t stats;
+};
+
+// Sets up `filter` to forward to `target`. Nothing is assumed about the state of `target`, so the
+// first bind of everything is forwarded.
+void d3d11_state_filter__init(struct d3d11_state_filter_t *filter, struct d3d11_context_i *target);
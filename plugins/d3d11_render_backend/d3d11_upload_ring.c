@@ -0,0 +1,228 @@
+#include "d3d11_upload_ring.h"
+
+#include "d3d11_device.h"
+#include "d3d11_internal.h"
+
+#include <foundation/allocator.h>
+#include <foundation/carray.inl>
+#include <foundation/log.h>
+#include <foundation/os.h>
+
+#include <string.h>
+
+// Largest supported allocation alignment. The capacity is rounded up to a multiple of it so that
+// aligned ring positions are aligned buffer offsets.
+#define MAX_ALIGNMENT (256)
+
+static inline struct d3d11_context_i *
+context(struct d3d11_upload_ring_t *ring)
+{
+    return ring->device->immediate_context(ring->device->inst);
+}
+
+static void
+pop_frame(struct d3d11_upload_ring_t *ring)
+{
+    ring->tail = ring->frames[ring->first_frame].end;
+    ring->first_frame = (ring->first_frame + 1) % UPLOAD_RING_MAX_FRAMES;
+    --ring->num_frames;
+}
+
+// Reclaims the frames the GPU has finished, without waiting.
+static void
+reclaim_completed(struct d3d11_upload_ring_t *ring)
+{
+    struct d3d11_context_i *ctx = context(ring);
+
+    while (ring->num_frames)
+    {
+        uint32_t signaled = 0;
+        if (!ctx->get_query_data(ctx->inst, ring->frames[ring->first_frame].query, &signaled, sizeof(signaled), false))
+            break;
+        pop_frame(ring);
+    }
+}
+
+// Waits for the oldest frame and reclaims it.
+static void
+wait_for_oldest_frame(struct d3d11_upload_ring_t *ring)
+{
+    struct d3d11_context_i *ctx = context(ring);
+    void *query = ring->frames[ring->first_frame].query;
+
+    uint32_t signaled = 0;
+    if (!ctx->get_query_data(ctx->inst, query, &signaled, sizeof(signaled), false))
+    {
+        const tm_clock_o start = tm_os_api->time->now();
+        while (!ctx->get_query_data(ctx->inst, query, &signaled, sizeof(signaled), true))
+            ;
+        ++ring->stats.num_wrap_stalls;
+        ring->stats.stall_seconds += tm_os_api->time->delta(tm_os_api->time->now(), start);
+    }
+
+    pop_frame(ring);
+}
+
+bool
+d3d11_upload_ring__init(struct d3d11_upload_ring_t *ring, struct tm_allocator_i *allocator,
+    struct d3d11_device_i *device, uint32_t capacity, uint32_t bind_flags)
+{
+    memset(ring, 0, sizeof(*ring));
+    ring->allocator = allocator;
+    ring->device = device;
+    ring->capacity = (capacity + MAX_ALIGNMENT - 1) & ~(uint32_t)(MAX_ALIGNMENT - 1);
+
+    const struct d3d11_buffer_desc_t desc = {
+        .size             = ring->capacity,
+        .usage            = USAGE__DYNAMIC,
+        .bind_flags       = bind_flags,
+        .cpu_access_flags = CPU_ACCESS__WRITE,
+    };
+    ring->buffer = device->create_buffer(device->inst, &desc, 0);
+
+    for (uint32_t i = 0; i != UPLOAD_RING_MAX_FRAMES; ++i)
+        ring->frames[i].query = device->create_query(device->inst, QUERY__EVENT);
+
+    if (!ring->buffer || !ring->frames[UPLOAD_RING_MAX_FRAMES - 1].query)
+    {
+        d3d11_upload_ring__shutdown(ring);
+        return false;
+    }
+
+    return true;
+}
+
+void
+d3d11_upload_ring__shutdown(struct d3d11_upload_ring_t *ring)
+{
+    struct d3d11_device_i *device = ring->device;
+    if (!device)
+        return;
+
+    if (ring->mapped)
+    {
+        struct d3d11_context_i *ctx = context(ring);
+        ctx->unmap(ctx->inst, ring->buffer, 0);
+    }
+
+    for (uint32_t i = 0; i != UPLOAD_RING_MAX_FRAMES; ++i)
+    {
+        if (ring->frames[i].query)
+            device->release(device->inst, ring->frames[i].query);
+    }
+
+    if (ring->buffer)
+        device->release(device->inst, ring->buffer);
+
+    tm_carray_free(ring->copies, ring->allocator);
+    memset(ring, 0, sizeof(*ring));
+}
+
+void *
+d3d11_upload_ring__allocate(struct d3d11_upload_ring_t *ring, uint32_t size, uint32_t alignment, uint32_t *offset)
+{
+    if (size > ring->capacity || alignment > MAX_ALIGNMENT)
+        return 0;
+
+    const uint64_t mask = (uint64_t)(alignment ? alignment : 1) - 1;
+    uint64_t pos = (ring->head + mask) & ~mask;
+
+    // Allocations never straddle the end of the buffer, skip to the start instead.
+    uint64_t buffer_offset = pos % ring->capacity;
+    if (buffer_offset + size > ring->capacity)
+    {
+        pos += ring->capacity - buffer_offset;
+        buffer_offset = 0;
+    }
+
+    // The very first map has nothing to preserve and is a discard as well.
+    const bool wrap = ring->head && pos / ring->capacity != (ring->head - 1) / ring->capacity;
+    const bool discard = wrap || !ring->head;
+
+    // Make sure the GPU is done with the memory we're about to overwrite.
+    while (pos + size - ring->tail > ring->capacity)
+    {
+        if (ring->num_frames == 0)
+        {
+            // Everything in the ring belongs to the current frame.
+            tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Upload ring of %u bytes is too small for the frame", ring->capacity);
+            return 0;
+        }
+        wait_for_oldest_frame(ring);
+    }
+
+    // Discarding renames the buffer, so queued copies must read it before that.
+    if (discard)
+        d3d11_upload_ring__flush(ring);
+    if (wrap)
+        ++ring->stats.num_wraps;
+
+    if (!ring->mapped)
+    {
+        struct d3d11_context_i *ctx = context(ring);
+        ring->mapped = ctx->map(ctx->inst, ring->buffer, 0, discard ? MAP__WRITE_DISCARD : MAP__WRITE_NO_OVERWRITE);
+        if (!ring->mapped)
+            return 0;
+    }
+
+    ring->head = pos + size;
+    ring->stats.bytes_uploaded += size;
+
+    *offset = (uint32_t)buffer_offset;
+    return ring->mapped + buffer_offset;
+}
+
+bool
+d3d11_upload_ring__copy_to_buffer(struct d3d11_upload_ring_t *ring, void *dst, uint32_t dst_offset, const void *data,
+    uint32_t size)
+{
+    uint32_t src_offset;
+    void *p = d3d11_upload_ring__allocate(ring, size, 16, &src_offset);
+    if (!p)
+        return false;
+
+    memcpy(p, data, size);
+
+    const struct d3d11_upload_copy_t copy = { dst, dst_offset, src_offset, size };
+    tm_carray_push(ring->copies, copy, ring->allocator);
+    return true;
+}
+
+void
+d3d11_upload_ring__flush(struct d3d11_upload_ring_t *ring)
+{
+    if (!ring->mapped)
+        return;
+
+    struct d3d11_context_i *ctx = context(ring);
+    ctx->unmap(ctx->inst, ring->buffer, 0);
+    ring->mapped = 0;
+
+    for (const struct d3d11_upload_copy_t *c = ring->copies; c != tm_carray_end(ring->copies); ++c)
+        ctx->copy_buffer_region(ctx->inst, c->dst, c->dst_offset, ring->buffer, c->src_offset, c->size);
+    tm_carray_resize(ring->copies, 0, ring->allocator);
+}
+
+void
+d3d11_upload_ring__end_frame(struct d3d11_upload_ring_t *ring)
+{
+    if (!ring->device)
+        return;
+
+    d3d11_upload_ring__flush(ring);
+    reclaim_completed(ring);
+
+    if (ring->head == ring->frame_start)
+        return;
+
+    if (ring->num_frames == UPLOAD_RING_MAX_FRAMES)
+        wait_for_oldest_frame(ring);
+
+    const uint32_t i = (ring->first_frame + ring->num_frames) % UPLOAD_RING_MAX_FRAMES;
+    struct d3d11_context_i *ctx = context(ring);
+    ctx->end_query(ctx->inst, ring->frames[i].query);
+    ring->frames[i].end = ring->head;
+    ++ring->num_frames;
+
+    ring->frame_start = ring->head;
+}
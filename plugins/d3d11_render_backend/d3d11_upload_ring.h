@@ -0,0 +1,102 @@
+#pragma once
+
+#include <foundation/api_types.h>
+
+// Persistent dynamic buffer that transient data (buffer updates, per-frame constants, UI
+// vertices) is streamed through. Constant buffers can't have other bind flags, so a ring created
+// as a constant buffer is only used for constants.
+//
+// Allocations are carved linearly out of the buffer, which stays mapped with
+// `MAP__WRITE_NO_OVERWRITE` between flushes. The buffer is only mapped with `MAP__WRITE_DISCARD`
+// when the ring wraps. Every call to `d3d11_upload_ring__end_frame()` issues an event query that
+// marks the end of the frame's allocations. Once the GPU has passed a marker, the memory before
+// it is reclaimed. Wrapping onto memory the GPU may still read waits for the marker first; that
+// is counted as a wrap stall.
+
+// Maximum number of frames with unreclaimed allocations. Ending a frame with more than this in
+// flight waits for the oldest one.
+#define UPLOAD_RING_MAX_FRAMES (8)
+
+struct d3d11_device_i;
+struct d3d11_context_i;
+struct tm_allocator_i;
+
+struct d3d11_upload_ring_statistics_t
+{
+    uint64_t bytes_uploaded;
+    uint64_t num_wraps;
+    uint64_t num_wrap_stalls;
+    double stall_seconds;
+};
+
+// A copy from the ring to another buffer queued by `d3d11_upload_ring__copy_to_buffer()`.
+struct d3d11_upload_copy_t
+{
+    void *dst;
+    uint32_t dst_offset;
+    uint32_t src_offset;
+    uint32_t size;
+    TM_PAD(4);
+};
+
+struct d3d11_upload_frame_t
+{
+    void *query;
+
+    // Ring position (`head`) at the end of the frame.
+    uint64_t end;
+};
+
+struct d3d11_upload_ring_t
+{
+    struct tm_allocator_i *allocator;
+    struct d3d11_device_i *device;
+
+    // Dynamic buffer, bound as vertex and index buffer or as constant buffer.
+    void *buffer;
+    uint8_t *mapped;
+    uint32_t capacity;
+    TM_PAD(4);
+
+    // Monotonic positions, `head - tail` bytes are in use. `head % capacity` is the buffer offset.
+    uint64_t head;
+    uint64_t tail;
+
+    // Ring of frames that haven't been reclaimed yet.
+    struct d3d11_upload_frame_t frames[UPLOAD_RING_MAX_FRAMES];
+    uint32_t first_frame;
+    uint32_t num_frames;
+
+    // Position `head` had at the last end of frame.
+    uint64_t frame_start;
+
+    /* carray */ struct d3d11_upload_copy_t *copies;
+
+    struct d3d11_upload_ring_statistics_t stats;
+};
+
+// Creates the ring buffer of `capacity` bytes on `device`, with the `enum d3d11_bind_flag`s
+// `bind_flags`. Returns false on failure.
+bool d3d11_upload_ring__init(struct d3d11_upload_ring_t *ring, struct tm_allocator_i *allocator,
+    struct d3d11_device_i *device, uint32_t capacity, uint32_t bind_flags);
+
+// Releases the buffer and queries. The GPU must be done with the ring.
+void d3d11_upload_ring__shutdown(struct d3d11_upload_ring_t *ring);
+
+// Reserves `size` bytes aligned to `alignment` (a power of two) and returns a pointer to write
+// them to. Their offset in `ring->buffer` is stored in `offset`. The data may be consumed by the
+// GPU after the next `d3d11_upload_ring__flush()`, and must be consumed before the ring wraps.
+// Returns NULL if `size` is larger than the ring.
+void *d3d11_upload_ring__allocate(struct d3d11_upload_ring_t *ring, uint32_t size, uint32_t alignment, uint32_t *offset);
+
+// Uploads `size` bytes of `data` to `dst` at `dst_offset` through the ring. The copy is issued by
+// the next flush. Returns false if the data doesn't fit in the ring.
+bool d3d11_upload_ring__copy_to_buffer(struct d3d11_upload_ring_t *ring, void *dst, uint32_t dst_offset, const void *data,
+    uint32_t size);
+
+// Unmaps the ring and issues the queued copies.
+void d3d11_upload_ring__flush(struct d3d11_upload_ring_t *ring);
+
+// Flushes and marks the end of the frame's allocations with a fence. Reclaims the memory of
+// frames the GPU has finished.
+void d3d11_upload_ring__end_frame(struct d3d11_upload_ring_t *ring);
@@ -37,6 +37,22 @@ filter "platforms:Win64"
     }
     linkoptions { "/ignore:4099" } -- warning LNK4099: linking object as if no debug info
 
+filter "system:linux"
+    platforms { "Linux" }
+
+filter "platforms:Linux"
+    defines { "TM_OS_LINUX", "TM_OS_POSIX" }
+    includedirs { "$(TM_SDK_DIR)/headers" }
+    architecture "x64"
+    toolset "clang"
+    buildoptions { "-fms-extensions", "-fno-strict-aliasing" }
+    libdirs { "$(TM_SDK_DIR)/lib/" .. _ACTION .. "/%{cfg.buildcfg}" }
+    disablewarnings {
+        "missing-field-initializers",
+        "missing-braces",
+        "unused-parameter",
+    }
+
 filter "configurations:Debug"
     defines { "TM_CONFIGURATION_DEBUG", "DEBUG" }
     symbols "On"
@@ -53,7 +69,7 @@ group "01-plugins"
         files { "plugins/d3d11_render_backend/**.inl", "plugins/d3d11_render_backend/**.h", "plugins/d3d11_render_backend/**.c" }
         targetdir "bin/%{cfg.buildcfg}/plugins"
         filter "platforms:Win64"
-            links { "dxgi.lib", "dxguid.lib" }
+            links { "dxgi.lib", "d3d11.lib", "dxguid.lib" }
 
 group "02-samples"
     project "simple-triangle-exe"
@@ -62,12 +78,20 @@ group "02-samples"
         kind "ConsoleApp"
         defines { "TM_LINKS_FOUNDATION", "TM_LINKS_HOST" }
         dependson { "simple-triangle-dll" }
-        files { "samples/simple_triangle/host.c", "samples/simple_triangle/host.inl" }
+        files { "samples/simple_triangle/host.c", "samples/simple_triangle/host.inl", "samples/simple_triangle/simple-triangle.plugins" }
         links { "foundation" }
+        postbuildcommands {
+            '{COPY} ../../samples/simple_triangle/simple-triangle.plugins ../../bin/%{cfg.buildcfg}'
+        }
         filter { "platforms:Win64" }
             postbuildcommands {
                 '{COPY} "%TM_SDK_DIR%/bin/plugins" ../../bin/%{cfg.buildcfg}/plugins'
             }
+        -- On Linux only offscreen mode runs, against the recording device.
+        filter { "platforms:Linux" }
+            postbuildcommands {
+                '{COPY} "$(TM_SDK_DIR)/bin/plugins" ../../bin/%{cfg.buildcfg}/plugins'
+            }
 
     project "simple-triangle-dll"
         location "build/simple_triangle_dll"
@@ -77,6 +101,31 @@ group "02-samples"
         filter "platforms:Win64"
             links { "Shcore.lib" }
 
+group "03-benchmarks"
+    project "d3d11-backend-bench-exe"
+        location "build/d3d11_backend_bench_exe"
+        targetname "d3d11-backend-bench"
+        kind "ConsoleApp"
+        defines { "TM_LINKS_FOUNDATION", "TM_LINKS_HOST" }
+        dependson { "d3d11-backend-bench-dll" }
+        files { "benchmarks/d3d11_backend_bench/host.c" }
+        links { "foundation" }
+        filter { "platforms:Win64" }
+            postbuildcommands {
+                '{COPY} "%TM_SDK_DIR%/bin/plugins" ../../bin/%{cfg.buildcfg}/plugins'
+            }
+        -- On Linux the benchmarks run against the recording device.
+        filter { "platforms:Linux" }
+            postbuildcommands {
+                '{COPY} "$(TM_SDK_DIR)/bin/plugins" ../../bin/%{cfg.buildcfg}/plugins'
+            }
+
+    project "d3d11-backend-bench-dll"
+        location "build/d3d11_backend_bench_dll"
+        kind "SharedLib"
+        dependson { "d3d11_render_backend" }
+        files { "benchmarks/d3d11_backend_bench/d3d11_backend_bench.h", "benchmarks/d3d11_backend_bench/d3d11_backend_bench.c", "benchmarks/d3d11_backend_bench/bench_*.c" }
+
 
 
 --[[
@@ -11,6 +11,7 @@ struct tm_path_api *tm_path_api;
 struct tm_plugins_api *tm_plugins_api;
 struct tm_temp_allocator_api *tm_temp_allocator_api;
 struct tm_the_truth_api *tm_the_truth_api;
+struct tm_job_system_api *tm_job_system_api;
 
 struct tm_os_window_api *tm_os_window_api;
 struct tm_dxc_shader_compiler_api *tm_dxc_shader_compiler_api;
@@ -36,7 +37,9 @@ struct tm_renderer_resource_command_buffer_api *tm_res_buf_api;
 #include <foundation/allocator.h>
 #include <foundation/application.h>
 #include <foundation/carray.inl>
+#include <foundation/carray_print.inl>
 #include <foundation/error.h>
+#include <foundation/job_system.h>
 #include <foundation/localizer.h>
 #include <foundation/log.h>
 #include <foundation/os.h>
@@ -50,7 +53,7 @@ struct tm_renderer_resource_command_buffer_api *tm_res_buf_api;
 #include <plugins/os_window/os_window.h>
 #include <plugins/renderer/nil_render_backend.h>
 #include <plugins/renderer/render_backend.h>
-// #include <plugins/renderer/render_command_buffer.h>
+#include <plugins/renderer/render_command_buffer.h>
 #include <plugins/renderer/renderer.h>
 #include <plugins/renderer/shader_compiler.h>
 #include <plugins/shader_system/shader_system.h>
@@ -61,6 +64,9 @@ struct tm_renderer_resource_command_buffer_api *tm_res_buf_api;
 #include <plugins/vulkan_render_backend/vulkan_render_backend.h>
 #endif
 
+#include <stdlib.h>
+#include <string.h>
+
 #if defined(TM_OS_WINDOWS)
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
@@ -70,6 +76,44 @@ struct tm_renderer_resource_command_buffer_api *tm_res_buf_api;
 struct window_t
 {
     struct tm_window_o *window;
+    tm_renderer_handle_t swap_chain;
+};
+
+// Command line options, see `parse_options()`.
+struct options_t
+{
+    // Number of frames to render offscreen, 0 opens a window instead.
+    uint32_t offscreen_frames;
+
+    // Use the software adapter or the recording device instead of a GPU.
+    bool software;
+    bool recording;
+
+    // Load every plugin in the plugin directory, even if there is a plugin manifest.
+    bool all_plugins;
+    TM_PAD(1);
+
+    // Where the offscreen frame timings are written.
+    const char *csv_path;
+};
+
+// Offscreen mode renders `options_t.offscreen_frames` frames to an image, without a window or a
+// swap chain, and writes the CPU and GPU time of each frame to a CSV file. Meant for headless
+// frame time baselines, for example on build agents.
+struct offscreen_t
+{
+    // Number of the last submit before the first frame, see `tm_d3d11_backend_i.gpu_timings()`.
+    uint64_t base_submit;
+
+    // CPU and GPU time of each frame in milliseconds. GPU times are negative until read back.
+    double *cpu_ms;
+    double *gpu_ms;
+
+    tm_renderer_handle_t target;
+
+    // Frames rendered so far. Keeps counting past `offscreen_frames` while the GPU timings of the
+    // last frames are read back.
+    uint32_t frame;
 };
 
 struct tm_application_o
@@ -91,6 +135,9 @@ struct tm_application_o
     char *shader_dir;
 
     struct window_t window;
+
+    struct options_t options;
+    struct offscreen_t offscreen;
 };
 
 
@@ -111,21 +158,180 @@ shutdown_renderer_plugin(void)
     tm_renderer_init_api->shutdown();
 }
 
+// Waits until the swap chain of `win` can take another frame. Returns false if the backend can't
+// wait for swap chains.
+static bool
+wait_for_swap_chain(struct tm_application_o *app, struct window_t *win)
+{
+#if defined(USE_D3D11_BACKEND)
+    if (!app->d3d11_backend || !win->swap_chain.resource)
+        return false;
+
+    // Presents are synced to vertical blank, so this blocks until the display has caught up
+    // instead of letting the CPU run ahead. The timeout only guards against a lost device.
+    app->d3d11_backend->wait_for_swap_chain(app->d3d11_backend->inst, win->swap_chain, 1.0f);
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Renders a frame to `target`, a swap chain or a render target image. The frame is wrapped in a
+// statistics scope so its GPU time can be read back.
+static void
+render_frame(struct tm_application_o *app, tm_renderer_handle_t target)
+{
+    struct tm_renderer_backend_i *rb = app->render_backend;
+    struct tm_renderer_command_buffer_o *cmd_buf = 0;
+    rb->create_command_buffers(rb->inst, &cmd_buf, 1);
+
+    const uint64_t scope = tm_cmd_buf_api->begin_statistics_scope(cmd_buf, 0, "simple_triangle", "frame", 0);
+
+    const tm_renderer_render_pass_bind_t pass = {
+        .render_targets[0] = {
+            .resource    = target,
+            .load_op     = TM_RENDERER_LOAD_OP_CLEAR,
+            .clear_value = { 0.1f, 0.1f, 0.1f, 1.0f },
+        },
+    };
+    tm_cmd_buf_api->bind_render_pass(cmd_buf, 0, &pass);
+
+    tm_cmd_buf_api->end_statistics_scope(cmd_buf, 0, scope);
+
+    rb->submit_command_buffers(rb->inst, &cmd_buf, 1);
+    rb->destroy_command_buffers(rb->inst, &cmd_buf, 1);
+}
+
+static void
+render_window(struct tm_application_o *app, struct window_t *win)
+{
+    if (!win->swap_chain.resource)
+        return;
+
+    render_frame(app, win->swap_chain);
+
+    struct tm_renderer_backend_i *rb = app->render_backend;
+    rb->present_swap_chain(rb->inst, win->swap_chain);
+}
+
+// Returns the number of the latest submit, or 0 if the backend doesn't number its submits.
+static uint64_t
+latest_submit(struct tm_application_o *app)
+{
+#if defined(USE_D3D11_BACKEND)
+    if (app->d3d11_backend)
+    {
+        struct tm_d3d11_statistics_t stats;
+        app->d3d11_backend->statistics(app->d3d11_backend->inst, &stats);
+        return stats.num_submits;
+    }
+#endif
+    return 0;
+}
+
+// Stores the GPU time of the latest frame that has been read back, if it is one of the measured
+// frames. Returns false if the backend doesn't report GPU timings.
+static bool
+read_gpu_timings(struct tm_application_o *app)
+{
+#if defined(USE_D3D11_BACKEND)
+    if (!app->d3d11_backend)
+        return false;
+
+    struct offscreen_t *off = &app->offscreen;
+    struct tm_d3d11_gpu_scope_timing_t frame_scope;
+    uint64_t submit;
+    const uint32_t num_scopes = app->d3d11_backend->gpu_timings(app->d3d11_backend->inst, &frame_scope, 1, &submit);
+    if (num_scopes && submit > off->base_submit && submit - off->base_submit <= app->options.offscreen_frames)
+        off->gpu_ms[submit - off->base_submit - 1] = frame_scope.duration * 1000.0;
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Writes the frame timings to `options_t.csv_path`. Frames whose GPU time was never read back
+// get an empty `gpu_ms` field.
+static void
+write_frame_timings(struct tm_application_o *app)
+{
+    const struct offscreen_t *off = &app->offscreen;
+    const char *path = app->options.csv_path;
+
+    char *csv = 0;
+    tm_carray_printf(&csv, &app->allocator, "frame,cpu_ms,gpu_ms\n");
+    for (uint32_t i = 0; i != app->options.offscreen_frames; ++i)
+    {
+        if (off->gpu_ms[i] >= 0.0)
+            tm_carray_printf(&csv, &app->allocator, "%u,%.4f,%.4f\n", i, off->cpu_ms[i], off->gpu_ms[i]);
+        else
+            tm_carray_printf(&csv, &app->allocator, "%u,%.4f,\n", i, off->cpu_ms[i]);
+    }
+
+    tm_file_o f = tm_os_api->file_io->open_output(path);
+    const bool ok = f.valid && tm_os_api->file_io->write(f, csv, tm_carray_size(csv));
+    if (f.valid)
+        tm_os_api->file_io->close(f);
+    tm_carray_free(csv, &app->allocator);
+
+    if (ok)
+        tm_logger_api->printf(TM_LOG_TYPE_INFO, "Wrote %u frame timings to `%s`", app->options.offscreen_frames, path);
+    else
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Failed to write frame timings to `%s`", path);
+}
+
+static bool
+tick_offscreen(struct tm_application_o *app)
+{
+    struct offscreen_t *off = &app->offscreen;
+    const uint32_t num_frames = app->options.offscreen_frames;
+
+    const tm_clock_o start = tm_os_api->time->now();
+    render_frame(app, off->target);
+    const double cpu_seconds = tm_os_api->time->delta(tm_os_api->time->now(), start);
+
+    if (off->frame < num_frames)
+        off->cpu_ms[off->frame] = cpu_seconds * 1000.0;
+    ++off->frame;
+
+    // Timings are read back a few submits late, so keep rendering until the last measured frame has
+    // been read back. Timings the backend dropped never show up, so give up after the longest
+    // supported latency.
+    bool done = !read_gpu_timings(app);
+#if defined(USE_D3D11_BACKEND)
+    done = done || off->gpu_ms[num_frames - 1] >= 0.0 || off->frame >= num_frames + TM_D3D11_MAX_GPU_TIMING_LATENCY;
+#endif
+    if (off->frame < num_frames || !done)
+        return true;
+
+    write_frame_timings(app);
+    return false;
+}
+
 static bool
 tick_application(struct tm_application_o *app)
 {
+    if (app->options.offscreen_frames)
+        return tick_offscreen(app);
+
     // Run message pump for all window
     tm_os_window_api->update_window(app->window.window);
 
-    // Slow down update rate when app is out of focus
-    struct tm_window_status_t win_status = tm_os_window_api->status(app->window.window);
-    const bool app_has_focus = win_status.has_focus || win_status.is_under_cursor;
-    if (!app_has_focus)
-        tm_os_api->thread->sleep(0.25f);
-
     if (tm_os_window_api->has_user_requested_close(app->window.window, true))
         return false;
 
+    // Pace the frame rate on the swap chain. Without one, slow down update rate when app is out
+    // of focus.
+    if (!wait_for_swap_chain(app, &app->window))
+    {
+        struct tm_window_status_t win_status = tm_os_window_api->status(app->window.window);
+        const bool app_has_focus = win_status.has_focus || win_status.is_under_cursor;
+        if (!app_has_focus)
+            tm_os_api->thread->sleep(0.25f);
+    }
+
+    render_window(app, &app->window);
+
     return true;
 }
 
@@ -140,6 +346,15 @@ create_window(struct tm_application_o *app, void *res_buf, tm_rect_t r, bool cen
 
     win->window = tm_os_window_api->create_window("The Machinery - Simple Triangle", r, window_style, 0);
 
+    const tm_window_platform_data_o platform_data = tm_os_window_api->platform_data(win->window);
+    const tm_renderer_swap_chain_t swap_chain = {
+        .window_handle = (void *)platform_data.opaque[0],
+        .width         = (uint32_t)r.w,
+        .height        = (uint32_t)r.h,
+    };
+    struct tm_renderer_backend_i *rb = app->render_backend;
+    win->swap_chain = rb->create_swap_chain(rb->inst, &swap_chain, app->device_affinity);
+
     return win;
 }
 
@@ -150,6 +365,44 @@ setup_initial_window(struct tm_application_o *app, void *res_buf)
     create_window(app, res_buf, rect, true);
 }
 
+// Creates the render target of offscreen mode, the same size as the initial window.
+static void
+setup_offscreen_target(struct tm_application_o *app, struct tm_renderer_resource_command_buffer_o *res_buf)
+{
+    struct offscreen_t *off = &app->offscreen;
+    const uint32_t num_frames = app->options.offscreen_frames;
+
+    const tm_renderer_image_desc_t desc = {
+        .type         = TM_RENDERER_IMAGE_TYPE_2D,
+        .usage_flags  = TM_RENDERER_IMAGE_USAGE_RENDER_TARGET,
+        .format       = TM_RENDERER_FORMAT_R8G8B8A8_UNORM,
+        .width        = 1440,
+        .height       = 900,
+        .depth        = 1,
+        .mip_levels   = 1,
+        .layer_count  = 1,
+        .sample_count = 1,
+        .debug_tag    = "offscreen_target",
+    };
+    off->target = tm_res_buf_api->create_image(res_buf, &desc, TM_RENDERER_DEVICE_AFFINITY_MASK_ALL);
+
+    off->cpu_ms = tm_alloc(&app->allocator, num_frames * sizeof(*off->cpu_ms));
+    off->gpu_ms = tm_alloc(&app->allocator, num_frames * sizeof(*off->gpu_ms));
+    for (uint32_t i = 0; i != num_frames; ++i)
+        off->gpu_ms[i] = -1.0;
+}
+
+static void
+shutdown_offscreen_target(struct tm_application_o *app, struct tm_renderer_resource_command_buffer_o *res_buf)
+{
+    struct offscreen_t *off = &app->offscreen;
+    const uint32_t num_frames = app->options.offscreen_frames;
+
+    tm_res_buf_api->destroy_resource(res_buf, off->target);
+    tm_free(&app->allocator, off->cpu_ms, num_frames * sizeof(*off->cpu_ms));
+    tm_free(&app->allocator, off->gpu_ms, num_frames * sizeof(*off->gpu_ms));
+}
+
 #if defined(USE_D3D11_BACKEND)
 
 static void
@@ -166,6 +419,21 @@ setup_render_backend(struct tm_application_o *app, bool vulkan_validation_layer)
 
     app->d3d11_backend->init(app->d3d11_backend->inst);
 
+    if (app->options.recording)
+        app->d3d11_backend->create_recording_device(app->d3d11_backend->inst);
+    else if (app->options.software)
+    {
+        // Only the software adapter, so the timings don't depend on the GPU of the machine.
+        const uint32_t flags = TM_D3D11_DEVICE_FLAG_SOFTWARE;
+        struct tm_d3d11_device_id wanted_device = { 0 };
+        if (!app->d3d11_backend->physical_device_id(app->d3d11_backend->inst, 0, flags, &wanted_device)
+            || !app->d3d11_backend->create_device(app->d3d11_backend->inst, wanted_device))
+        {
+            tm_logger_api->print(TM_LOG_TYPE_ERROR, "No software adapter, falling back to the recording device");
+            app->d3d11_backend->create_recording_device(app->d3d11_backend->inst);
+        }
+    }
+    else
     {
         uint32_t flags = TM_D3D11_DEVICE_FLAG_DISCRETE;
         uint32_t num_devices = app->d3d11_backend->num_physical_devices(app->d3d11_backend->inst, flags);
@@ -191,11 +459,19 @@ setup_render_backend(struct tm_application_o *app, bool vulkan_validation_layer)
 
         struct tm_d3d11_device_id wanted_device = { 0 };
         app->d3d11_backend->physical_device_id(app->d3d11_backend->inst, 0, flags, &wanted_device);
-        app->d3d11_backend->create_device(app->d3d11_backend->inst, wanted_device);
+        const bool created = app->d3d11_backend->create_device(app->d3d11_backend->inst, wanted_device);
 
-        app->render_backend = app->d3d11_backend->agnostic_render_backend(app->d3d11_backend->inst);
+        // Without D3D11, as on Linux, offscreen mode still runs on the recording device. It
+        // measures the CPU cost only.
+        if (!created && app->options.offscreen_frames)
+        {
+            tm_logger_api->print(TM_LOG_TYPE_INFO, "No D3D11 device, rendering offscreen on the recording device");
+            app->d3d11_backend->create_recording_device(app->d3d11_backend->inst);
+        }
     }
 
+    app->render_backend = app->d3d11_backend->agnostic_render_backend(app->d3d11_backend->inst);
+
     // Expose abstract render backend interfaces to the API registry.
     tm_add_or_remove_implementation(tm_global_api_registry, true, TM_RENDER_BACKEND_INTERFACE_NAME, app->render_backend);
 }
@@ -284,9 +560,409 @@ default_data_dir(struct tm_temp_allocator_i *ta, const char *exe)
     return tm_temp_allocator_api->printf(ta, "%.*sdata-simple-triangle/", (int)(exe_name - exe), exe);
 }
 
+// -------------------------------------------------------------------
+// Startup timeline
+
+#define MAX_TIMELINE_EVENTS 128
+
+struct timeline_event_t
+{
+    char name[64];
+
+    // Seconds since the start of the timeline.
+    double begin;
+    double end;
+};
+
+// Records how long each step of `create_application()` takes, logged once it is done.
+struct startup_timeline_t
+{
+    tm_clock_o start;
+
+    uint32_t num_events;
+
+    // Events that didn't fit in `events`.
+    uint32_t num_dropped;
+
+    struct timeline_event_t events[MAX_TIMELINE_EVENTS];
+};
+
+static double
+timeline__now(const struct startup_timeline_t *tl)
+{
+    return tm_os_api->time->delta(tm_os_api->time->now(), tl->start);
+}
+
+static void
+timeline__add(struct startup_timeline_t *tl, const char *name, double begin, double end)
+{
+    if (tl->num_events == MAX_TIMELINE_EVENTS)
+    {
+        ++tl->num_dropped;
+        return;
+    }
+
+    struct timeline_event_t *e = tl->events + tl->num_events++;
+    strncpy(e->name, name, sizeof(e->name) - 1);
+    e->name[sizeof(e->name) - 1] = 0;
+    e->begin = begin;
+    e->end = end;
+}
+
+// Adds the event `name` from `*t` to now and moves `*t` to now, for back to back steps.
+static void
+timeline__step(struct startup_timeline_t *tl, const char *name, double *t)
+{
+    const double now = timeline__now(tl);
+    timeline__add(tl, name, *t, now);
+    *t = now;
+}
+
+static void
+timeline__log(const struct startup_timeline_t *tl, struct tm_allocator_i *a)
+{
+    char *out = 0;
+    tm_carray_printf(&out, a, "Startup timeline, %.2f ms:\n", timeline__now(tl) * 1000.0);
+    for (const struct timeline_event_t *e = tl->events; e != tl->events + tl->num_events; ++e)
+    {
+        tm_carray_printf(&out, a, "  %8.2f - %8.2f ms %8.2f ms  %s\n", e->begin * 1000.0, e->end * 1000.0,
+            (e->end - e->begin) * 1000.0, e->name);
+    }
+    if (tl->num_dropped)
+        tm_carray_printf(&out, a, "  (%u more events not recorded)\n", tl->num_dropped);
+
+    tm_logger_api->print(TM_LOG_TYPE_INFO, out);
+    tm_carray_free(out, a);
+}
+
+// -------------------------------------------------------------------
+// Plugin loading
+
+// Plugin manifest looked for next to the executable. Lists the plugins the sample needs, see
+// `load_manifest_plugins()`.
+#define PLUGIN_MANIFEST "simple-triangle.plugins"
+
+#define MAX_MANIFEST_PLUGINS 32
+#define MAX_PLUGIN_DEPENDENCIES 8
+
+struct manifest_plugin_t
+{
+    char name[64];
+
+    // Path of the plugin file in the plugin directory.
+    const char *path;
+
+    // Indices of the plugins this one must be loaded after.
+    uint32_t dependencies[MAX_PLUGIN_DEPENDENCIES];
+    uint32_t num_dependencies;
+    TM_PAD(4);
+
+    // Written by `prefetch_plugin_job()`, in seconds since the start of the timeline.
+    double prefetch_begin;
+    double prefetch_end;
+    uint64_t prefetch_bytes;
+};
+
+struct prefetch_job_t
+{
+    struct manifest_plugin_t *plugin;
+    const struct startup_timeline_t *tl;
+};
+
+// Reads the whole plugin file and throws the data away, so the file is in the OS file cache when
+// the plugin is loaded.
+static void
+prefetch_plugin_job(void *data)
+{
+    struct prefetch_job_t *job = data;
+    struct manifest_plugin_t *p = job->plugin;
+    p->prefetch_begin = timeline__now(job->tl);
+
+    const uint64_t buffer_size = 1024 * 1024;
+    void *buffer = tm_alloc(tm_allocator_api->system, buffer_size);
+    tm_file_o f = tm_os_api->file_io->open_input(p->path);
+    if (f.valid)
+    {
+        int64_t n;
+        while ((n = tm_os_api->file_io->read(f, buffer, buffer_size)) > 0)
+            p->prefetch_bytes += (uint64_t)n;
+        tm_os_api->file_io->close(f);
+    }
+    tm_free(tm_allocator_api->system, buffer, buffer_size);
+
+    p->prefetch_end = timeline__now(job->tl);
+}
+
+// Returns true if `path` is the file of the plugin `name`: `name.dll` on Windows and
+// `libname.so` on Linux.
+static bool
+plugin_file_matches(const char *path, const char *name)
+{
+    const char *file = tm_path_api->base_cstr(path);
+    if (!strncmp(file, "lib", 3) && strncmp(name, "lib", 3))
+        file += 3;
+    const char *ext = strrchr(file, '.');
+    const size_t len = ext ? (size_t)(ext - file) : strlen(file);
+    return len == strlen(name) && !strncmp(file, name, len);
+}
+
+// Copies the next whitespace separated word of `*s` to `word` and advances `*s` past it. Stops at
+// the end of the line. Returns false if there are no more words on the line.
+static bool
+next_word(const char **s, char *word, uint32_t size)
+{
+    const char *c = *s;
+    while (*c == ' ' || *c == '\t' || *c == '\r')
+        ++c;
+    uint32_t n = 0;
+    while (*c && *c != ' ' && *c != '\t' && *c != '\r' && *c != '\n')
+    {
+        if (n + 1 < size)
+            word[n++] = *c;
+        ++c;
+    }
+    word[n] = 0;
+    *s = c;
+    return n > 0;
+}
+
+static const char *
+next_line(const char *s)
+{
+    const char *nl = strchr(s, '\n');
+    return nl ? nl + 1 : s + strlen(s);
+}
+
+static uint32_t
+find_manifest_plugin(const struct manifest_plugin_t *plugins, uint32_t n, const char *name)
+{
+    for (uint32_t i = 0; i != n; ++i)
+    {
+        if (!strcmp(plugins[i].name, name))
+            return i;
+    }
+    return UINT32_MAX;
+}
+
+// Parses the manifest `text` into `plugins`. Every line names a plugin, followed by the plugins it
+// must be loaded after. `#` starts a comment. Returns the number of plugins, or UINT32_MAX if the
+// manifest is invalid.
+static uint32_t
+parse_plugin_manifest(const char *text, struct manifest_plugin_t *plugins)
+{
+    uint32_t n = 0;
+    char word[64];
+
+    // All plugins are named before dependencies are resolved, so the lines can come in any order.
+    for (const char *line = text; *line; line = next_line(line))
+    {
+        const char *c = line;
+        if (!next_word(&c, word, sizeof(word)) || word[0] == '#')
+            continue;
+        if (n == MAX_MANIFEST_PLUGINS)
+        {
+            tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Plugin manifest: more than %u plugins", MAX_MANIFEST_PLUGINS);
+            return UINT32_MAX;
+        }
+        plugins[n++] = (struct manifest_plugin_t) { 0 };
+        strcpy(plugins[n - 1].name, word);
+    }
+
+    uint32_t i = 0;
+    for (const char *line = text; *line; line = next_line(line))
+    {
+        const char *c = line;
+        if (!next_word(&c, word, sizeof(word)) || word[0] == '#')
+            continue;
+        struct manifest_plugin_t *p = plugins + i++;
+        while (next_word(&c, word, sizeof(word)) && word[0] != '#')
+        {
+            const uint32_t dep = find_manifest_plugin(plugins, n, word);
+            if (dep == UINT32_MAX || p->num_dependencies == MAX_PLUGIN_DEPENDENCIES)
+            {
+                tm_logger_api->printf(TM_LOG_TYPE_ERROR, dep == UINT32_MAX ? "Plugin manifest: `%s` depends on unlisted plugin `%s`"
+                    : "Plugin manifest: `%s` has too many dependencies", p->name, word);
+                return UINT32_MAX;
+            }
+            p->dependencies[p->num_dependencies++] = dep;
+        }
+    }
+    return n;
+}
+
+// Appends plugin `i` to `order` after its dependencies. `state` is 0 for unvisited plugins, 1 for
+// plugins being visited and 2 for plugins in `order`. Returns false on a dependency cycle.
+static bool
+order_plugin(const struct manifest_plugin_t *plugins, uint32_t i, uint8_t *state, uint32_t *order, uint32_t *num_ordered)
+{
+    if (state[i] == 2)
+        return true;
+    if (state[i] == 1)
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Plugin manifest: dependency cycle through `%s`", plugins[i].name);
+        return false;
+    }
+
+    state[i] = 1;
+    for (uint32_t d = 0; d != plugins[i].num_dependencies; ++d)
+    {
+        if (!order_plugin(plugins, plugins[i].dependencies[d], state, order, num_ordered))
+            return false;
+    }
+    state[i] = 2;
+    order[(*num_ordered)++] = i;
+    return true;
+}
+
+// Loads only the plugins listed in the manifest at `manifest_path`, dependencies first. While the
+// plugins are loaded on this thread, jobs read the files of the ones further down the order so
+// they are already cached when their turn comes. Returns false without loading anything if there
+// is no manifest or it can't be used.
+static bool
+load_manifest_plugins(const char *manifest_path, const char **plugin_files, bool hot_reload,
+    struct startup_timeline_t *tl, struct tm_temp_allocator_i *ta)
+{
+    double t = timeline__now(tl);
+
+    const tm_file_stat_t stat = tm_os_api->file_system->stat(manifest_path);
+    if (!stat.exists)
+        return false;
+
+    char *text = tm_temp_alloc(ta, stat.size + 1);
+    tm_file_o f = tm_os_api->file_io->open_input(manifest_path);
+    const bool read = f.valid && tm_os_api->file_io->read(f, text, stat.size) == (int64_t)stat.size;
+    if (f.valid)
+        tm_os_api->file_io->close(f);
+    if (!read)
+    {
+        tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Failed to read plugin manifest `%s`", manifest_path);
+        return false;
+    }
+    text[stat.size] = 0;
+
+    struct manifest_plugin_t *plugins = tm_temp_alloc(ta, MAX_MANIFEST_PLUGINS * sizeof(*plugins));
+    const uint32_t n = parse_plugin_manifest(text, plugins);
+    if (n == UINT32_MAX)
+        return false;
+
+    for (uint32_t i = 0; i != n; ++i)
+    {
+        for (const char **file = plugin_files; file != tm_carray_end(plugin_files) && !plugins[i].path; ++file)
+        {
+            if (plugin_file_matches(*file, plugins[i].name))
+                plugins[i].path = *file;
+        }
+        if (!plugins[i].path)
+        {
+            tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Plugin manifest: plugin `%s` not found", plugins[i].name);
+            return false;
+        }
+    }
+
+    uint8_t state[MAX_MANIFEST_PLUGINS] = { 0 };
+    uint32_t order[MAX_MANIFEST_PLUGINS];
+    uint32_t num_ordered = 0;
+    for (uint32_t i = 0; i != n; ++i)
+    {
+        if (!order_plugin(plugins, i, state, order, &num_ordered))
+            return false;
+    }
+    timeline__step(tl, "read plugin manifest", &t);
+
+    // The file reads are independent and go to jobs, in load order. Loading stays on this thread:
+    // plugins register their APIs as they load and the OS loader serializes library loads anyway.
+    struct prefetch_job_t *jobs = tm_temp_alloc(ta, n * sizeof(*jobs));
+    tm_jobdecl_t *decls = tm_temp_alloc(ta, n * sizeof(*decls));
+    for (uint32_t i = 0; i != n; ++i)
+    {
+        jobs[i] = (struct prefetch_job_t) { .plugin = plugins + order[i], .tl = tl };
+        decls[i] = (tm_jobdecl_t) { .task = prefetch_plugin_job, .data = jobs + i };
+    }
+    tm_atomic_counter_o *counter = tm_job_system_api->run_jobs(decls, n);
+
+    for (uint32_t i = 0; i != n; ++i)
+    {
+        const struct manifest_plugin_t *p = plugins + order[i];
+        tm_plugins_api->load(p->path, hot_reload);
+        timeline__step(tl, tm_temp_allocator_api->printf(ta, "load %s", p->name), &t);
+    }
+
+    tm_job_system_api->wait_for_counter_and_free(counter);
+    for (uint32_t i = 0; i != n; ++i)
+    {
+        const struct manifest_plugin_t *p = plugins + order[i];
+        timeline__add(tl, tm_temp_allocator_api->printf(ta, "prefetch %s (%llu KB, job)", p->name,
+            (unsigned long long)(p->prefetch_bytes >> 10)), p->prefetch_begin, p->prefetch_end);
+    }
+    return true;
+}
+
+// Loads the plugins of the plugin directory next to the executable. If there is a plugin
+// manifest, only the plugins it lists are loaded, otherwise all of them, one after the other.
+static void
+load_plugins(const char *exe_path, bool all_plugins, bool hot_reload, struct startup_timeline_t *tl)
+{
+    TM_INIT_TEMP_ALLOCATOR(ta);
+
+    double t = timeline__now(tl);
+    const tm_str_t exe_dir = tm_path_api->directory(tm_str(exe_path));
+    const tm_str_t plugin_dir = tm_path_api->join(exe_dir, tm_str("plugins"), ta);
+    const char **plugins = tm_plugins_api->enumerate(tm_cstring(plugin_dir, ta), ta);
+    timeline__step(tl, "enumerate plugins", &t);
+
+    const tm_str_t manifest = tm_path_api->join(exe_dir, tm_str(PLUGIN_MANIFEST), ta);
+    if (all_plugins || !load_manifest_plugins(tm_cstring(manifest, ta), plugins, hot_reload, tl, ta))
+    {
+        t = timeline__now(tl);
+        for (const char **p = plugins; p != tm_carray_end(plugins); ++p)
+        {
+            tm_plugins_api->load(*p, hot_reload);
+            timeline__step(tl, tm_temp_allocator_api->printf(ta, "load %s", tm_path_api->base_cstr(*p)), &t);
+        }
+    }
+
+    TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
+}
+
+// Parses the command line:
+//
+//     simple-triangle [--offscreen=<frames>] [--csv=<path>] [--software] [--recording] [--all-plugins]
+//
+// `--offscreen` renders `<frames>` frames offscreen, writes their timings to `--csv` (default
+// `frame_times.csv`) and quits. `--software` and `--recording` pick the software adapter or the
+// recording device instead of a GPU. `--all-plugins` ignores the plugin manifest.
+static struct options_t
+parse_options(int argc, char **argv)
+{
+    struct options_t options = {
+        .csv_path = "frame_times.csv",
+    };
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strncmp(argv[i], "--offscreen=", 12))
+            options.offscreen_frames = (uint32_t)strtoul(argv[i] + 12, 0, 10);
+        else if (!strncmp(argv[i], "--csv=", 6))
+            options.csv_path = argv[i] + 6;
+        else if (!strcmp(argv[i], "--software"))
+            options.software = true;
+        else if (!strcmp(argv[i], "--recording"))
+            options.recording = true;
+        else if (!strcmp(argv[i], "--all-plugins"))
+            options.all_plugins = true;
+        else if (!strcmp(argv[i], "--hot-reload"))
+            ; // Handled by the host.
+        else
+            tm_logger_api->printf(TM_LOG_TYPE_ERROR, "Unknown option `%s`", argv[i]);
+    }
+    return options;
+}
+
 static tm_application_o *
 create_application(int argc, char **argv)
 {
+    struct startup_timeline_t tl = { .start = tm_os_api->time->now() };
+    const struct options_t options = parse_options(argc, argv);
+
 #if defined(TM_OS_WINDOWS)
     HINSTANCE hUser32 = LoadLibraryW(L"user32.dll");
     if (hUser32)
@@ -302,18 +978,9 @@ create_application(int argc, char **argv)
 
     // Attempt to load plugins
     const char *exe_path = tm_os_api->system->exe_path(argv[0]);
-    {
-        TM_INIT_TEMP_ALLOCATOR(ta);
-
-        const tm_str_t exe_dir = tm_path_api->directory(tm_str(exe_path));
-        const tm_str_t plugin_dir = tm_path_api->join(exe_dir, tm_str("plugins"), ta);
-        const char **plugins = tm_plugins_api->enumerate(tm_cstring(plugin_dir, ta), ta);
-        for (const char **p = plugins; p != tm_carray_end(plugins); ++p)
-            tm_plugins_api->load(*p, hot_reload_plugins);
-
-        TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
-    }
+    load_plugins(exe_path, options.all_plugins, hot_reload_plugins, &tl);
     tm_global_api_registry->log_missing_apis();
+    double t = timeline__now(&tl);
 
     const bool USE_END_OF_PAGE_ALLOCATOR = false;
     struct tm_allocator_i *standard_allocator = USE_END_OF_PAGE_ALLOCATOR ? tm_allocator_api->end_of_page : tm_allocator_api->system;
@@ -322,22 +989,27 @@ create_application(int argc, char **argv)
     struct tm_application_o *app = tm_alloc(&a, sizeof(*app));
     *app = (struct tm_application_o) {
         .allocator = a,
+        .options   = options,
     };
 
     TM_INIT_TEMP_ALLOCATOR(ta);
 
     // Initialize the render plugin, setup APIs
     init_renderer_plugin(&app->allocator);
+    timeline__step(&tl, "init renderer", &t);
 
     // Initialize and setup the truth
     app->tt = tm_the_truth_api->create(&app->allocator, TM_THE_TRUTH_CREATE_TYPES_ALL);
+    timeline__step(&tl, "create the truth", &t);
 
     // Setup render backend and create device
     const bool vulkan_validation = false;
     setup_render_backend(app, vulkan_validation);
+    timeline__step(&tl, "setup render backend", &t);
 
     // Setup DXC Shader compiler
     tm_dxc_shader_compiler_api->init();
+    timeline__step(&tl, "init shader compiler", &t);
 
     // Load shaders
     struct tm_renderer_resource_command_buffer_o *res_buf = 0;
@@ -353,13 +1025,22 @@ create_application(int argc, char **argv)
     memcpy(app->shader_dir, shader_dir, l);
     tm_shader_repository_api->update_shaders_from_directory(app->shader_repository, shader_dir, false,
         &app->allocator, res_buf);
+    timeline__step(&tl, "load shaders", &t);
 
-    // Create default window and initialize swap chain.
-    setup_initial_window(app, (void*)0);
+    // Create default window and initialize swap chain, or the render target of offscreen mode.
+    if (app->options.offscreen_frames)
+        setup_offscreen_target(app, res_buf);
+    else
+        setup_initial_window(app, (void*)0);
 
     rb->submit_resource_command_buffers(rb->inst, &res_buf, 1);
     rb->destroy_resource_command_buffers(rb->inst, &res_buf, 1);
 
+    app->offscreen.base_submit = latest_submit(app);
+    timeline__step(&tl, app->options.offscreen_frames ? "create offscreen target" : "create window", &t);
+
+    timeline__log(&tl, &app->allocator);
+
     TM_SHUTDOWN_TEMP_ALLOCATOR(ta);
     return app;
 }
@@ -375,8 +1056,13 @@ destroy_application(struct tm_application_o *app)
     tm_shader_repository_api->destroy(app->shader_repository, res_buf);
     tm_free(&app->allocator, app->shader_dir, strlen(app->shader_dir) + 1);
 
-    // TODO: destroy_swap_chain
-    // TODO: destroy_window
+    if (app->options.offscreen_frames)
+        shutdown_offscreen_target(app, res_buf);
+    else
+    {
+        rb->destroy_swap_chain(rb->inst, app->window.swap_chain, app->device_affinity);
+        // TODO: destroy_window
+    }
 
     rb->submit_resource_command_buffers(rb->inst, &res_buf, 1);
     rb->destroy_resource_command_buffers(rb->inst, &res_buf, 1);
@@ -413,6 +1099,7 @@ TM_DLL_EXPORT void tm_load_plugin(struct tm_api_registry_api *reg, bool load)
     tm_plugins_api             = reg->get(TM_PLUGINS_API_NAME);
     tm_temp_allocator_api      = reg->get(TM_TEMP_ALLOCATOR_API_NAME);
     tm_the_truth_api           = reg->get(TM_THE_TRUTH_API_NAME);
+    tm_job_system_api          = reg->get(TM_JOB_SYSTEM_API_NAME);
 
     // other plugin apis
     tm_dxc_shader_compiler_api = reg->get(TM_DXC_SHADER_COMPILER_API_NAME);